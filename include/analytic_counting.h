@@ -0,0 +1,46 @@
+#pragma once
+#include "graph.h"
+#include "pattern.h"
+
+#include <mutex>
+
+// Counts of the trees of diameter at most 3 without enumeration: stars (the
+// wedge among them) and double stars (two adjacent centers with a and b
+// leaves, the path of 4 vertices among them). Each count is one parallel
+// pass over the degrees or the edges of the graph:
+//   star of k leaves             sum_v C(d_v, k)
+//   double star of a, b leaves   sum_(u,v) sum_i C(t_uv, i) C(d_u - 1 - t_uv, a - i) C(d_v - 1 - i, b)
+// where t_uv is the number of triangles on edge (u, v): the leaves of u are
+// chosen with i of them among the common neighbors, which the leaves of v
+// have to avoid. For a = b = 1 this is sum (d_u - 1)(d_v - 1) - 3 triangles.
+// Longer paths and the other depth-2 trees also need the 4-cycles, so they
+// are left to pattern_matching.
+//
+// The triangles per edge are found by Graph::edge_support() on the first
+// count that needs them and kept for the next ones; a counter can be shared
+// by threads. The counts are those of pattern_matching.
+class AnalyticCounter {
+public:
+    AnalyticCounter(Graph* _g) : g(_g), support(nullptr) {}
+    ~AnalyticCounter() { delete[] support; }
+
+    // whether count() applies: an edge-induced star or double star, or the
+    // vertex-induced wedge (wedges that are not in a triangle)
+    static bool is_supported(const Pattern& pattern, bool vertex_induced = false);
+    long long count(const Pattern& pattern, bool vertex_induced = false);
+
+    long long count_star(int leaf_num);
+    long long count_double_star(int leaf_num_a, int leaf_num_b);
+    long long count_triangles();
+
+private:
+    Graph* g;
+    int* support;
+    std::once_flag support_flag;
+
+    const int* get_support();
+    // the sizes of the two centers' leaf sets, false if pattern is not a double star
+    static bool get_double_star(const Pattern& pattern, int& leaf_num_a, int& leaf_num_b);
+    AnalyticCounter(const AnalyticCounter&) = delete;
+    AnalyticCounter& operator = (const AnalyticCounter&) = delete;
+};
@@ -0,0 +1,36 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+
+// Cooperative cancellation of a long running count. The engine polls
+// is_cancelled() between chunks of start vertices and every few iterations of
+// its outermost loop, so a run stops shortly after cancel() is called or the
+// deadline passes.
+class CancelToken {
+public:
+    // no deadline if seconds < 0
+    CancelToken(double seconds = -1) : cancelled(false), has_deadline(seconds >= 0) {
+        if (has_deadline)
+            deadline = std::chrono::steady_clock::now() +
+                       std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+    }
+    CancelToken(const CancelToken &t) = delete;
+    CancelToken &operator=(const CancelToken &t) = delete;
+
+    inline void cancel() { cancelled.store(true, std::memory_order_relaxed); }
+
+    inline bool is_cancelled() const {
+        if (cancelled.load(std::memory_order_relaxed))
+            return true;
+        if (has_deadline && std::chrono::steady_clock::now() >= deadline) {
+            cancelled.store(true, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+private:
+    mutable std::atomic<bool> cancelled;
+    bool has_deadline;
+    std::chrono::steady_clock::time_point deadline;
+};
@@ -0,0 +1,65 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Canonical labeling and automorphism group of a small (possibly directed,
+// vertex-colored) graph, by partition refinement as in nauty.
+//
+// The vertices are split into cells until the partition is equitable: the
+// vertices of a cell have the same numbers of out- and in-neighbors in each
+// cell. The search tree individualizes each vertex of the first non-trivial
+// cell and refines again, its leaves are discrete partitions, i.e. vertex
+// orders. Two leaves with the same relabeled graph give an automorphism, the
+// canonical order is the leaf whose relabeled graph has the largest code.
+// A child is skipped if an automorphism fixing the path to its node maps it to
+// an explored one, and once a leaf is found equivalent to an earlier one, the
+// search goes back to their common ancestor. So symmetric patterns only cost
+// a few leaves per level instead of the size! orders.
+class CanonicalLabeling
+{
+public:
+    // adj_mat[INDEX(i, j, size)] != 0 for the edge i -> j,
+    // vertices of different colors are never mapped to each other
+    CanonicalLabeling(const int* adj_mat, int size, const int* color = nullptr);
+
+    // order[i] is the vertex at position i of the canonical relabeling
+    inline const std::vector<int>& get_order() const { return canonical_order; }
+    // the same for isomorphic graphs (with the same colors) and different ones otherwise
+    inline const std::string& get_code() const { return canonical_code; }
+    // generators of the automorphism group, automorphism[i] is the image of vertex i
+    inline const std::vector< std::vector<int> >& get_generators() const { return generators; }
+    // orbit of each vertex under the automorphisms, numbered by their first vertex
+    inline const std::vector<int>& get_orbits() const { return orbits; }
+    inline long long get_automorphism_num() const { return automorphism_num; }
+    // every automorphism, in lexicographical order
+    std::vector< std::vector<int> > get_automorphisms() const;
+
+private:
+    int size;
+    const int* adj_mat;
+    const int* color;
+    bool is_directed;
+
+    std::vector<int> canonical_order;
+    std::string canonical_code;
+    std::vector< std::vector<int> > generators;
+    std::vector<int> orbits;
+    long long automorphism_num;
+
+    // the leftmost leaf, on which the group is built
+    std::vector<int> first_path;
+    std::vector<int> first_order;
+    std::string first_code;
+    std::vector<int> best_path;
+    int jump_depth; // the search returns to the node of this depth, -1 if it does not
+
+    void refine(std::vector< std::vector<int> >& cells) const;
+    void search(std::vector< std::vector<int> >& cells, std::vector<int>& path);
+    void visit_leaf(const std::vector< std::vector<int> >& cells, const std::vector<int>& path);
+    std::string get_code(const std::vector<int>& order) const;
+    void add_automorphism(const std::vector<int>& from, const std::vector<int>& to);
+    // orbits of the group generated by the generators that fix the first fixed_num vertices of path
+    void get_stabilizer_orbits(const std::vector<int>& path, int fixed_num, std::vector<int>& orbit) const;
+    // coset representatives of the stabilizer of first_path[0, depth] in that of first_path[0, depth)
+    void get_transversal(int depth, std::vector< std::vector<int> >& transversal) const;
+};
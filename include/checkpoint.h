@@ -0,0 +1,93 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Periodic checkpoint of a long run so that it can resume after being killed.
+//
+// A run is split into stages (e.g. the unlabeled patterns of FSM), each stage
+// into independent units of work (chunks of start vertices, FSM jobs). Workers
+// report a finished unit with finish(), which only touches an atomic bitmap.
+// A background thread writes the finished units, their summed answers, the
+// count carried over from earlier stages and an optional shared bitvector
+// (FSM's is_frequent) to the file every `interval` seconds. The file is
+// written to a temporary name and renamed, so a crash never leaves a torn
+// checkpoint behind.
+//
+// With restart = true, restore() loads the file if it was written for the same
+// key and begin_stage() keeps the finished units of the saved stage, which the
+// caller then skips.
+class Checkpoint {
+public:
+    Checkpoint(const char *_file_name, bool _restart = false, double _interval = 60);
+    Checkpoint(const Checkpoint &c) = delete;
+    Checkpoint &operator=(const Checkpoint &c) = delete;
+    // stops the writer thread after a last save
+    ~Checkpoint();
+
+    // Identifies the run (graph, pattern, parameters). Returns true if progress
+    // for this key was loaded from the file.
+    bool restore(const std::string &_key);
+    // stage and base count of the loaded checkpoint, 0 if nothing was loaded
+    inline long long get_restored_stage() const { return restored_stage; }
+    inline long long get_restored_base() const { return restored_base; }
+    // copies the loaded bitvector into bits (len words), returns false if none of that length was saved
+    bool get_restored_bits(unsigned int *bits, size_t len) const;
+
+    // Starts a stage of unit_num units. base is the count of the earlier
+    // stages. Units finished in the restored checkpoint of the same stage
+    // stay finished. Returns the summed answer of those units.
+    long long begin_stage(long long stage, long long base, long long unit_num);
+    // bits (len words) are saved with every checkpoint, until the next call
+    void set_bits(const unsigned int *bits, size_t len);
+
+    inline bool is_finished(long long unit) const {
+        return finished[unit >> 6].load(std::memory_order_relaxed) >> (unit & 63) & 1;
+    }
+    // may be called concurrently, once per unit
+    inline void finish(long long unit, long long ans) {
+        unit_ans[unit] = ans;
+        finished[unit >> 6].fetch_or(1ULL << (unit & 63), std::memory_order_release);
+        dirty.store(true, std::memory_order_relaxed);
+    }
+
+    // writes the checkpoint now
+    void save();
+
+private:
+    std::string file_name;
+    std::string key;
+    bool restart;
+    double interval;
+
+    long long restored_stage;
+    long long restored_base;
+    long long restored_unit_num;
+    long long restored_ans;
+    std::vector<uint64_t> restored_finished;
+    std::vector<unsigned int> restored_bits;
+
+    // current stage, guarded by stage_mutex against the writer
+    long long stage;
+    long long base;
+    long long unit_num;
+    long long stage_restored_ans; // answer of the units finished before the restart
+    std::atomic<uint64_t> *finished;
+    long long *unit_ans;
+    const unsigned int *bits;
+    size_t bits_len;
+    std::atomic<bool> dirty;
+    std::mutex stage_mutex;
+
+    std::thread writer;
+    std::mutex writer_mutex;
+    std::condition_variable writer_cv;
+    bool stopped;
+
+    void writer_loop();
+    bool load();
+};
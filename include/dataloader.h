@@ -25,16 +25,6 @@ enum DataType {
     Invalid
 };
 
-constexpr long long Patents_tri_cnt = 7515023LL;
-constexpr long long LiveJournal_tri_cnt = 177820130LL;
-constexpr long long MiCo_tri_cnt = 12534960LL;
-constexpr long long CiteSeer_tri_cnt = 1166LL;
-constexpr long long Wiki_Vote_tri_cnt = 608389LL;
-constexpr long long Orkut_tri_cnt = 627584181LL;
-constexpr long long Twitter_tri_cnt = 34824916864LL;
-constexpr long long YouTube_tri_cnt = 103017122LL;
-constexpr long long Friendster_tri_cnt = 4173724142LL;
-
 class DataLoader {
 public:
 
@@ -50,7 +40,16 @@ public:
         
     bool load_data(Graph* &g, int clique_size);
 
-    bool fast_load(Graph* &g, const char* path);
+    // With use_mmap the vertex and edge arrays are mapped from the file
+    // instead of read, so the pages are shared with the page cache and only
+    // touched when a query reads them. Writes (e.g. reduce_edges_for_clique)
+    // stay private to the process. The statistics missing from files of
+    // older formats are counted on the first load and saved next to the file
+    // as path + ".stats", for as long as the file is not modified.
+    bool fast_load(Graph* &g, const char* path, bool use_mmap = false);
+
+    // binary graph file for fast_load, with the statistics of the performance model (counted first if missing)
+    bool fast_dump(Graph* g, const char* path);
 
     bool load_complete(Graph* &g, int clique_size);
 
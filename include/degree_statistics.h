@@ -0,0 +1,44 @@
+#pragma once
+#include "types.h"
+
+#include <cstdint>
+
+class Graph;
+
+// Degree-conditioned statistics of a graph for the performance model of
+// Schedule_IEP. Vertices are grouped into buckets by the bit length of their
+// degree (bucket 0: isolated vertices, bucket b: degree in [2^(b-1), 2^b)).
+//
+// The histograms and the edge counts between buckets are exact, the rest is
+// sampled from uniform edges and uniform wedges (paths u - v - w). Means of
+// bucket pairs with fewer than min_samples samples are -1.
+//
+// The struct is plain data, it is written to the binary graph files as is.
+struct DegreeStatistics {
+    static const int bucket_num = 32;
+    static const int min_samples = 8;
+
+    static inline int get_bucket(long long degree) { return degree == 0 ? 0 : 64 - __builtin_clzll(degree); }
+
+    double vertex_cnt[bucket_num];
+    double avg_degree[bucket_num];
+    // fraction of the wedges centered at a vertex of the bucket that are closed
+    double clustering[bucket_num];
+    // distribution of the common neighbors of the edges over the buckets
+    double triangle_rate[bucket_num];
+    // distribution of the neighbors of the vertices of bucket a over the buckets
+    double neighbor_rate[bucket_num][bucket_num];
+    // mean |N(u) & N(v)| of the edges (u, v)
+    double edge_common[bucket_num][bucket_num];
+    // mean |N(u) & N(w)| of the endpoints of the wedges u - v - w
+    double wedge_common[bucket_num][bucket_num];
+    // (sum of d^2 - d) / (sum of d)^2, the mean |N(u) & N(v)| / (d(u) * d(v))
+    // of two random vertices in a configuration model
+    double random_common_rate;
+    uint32_t checksum;
+    // slope of the rank of the vertex id on the rank of the degree, 0 in the
+    // files written before it was kept (in the place of their padding)
+    float id_slope;
+
+    void compute(const Graph& g, long long sample_cnt = 1 << 16, unsigned long long seed = 0);
+};
@@ -0,0 +1,110 @@
+#pragma once
+#include "graph.h"
+#include "pattern.h"
+#include "types.h"
+
+#include <vector>
+
+struct EdgeUpdate {
+    v_index_t u, v;
+    bool insert; // false: delete
+};
+
+// A graph that changes by batches of edge insertions and deletions, on top of
+// a CSR base (a Graph) and a sorted delta list per vertex. The counts of the
+// registered patterns are maintained incrementally.
+//
+// The updates of a batch are applied in order. Update i changes the count by
+// the number of subgraphs that contain its edge in the graph as it was just
+// before update i, plus that edge. Those subgraphs are found by searching
+// outward from the edge, on a view of the graph that only includes the
+// updates before i. An embedding with several changed edges is therefore
+// counted once, at its first changed edge. The searches of a batch are
+// independent and run in parallel, and their cost depends only on the
+// neighborhoods of the changed edges.
+//
+// The initial counts use Schedule_IEP and pattern_matching. The anchored
+// searches do not: the engine walks a CSR, while a search must see the graph
+// as of its own update, base lists merged with the delta entries before it.
+// So each search is a plain backtracking over a fixed order that starts with
+// the changed edge and then takes the vertex with most placed neighbors. A
+// vertex with later neighbors has its merged list built once per placement,
+// and the candidates are intersected with intersect_simd4x. It has neither
+// the restrictions nor IEP of the engine, so an update costs about the number
+// of embeddings (automorphic copies included) that map an anchor edge onto
+// its edge; symmetric patterns with large counts around hub edges are better
+// recounted on get_graph().
+//
+// Once the delta lists hold more than compact_ratio * e_cnt entries they are
+// merged into a new CSR.
+class DynamicGraph {
+public:
+    // takes the ownership of _graph
+    DynamicGraph(Graph *_graph, double _compact_ratio = 0.05);
+    DynamicGraph(const DynamicGraph &g) = delete;
+    DynamicGraph &operator=(const DynamicGraph &g) = delete;
+    ~DynamicGraph();
+
+    // counts pattern (edge-induced, connected) on the current graph with Schedule_IEP and maintains it from now on
+    int add_pattern(const Pattern &pattern);
+    inline long long get_count(int pattern_id) const { return patterns[pattern_id].count; }
+
+    // Applies the updates in order, inserting an existing edge or deleting a
+    // missing one is ignored. Returns the number of updates that changed the graph.
+    int apply_batch(const std::vector<EdgeUpdate> &batch);
+
+    bool has_edge(v_index_t u, v_index_t v) const;
+    inline v_index_t get_v_cnt() const { return graph->v_cnt; }
+    inline e_index_t get_delta_size() const { return delta_size; }
+
+    // merges the delta lists into the CSR base and recomputes its statistics (Graph::compute_statistics)
+    void compact();
+    // the current graph as a CSR, compacted first
+    Graph *get_graph();
+
+private:
+    // time is the position of the update in the current batch, -1 once applied
+    struct DeltaEntry {
+        v_index_t v;
+        int time;
+        bool insert;
+        bool operator<(const DeltaEntry &e) const { return v < e.v || (v == e.v && time < e.time); }
+    };
+
+    // A matching order that starts with a pattern edge (a, b), used for the
+    // embeddings mapping a to u and b to v. Pattern edges in the same orbit of
+    // the automorphisms give the same count, so one anchor stands for the
+    // whole orbit.
+    struct Anchor {
+        long long multiplicity;
+        std::vector<int> order;                   // pattern vertices, order[0] = a, order[1] = b
+        std::vector<std::vector<int> > neighbors; // earlier positions adjacent to each position
+        std::vector<bool> has_later_neighbor;
+    };
+
+    struct MaintainedPattern {
+        int size;
+        long long automorphism_num;
+        std::vector<Anchor> anchors;
+        long long count;
+    };
+
+    // per thread buffers of the anchored search
+    struct SearchBuffer {
+        std::vector<std::vector<v_index_t> > neighbors; // of the vertex at each position
+        std::vector<std::vector<v_index_t> > candidates[2]; // intersections at each position, in turn
+        std::vector<v_index_t> embedding;
+    };
+
+    Graph *graph;
+    double compact_ratio;
+    std::vector<std::vector<DeltaEntry> > delta;
+    e_index_t delta_size;
+    std::vector<MaintainedPattern> patterns;
+
+    bool in_base(v_index_t u, v_index_t v) const;
+    // neighbors of x in the graph after the updates before time (and all applied ones), with the edge (forced_u, forced_v)
+    void get_neighbors(v_index_t x, int time, v_index_t forced_u, v_index_t forced_v, std::vector<v_index_t> &neighbors) const;
+    long long count_anchored(const MaintainedPattern &pattern, const Anchor &anchor, v_index_t u, v_index_t v, int time, SearchBuffer &buffer) const;
+    long long count_anchored_func(const Anchor &anchor, int size, int depth, int time, v_index_t forced_u, v_index_t forced_v, SearchBuffer &buffer) const;
+};
@@ -0,0 +1,136 @@
+#pragma once
+#include "types.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+
+// A fixed-size buffer of complete embeddings. Each embedding occupies
+// pattern_size consecutive slots, listed in the vertex order of the schedule
+// that produced it (i.e. the order of schedule.get_adj_mat_ptr()).
+class EmbeddingBatch {
+public:
+    EmbeddingBatch(int _pattern_size, int _capacity);
+    EmbeddingBatch(const EmbeddingBatch &b) = delete;
+    EmbeddingBatch &operator=(const EmbeddingBatch &b) = delete;
+    ~EmbeddingBatch();
+
+    inline int get_size() const { return size; }
+    inline int get_capacity() const { return capacity; }
+    inline int get_pattern_size() const { return pattern_size; }
+    inline bool full() const { return size == capacity; }
+    inline const v_index_t *get_embedding(int i) const { return data + (int64_t)i * pattern_size; }
+    inline const v_index_t *get_data_ptr() const { return data; }
+    // returns the slots of a new embedding, the caller fills all of them
+    inline v_index_t *append() { return data + (int64_t)(size++) * pattern_size; }
+    inline void clear() { size = 0; }
+    // exchange buffers (and capacities) with another batch of the same pattern size, no copy
+    void swap(EmbeddingBatch &b);
+
+private:
+    v_index_t *data;
+    int size;
+    int capacity;
+    int pattern_size;
+};
+
+// Receives batches from the enumeration engine. consume() is called
+// concurrently by every worker thread with its own batch, either when the
+// batch is full or once at the end with the remaining embeddings. The batch is
+// cleared by the caller afterwards, so an implementation must copy or swap
+// out anything it wants to keep.
+class EmbeddingSink {
+public:
+    virtual ~EmbeddingSink() {}
+    virtual void consume(EmbeddingBatch &batch) = 0;
+};
+
+// Hands each batch to a user function. The function runs on the worker thread
+// and must be thread safe.
+class EmbeddingCallbackSink : public EmbeddingSink {
+public:
+    EmbeddingCallbackSink(std::function<void(const EmbeddingBatch &)> _callback) : callback(_callback) {}
+    void consume(EmbeddingBatch &batch) override { callback(batch); }
+
+private:
+    std::function<void(const EmbeddingBatch &)> callback;
+};
+
+// Bounded lock-free queue between the enumeration threads (producers) and any
+// number of consumer threads. Batches are recycled through a free list, so no
+// memory is allocated after construction. When all batches are in flight the
+// producers wait, which throttles enumeration to the speed of the consumers.
+//
+// consumer loop:
+//     for (EmbeddingBatch *b; (b = queue.pop()) != nullptr; queue.release(b))
+//         ...
+// The producer side must call close() after the enumeration returns.
+class EmbeddingQueue : public EmbeddingSink {
+public:
+    EmbeddingQueue(int pattern_size, int batch_capacity, int queue_capacity = 64);
+    EmbeddingQueue(const EmbeddingQueue &q) = delete;
+    EmbeddingQueue &operator=(const EmbeddingQueue &q) = delete;
+    ~EmbeddingQueue();
+
+    void consume(EmbeddingBatch &batch) override;
+    // blocks until a batch is available, returns nullptr once closed and drained
+    EmbeddingBatch *pop();
+    // gives a batch returned by pop() back to the producers
+    void release(EmbeddingBatch *batch);
+    void close();
+
+private:
+    // Vyukov's bounded MPMC ring of batch pointers
+    class Ring {
+    public:
+        void init(int capacity);
+        ~Ring();
+        bool push(EmbeddingBatch *batch);
+        bool pop(EmbeddingBatch *&batch);
+
+    private:
+        struct Cell {
+            std::atomic<uint64_t> seq;
+            EmbeddingBatch *batch;
+        };
+        Cell *cells = nullptr;
+        uint64_t mask;
+        alignas(64) std::atomic<uint64_t> head;
+        alignas(64) std::atomic<uint64_t> tail;
+    };
+
+    Ring full_ring, free_ring;
+    EmbeddingBatch **batches;
+    int batch_num;
+    std::atomic<bool> closed;
+};
+
+// Writes embeddings to a compact binary file:
+//     uint32 magic, uint32 pattern_size, uint64 embedding count,
+//     followed by count * pattern_size vertex ids (v_index_t).
+// Batches can be forwarded to another sink after being written.
+class EmbeddingFileSink : public EmbeddingSink {
+public:
+    static const uint32_t magic = 0x424d4547; // "GEMB"
+
+    EmbeddingFileSink(const char *path, int _pattern_size, EmbeddingSink *_next = nullptr);
+    ~EmbeddingFileSink();
+
+    void consume(EmbeddingBatch &batch) override;
+    // flush and write the final count into the header, called by the destructor
+    void close();
+    inline bool is_open() const { return fp != nullptr; }
+    inline uint64_t get_embedding_cnt() const { return embedding_cnt; }
+
+    // reads the header of a file written by this class, returns false on mismatch
+    static bool read_header(FILE *fp, int &pattern_size, uint64_t &embedding_cnt);
+
+private:
+    FILE *fp;
+    int pattern_size;
+    uint64_t embedding_cnt;
+    EmbeddingSink *next;
+    std::mutex lock;
+};
@@ -1,42 +1,98 @@
 #pragma once
 #include "types.h"
 #include "schedule_IEP.h"
+#include "schedule_plan.h"
 #include "vertex_set.h"
+#include "multi_schedule.h"
 
+#include <atomic>
 #include <cassert>
 #include <cstdint>
+#include <sys/mman.h>
 
 constexpr int chunk_size = 100;
 
+// how Graph::pattern_matching_estimate draws its samples
+enum class SampleType {
+    Vertex, // a uniform random vertex as the first vertex of the schedule
+    Edge    // a uniform random (directed) edge as the first two vertices
+};
+
+// result of Graph::pattern_matching_partial, already divided by the IEP redundancy
+struct PartialCount {
+    long long ans;             // embeddings found from the finished start vertices
+    double completed_fraction; // share of the start vertices that were finished
+    double estimate;           // ans / completed_fraction, biased low if not finished
+    bool finished;             // every start vertex was finished
+};
+
+// result of Graph::pattern_matching_estimate, already divided by the IEP redundancy
+struct CountEstimate {
+    double estimate;
+    double lower, upper;   // confidence interval
+    double relative_error; // half width of the interval / estimate
+    long long sample_cnt;
+    bool converged;        // the requested relative error was reached, never while every sample is 0
+};
+
 class Graphmpi;
+class CancelToken;
+class Checkpoint;
+class EmbeddingBatch;
+class EmbeddingSink;
 class Graph {
 public:
     v_index_t v_cnt; // number of vertex
     e_index_t e_cnt; // number of edge
-    long long tri_cnt; // number of triangle
+    long long tri_cnt; // number of triangle, -1 if unknown
+    long long wedge_cnt; // number of paths of length 2, sum of C(d, 2)
+    v_index_t max_degree;
+    DegreeStatistics* degree_stats; // of the performance model, nullptr if not computed
     double max_running_time = 60 * 60 * 24; // second
     v_index_t *edge, *edge_from; // edges
     e_index_t *vertex; // v_i's neighbor is in edge[ vertex[i], vertex[i+1]-1]
+    // vertex and edge point into this private mapping of the graph file if
+    // it is not null (DataLoader::fast_load with use_mmap), not to new[] arrays
+    void *mapped_data;
+    size_t mapped_len;
     
     Graph() {
         v_cnt = 0;
         e_cnt = 0LL;
+        tri_cnt = -1;
+        wedge_cnt = 0;
+        max_degree = 0;
+        degree_stats = nullptr;
         edge = nullptr;
         vertex = nullptr;
         edge_from = nullptr;
+        mapped_data = nullptr;
+        mapped_len = 0;
+        max_intersection_size = -1;
     }
 
     ~Graph() {
-        if(edge != nullptr) delete[] edge;
-        if(vertex != nullptr) delete[] vertex;
+        if (mapped_data != nullptr)
+            munmap(mapped_data, mapped_len);
+        else {
+            if(edge != nullptr) delete[] edge;
+            if(vertex != nullptr) delete[] vertex;
+        }
         if (edge_from != nullptr) delete[] edge_from;
+        delete degree_stats;
     }
 
     int intersection_size(v_index_t v1,v_index_t v2);
-    int intersection_size_mpi(v_index_t v1,v_index_t v2);
+    int intersection_size_mpi(Graphmpi& gm, v_index_t v1,v_index_t v2);
     int intersection_size_clique(v_index_t v1,v_index_t v2);
     void build_reverse_edges();
 
+    // Capacity of the intersection buffers of the engine on this graph, the
+    // second largest degree unless a loader set it. Every run sizes its own
+    // buffers by it, so runs on different graphs can share a process.
+    int get_max_intersection_size() const;
+    inline void set_max_intersection_size(int size) { max_intersection_size.store(size, std::memory_order_relaxed); }
+
 /*    long long intersection_times_low;
     long long intersection_times_high;
     long long dep1_cnt;
@@ -46,26 +102,156 @@ public:
     //single thread triangle counting
     long long triangle_counting();
     
-    //multi thread triangle counting
+    // Multi thread triangle counting on the degree-oriented CSR: every
+    // triangle is counted once from its edge u -> v as |out(u) & out(v)|,
+    // with SIMD intersections, or with a bitmap of out(u) if u is a hub. The
+    // out edges are split into tasks of about equal estimated cost, so the
+    // edges of a hub are shared by several threads.
     long long triangle_counting_mt();
 
-    //multi thread triangle counting with mpi
-    long long triangle_counting_mpi();
+    // triangle counting with multi thread and multi process, vertices are handed out by Graphmpi
+    long long triangle_counting_mpi(int thread_count);
+
+    // Number of k-cliques. Like triangle_counting_mt, every clique is found
+    // once on the degree-oriented CSR, from its lowest edge u -> v, by
+    // intersecting out-neighborhoods down to the last two levels, which are
+    // counted. The graph itself is not changed (unlike
+    // reduce_edges_for_clique), so it can be shared by other queries.
+    long long clique_counting(int k);
+
+    // Estimates the number of triangles from sample_cnt uniform wedges (paths
+    // u - v - w): a third of the wedges are closed once per triangle, so
+    // tri_cnt ~ closed fraction * wedge_cnt / 3. The relative error is about
+    // 1 / sqrt(closed samples).
+    long long triangle_counting_estimate(long long sample_cnt = 1 << 22, unsigned long long seed = 0) const;
+
+    // Sets the statistics of the performance model: wedge_cnt, max_degree and
+    // degree_stats, and tri_cnt, counted exactly on graphs of at most
+    // exact_triangle_limit edges and estimated above.
+    void compute_statistics(e_index_t exact_triangle_limit = 1LL << 32);
 
     //general pattern matching algorithm with multi thread
-    long long pattern_matching(const Schedule_IEP& schedule, bool clique = false);
+    //stops after max_running_time and returns the count found until then
+    //finished chunks of start vertices are saved to checkpoint if given
+    long long pattern_matching(const Schedule_IEP& schedule, bool clique = false, Checkpoint* checkpoint = nullptr);
+
+    // Pattern matching that can stop early. Start vertices are taken in
+    // chunks in a fixed pseudo-random order and only finished chunks are
+    // counted, so the partial count is exact for the finished start vertices.
+    // Scaled by the finished fraction it is only a rough estimate of the
+    // total, biased low: the chunks still running when the run stops are
+    // dropped, and those are the expensive ones. Stops when token is
+    // cancelled, or after max_running_time if no token is given. With a
+    // checkpoint, finished chunks are saved in the background and a
+    // restarted run skips them.
+    PartialCount pattern_matching_partial(const Schedule_IEP& schedule, const CancelToken* token = nullptr, Checkpoint* checkpoint = nullptr);
+    // the same on a flat plan, which the schedule versions build and run
+    PartialCount pattern_matching_partial(const SchedulePlan& plan, const CancelToken* token = nullptr, Checkpoint* checkpoint = nullptr);
+    long long pattern_matching(const SchedulePlan& plan, Checkpoint* checkpoint = nullptr);
 
     //general pattern matching algorithm with multi thread ans multi process
     long long pattern_matching_mpi(const Schedule_IEP& schedule, int thread_count, bool clique = false);
 
-    // naive motif counting
-    void motif_counting(int pattern_size);
+    // list every embedding instead of only counting them. Complete embeddings are
+    // collected in per-thread batches of batch_size and handed to sink, the
+    // return value is the number of embeddings. IEP is never used at the leaf,
+    // the last vertex is always listed explicitly.
+    long long pattern_enumeration(const Schedule_IEP& schedule, EmbeddingSink& sink, int batch_size = 4096);
+
+    // enumeration with multi thread and multi process, each process delivers its own embeddings to its sink
+    long long pattern_enumeration_mpi(const Schedule_IEP& schedule, EmbeddingSink& sink, int thread_count, int batch_size = 4096);
+
+    // Estimate pattern_matching(schedule) by sampling. Each sample is a uniform
+    // random start vertex or edge whose embeddings are counted exactly, scaled
+    // by the number of vertices or edges. Samples are taken in rounds until the
+    // confidence interval is within relative_error of the estimate, or
+    // max_sample_cnt samples were taken, or max_running_time has passed. The
+    // cost only depends on the samples, not on the size of the graph. A
+    // pattern that no sample has hit keeps being sampled until one of the
+    // limits, and is not converged then.
+    CountEstimate pattern_matching_estimate(const Schedule_IEP& schedule, double relative_error = 0.01, double confidence = 0.95,
+        SampleType sample_type = SampleType::Edge, long long max_sample_cnt = 1LL << 32, unsigned long long seed = 0);
+
+    // Local counts: vertex_ans[v] is the number of embeddings that contain v
+    // and, if edge_ans is not null, edge_ans[e] the number of embeddings that
+    // map a pattern edge onto e (the same for both directions of an edge).
+    // Embeddings are counted once per subgraph, as by pattern_matching; the
+    // total count is returned. Each thread keeps its own v_cnt (and e_cnt)
+    // counters, which are summed at the end.
+    // With vertex_column, a vertex is credited in the column of the pattern
+    // vertex it is mapped to: vertex_ans[vertex_column[i] * v_cnt + v] counts
+    // the embeddings that map schedule vertex i (or another vertex of the
+    // same column) onto v.
+    long long local_pattern_matching(const Schedule_IEP& schedule, long long* vertex_ans, long long* edge_ans = nullptr, const int* vertex_column = nullptr);
+
+    // position of v in the neighbor list of u (an index into edge[]), -1 if they are not adjacent
+    e_index_t get_edge_id(v_index_t u, v_index_t v) const;
+
+    // Graphlet orbit counts of every vertex (graphlet degree vectors, vertex
+    // induced as in ORCA) for the connected graphlets of 2 to max_size
+    // vertices: 15 orbits for max_size 4, 73 for 5. Returns orbit_num * v_cnt
+    // counts, column-major (count of orbit o at v in [o * v_cnt + v]), to be
+    // deleted by the caller. Orbits are numbered by graphlet size, then by
+    // graphlet in the order of MotifGenerator and then by their first vertex;
+    // orbit_graphlet (if given) receives a graphlet and a vertex of each orbit.
+    // The edge-induced orbit counts are turned into vertex-induced ones per
+    // vertex. Those of 3 and 4 vertices follow from degrees, triangles per
+    // edge, diamonds, 4-cycles and 4-cliques listed on the degree-oriented
+    // CSR with SIMD intersections; those of 5 vertices are found by
+    // local_pattern_matching with IEP.
+    long long* orbit_counting(int max_size, int& orbit_num, std::vector<std::pair<Pattern, int> >* orbit_graphlet = nullptr);
+
+    // count several patterns in one traversal of a merged schedule, ans[i] is the count of the i-th pattern
+    void multi_pattern_matching(const MultiSchedule& schedule, long long* ans);
+
+    // motif counting, all motifs share one traversal of the graph
+    // vertex-induced counts are derived from the edge-induced ones, which are counted with IEP
+    // the motifs are cached in motif_cache_dir if given, see MotifGenerator
+    void motif_counting(int pattern_size, bool vertex_induced = false, const char* motif_cache_dir = nullptr);
 
-    // hand optimized 3-motif counting
-    void motif_counting_3();
+    // counts of all connected motifs of pattern_size vertices, in the order of MotifGenerator::generate();
+    // edge-induced unless vertex_induced, like motif_counting
+    void motif_census(int pattern_size, long long* ans, bool vertex_induced = false);
+
+    // hand optimized 3-motif counting, edge-induced unless vertex_induced:
+    // the wedges then exclude those closed by a triangle
+    void motif_counting_3(bool vertex_induced = false);
+
+    // hand optimized 4-motif counting without enumeration: the edge-induced
+    // counts follow from degrees, triangles per edge, 4-cycles and 4-cliques.
+    // ans (if given) is in the order of MotifGenerator(4).generate()
+    void motif_counting_4(long long* ans = nullptr, bool vertex_induced = false);
+
+    // triangle support of every edge: support[e] is the number of triangles
+    // that contain edge e, indexed like edge[] (the same for both directions).
+    // Triangles are listed once on the degree-oriented CSR with SIMD
+    // intersections. To be deleted by the caller.
+    int* edge_support();
+
+    // Truss number of every edge, the largest k such that the edge is in the
+    // k-truss (the largest subgraph in which every edge is in at least k - 2
+    // triangles), indexed like edge[]. Edges are peeled in parallel by
+    // support buckets. support (if given) is the result of edge_support().
+    // To be deleted by the caller.
+    int* truss_decomposition(const int* support = nullptr);
+
+    // The k-truss as a new graph with the same vertex ids, to be deleted by
+    // the caller. truss (if given) is the result of truss_decomposition().
+    // An embedding of a pattern only uses edges of truss number at least
+    // pattern.get_truss_number(), so counting on
+    // truss_subgraph(pattern.get_truss_number()) gives the same result.
+    Graph* truss_subgraph(int k, const int* truss = nullptr);
 
     // internal use only
-    long long pattern_matching_edge_task(const Schedule_IEP& schedule, int edge_id,
+    // n vertex sets of the engine, sized for this graph, to be deleted with delete[]
+    VertexSet* new_vertex_sets(int n) const;
+
+    long long pattern_matching_edge_task(const SchedulePlan& plan, int edge_id,
+        VertexSet vertex_sets[], VertexSet& partial_embedding, VertexSet& tmp_set, int ans_buffer[]);
+    
+    long long pattern_matching_edge_task(const SchedulePlan& plan, v_index_t v0, v_index_t v1,
+        VertexSet vertex_sets[], VertexSet& partial_embedding, VertexSet& tmp_set, int ans_buffer[]);
+    long long pattern_matching_vertex_task(const SchedulePlan& plan, v_index_t v0,
         VertexSet vertex_sets[], VertexSet& partial_embedding, VertexSet& tmp_set, int ans_buffer[]);
     
     void get_third_layer_size(const Schedule_IEP& schedule, int *count) const;
@@ -74,9 +260,26 @@ public:
 
 private:
     friend Graphmpi;
-    void tc_mt(long long * global_ans);
+    mutable std::atomic<int> max_intersection_size; // -1 until it is computed or set
 
-    void remove_anti_edge_vertices(VertexSet& out_buf, const VertexSet& in_buf, const Schedule_IEP& sched, const VertexSet& partial_embedding, int vp);
+    // triangles found from the out edges [begin, end) of the oriented CSR, hub_bitmap is all zero
+    long long tc_out_edges(const e_index_t* out_vertex, v_index_t* out_edge, e_index_t begin, e_index_t end, Bitmap& hub_bitmap) const;
+
+    // true if the oriented CSR keeps u -> v: edges point towards the vertex of higher (degree, id)
+    inline bool is_oriented(v_index_t u, v_index_t v) const {
+        e_index_t du = vertex[u + 1] - vertex[u], dv = vertex[v + 1] - vertex[v];
+        return du < dv || (du == dv && u < v);
+    }
+    // the oriented CSR, both arrays to be deleted by the caller
+    void build_oriented_csr(e_index_t*& out_vertex, v_index_t*& out_edge) const;
+
+    // edge-induced counts of the orbits of the graphlets of 3 (and 4 if
+    // max_size >= 4) vertices at every vertex, column-major in the order of
+    // SmallOrbit (graph.cpp), local has SmallOrbitNum * v_cnt entries
+    void small_orbit_counting(int max_size, long long* local);
+
+    // pattern_adj_mat is the size * size adjacency matrix of the schedule
+    void remove_anti_edge_vertices(VertexSet& out_buf, const VertexSet& in_buf, const int* pattern_adj_mat, int pattern_size, const VertexSet& partial_embedding, int vp);
 
     void get_edge_index(v_index_t v, e_index_t& l, e_index_t& r) const;
 
@@ -84,9 +287,20 @@ private:
 
     void pattern_matching_func(const Schedule_IEP& schedule, VertexSet* vertex_set, VertexSet& subtraction_set, long long& local_ans, int depth, bool clique = false);
 
-    void pattern_matching_aggressive_func(const Schedule_IEP& schedule, VertexSet* vertex_set, VertexSet& subtraction_set, VertexSet& tmp_set, long long& local_ans, int depth, int* ans_buffer);
+    // the outermost loop polls token if it is not null
+    void pattern_matching_aggressive_func(const SchedulePlan& plan, VertexSet* vertex_set, VertexSet& subtraction_set, VertexSet& tmp_set, long long& local_ans, int depth, int* ans_buffer, const CancelToken* token = nullptr);
+
+    void pattern_matching_aggressive_func_mpi(Graphmpi& gm, const SchedulePlan& plan, VertexSet* vertex_set, VertexSet& subtraction_set, VertexSet &tmp_set, long long& local_ans, int depth);
+
+    void multi_pattern_matching_func(const MultiSchedule& schedule, int node_id, VertexSet* vertex_set, VertexSet& subtraction_set, long long* local_ans, int* ans_buffer);
+
+    void multi_pattern_matching_extend(const MultiSchedule& schedule, const MultiScheduleNode& node, VertexSet* vertex_set, VertexSet& subtraction_set, long long* local_ans, int* ans_buffer);
+
+    void local_pattern_matching_func(const Schedule_IEP& schedule, VertexSet* vertex_set, VertexSet& subtraction_set, long long** vertex_ans, long long* edge_ans, long long& local_ans, int depth);
+
+    int get_neighbor_cursors(const Schedule_IEP& schedule, int pattern_vertex, const int* embedding, std::pair<v_index_t*, v_index_t*>* cursor);
 
-    void pattern_matching_aggressive_func_mpi(const Schedule_IEP& schedule, VertexSet* vertex_set, VertexSet& subtraction_set, VertexSet &tmp_set, long long& local_ans, int depth);
+    void pattern_enumeration_func(const Schedule_IEP& schedule, VertexSet* vertex_set, VertexSet& subtraction_set, EmbeddingBatch& batch, EmbeddingSink& sink, long long& local_ans, int depth);
     
 };
 
@@ -1,32 +1,44 @@
 #pragma once
 #include "graph.h"
+#include <mpi.h>
 #include <queue>
 #include <atomic>
 
+// Work distribution of one multi-process run (pattern_matching_mpi and the
+// like). Each run has its own communicator, duplicated from MPI_COMM_WORLD,
+// and its own buffers, so several runs, on different graphs or one after the
+// other, can share a process. MPI is initialized by the first run and
+// finalized at exit; if the library does not provide MPI_THREAD_MULTIPLE,
+// runs of different threads take turns. Every process has to start the runs
+// in the same order.
 class Graphmpi {
 public:
-    static Graphmpi& getinstance();
-    std::pair<int, int> init(int thread_count, Graph *graph); // get node range
+    // called by the thread that runs runmajor()
+    Graphmpi(int thread_count, Graph *graph);
+    ~Graphmpi();
     long long runmajor(); // mpi uses on major thread
     int* getneighbor(int u); // return a int[] end with a -1
     int getdegree(); // this function can only be called immediately after calling getneighbor
     bool include(int u); // return whether u is in this process
+    std::pair<int, int> get_node_range() const { return std::make_pair(mynodel, mynoder); }
     std::pair<int, int> get_vertex_range();
     void report(long long local_ans);
     void end();
 
 private:
-    static const int MAXN = 1 << 22, MAXTHREAD = 24, chunksize = 8;
+    static const int MAXN = 1 << 22, chunksize = 8, message_len = 3;
     Graph* graph;
-    int comm_sz, my_rank, mynodel, mynoder, blocksize, idlethreadcnt, threadcnt, global_vertex, vertex[MAXTHREAD];
+    MPI_Comm comm;
+    bool serialized; // holds the lock of the runs for its lifetime
+    int comm_sz, my_rank, mynodel, mynoder, blocksize, idlethreadcnt, threadcnt, global_vertex;
     long long node_ans = 0;
     double starttime;
     std::queue<int> requestq, idleq;
-    static int data[MAXTHREAD][MAXN], qrynode[MAXTHREAD], qrydest[MAXTHREAD], length[MAXTHREAD];
-    std::atomic_flag lock[MAXTHREAD], global_vertex_lock;
-    Graphmpi();
+    // per thread, data[i] is allocated by the first getneighbor() of thread i
+    int **data, *qrynode, *qrydest, *length, *vertex;
+    std::atomic_flag *lock, global_vertex_lock;
+    int recv_buf[message_len], send_buf[message_len];
     Graphmpi(const Graphmpi&&) = delete;
     Graphmpi(const Graphmpi&) = delete;
     Graphmpi& operator = (const Graphmpi&) = delete;
-    ~Graphmpi();
 };
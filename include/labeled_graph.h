@@ -9,7 +9,7 @@
 #include <unordered_map>
 #include <cstdint>
 
-
+class Checkpoint;
 
 class LabeledGraph {
 public:
@@ -48,8 +48,10 @@ public:
     void get_support_pattern_matching_vertex(int vertex, VertexSet* vertex_set, VertexSet& subtraction_set, const Schedule_IEP& schedule, const char* p_label, std::vector<std::set<int> >& fsm_set, int min_support) const; 
     void get_fsm_necessary_info(std::vector<Pattern>& patterns, int max_edge, Schedule_IEP*& schedules, int& schedules_num, int*& mapping_start_idx, int*& mappings, unsigned int*& pattern_is_frequent_index, unsigned int*& is_frequent) const;
     void traverse_all_labeled_patterns(const Schedule_IEP* schedules, char* all_p_label, char* p_label, const int* mapping_start_idx, const int* mappings, const unsigned int* pattern_is_frequent_index, const unsigned int* is_frequent, int s_id, int depth, int mapping_start_idx_pos, size_t& all_p_label_idx) const;
-    int fsm(int max_edge, long long _min_support, double *time_out = nullptr); // return the number of frequent labeled patterns with max_edge edges
-    int fsm_pattern_matching(int job_start, int job_end, const Schedule_IEP &schedule, const char *all_p_label, std::vector<std::vector<int> > &automorphisms, unsigned int* is_frequent, unsigned int& pattern_is_frequent_index, int max_edge, int min_support) const;
+    // return the number of frequent labeled patterns with max_edge edges
+    // with a checkpoint, the finished jobs and is_frequent are saved in the background and a restarted run skips them
+    int fsm(int max_edge, long long _min_support, double *time_out = nullptr, Checkpoint* checkpoint = nullptr);
+    int fsm_pattern_matching(int job_start, int job_end, const Schedule_IEP &schedule, const char *all_p_label, std::vector<std::vector<int> > &automorphisms, unsigned int* is_frequent, unsigned int& pattern_is_frequent_index, int max_edge, int min_support, Checkpoint* checkpoint = nullptr) const;
     int fsm_vertex(int max_edge, long long _min_support, double *time_out = nullptr); 
     int fsm_pattern_matching_vertex(int job_id, const Schedule_IEP &schedule, const char *p_label, std::vector<std::vector<int> > &automorphisms, unsigned int* is_frequent, unsigned int& pattern_is_frequent_index,  int max_edge, int min_support) const;
 private:
@@ -1,14 +1,54 @@
 #pragma once
 #include "pattern.h"
+#include <cstdint>
+#include <string>
 #include <vector>
 
+// Connected patterns of one size up to isomorphism, by orderly generation
+// (McKay's canonical augmentation): a graph of n vertices is grown from one of
+// n - 1 vertices by a new vertex adjacent to a subset of the old ones. Only one
+// subset of each orbit of the automorphisms of the parent is tried, and the
+// child is kept if the new vertex is in the orbit of its canonical deletion
+// vertex, a non-cut vertex chosen from the canonical labeling. So each class is
+// generated exactly once from a connected parent, without comparing children.
 class MotifGenerator
 {
 public:
-    MotifGenerator(int input_size): size(input_size){}
+    // The patterns with min_edge to max_edge edges (no upper bound if max_edge < 0).
+    // The catalog is loaded from and saved to cache_dir (created if it does not
+    // exist), one file per size and edge bounds; nullptr disables the cache.
+    MotifGenerator(int input_size, int _min_edge = 0, int _max_edge = -1, const char* _cache_dir = nullptr);
+    // sorted by edge number, each one in the breadth-first order of its canonical labeling
     std::vector<Pattern> generate();
+
+    // the catalog file of this size and edge bounds
+    std::string get_cache_file_name() const;
+
+    // c[p][q] = number of subgraphs of q (on all of its vertices) isomorphic to p,
+    // so that the edge-induced count of p is sum_q c[p][q] * (vertex-induced count of q)
+    static std::vector< std::vector<long long> > get_containment_matrix(const std::vector<Pattern>& patterns);
+    // solves the system above for the vertex-induced counts, patterns must hold every connected pattern of one size
+    // edge_induced_ans and vertex_induced_ans may be the same array
+    static void to_vertex_induced(const std::vector<Pattern>& patterns, const std::vector< std::vector<long long> >& containment,
+        const long long* edge_induced_ans, long long* vertex_induced_ans);
+
+    // orbit of each vertex under the automorphisms of p, numbered by their first vertex
+    static std::vector<int> get_orbits(const Pattern& p);
+    // The same relation for the orbits of patterns of one size: the orbits of
+    // all patterns are numbered one after another, and c[o][o'] is the number
+    // of subgraphs of the pattern of o' that contain a fixed vertex x of o' and
+    // are isomorphic to the pattern of o with x in o.
+    static std::vector< std::vector<long long> > get_orbit_containment_matrix(const std::vector<Pattern>& patterns);
 private:
     int size;
-    std::set< std::set<int> > s;
-    void generate_all_pattern(std::vector<Pattern>& vec, std::set<int> edge_set, Pattern& p, int depth, int i, int j);
-};
\ No newline at end of file
+    int min_edge;
+    int max_edge;
+    std::string cache_dir;
+
+    // a graph is the neighbor mask of each vertex
+    typedef std::vector<uint32_t> NeighborMasks;
+    // the children of g that are kept, in their canonical vertex order
+    void augment(const NeighborMasks& g, std::vector<NeighborMasks>& children) const;
+    bool load(std::vector<Pattern>& patterns) const;
+    bool save(const std::vector<Pattern>& patterns) const;
+};
@@ -0,0 +1,85 @@
+#pragma once
+#include "pattern.h"
+#include "schedule_IEP.h"
+#include "types.h"
+
+#include <map>
+#include <vector>
+
+// One vertex of a merged execution plan. The path from the root to a node at
+// depth d fixes the first d+1 vertices of every pattern below it: which earlier
+// vertices they are adjacent to and which symmetry-breaking restrictions they
+// obey. Vertex sets are addressed by slots instead of prefix ids, a node only
+// builds the prefixes whose last vertex is its own vertex.
+struct MultiScheduleNode {
+    int depth;
+    int loop_slot;       // candidate set of this vertex, -1 for the root
+    int loop_break_size; // the candidate set holds at least this many used vertices
+    std::vector<int> restrict_index; // this vertex must be smaller than these earlier vertices
+    std::vector<int> build_slot;     // prefixes built once this vertex is chosen
+    std::vector<int> build_father_slot;
+    std::vector<int> children;
+    std::vector<int> pattern_id; // patterns whose last vertex is this one, only counted
+    std::vector<int> iep_tail;   // patterns finished by IEP right after this vertex is chosen
+
+    // used while building the plan
+    int neighbor_mask;
+    std::map<int, int> build_mask; // prefix (bitmask of vertices) -> slot
+};
+
+// The IEP part of one pattern, the same tables as Schedule_IEP with prefix ids
+// replaced by slots.
+struct MultiScheduleIEP {
+    int pattern_id;
+    int loop_slot; // candidate set of the first IEP vertex
+    std::vector<int> vertex_slot;
+    std::vector<bool> vertex_flag;
+    std::vector<int> vertex_coef;
+    std::vector<int> coef;
+    std::vector<bool> flag;
+    std::vector<int> ans_pos;
+
+    // used while building the plan
+    int loop_mask;
+    std::vector<int> vertex_mask;
+};
+
+// A trie of the schedules of several patterns, traversed once by
+// Graph::multi_pattern_matching. Each pattern is planned on its own by
+// Schedule_IEP, then patterns whose schedules start with the same vertices and
+// restrictions share the trie nodes, and so the intersections, of that prefix.
+class MultiSchedule {
+public:
+    MultiSchedule(const std::vector<Pattern> &patterns, bool use_in_exclusion_optimize, int v_cnt, e_index_t e_cnt, long long tri_cnt = 0);
+    MultiSchedule(const MultiSchedule &s) = delete;
+    MultiSchedule &operator=(const MultiSchedule &s) = delete;
+
+    inline int get_pattern_num() const { return pattern_num; }
+    inline bool is_pattern_valid(int pattern_id) const { return pattern_valid[pattern_id]; }
+    inline long long get_redundancy(int pattern_id) const { return redundancy[pattern_id]; }
+    inline int get_node_num() const { return nodes.size(); }
+    inline const MultiScheduleNode &get_node(int node_id) const { return nodes[node_id]; }
+    inline const MultiScheduleIEP &get_iep_tail(int tail_id) const { return iep_tails[tail_id]; }
+    inline int get_slot_num() const { return slot_num; }
+    inline int get_max_iep_vertex_num() const { return max_iep_vertex_num; }
+    // number of trie nodes if every pattern had its own path
+    inline int get_unshared_node_num() const { return unshared_node_num; }
+
+    void print_schedule() const;
+
+private:
+    int pattern_num;
+    int slot_num;
+    int max_iep_vertex_num;
+    int unshared_node_num;
+    std::vector<bool> pattern_valid;
+    std::vector<long long> redundancy;
+    std::vector<MultiScheduleNode> nodes;
+    std::vector<MultiScheduleIEP> iep_tails;
+
+    int get_child(int node_id, int neighbor_mask, const std::vector<int> &restrict_index);
+    void add_prefix(const std::vector<int> &path, int mask);
+    int get_slot(const std::vector<int> &path, int mask) const;
+    void insert(const Schedule_IEP &schedule, int pattern_id);
+    void assign_slots(int node_id, int base, std::vector<int> &path);
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include <set>
+#include <string>
 #include <vector>
 #include <cstdio>
 
@@ -39,11 +40,14 @@ public:
     inline int get_size() const {return size;}
     inline const int* get_adj_mat_ptr() const {return adj_mat;}
     bool check_connected() const;
-    void count_all_isomorphism(std::set< std::set<int> >& s) const;
+    // the largest k such that every edge of the pattern is in its k-truss (at least 2)
+    int get_truss_number() const;
     void print() const;
     bool is_dag() const;
+    // the same string for isomorphic patterns and different ones otherwise:
+    // the size and the adjacency matrix of the canonical relabeling, see CanonicalLabeling
+    std::string get_canonical_form() const;
 private:
-    void get_full_permutation(std::vector< std::vector<int> >& vec, bool use[], std::vector<int> tmp_vec, int depth) const;
     int* adj_mat;
     int size;
 };
@@ -0,0 +1,53 @@
+#pragma once
+#include "graph.h"
+#include "pattern.h"
+#include "schedule_IEP.h"
+
+#include <string>
+
+// On-disk cache of Schedule_IEP, one file per plan in a directory.
+//
+// A plan is keyed by the canonical form of the pattern, the parameters of the
+// Schedule_IEP constructor, Schedule_IEP::planner_version and a fingerprint of
+// the graph statistics the performance model reads (v_cnt, e_cnt, tri_cnt,
+// wedge_cnt, max_degree and a hash of the degree statistics if they are used).
+// Plans of an older planner are never hit, they are planned again. Isomorphic patterns share a plan,
+// the schedule fixes its own vertex order. Without performance modeling the
+// order of the given pattern is kept, so the pattern itself is the key.
+//
+// The file name is a hash of the key, the file holds the full key to rule out
+// collisions. Files are written to a temporary name and renamed, so processes
+// sharing the directory never read a torn plan.
+class PlanCache {
+public:
+    // creates dir if it does not exist
+    PlanCache(const char* _dir);
+
+    // Loads the plan from the cache, or constructs the schedule as
+    // Schedule_IEP(pattern, ..., g->v_cnt, g->e_cnt, g->tri_cnt, vertex_induced,
+    // g->degree_stats if use_degree_stats, planning_time_limit) and saves it,
+    // unless its search was truncated: such a plan depends on the load of the
+    // machine and is planned again next time. The caller deletes it.
+    Schedule_IEP* get_schedule(const Pattern& pattern, bool& is_pattern_valid,
+        int performance_modeling_type, int restricts_type, bool use_in_exclusion_optimize,
+        const Graph* g, bool vertex_induced = false, bool use_degree_stats = false,
+        double planning_time_limit = Schedule_IEP::default_planning_time_limit);
+
+    std::string get_key(const Pattern& pattern, int performance_modeling_type, int restricts_type,
+        bool use_in_exclusion_optimize, const Graph* g, bool vertex_induced, bool use_degree_stats) const;
+    std::string get_file_name(const std::string& key) const;
+
+    inline long long get_hit_cnt() const { return hit_cnt; }
+    inline long long get_miss_cnt() const { return miss_cnt; }
+    // whether the last get_schedule() was answered from the cache
+    inline bool get_last_hit() const { return last_hit; }
+
+private:
+    std::string dir;
+    long long hit_cnt;
+    long long miss_cnt;
+    bool last_hit;
+
+    Schedule_IEP* load(const std::string& key) const;
+    bool save(const std::string& key, const Schedule_IEP& schedule) const;
+};
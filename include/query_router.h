@@ -0,0 +1,57 @@
+#pragma once
+#include "graph.h"
+#include "pattern.h"
+#include "plan_cache.h"
+#include "analytic_counting.h"
+
+#include <memory>
+
+// shape of a pattern, by the engine that counts it fastest
+enum class PatternClass {
+    Triangle,
+    Clique, // of 2 or of at least 4 vertices
+    Wedge,  // the path of 3 vertices
+    Star,   // a center and at least 3 leaves
+    Path,   // of at least 4 vertices
+    DoubleStar, // two adjacent centers and their leaves, other than the path of 4 vertices
+    Other
+};
+
+// Picks the engine of a count query from the shape of the pattern, so callers
+// need not know which binary or flags fit it:
+//   Triangle  triangle_counting_mt
+//   Clique    clique_counting on the degree-oriented CSR
+//   Wedge, Star, DoubleStar and the Path of 4 vertices
+//             AnalyticCounter, from degrees and triangles per edge
+//   anything else, and vertex-induced trees other than the wedge, the
+//   generic pattern_matching with the schedule of our modeling
+// The graph is never modified, every engine orients a private copy if it
+// needs one. The counts are those of pattern_matching.
+class QueryRouter {
+public:
+    // plan_cache (if given) supplies the schedules of the generic engine;
+    // counter (if given) keeps the triangles per edge for other routers of
+    // the same graph, otherwise the router has its own
+    QueryRouter(Graph* _g, PlanCache* _plan_cache = nullptr, AnalyticCounter* _counter = nullptr);
+
+    static PatternClass classify(const Pattern& pattern);
+    static const char* get_class_name(PatternClass pattern_class);
+
+    // Counts pattern with a specialized engine if one applies and returns
+    // true, returns false if it needs the generic engine.
+    bool count_direct(const Pattern& pattern, bool vertex_induced, long long& ans);
+
+    // count_direct or pattern_matching, is_pattern_valid is false (and 0 is
+    // returned) if the generic engine has no schedule for the pattern
+    long long count(const Pattern& pattern, bool& is_pattern_valid, bool vertex_induced = false);
+
+    // the engine of the last count
+    inline const char* get_last_engine() const { return last_engine; }
+
+private:
+    Graph* g;
+    PlanCache* plan_cache;
+    std::unique_ptr<AnalyticCounter> own_counter;
+    AnalyticCounter* counter;
+    const char* last_engine;
+};
@@ -0,0 +1,74 @@
+#pragma once
+#include "graph.h"
+#include "plan_cache.h"
+#include "schedule_plan.h"
+#include "analytic_counting.h"
+
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+// Long running counting server. Graphs are loaded (mapped) once and stay
+// resident, the schedule of each pattern is planned once per graph and kept as
+// a SchedulePlan, and the OpenMP threads live as long as the process, so a
+// query only pays for its count.
+//
+// One request per line, one reply per line:
+//   load NAME PATH                 ok NAME v_cnt e_cnt load_time
+//   drop NAME                      ok
+//   graphs                         ok n NAME...
+//   count NAME SIZE ADJ [induced] [timeout SECONDS]
+//                                  ok ans plan_time count_time hit|miss|direct
+//                                  partial ans estimate completed_fraction plan_time count_time hit|miss
+//   quit                           closes the connection
+//   shutdown                       ok, and stops the server
+// Errors are replied as "error message". ADJ is the adjacency string of
+// pm_test, times are in seconds, a count stopped by its timeout is partial.
+// Triangles, cliques, stars and double stars are counted by their own engines
+// (see QueryRouter), without a plan and without a timeout, and replied as
+// direct.
+class QueryServer {
+public:
+    // plan_cache (if given) keeps the schedules across runs of the server;
+    // thread_num > 0 limits the OpenMP threads of each query
+    QueryServer(PlanCache* _plan_cache, int _thread_num) : plan_cache(_plan_cache), thread_num(_thread_num) {}
+
+    // replies to every line of in until quit, shutdown or the end of in
+    // returns false on shutdown
+    bool serve(FILE* in, FILE* out);
+
+    // Serves every connection of the unix socket socket_path by its own
+    // thread, so queries of different clients run at the same time, until a
+    // client sends shutdown. Then the clients are disconnected: idle ones at
+    // once, busy ones after replying to the requests they have sent.
+    // returns false if the socket cannot be opened or fails
+    bool serve_socket(const char* socket_path);
+
+    // the reply of "load name path"
+    std::string load(const std::string& name, const std::string& path);
+
+private:
+    // a graph, its plans, by vertex_induced and canonical code of the
+    // pattern, and its triangles per edge for the closed-form counts; running
+    // queries keep it alive when it is dropped
+    struct ResidentGraph {
+        std::unique_ptr<Graph> g;
+        std::unique_ptr<AnalyticCounter> counter;
+        std::map<std::string, std::shared_ptr<SchedulePlan> > plans;
+    };
+
+    std::map<std::string, std::shared_ptr<ResidentGraph> > graphs;
+    std::mutex mutex;      // of graphs and the plans
+    std::mutex plan_mutex; // one schedule is planned at a time, PlanCache is not thread safe
+    std::mutex load_mutex;
+    PlanCache* plan_cache;
+    int thread_num;
+
+    std::shared_ptr<ResidentGraph> find(const std::string& name);
+    std::shared_ptr<SchedulePlan> find_plan(ResidentGraph& resident, const std::string& key);
+    std::string handle(const std::string& command, std::istringstream& request);
+    std::string count(std::istringstream& request);
+};
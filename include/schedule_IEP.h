@@ -4,10 +4,23 @@
 #include "prefix.h"
 #include "types.h"
 #include "disjoint_set_union.h"
+#include "degree_statistics.h"
 
 #include <cstdint>
+#include <cstdio>
+#include <map>
+#include <set>
 #include <vector>
 
+// a matching order and its restrictions with their cost in our modeling,
+// see Schedule_IEP::get_candidates()
+struct ScheduleCandidate {
+    std::vector<int> order; // order[i] is the pattern vertex matched i-th
+    std::vector< std::pair<int,int> > restricts; // on the reordered vertices
+    bool use_in_exclusion_optimize;
+    double cost;
+};
+
 class Schedule_IEP
 {
 public:
@@ -15,15 +28,29 @@ public:
     Schedule_IEP(const Pattern& pattern, bool& is_pattern_valid, 
         int performance_modeling_type, int restricts_type, bool use_in_exclusion_optimize,
         int v_cnt, int64_t e_cnt, long long tri_cnt = 0,
-        bool vertex_induced = false);
+        bool vertex_induced = false, const DegreeStatistics* degree_stats = nullptr,
+        double planning_time_limit = default_planning_time_limit);
     // performance_modeling type = 0 : not use modeling
-    //                      type = 1 : use our modeling
+    //                      type = 1 : use our modeling, degree-aware if degree_stats is given
     //                      type = 2 : use GraphZero's modeling
     //                      type = 3 : use naive modeling
     // restricts_type = 0 : not use restricts
     //                = 1 : use our restricts
     //                = 2 : use GraphZero's restricts
     Schedule_IEP(const int* _adj_mat, int _size);
+    // the schedule of a candidate, without planning
+    Schedule_IEP(const Pattern& pattern, const ScheduleCandidate& candidate, bool vertex_induced = false);
+    // The candidate_num cheapest orders and restrictions in our modeling
+    // (performance_modeling_type = 1), ranked as the constructor ranks them,
+    // so the first one is the schedule it picks with the same parameters.
+    static std::vector<ScheduleCandidate> get_candidates(const Pattern& pattern, int candidate_num,
+        int restricts_type, bool use_in_exclusion_optimize, int v_cnt, int64_t e_cnt, long long tri_cnt,
+        const DegreeStatistics* degree_stats = nullptr);
+    // Version of the planning: the orders, restrictions and costs the
+    // constructor picks for the same parameters. Plan caches key on it, so
+    // bump it with every change that can make the constructor plan otherwise.
+    static const int planner_version = 2;
+
     Schedule_IEP(const Schedule_IEP& s) = delete;
     Schedule_IEP& operator = (const Schedule_IEP& s) = delete;
     ~Schedule_IEP();
@@ -57,7 +84,7 @@ public:
     int get_multiplicity() const;
     void aggressive_optimize(std::vector< std::pair<int,int> >& ordered_pairs) const;
     void aggressive_optimize_get_all_pairs(std::vector< std::vector< std::pair<int,int> > >& ordered_pairs_vector);
-    void aggressive_optimize_dfs(Pattern base_dag, std::vector< std::vector<int> > isomorphism_vec, std::vector< std::vector< std::vector<int> > > permutation_groups, std::vector< std::pair<int,int> > ordered_pairs, std::vector< std::vector< std::pair<int,int> > >& ordered_pairs_vector);
+    void aggressive_optimize_dfs(Pattern base_dag, std::vector< std::vector<int> > isomorphism_vec, std::vector< std::vector< std::vector<int> > > permutation_groups, std::vector< std::pair<int,int> > ordered_pairs, std::vector< std::vector< std::pair<int,int> > >& ordered_pairs_vector, std::set< std::vector< std::pair<int,int> > >& visited, long long min_extension_cnt);
     void restrict_selection(int v_cnt, e_index_t e_cnt, long long tri_cnt, std::vector< std::vector< std::pair<int,int> > > ordered_pairs_vector, std::vector< std::pair<int,int> >& best_restricts) const;
     void restricts_generate(const int* cur_adj_mat, std::vector< std::vector< std::pair<int,int> > > &restricts);
 
@@ -71,8 +98,28 @@ public:
     inline void set_in_exclusion_optimize_redundancy(long long redundancy) { in_exclusion_optimize_redundancy = redundancy; }
     inline long long get_in_exclusion_optimize_redundancy() const { return in_exclusion_optimize_redundancy; } 
 
+    // Seconds the search of the matching order may take by default, after
+    // that the best order found so far is used (at worst the greedy one the
+    // search starts from). A truncated search depends on the speed of the
+    // machine, see is_planning_truncated().
+    static constexpr double default_planning_time_limit = 1.0;
+    // whether the search of the order was stopped by its time limit, never
+    // for schedules that were loaded or built from a candidate
+    inline bool is_planning_truncated() const { return planning_truncated; }
+
+    // cost of this schedule (order and restrictions) in our modeling, for
+    // comparing the predictions with measured times
+    double estimate_cost(int v_cnt, e_index_t e_cnt, long long tri_cnt, const DegreeStatistics* degree_stats = nullptr);
+
     void print_schedule() const;
 
+    // Writes everything the matching reads (order, prefixes, restrictions,
+    // break_size, IEP groups and coefficients), load() rebuilds the schedule
+    // from it without planning. Used by PlanCache.
+    bool save(FILE* fp) const;
+    // nullptr if fp does not hold a complete schedule
+    static Schedule_IEP* load(FILE* fp);
+
     void update_loop_invariant_for_fsm();
 
     std::vector< std::pair<int,int> > restrict_pair;
@@ -90,6 +137,8 @@ public:
     bool is_vertex_induced;
 
 private:
+    Schedule_IEP() = default; // for load()
+
     int* adj_mat = nullptr;
     int* father_prefix_id = nullptr;
     int* last = nullptr;
@@ -100,6 +149,7 @@ private:
     int* restrict_last = nullptr;
     int* restrict_next = nullptr;
     int* restrict_index = nullptr;
+    bool planning_truncated = false;
     int size;
     int total_prefix_num;
     int basic_prefix_num;
@@ -112,18 +162,24 @@ private:
     std::vector< std::vector< std::vector<int> > >in_exclusion_optimize_group;
     std::vector< int > in_exclusion_optimize_val;
 
+    void init_arrays();
+    void plan_order(const Pattern& pattern, int performance_modeling_type, int restricts_type, bool& use_in_exclusion_optimize,
+        int v_cnt, e_index_t e_cnt, long long tri_cnt, const DegreeStatistics* degree_stats, double planning_time_limit,
+        std::vector< std::pair<int,int> >& best_pairs, int candidate_num = 0, std::vector<ScheduleCandidate>* candidates = nullptr);
     bool check_connectivity() const;
     void setup_optimization_info(bool use_in_exclusion_optimize = true);
     void copy_adj_mat_from(const std::vector<int>& vec, const int* src_adj_mat);
     void build_loop_invariant(int in_exclusion_optimize_num = 0);
     int find_father_prefix(int data_size, const int* data);
-    void get_full_permutation(std::vector< std::vector<int> >& vec, bool use[], std::vector<int> tmp_vec, int depth) const;
     void performance_modeling(int* best_order, std::vector< std::vector<int> > &candidates, int v_cnt, e_index_t e_cnt);
     void bug_performance_modeling(int* best_order, std::vector< std::vector<int> > &candidates, int v_cnt, e_index_t e_cnt);
     void new_performance_modeling(int* best_order, std::vector< std::vector<int> > &candidates, int v_cnt, e_index_t e_cnt, long long tri_cnt);
     void GraphZero_performance_modeling(int* best_order, int v_cnt, e_index_t e_cnt);
 
-    double new_estimate_schedule_restrict(const std::vector<std::pair<int, int>>& restrictions, int v_cnt, e_index_t e_cnt, long long tri_cnt);
+    double new_estimate_schedule_restrict(const std::vector<std::pair<int, int>>& restrictions, int v_cnt, e_index_t e_cnt, long long tri_cnt,
+        const DegreeStatistics* degree_stats = nullptr, std::map< std::vector< std::pair<int,int> >, long long >* extension_cnt_cache = nullptr);
+    void get_degree_aware_set_sizes(const DegreeStatistics& stats, const std::vector< std::pair<int,int> >& restricts, const std::vector<double>& sum,
+        std::vector< std::vector<double> >& set_size, std::vector<double>& degree, std::vector<double>& restrict_rate) const;
     double our_estimate_schedule_restrict(const std::vector<int> &order, const std::vector< std::pair<int,int> > &pairs, int v_cnt, e_index_t e_cnt, long long tri_cnt);
     double GraphZero_estimate_schedule_restrict(const std::vector<int> &order, const std::vector< std::pair<int,int> > &pairs, int v_cnt, e_index_t e_cnt);
     double Naive_estimate_schedule_restrict(const std::vector<int> &order, const std::vector< std::pair<int,int> > &paris, int v_cnt, e_index_t e_cnt);
@@ -134,7 +190,24 @@ private:
     
     int get_vec_optimize_num(const std::vector<int> &vec);
 
-    void remove_invalid_permutation(std::vector< std::vector<int> > &candidate_permutations);
+    static const int max_all_restricts_size = 8;
+    static const int max_restricts_search_states = 1 << 12;
+
+    // matching order search, see the constructor
+    struct OrderSearch;
+    void search_order(OrderSearch& search, int depth, const std::vector<int>& stabilizer);
+    void parallel_search_order(OrderSearch& search, const std::vector<int>& stabilizer);
+    void evaluate_order(OrderSearch& search);
+    double order_lower_bound(const OrderSearch& search, int depth) const;
+    void get_max_optimize_vertices(std::vector<int>& optimize_vertices) const;
+    void get_greedy_order(const std::vector<int>& optimize_vertices, std::vector<int>& order) const;
+
+    // number of vertex orders in which p.first comes after p.second for all pairs p
+    long long count_linear_extensions(const std::vector< std::pair<int,int> >& pairs,
+        std::map< std::vector< std::pair<int,int> >, long long >* cache = nullptr) const;
+    // false if no restriction set is left that IEP can keep
+    bool remove_in_exclusion_invalid_restricts(std::vector< std::vector< std::pair<int,int> > > &restricts_vector, int optimize_num,
+        std::map< std::vector< std::pair<int,int> >, long long >* extension_cnt_cache = nullptr) const;
     
     inline void set_in_exclusion_optimize_num(int num) { in_exclusion_optimize_num = num; }
     
@@ -0,0 +1,85 @@
+#pragma once
+#include "schedule_IEP.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// Flat execution plan of a Schedule_IEP: everything the counting engine reads
+// (order, prefixes, restrictions, break_size and the IEP terms) in one 64-byte
+// aligned block without pointers. The block starts with this header and its
+// int arrays follow, at the offsets (in ints from the start of the block) kept
+// in the header, so the hot loop reads a few consecutive cache lines.
+//
+// A plan is copied with memcpy, so it can be replicated per socket, sent as
+// bytes to other ranks, written to a file or used in place from a mapped file
+// once check() accepts the bytes.
+struct alignas(64) SchedulePlan
+{
+    enum Array {
+        AdjMat,             // size * size
+        LoopSetPrefixId,    // size
+        Last,               // size, first prefix built at each depth, -1 if none
+        Next,               // total_prefix_num, next prefix of the same depth
+        FatherPrefixId,     // total_prefix_num, -1 for a single neighborhood
+        BreakSize,          // total_prefix_num, prune the branch if a prefix has this size
+        RestrictLast,       // size, first restriction of each depth
+        RestrictNext,       // total_restrict_num
+        RestrictIndex,      // total_restrict_num, the depth of the vertex bounding it from above
+        RestrictPair,       // 2 * restrict_pair_num
+        IepVertexId,        // iep_vertex_num, prefix of each IEP set
+        IepVertexFlag,      // iep_vertex_num
+        IepVertexCoef,      // iep_vertex_num
+        IepCoef,            // iep_term_num
+        IepFlag,            // iep_term_num
+        IepAnsPos,          // iep_term_num
+        ArrayNum
+    };
+
+    char magic[8];
+    uint32_t byte_size; // of the whole block, a multiple of 64
+    int32_t size;
+    int32_t total_prefix_num;
+    int32_t basic_prefix_num;
+    int32_t total_restrict_num;
+    int32_t restrict_pair_num;
+    int32_t in_exclusion_optimize_num;
+    int32_t iep_vertex_num;
+    int32_t iep_term_num;
+    int32_t is_vertex_induced;
+    int64_t in_exclusion_optimize_redundancy;
+    int32_t offset[ArrayNum + 1]; // offset[ArrayNum] is the end of the last array
+
+    // allocated with create(), clone() or load(), freed with destroy()
+    static SchedulePlan* create(const Schedule_IEP& schedule);
+    static void destroy(SchedulePlan* plan);
+    SchedulePlan* clone() const;
+
+    // whether the len bytes at data hold a complete, consistent plan; data
+    // must be 64-byte aligned to be used as a plan in place
+    static bool check(const void* data, size_t len);
+    bool save(FILE* fp) const;
+    // nullptr if fp does not hold a complete plan
+    static SchedulePlan* load(FILE* fp);
+
+    inline const int* get_array(Array a) const { return reinterpret_cast<const int*>(this) + offset[a]; }
+    inline int get_size() const { return size; }
+    inline int get_total_prefix_num() const { return total_prefix_num; }
+    inline int get_basic_prefix_num() const { return basic_prefix_num; }
+    inline int get_total_restrict_num() const { return total_restrict_num; }
+    inline int get_in_exclusion_optimize_num() const { return in_exclusion_optimize_num; }
+    inline long long get_in_exclusion_optimize_redundancy() const { return in_exclusion_optimize_redundancy; }
+    inline const int* get_adj_mat_ptr() const { return get_array(AdjMat); }
+    inline int get_loop_set_prefix_id(int depth) const { return get_array(LoopSetPrefixId)[depth]; }
+    inline int get_last(int depth) const { return get_array(Last)[depth]; }
+    inline int get_next(int prefix_id) const { return get_array(Next)[prefix_id]; }
+    inline int get_father_prefix_id(int prefix_id) const { return get_array(FatherPrefixId)[prefix_id]; }
+    inline int get_break_size(int prefix_id) const { return get_array(BreakSize)[prefix_id]; }
+    inline int get_restrict_last(int depth) const { return get_array(RestrictLast)[depth]; }
+    inline int get_restrict_next(int i) const { return get_array(RestrictNext)[i]; }
+    inline int get_restrict_index(int i) const { return get_array(RestrictIndex)[i]; }
+    // restrict_pair[i] of the schedule, the vertex at depth second is smaller than the one at depth first
+    inline int get_restrict_pair_first(int i) const { return get_array(RestrictPair)[2 * i]; }
+    inline int get_restrict_pair_second(int i) const { return get_array(RestrictPair)[2 * i + 1]; }
+    inline int get_restrict_pair_num() const { return restrict_pair_num; }
+};
@@ -0,0 +1,71 @@
+#pragma once
+#include "graph.h"
+#include "pattern.h"
+#include "schedule_IEP.h"
+
+#include <vector>
+
+// Empirical choice among the schedules our modeling ranks best, for the cases
+// the model ranks wrongly.
+//
+// The candidate_num cheapest orders and restrictions of
+// Schedule_IEP::get_candidates() are timed on the same sample of start
+// vertices. A fraction rate of the vertices of each degree bucket (see
+// DegreeStatistics) is sampled, rounded up or down at random, so each vertex
+// is in the sample with probability rate and its time and count stand for
+// 1 / rate vertices. Unlike a uniform sample, this always has about the
+// right number of hubs, which do most of the work.
+//
+// Tuning runs in rounds: the first one samples first_round_samples vertices,
+// each next one has 4 times the rate and only times the new vertices of the
+// candidates still in the race. After a round, the candidates estimated at
+// more than drop_ratio times the best are dropped. It stops when one
+// candidate is left, when the whole graph was sampled, or when the next round
+// (its cost extrapolated from the last one) would take the tuning time over
+// budget_fraction of the expected run time of the best candidate. Before the
+// first round only the candidate our modeling ranks best is timed; if the
+// round would take the tuning over budget at its pace, that one is picked and
+// no round is counted.
+class ScheduleTuner {
+public:
+    ScheduleTuner(Graph* _g, int _candidate_num = 8, double _budget_fraction = 0.05, unsigned int seed = 0);
+
+    // the fastest candidate, to be deleted by the caller; the candidates are
+    // ranked by the degree-aware model if use_degree_stats. nullptr with
+    // is_pattern_valid false if the pattern is not connected or has no candidate.
+    Schedule_IEP* tune(const Pattern& pattern, bool& is_pattern_valid, int restricts_type = 1, bool use_in_exclusion_optimize = true,
+        bool use_degree_stats = false);
+
+    // of the last tune(), the estimates are 0 if there was only one candidate
+    inline int get_candidate_cnt() const { return candidate_cnt; }
+    inline int get_picked_rank() const { return picked_rank; } // rank of the picked candidate in our modeling
+    inline int get_round_cnt() const { return round_cnt; }
+    inline long long get_sample_cnt() const { return sample_cnt; } // timed start vertices
+    inline double get_tuning_time() const { return tuning_time; }
+    inline double get_expected_time() const { return expected_time; } // estimated run time of the picked schedule
+    inline double get_estimated_count() const { return estimated_count; } // by the picked schedule's sample
+
+    static const int first_round_samples = 64;
+    static constexpr double drop_ratio = 2;
+
+private:
+    Graph* g;
+    int candidate_num;
+    double budget_fraction;
+    std::vector< std::vector<v_index_t> > buckets; // vertices of each degree bucket, shuffled
+    std::vector<double> rounding; // of the sample size of each bucket
+
+    int candidate_cnt;
+    int picked_rank;
+    int round_cnt;
+    long long sample_cnt;
+    double tuning_time;
+    double expected_time;
+    double estimated_count;
+
+    // the first sample_size(b, rate) vertices of bucket b are the sample
+    int sample_size(int b, double rate) const;
+    // adds the time and the count of the start vertices buckets[b][begin[b], end[b]) to time_sum and count_sum
+    void run_sample(const Schedule_IEP& schedule, const std::vector<int>& begin, const std::vector<int>& end,
+        double& time_sum, double& count_sum);
+};
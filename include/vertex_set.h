@@ -1,5 +1,6 @@
 #pragma once
 #include "schedule_IEP.h"
+#include "schedule_plan.h"
 #include <cstdint>
 #include <cstring>
 
@@ -26,7 +27,9 @@ class VertexSet
 {
 public:
     VertexSet();
-    // allocate new memory according to max_intersection_size
+    // the buffer allocated by init() holds intersections of up to capacity vertices
+    VertexSet(int _capacity);
+    // allocate new memory according to the capacity, or max_intersection_size if it is not set
     void init();
     // use memory from Graph, do not allocate new memory
     void init(int input_size, int* input_data);
@@ -51,12 +54,19 @@ public:
     inline void pop_back() { --size;}
     inline int get_last() const { return data[size - 1];}
     bool has_data(int val);
+    inline void set_capacity(int _capacity) { capacity = _capacity; }
+    // default capacity, the largest of the loaded graphs; the engine of Graph
+    // sizes its sets by Graph::get_max_intersection_size() instead
     static int max_intersection_size;
     void build_vertex_set(const Schedule_IEP& schedule, const VertexSet* vertex_set, int* input_data, int input_size, int prefix_id, int min_vertex = -1, bool clique = false);
+    void build_vertex_set(const SchedulePlan& plan, const VertexSet* vertex_set, int* input_data, int input_size, int prefix_id);
+    // same as above with the father set given directly, nullptr if the prefix has only one vertex
+    void build_vertex_set(const VertexSet* father, int* input_data, int input_size);
     void build_vertex_set_bs(const Schedule_IEP& schedule, const VertexSet* vertex_set, Bitmap *bs, int* input_data, int input_size, int prefix_id, int depth);
     void build_vertex_set_bs_only_size(const Schedule_IEP& schedule, const VertexSet* vertex_set, Bitmap *bs, int* input_data, int input_size, int prefix_id, int depth);
 private:
     int* data;
     int size;
     bool allocate;
+    int capacity; // -1 for max_intersection_size
 };
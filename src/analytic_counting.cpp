@@ -0,0 +1,125 @@
+#include "../include/analytic_counting.h"
+
+#include <algorithm>
+#include <cassert>
+#include <omp.h>
+
+// C(n, k), 0 if n < k
+static inline long long binomial(long long n, int k) {
+    if (k < 0 || n < k)
+        return 0;
+    long long ans = 1;
+    for (int i = 0; i < k; ++i)
+        ans = ans * (n - i) / (i + 1);
+    return ans;
+}
+
+bool AnalyticCounter::get_double_star(const Pattern& pattern, int& leaf_num_a, int& leaf_num_b)
+{
+    int size = pattern.get_size();
+    const int* adj_mat = pattern.get_adj_mat_ptr();
+    if (size < 4 || !pattern.check_connected())
+        return false;
+    int edge_num = 0;
+    int center[2], center_num = 0;
+    for (int u = 0; u < size; ++u) {
+        int degree = 0;
+        for (int v = 0; v < size; ++v)
+            degree += adj_mat[INDEX(u, v, size)] != 0;
+        edge_num += degree;
+        if (degree > 1) {
+            if (center_num == 2)
+                return false;
+            center[center_num++] = u;
+        }
+    }
+    if (edge_num != 2 * (size - 1) || center_num != 2 || adj_mat[INDEX(center[0], center[1], size)] == 0)
+        return false;
+    leaf_num_a = leaf_num_b = -1; // the other center is not a leaf
+    for (int v = 0; v < size; ++v) {
+        leaf_num_a += adj_mat[INDEX(center[0], v, size)] != 0;
+        leaf_num_b += adj_mat[INDEX(center[1], v, size)] != 0;
+    }
+    return true;
+}
+
+bool AnalyticCounter::is_supported(const Pattern& pattern, bool vertex_induced)
+{
+    int leaf_num_a, leaf_num_b;
+    int size = pattern.get_size();
+    const int* adj_mat = pattern.get_adj_mat_ptr();
+    if (size < 3 || !pattern.check_connected())
+        return false;
+    int edge_num = 0, max_degree = 0;
+    for (int u = 0; u < size; ++u) {
+        int degree = 0;
+        for (int v = 0; v < size; ++v)
+            degree += adj_mat[INDEX(u, v, size)] != 0;
+        edge_num += degree;
+        max_degree = std::max(max_degree, degree);
+    }
+    bool is_star = edge_num == 2 * (size - 1) && max_degree == size - 1;
+    if (vertex_induced)
+        return is_star && size == 3;
+    return is_star || get_double_star(pattern, leaf_num_a, leaf_num_b);
+}
+
+long long AnalyticCounter::count(const Pattern& pattern, bool vertex_induced)
+{
+    assert(is_supported(pattern, vertex_induced));
+    int leaf_num_a, leaf_num_b;
+    if (get_double_star(pattern, leaf_num_a, leaf_num_b))
+        return count_double_star(leaf_num_a, leaf_num_b);
+    if (vertex_induced)
+        return count_star(2) - 3 * count_triangles();
+    return count_star(pattern.get_size() - 1);
+}
+
+long long AnalyticCounter::count_star(int leaf_num)
+{
+    long long ans = 0;
+#pragma omp parallel for schedule(static) reduction(+ : ans)
+    for (v_index_t v = 0; v < g->v_cnt; ++v)
+        ans += binomial(g->vertex[v + 1] - g->vertex[v], leaf_num);
+    return ans;
+}
+
+long long AnalyticCounter::count_double_star(int leaf_num_a, int leaf_num_b)
+{
+    const int* t = get_support();
+    long long ans = 0;
+#pragma omp parallel for schedule(dynamic, 1024) reduction(+ : ans)
+    for (v_index_t u = 0; u < g->v_cnt; ++u) {
+        long long du = g->vertex[u + 1] - g->vertex[u];
+        for (e_index_t e = g->vertex[u]; e < g->vertex[u + 1]; ++e) {
+            v_index_t v = g->edge[e];
+            if (v <= u)
+                continue;
+            long long dv = g->vertex[v + 1] - g->vertex[v];
+            // a leaves of u and b of v, then the other way round if it differs
+            for (int swap = 0; swap < (leaf_num_a == leaf_num_b ? 1 : 2); ++swap) {
+                int a = swap ? leaf_num_b : leaf_num_a, b = swap ? leaf_num_a : leaf_num_b;
+                for (int i = 0; i <= a && i <= t[e]; ++i)
+                    ans += binomial(t[e], i) * binomial(du - 1 - t[e], a - i) * binomial(dv - 1 - i, b);
+            }
+        }
+    }
+    return ans;
+}
+
+long long AnalyticCounter::count_triangles()
+{
+    const int* t = get_support();
+    long long ans = 0;
+#pragma omp parallel for schedule(static) reduction(+ : ans)
+    for (e_index_t e = 0; e < g->e_cnt; ++e)
+        ans += t[e];
+    // every triangle is on 3 edges, each in both directions
+    return ans / 6;
+}
+
+const int* AnalyticCounter::get_support()
+{
+    std::call_once(support_flag, [this]() { support = g->edge_support(); });
+    return support;
+}
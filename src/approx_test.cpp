@@ -0,0 +1,55 @@
+#include <../include/graph.h>
+#include <../include/dataloader.h>
+#include "../include/pattern.h"
+#include "../include/common.h"
+
+#include <assert.h>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <omp.h>
+
+// Approximate pattern counting: samples start edges (or vertices with the
+// "vertex" option) until the confidence interval is within the requested
+// relative error.
+int main(int argc,char *argv[]) {
+    Graph *g;
+    DataLoader D;
+
+    if(argc < 4 || argc > 7) {
+        printf("usage: %s graph_file pattern_size pattern_adj_string [relative_error=0.01] [confidence=0.95] [edge|vertex]\n", argv[0]);
+        return 0;
+    }
+
+    bool ok = D.fast_load(g, argv[1]);
+    if(!ok) { printf("Load data failed\n"); return 0; }
+
+    printf("Load data success!\n");
+    fflush(stdout);
+    int pattern_size = atoi(argv[2]);
+    const char* pattern_str= argv[3];
+    double relative_error = argc > 4 ? atof(argv[4]) : 0.01;
+    double confidence = argc > 5 ? atof(argv[5]) : 0.95;
+    SampleType sample_type = SampleType::Edge;
+    if (argc > 6 && strcmp(argv[6], "vertex") == 0)
+        sample_type = SampleType::Vertex;
+
+    Pattern p(pattern_size, pattern_str);
+    bool is_pattern_valid;
+    Schedule_IEP schedule(p, is_pattern_valid, 1, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt);
+    assert(is_pattern_valid==true);
+    schedule.print_schedule();
+    printf("thread count: %d\n", omp_get_max_threads());
+
+    double t1 = get_wall_time();
+    CountEstimate result = g->pattern_matching_estimate(schedule, relative_error, confidence, sample_type);
+    double t2 = get_wall_time();
+
+    printf("Estimate: %.0lf [%.0lf, %.0lf] relative error: %.4lf confidence: %.3lf\n", result.estimate, result.lower, result.upper,
+           result.relative_error, confidence);
+    printf("samples: %lld %s\n", result.sample_cnt, result.converged ? "converged" : "not converged");
+    printf("Counting time cost: %.6lf s\n", t2 - t1);
+
+    delete g;
+    return 0;
+}
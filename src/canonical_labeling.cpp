@@ -0,0 +1,274 @@
+#include "../include/canonical_labeling.h"
+#include "../include/pattern.h"
+
+#include <algorithm>
+#include <cassert>
+
+CanonicalLabeling::CanonicalLabeling(const int* _adj_mat, int _size, const int* _color)
+    : size(_size), adj_mat(_adj_mat), color(_color), jump_depth(-1)
+{
+    is_directed = false;
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < i; ++j)
+            if ((adj_mat[INDEX(i, j, size)] != 0) != (adj_mat[INDEX(j, i, size)] != 0))
+                is_directed = true;
+
+    // the first cells are the colors, in increasing order
+    std::vector< std::vector<int> > cells;
+    std::vector<int> vertices(size);
+    for (int i = 0; i < size; ++i)
+        vertices[i] = i;
+    if (color != nullptr)
+        std::stable_sort(vertices.begin(), vertices.end(), [&](int a, int b) { return color[a] < color[b]; });
+    for (int i = 0; i < size; ++i) {
+        if (i == 0 || (color != nullptr && color[vertices[i]] != color[vertices[i - 1]]))
+            cells.push_back(std::vector<int>());
+        cells.back().push_back(vertices[i]);
+    }
+    std::vector<int> path;
+    if (size > 0)
+        search(cells, path);
+
+    // |Aut| is the product of the orbit sizes along the first path
+    automorphism_num = 1;
+    std::vector<int> orbit;
+    for (int depth = 0; depth < (int)first_path.size(); ++depth) {
+        get_stabilizer_orbits(first_path, depth, orbit);
+        automorphism_num *= std::count(orbit.begin(), orbit.end(), orbit[first_path[depth]]);
+    }
+
+    get_stabilizer_orbits(first_path, 0, orbits);
+    std::vector<int> id(size, -1);
+    int orbit_num = 0;
+    for (int i = 0; i < size; ++i) {
+        if (id[orbits[i]] == -1)
+            id[orbits[i]] = orbit_num++;
+        orbits[i] = id[orbits[i]];
+    }
+}
+
+// Splits each cell by the numbers of out- and in-neighbors of its vertices in
+// every cell, the parts in increasing order of those numbers, until no cell
+// splits. The result only depends on the graph and the order of the cells, so
+// isomorphisms map it to the refinement of the image.
+void CanonicalLabeling::refine(std::vector< std::vector<int> >& cells) const
+{
+    std::vector<int> cell_id(size);
+    bool split = true;
+    while (split && (int)cells.size() < size) {
+        split = false;
+        int cell_num = cells.size();
+        for (int c = 0; c < cell_num; ++c)
+            for (int v : cells[c])
+                cell_id[v] = c;
+        std::vector< std::vector<int> > next_cells;
+        for (const auto& cell : cells) {
+            if (cell.size() == 1) {
+                next_cells.push_back(cell);
+                continue;
+            }
+            std::vector< std::pair< std::vector<int>, int > > keys;
+            for (int v : cell) {
+                std::vector<int> key(is_directed ? 2 * cell_num : cell_num, 0);
+                for (int u = 0; u < size; ++u) {
+                    if (adj_mat[INDEX(v, u, size)] != 0)
+                        ++key[cell_id[u]];
+                    if (is_directed && adj_mat[INDEX(u, v, size)] != 0)
+                        ++key[cell_num + cell_id[u]];
+                }
+                keys.push_back(std::make_pair(key, v));
+            }
+            std::sort(keys.begin(), keys.end());
+            for (int i = 0; i < (int)keys.size(); ++i) {
+                if (i == 0 || keys[i].first != keys[i - 1].first)
+                    next_cells.push_back(std::vector<int>());
+                next_cells.back().push_back(keys[i].second);
+            }
+            if (keys.front().first != keys.back().first)
+                split = true;
+        }
+        cells.swap(next_cells);
+    }
+}
+
+void CanonicalLabeling::search(std::vector< std::vector<int> >& cells, std::vector<int>& path)
+{
+    refine(cells);
+    int target = 0;
+    while (target < (int)cells.size() && cells[target].size() == 1)
+        ++target;
+    if (target == (int)cells.size()) {
+        visit_leaf(cells, path);
+        return;
+    }
+
+    int depth = path.size();
+    std::vector<int> candidates = cells[target];
+    std::vector<int> explored, orbit;
+    for (int v : candidates) {
+        // automorphisms that fix the path map the child v to child w
+        get_stabilizer_orbits(path, depth, orbit);
+        bool is_equivalent = false;
+        for (int w : explored)
+            if (orbit[w] == orbit[v])
+                is_equivalent = true;
+        if (is_equivalent)
+            continue;
+        explored.push_back(v);
+
+        std::vector< std::vector<int> > child(cells.begin(), cells.begin() + target);
+        child.push_back(std::vector<int>(1, v));
+        child.push_back(std::vector<int>());
+        for (int u : cells[target])
+            if (u != v)
+                child.back().push_back(u);
+        child.insert(child.end(), cells.begin() + target + 1, cells.end());
+        path.push_back(v);
+        search(child, path);
+        path.pop_back();
+
+        if (jump_depth != -1) {
+            if (jump_depth < depth)
+                return;
+            jump_depth = -1;
+        }
+    }
+}
+
+void CanonicalLabeling::visit_leaf(const std::vector< std::vector<int> >& cells, const std::vector<int>& path)
+{
+    std::vector<int> order;
+    for (const auto& cell : cells)
+        order.push_back(cell[0]);
+    std::string code = get_code(order);
+    if (first_order.empty()) {
+        first_path = path;
+        first_order = order;
+        first_code = code;
+        best_path = path;
+        canonical_order = order;
+        canonical_code = code;
+        return;
+    }
+
+    // an automorphism maps the subtree of the ancestor's child on the path of
+    // the equivalent leaf to the current one, which is left
+    const std::vector<int>* equivalent_path = nullptr;
+    if (code == first_code) {
+        add_automorphism(first_order, order);
+        equivalent_path = &first_path;
+    }
+    else if (code == canonical_code) {
+        add_automorphism(canonical_order, order);
+        equivalent_path = &best_path;
+    }
+    else if (code > canonical_code) {
+        canonical_order = order;
+        canonical_code = code;
+        best_path = path;
+    }
+    if (equivalent_path != nullptr) {
+        int common = 0;
+        while (common < (int)path.size() && common < (int)equivalent_path->size() && path[common] == (*equivalent_path)[common])
+            ++common;
+        jump_depth = common;
+    }
+}
+
+std::string CanonicalLabeling::get_code(const std::vector<int>& order) const
+{
+    std::string code;
+    if (color != nullptr)
+        for (int v : order)
+            code += std::to_string(color[v]) + ",";
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < size; ++j)
+            code += adj_mat[INDEX(order[i], order[j], size)] != 0 ? '1' : '0';
+    return code;
+}
+
+void CanonicalLabeling::add_automorphism(const std::vector<int>& from, const std::vector<int>& to)
+{
+    std::vector<int> automorphism(size);
+    for (int i = 0; i < size; ++i)
+        automorphism[from[i]] = to[i];
+    for (const auto& g : generators)
+        if (g == automorphism)
+            return;
+    generators.push_back(automorphism);
+}
+
+void CanonicalLabeling::get_stabilizer_orbits(const std::vector<int>& path, int fixed_num, std::vector<int>& orbit) const
+{
+    orbit.resize(size);
+    for (int i = 0; i < size; ++i)
+        orbit[i] = i;
+    for (const auto& g : generators) {
+        bool fixes = true;
+        for (int i = 0; i < fixed_num && fixes; ++i)
+            fixes = g[path[i]] == path[i];
+        if (!fixes)
+            continue;
+        for (int i = 0; i < size; ++i) {
+            int a = orbit[i], b = orbit[g[i]];
+            if (a == b)
+                continue;
+            if (a > b)
+                std::swap(a, b);
+            for (int j = 0; j < size; ++j)
+                if (orbit[j] == b)
+                    orbit[j] = a;
+        }
+    }
+}
+
+void CanonicalLabeling::get_transversal(int depth, std::vector< std::vector<int> >& transversal) const
+{
+    int v = first_path[depth];
+    std::vector<int> identity(size);
+    for (int i = 0; i < size; ++i)
+        identity[i] = i;
+    transversal.assign(1, identity);
+    std::vector<bool> reached(size, false);
+    reached[v] = true;
+    for (int k = 0; k < (int)transversal.size(); ++k)
+        for (const auto& g : generators) {
+            bool fixes = true;
+            for (int i = 0; i < depth && fixes; ++i)
+                fixes = g[first_path[i]] == first_path[i];
+            if (!fixes)
+                continue;
+            std::vector<int> next(size);
+            for (int i = 0; i < size; ++i)
+                next[i] = g[transversal[k][i]];
+            if (!reached[next[v]]) {
+                reached[next[v]] = true;
+                transversal.push_back(next);
+            }
+        }
+}
+
+// Every automorphism is t_0 t_1 ... t_k for one choice of the coset
+// representatives t_i of each level of the first path.
+std::vector< std::vector<int> > CanonicalLabeling::get_automorphisms() const
+{
+    std::vector<int> identity(size);
+    for (int i = 0; i < size; ++i)
+        identity[i] = i;
+    std::vector< std::vector<int> > automorphisms(1, identity);
+    for (int depth = (int)first_path.size() - 1; depth >= 0; --depth) {
+        std::vector< std::vector<int> > transversal, next;
+        get_transversal(depth, transversal);
+        for (const auto& t : transversal)
+            for (const auto& h : automorphisms) {
+                std::vector<int> g(size);
+                for (int i = 0; i < size; ++i)
+                    g[i] = t[h[i]];
+                next.push_back(g);
+            }
+        automorphisms.swap(next);
+    }
+    assert((long long)automorphisms.size() == automorphism_num);
+    std::sort(automorphisms.begin(), automorphisms.end());
+    return automorphisms;
+}
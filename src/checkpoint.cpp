@@ -0,0 +1,162 @@
+#include "../include/checkpoint.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+static const char checkpoint_magic[8] = {'G', 'M', 'C', 'K', 'P', 'T', '0', '1'};
+
+Checkpoint::Checkpoint(const char *_file_name, bool _restart, double _interval)
+    : file_name(_file_name), restart(_restart), interval(_interval), restored_stage(0), restored_base(0), restored_unit_num(0), restored_ans(0),
+      stage(0), base(0), unit_num(0), stage_restored_ans(0), finished(nullptr), unit_ans(nullptr), bits(nullptr), bits_len(0), dirty(false),
+      stopped(false) {
+    writer = std::thread(&Checkpoint::writer_loop, this);
+}
+
+Checkpoint::~Checkpoint() {
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex);
+        stopped = true;
+    }
+    writer_cv.notify_all();
+    writer.join();
+    if (!key.empty())
+        save();
+    delete[] finished;
+    delete[] unit_ans;
+}
+
+void Checkpoint::writer_loop() {
+    std::unique_lock<std::mutex> lock(writer_mutex);
+    while (!stopped) {
+        writer_cv.wait_for(lock, std::chrono::duration<double>(interval));
+        if (stopped)
+            break;
+        if (!dirty.exchange(false))
+            continue;
+        lock.unlock();
+        save();
+        lock.lock();
+    }
+}
+
+bool Checkpoint::restore(const std::string &_key) {
+    {
+        std::lock_guard<std::mutex> lock(stage_mutex);
+        key = _key;
+    }
+    restored_stage = restored_base = restored_unit_num = restored_ans = 0;
+    restored_finished.clear();
+    restored_bits.clear();
+    if (!restart)
+        return false;
+    if (!load()) {
+        restored_stage = restored_base = restored_unit_num = restored_ans = 0;
+        restored_finished.clear();
+        restored_bits.clear();
+        return false;
+    }
+    printf("checkpoint: resuming stage %lld from %s\n", restored_stage, file_name.c_str());
+    return true;
+}
+
+bool Checkpoint::load() {
+    FILE *fp = fopen(file_name.c_str(), "rb");
+    if (fp == nullptr)
+        return false;
+    bool ok = true;
+    char magic[8];
+    uint64_t key_len = 0;
+    ok = ok && fread(magic, 1, 8, fp) == 8 && memcmp(magic, checkpoint_magic, 8) == 0;
+    ok = ok && fread(&key_len, sizeof(key_len), 1, fp) == 1 && key_len == key.size();
+    if (ok) {
+        std::string file_key(key_len, ' ');
+        ok = fread(&file_key[0], 1, key_len, fp) == key_len && file_key == key;
+    }
+    ok = ok && fread(&restored_stage, sizeof(long long), 1, fp) == 1;
+    ok = ok && fread(&restored_base, sizeof(long long), 1, fp) == 1;
+    ok = ok && fread(&restored_unit_num, sizeof(long long), 1, fp) == 1;
+    ok = ok && fread(&restored_ans, sizeof(long long), 1, fp) == 1;
+    if (ok) {
+        restored_finished.resize((restored_unit_num + 63) / 64);
+        ok = fread(restored_finished.data(), sizeof(uint64_t), restored_finished.size(), fp) == restored_finished.size();
+    }
+    uint64_t len = 0;
+    ok = ok && fread(&len, sizeof(len), 1, fp) == 1;
+    if (ok) {
+        restored_bits.resize(len);
+        ok = fread(restored_bits.data(), sizeof(unsigned int), len, fp) == len;
+    }
+    fclose(fp);
+    return ok;
+}
+
+bool Checkpoint::get_restored_bits(unsigned int *_bits, size_t len) const {
+    if (restored_bits.size() != len)
+        return false;
+    memcpy(_bits, restored_bits.data(), sizeof(unsigned int) * len);
+    return true;
+}
+
+long long Checkpoint::begin_stage(long long _stage, long long _base, long long _unit_num) {
+    std::lock_guard<std::mutex> lock(stage_mutex);
+    delete[] finished;
+    delete[] unit_ans;
+    stage = _stage;
+    base = _base;
+    unit_num = _unit_num;
+    long long word_num = (unit_num + 63) / 64;
+    finished = new std::atomic<uint64_t>[word_num];
+    unit_ans = new long long[unit_num];
+    memset(unit_ans, 0, sizeof(long long) * unit_num);
+    bool resumed = stage == restored_stage && unit_num == restored_unit_num && (long long)restored_finished.size() == word_num;
+    for (long long i = 0; i < word_num; ++i)
+        finished[i].store(resumed ? restored_finished[i] : 0, std::memory_order_relaxed);
+    stage_restored_ans = resumed ? restored_ans : 0;
+    dirty.store(true);
+    return stage_restored_ans;
+}
+
+void Checkpoint::set_bits(const unsigned int *_bits, size_t len) {
+    std::lock_guard<std::mutex> lock(stage_mutex);
+    bits = _bits;
+    bits_len = len;
+}
+
+void Checkpoint::save() {
+    std::string tmp_name = file_name + ".tmp";
+    std::lock_guard<std::mutex> lock(stage_mutex);
+    FILE *fp = fopen(tmp_name.c_str(), "wb");
+    if (fp == nullptr) {
+        printf("checkpoint: cannot write %s\n", tmp_name.c_str());
+        return;
+    }
+    long long word_num = (unit_num + 63) / 64;
+    std::vector<uint64_t> words(word_num);
+    long long ans = stage_restored_ans;
+    for (long long i = 0; i < word_num; ++i) {
+        words[i] = finished[i].load(std::memory_order_acquire);
+        for (uint64_t w = words[i]; w != 0; w &= w - 1)
+            ans += unit_ans[i * 64 + __builtin_ctzll(w)];
+    }
+    // the bitvector is written by the workers without atomics, read each word once
+    std::vector<unsigned int> bits_copy(bits_len);
+    for (size_t i = 0; i < bits_len; ++i)
+        bits_copy[i] = __atomic_load_n(bits + i, __ATOMIC_RELAXED);
+
+    uint64_t key_len = key.size();
+    uint64_t len = bits_len;
+    bool ok = fwrite(checkpoint_magic, 1, 8, fp) == 8;
+    ok = ok && fwrite(&key_len, sizeof(key_len), 1, fp) == 1;
+    ok = ok && fwrite(key.data(), 1, key_len, fp) == key_len;
+    ok = ok && fwrite(&stage, sizeof(long long), 1, fp) == 1;
+    ok = ok && fwrite(&base, sizeof(long long), 1, fp) == 1;
+    ok = ok && fwrite(&unit_num, sizeof(long long), 1, fp) == 1;
+    ok = ok && fwrite(&ans, sizeof(long long), 1, fp) == 1;
+    ok = ok && fwrite(words.data(), sizeof(uint64_t), word_num, fp) == (size_t)word_num;
+    ok = ok && fwrite(&len, sizeof(len), 1, fp) == 1;
+    ok = ok && fwrite(bits_copy.data(), sizeof(unsigned int), len, fp) == len;
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || rename(tmp_name.c_str(), file_name.c_str()) != 0)
+        printf("checkpoint: cannot write %s\n", file_name.c_str());
+}
@@ -4,6 +4,7 @@
 #include "../include/schedule.h"
 #include "../include/common.h"
 #include "../include/motif_generator.h"
+#include "../include/query_router.h"
 #include "omp.h"
 
 #include <assert.h>
@@ -12,38 +13,20 @@
 #include <algorithm>
 
 double test_pattern(Graph* g, Pattern &pattern) {
-
-    bool is_pattern_valid;
-    int performance_modeling_type;
-    bool use_in_exclusion_optimize;
-
-    performance_modeling_type = 1;
-    use_in_exclusion_optimize = true;
-    Schedule_IEP schedule_our(pattern, is_pattern_valid, performance_modeling_type, 1, use_in_exclusion_optimize, g->v_cnt, g->e_cnt);
-    assert(is_pattern_valid==true);
-
-    double t1,t2;
-    double total_time = 0;
-
-    int times = 1;
-
     printf("thread num: %d\n", omp_get_max_threads());
 
-    for(int i = 0; i < times; ++i) {
-        t1 = get_wall_time();
-        long long ans_our = g->pattern_matching(schedule_our, true);
-        t2 = get_wall_time();
+    // the router counts cliques on an oriented copy, the graph is not reduced in place
+    QueryRouter router(g);
+    long long ans;
+    double t1 = get_wall_time();
+    bool ok = router.count_direct(pattern, false, ans);
+    assert(ok);
+    double t2 = get_wall_time();
 
-        printf("ans: %lld time: %.6lf\n", ans_our, t2 - t1);
-        total_time += (t2 - t1);
-        if(i == times - 1) {
-            schedule_our.print_schedule();
-        }
-        fflush(stdout);
-    }
-    total_time /= times;
-    printf("Counting time cost: %.6lf s\n",total_time);
-    return total_time;
+    printf("ans: %lld time: %.6lf engine: %s\n", ans, t2 - t1, router.get_last_engine());
+    printf("Counting time cost: %.6lf s\n", t2 - t1);
+    fflush(stdout);
+    return t2 - t1;
 }
 
 int main(int argc,char *argv[]) {
@@ -55,8 +38,6 @@ int main(int argc,char *argv[]) {
         return 0;
     }
 
-    DataType type = DataType::Patents;
-
     bool ok = D.fast_load(g, argv[1]);
     if(!ok) { printf("Load data failed\n"); return 0; }
 
@@ -70,7 +51,6 @@ int main(int argc,char *argv[]) {
         }
     }
 
-    reduce_edges_for_clique(*g);
     test_pattern(g, pattern);
     delete g;
     return 0;
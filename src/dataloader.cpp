@@ -10,6 +10,9 @@
 #include <string>
 #include <map>
 #include <cstdint>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 struct FileGuard {
     FILE *fp;
@@ -18,14 +21,29 @@ struct FileGuard {
     ~FileGuard() { fclose(fp); }
 };
 
+// graph_header_version in GraphHeader::version: a GraphStatsHeader and the
+// DegreeStatistics follow the header, only a GraphStatsHeader with version 1
+static const uint32_t graph_header_version = 0x32544753; // "SGT2"
+static const uint32_t graph_header_version_1 = 0x31544753; // "SGT1"
+
 struct GraphHeader {
     v_index_t v_cnt;
+    uint32_t version; // was padding, arbitrary in older files
     e_index_t e_cnt;
     uint32_t max_intersection_size, checksum;
     int64_t tri_cnt;
 };
 
-static void calculate_checksum(GraphHeader& h)
+// statistics of the performance model, counted once when the graph is dumped
+struct GraphStatsHeader {
+    int64_t tri_cnt;
+    int64_t wedge_cnt;
+    v_index_t max_degree;
+    uint32_t checksum;
+};
+
+template <typename Header>
+static void calculate_checksum(Header& h)
 {
     h.checksum = 0;
     uint32_t sum = 0;
@@ -36,7 +54,8 @@ static void calculate_checksum(GraphHeader& h)
     h.checksum = -sum;
 }
 
-static bool do_checksum(GraphHeader& h)
+template <typename Header>
+static bool do_checksum(Header& h)
 {
     uint32_t sum = 0;
     uint32_t *p = reinterpret_cast<uint32_t*>(&h);
@@ -53,29 +72,136 @@ static bool do_checksum(GraphHeader& h)
  */
 static bool dump_graph(Graph& g, const char* filename)
 {
+    if (g.tri_cnt < 0 || g.degree_stats == nullptr)
+        g.compute_statistics();
+
     GraphHeader h;
+    memset(&h, 0, sizeof(h));
     h.v_cnt = g.v_cnt;
+    h.version = graph_header_version;
     h.e_cnt = g.e_cnt;
     h.tri_cnt = g.tri_cnt;
-    h.max_intersection_size = VertexSet::max_intersection_size; // ...
+    h.max_intersection_size = g.get_max_intersection_size();
     calculate_checksum(h);
 
+    GraphStatsHeader s;
+    memset(&s, 0, sizeof(s));
+    s.tri_cnt = g.tri_cnt;
+    s.wedge_cnt = g.wedge_cnt;
+    s.max_degree = g.max_degree;
+    calculate_checksum(s);
+    calculate_checksum(*g.degree_stats);
+
     FILE *fp = fopen(filename, "wb");
     if (!fp)
         return false;
     fwrite(&h, sizeof(h), 1, fp);
+    fwrite(&s, sizeof(s), 1, fp);
+    fwrite(g.degree_stats, sizeof(DegreeStatistics), 1, fp);
     fwrite(g.vertex, sizeof(e_index_t), g.v_cnt + 1, fp);
     fwrite(g.edge, sizeof(v_index_t), g.e_cnt, fp);
     fclose(fp);
     return true;
 }
 
+// Statistics of a file without them, saved next to it as filename + ".stats"
+// when they are first counted. They belong to the file of that size and
+// modification time only.
+struct GraphStatsFile {
+    v_index_t v_cnt;
+    uint32_t checksum;
+    e_index_t e_cnt;
+    int64_t file_size;
+    int64_t file_mtime;
+};
+
+static bool stats_key(const char* filename, const Graph& g, GraphStatsFile& key)
+{
+    struct stat st;
+    if (stat(filename, &st) != 0)
+        return false;
+    memset(&key, 0, sizeof(key));
+    key.v_cnt = g.v_cnt;
+    key.e_cnt = g.e_cnt;
+    key.file_size = st.st_size;
+    key.file_mtime = st.st_mtime;
+    calculate_checksum(key);
+    return true;
+}
+
+/**
+ * @brief read the saved statistics of a file without them
+ * @return true if they were saved for this file
+ */
+static bool load_stats(Graph& g, const char* filename)
+{
+    GraphStatsFile key, saved;
+    if (!stats_key(filename, g, key))
+        return false;
+    std::string stats_name = std::string(filename) + ".stats";
+    FILE *fp = fopen(stats_name.c_str(), "rb");
+    if (!fp)
+        return false;
+    FileGuard guard(fp);
+    GraphStatsHeader s;
+    DegreeStatistics* degree_stats = new DegreeStatistics();
+    if (fread(&saved, sizeof(saved), 1, fp) != 1 || memcmp(&saved, &key, sizeof(key)) != 0 ||
+        fread(&s, sizeof(s), 1, fp) != 1 || !do_checksum(s) ||
+        fread(degree_stats, sizeof(DegreeStatistics), 1, fp) != 1 || !do_checksum(*degree_stats)) {
+        delete degree_stats;
+        return false;
+    }
+    g.tri_cnt = s.tri_cnt;
+    g.wedge_cnt = s.wedge_cnt;
+    g.max_degree = s.max_degree;
+    delete g.degree_stats;
+    g.degree_stats = degree_stats;
+    return true;
+}
+
+/**
+ * @brief save the statistics of a file without them, so later loads read them
+ * @note the graph file itself is never rewritten, it may be mapped or read-only
+ */
+static void dump_stats(const Graph& g, const char* filename)
+{
+    GraphStatsFile key;
+    if (!stats_key(filename, g, key))
+        return;
+    GraphStatsHeader s;
+    memset(&s, 0, sizeof(s));
+    s.tri_cnt = g.tri_cnt;
+    s.wedge_cnt = g.wedge_cnt;
+    s.max_degree = g.max_degree;
+    calculate_checksum(s);
+    calculate_checksum(*g.degree_stats);
+
+    // written aside first, so a concurrent load never reads half of it and
+    // concurrent dumps do not write the same file
+    std::string stats_name = std::string(filename) + ".stats";
+    std::string tmp_name = stats_name + ".tmp" + std::to_string(getpid());
+    FILE *fp = fopen(tmp_name.c_str(), "wb");
+    bool success = fp != nullptr;
+    if (success) {
+        success = fwrite(&key, sizeof(key), 1, fp) == 1 && fwrite(&s, sizeof(s), 1, fp) == 1 &&
+                  fwrite(g.degree_stats, sizeof(DegreeStatistics), 1, fp) == 1;
+        success = fclose(fp) == 0 && success;
+        success = success && rename(tmp_name.c_str(), stats_name.c_str()) == 0;
+    }
+    if (success)
+        printf("load_graph: statistics saved to %s\n", stats_name.c_str());
+    else {
+        remove(tmp_name.c_str());
+        printf("load_graph: cannot save the statistics to %s\n", stats_name.c_str());
+    }
+}
+
 /**
  * @brief load graph from a file
  * @note for internal use only
  * @return true if graph is successfully loaded
  */
-static bool load_graph(Graph& g, const char* filename)
+static bool load_graph(Graph& g, const char* filename, bool use_mmap)
 {
     GraphHeader h;
 
@@ -93,36 +219,92 @@ static bool load_graph(Graph& g, const char* filename)
         printf("load_graph: checksum != 0. stop.\n");
         return false;
     }
+    GraphStatsHeader s;
+    bool has_stats = h.version == graph_header_version || h.version == graph_header_version_1;
+    if (has_stats && (fread(&s, sizeof(s), 1, fp) != 1 || !do_checksum(s))) {
+        printf("load_graph: bad statistics header.\n");
+        return false;
+    }
+    DegreeStatistics* degree_stats = nullptr;
+    if (h.version == graph_header_version) {
+        degree_stats = new DegreeStatistics();
+        if (fread(degree_stats, sizeof(DegreeStatistics), 1, fp) != 1 || !do_checksum(*degree_stats)) {
+            printf("load_graph: bad degree statistics.\n");
+            delete degree_stats;
+            return false;
+        }
+    }
+    g.degree_stats = degree_stats;
 
     g.v_cnt = h.v_cnt;
     g.e_cnt = h.e_cnt;
-    g.tri_cnt = h.tri_cnt;
-    VertexSet::max_intersection_size = h.max_intersection_size; // ...
-
-    g.vertex = new e_index_t[h.v_cnt + 1];
-    g.edge = new v_index_t[g.e_cnt];
-
-    if (fread(g.vertex, sizeof(e_index_t), h.v_cnt + 1, fp) != h.v_cnt + 1) {
-        printf("load_graph: failed to load vertexes.\n");
-        return false;
+    g.set_max_intersection_size(h.max_intersection_size);
+    // the default of the vertex sets outside Graph's engine fits every loaded graph
+    VertexSet::max_intersection_size = std::max(VertexSet::max_intersection_size, (int)h.max_intersection_size);
+
+    // the headers are multiples of 8 bytes, so the arrays are aligned in the mapping
+    long offset = ftell(fp);
+    size_t data_len = offset + sizeof(e_index_t) * (h.v_cnt + 1) + sizeof(v_index_t) * h.e_cnt;
+    struct stat st;
+    if (use_mmap && offset % sizeof(e_index_t) == 0 && fstat(fileno(fp), &st) == 0 && (size_t)st.st_size >= data_len) {
+        void* data = mmap(nullptr, data_len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(fp), 0);
+        if (data != MAP_FAILED) {
+            g.mapped_data = data;
+            g.mapped_len = data_len;
+            g.vertex = reinterpret_cast<e_index_t*>(static_cast<char*>(data) + offset);
+            g.edge = reinterpret_cast<v_index_t*>(g.vertex + h.v_cnt + 1);
+        }
+        else
+            printf("load_graph: cannot map %s, reading it instead\n", filename);
+    }
+    if (g.mapped_data == nullptr) {
+        g.vertex = new e_index_t[h.v_cnt + 1];
+        g.edge = new v_index_t[g.e_cnt];
+
+        if (fread(g.vertex, sizeof(e_index_t), h.v_cnt + 1, fp) != (size_t)h.v_cnt + 1) {
+            printf("load_graph: failed to load vertexes.\n");
+            return false;
+        }
+        if (fread(g.edge, sizeof(v_index_t), h.e_cnt, fp) != (size_t)h.e_cnt) {
+            printf("load_graph: failed to load edges.\n");
+            return false;
+        }
     }
-    if (fread(g.edge, sizeof(v_index_t), h.e_cnt, fp) != h.e_cnt) {
-        printf("load_graph: failed to load edges.\n");
-        return false;
+    if (has_stats) {
+        g.tri_cnt = s.tri_cnt;
+        g.wedge_cnt = s.wedge_cnt;
+        g.max_degree = s.max_degree;
+    }
+    // older files lack some statistics (their tri_cnt is often 0), they are
+    // counted on the first load only
+    if (g.degree_stats == nullptr && !load_stats(g, filename)) {
+        if (has_stats) {
+            g.degree_stats = new DegreeStatistics();
+            g.degree_stats->compute(g);
+        } else {
+            printf("load_graph: no statistics in %s, counting triangles\n", filename);
+            g.compute_statistics();
+        }
+        dump_stats(g, filename);
     }
     printf("load_graph: %u vertexes, %lu edges\n", g.v_cnt, g.e_cnt);
     return true;
 }
 
-bool DataLoader::fast_load(Graph* &g, const char* path)
+bool DataLoader::fast_load(Graph* &g, const char* path, bool use_mmap)
 {
     g = new Graph();
-    bool success = load_graph(*g, path);
+    bool success = load_graph(*g, path, use_mmap);
     if (!success)
         delete g;
     return success;
 }
 
+bool DataLoader::fast_dump(Graph* g, const char* path)
+{
+    return dump_graph(*g, path);
+}
+
 bool DataLoader::load_data(Graph* &g, DataType type, const char* path, bool binary_input, int oriented_type) {
     if(type == Patents || type == Orkut || type == complete8 || type == LiveJournal || type == MiCo || type == CiteSeer || type == Wiki_Vote || type == YouTube || type == Friendster) {
         return general_load_data(g, type, path, binary_input, oriented_type);
@@ -197,46 +379,6 @@ bool DataLoader::general_load_data(Graph* &g, DataType type, const char* path, b
     printf("Load begin in %s\n", path);
     g = new Graph();
 
-    //load triangle counting information
-    switch(type) {
-        case DataType::Patents : {
-            g->tri_cnt = Patents_tri_cnt;
-            break;
-        }
-        case DataType::LiveJournal : {
-            g->tri_cnt = LiveJournal_tri_cnt;
-            break;
-        }
-        case DataType::MiCo : {
-            g->tri_cnt = MiCo_tri_cnt;
-            break;
-        }
-        case DataType::CiteSeer : {
-            g->tri_cnt = CiteSeer_tri_cnt;
-            break;
-        }
-        case DataType::Wiki_Vote : {
-            g->tri_cnt = Wiki_Vote_tri_cnt;
-            break;
-        }
-        case DataType::Orkut : {
-            g->tri_cnt = Orkut_tri_cnt;
-            break;
-        }
-        case DataType::YouTube : {
-            g->tri_cnt = YouTube_tri_cnt;
-            break;
-        }
-        case DataType::Friendster : {
-            g->tri_cnt = Friendster_tri_cnt;
-            break;
-        }
-        default : {
-            g->tri_cnt = -1;
-            break;
-        }
-    }
-
     uint32_t x,y;
     e_index_t z;
     v_index_t tmp_v;
@@ -297,7 +439,7 @@ bool DataLoader::general_load_data(Graph* &g, DataType type, const char* path, b
     std::nth_element(degree, degree + g->v_cnt - 2, degree + g->v_cnt); // OK, fixed
 
     // The max size of intersections is the second largest degree.
-    //TODO VertexSet::max_intersection_size has different value with different dataset, but we use a static variable now.
+    g->set_max_intersection_size(degree[g->v_cnt - 2]);
     VertexSet::max_intersection_size = std::max( VertexSet::max_intersection_size, degree[g->v_cnt - 2]);
     delete[] degree;
     if(tmp_v != g->v_cnt) {
@@ -343,6 +485,9 @@ bool DataLoader::general_load_data(Graph* &g, DataType type, const char* path, b
         }
     delete[] have_edge;
 
+    g->compute_statistics();
+    printf("%lld triangles\n", g->tri_cnt);
+
     bool ok = dump_graph(*g, "patents.g");
     printf("dump graph %d\n", ok);
 
@@ -357,13 +502,13 @@ bool DataLoader::twitter_load_data(Graph *&g, DataType type, const char* path, i
     }
     printf("Load begin in %s\n",path);
     g = new Graph();
-    g->tri_cnt = Twitter_tri_cnt;
     unsigned int* buffer = new unsigned int[41652230u + 2936729768u + 10u];
     FILE* file = fopen(path, "r");
     fread(buffer, sizeof(unsigned int), 41652230u + 2936729768u + 4, file);
     g->v_cnt = buffer[0];
     g->e_cnt = buffer[1];
     int mx_degree = buffer[2];
+    g->set_max_intersection_size(mx_degree);
     VertexSet::max_intersection_size = std::max( VertexSet::max_intersection_size, mx_degree);
     g->edge = new v_index_t [g->e_cnt];
     g->vertex = new e_index_t [g->v_cnt + 1];
@@ -372,9 +517,30 @@ bool DataLoader::twitter_load_data(Graph *&g, DataType type, const char* path, i
     for(e_index_t i = 0; i < g->e_cnt; ++i)
         g->edge[i] = buffer[4 + g->v_cnt + i];
     delete[] buffer;
+    g->compute_statistics();
     return true;
 }
 
+// triangles of the graph of the (directed, both ways) edges e, which are sorted
+static long long count_triangles(std::vector< std::pair<uint32_t, uint32_t> >& e, int v_cnt)
+{
+    std::sort(e.begin(), e.end());
+    Graph g;
+    g.v_cnt = v_cnt;
+    g.e_cnt = std::unique(e.begin(), e.end()) - e.begin();
+    g.vertex = new e_index_t[v_cnt + 1];
+    g.edge = new v_index_t[g.e_cnt];
+    memset(g.vertex, 0, sizeof(e_index_t) * (v_cnt + 1));
+    for (e_index_t i = 0; i < g.e_cnt; ++i) {
+        ++g.vertex[e[i].first + 1];
+        g.edge[i] = e[i].second;
+    }
+    for (int v = 0; v < v_cnt; ++v)
+        g.vertex[v + 1] += g.vertex[v];
+    g.compute_statistics();
+    return g.tri_cnt;
+}
+
 //默认节点编号从0~cnt-1，不进行重排序；默认同一条边在输入数据中会出现正反各一次（所以按照单向边读入）
 //第一行为点数v_cnt
 //接下来v_cnt行，每行第一个数是点编号，第二个数是label（可以不从0开始，会重新映射），之后一直到行末是邻居节点编号
@@ -388,46 +554,6 @@ bool DataLoader::general_load_labeled_data(LabeledGraph* &g, DataType type, cons
     printf("Load begin in %s\n", path);
     g = new LabeledGraph();
 
-    //load triangle counting information
-    switch(type) {
-        case DataType::Patents : {
-            g->tri_cnt = Patents_tri_cnt;
-            break;
-        }
-        case DataType::LiveJournal : {
-            g->tri_cnt = LiveJournal_tri_cnt;
-            break;
-        }
-        case DataType::MiCo : {
-            g->tri_cnt = MiCo_tri_cnt;
-            break;
-        }
-        case DataType::CiteSeer : {
-            g->tri_cnt = CiteSeer_tri_cnt;
-            break;
-        }
-        case DataType::Wiki_Vote : {
-            g->tri_cnt = Wiki_Vote_tri_cnt;
-            break;
-        }
-        case DataType::Orkut : {
-            g->tri_cnt = Orkut_tri_cnt;
-            break;
-        }
-        case DataType::YouTube : {
-            g->tri_cnt = YouTube_tri_cnt;
-            break;
-        }
-        case DataType::Friendster : {
-            g->tri_cnt = Friendster_tri_cnt;
-            break;
-        }
-        default : {
-            g->tri_cnt = -1;
-            break;
-        }
-    }
-
     uint32_t x, y, tmp_v, tmp_e, tmp_l;
     fin >> x;
     g->v_cnt = x;
@@ -605,6 +731,7 @@ bool DataLoader::general_load_labeled_data(LabeledGraph* &g, DataType type, cons
         lst_l = std::get<1>(labeled_e->at(i));
         g->edge[i] = std::get<2>(labeled_e->at(i));
     }
+    g->tri_cnt = count_triangles(*e, g->v_cnt);
     delete e;
     delete labeled_e;
     printf("Success! There are %d nodes and %u edges.\n",g->v_cnt,g->e_cnt);
@@ -658,7 +785,7 @@ bool DataLoader::load_data(Graph* &g, int clique_size) {
     std::sort(degree, degree + g->v_cnt);
 
     // The max size of intersections is the second largest degree.
-    //TODO VertexSet::max_intersection_size has different value with different dataset, but we use a static variable now.
+    g->set_max_intersection_size(degree[g->v_cnt - 2]);
     VertexSet::max_intersection_size = std::max( VertexSet::max_intersection_size, degree[g->v_cnt - 2]);
     delete[] degree;
     if(tmp_v != g->v_cnt) {
@@ -695,6 +822,7 @@ bool DataLoader::load_data(Graph* &g, int clique_size) {
             g->vertex[i] = g->vertex[i+1];
         }
     delete[] have_edge;
+    g->compute_statistics();
     return true;
 }
 
@@ -729,7 +857,7 @@ bool DataLoader::load_complete(Graph* &g, int clique_size) {
     std::sort(degree, degree + g->v_cnt);
 
     // The max size of intersections is the second largest degree.
-    //TODO VertexSet::max_intersection_size has different value with different dataset, but we use a static variable now.
+    g->set_max_intersection_size(degree[g->v_cnt - 2]);
     VertexSet::max_intersection_size = std::max( VertexSet::max_intersection_size, degree[g->v_cnt - 2]);
     //g->max_degree = degree[g->v_cnt - 1];
     delete[] degree;
@@ -767,6 +895,7 @@ bool DataLoader::load_complete(Graph* &g, int clique_size) {
             g->vertex[i] = g->vertex[i+1];
         }
     delete[] have_edge;
+    g->compute_statistics();
     return true;
 }
 
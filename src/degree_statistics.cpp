@@ -0,0 +1,172 @@
+#include "../include/degree_statistics.h"
+#include "../include/graph.h"
+
+#include <omp.h>
+#include <algorithm>
+#include <cstring>
+
+static inline uint64_t mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// |N(u) & N(v)|, the smaller neighborhood is searched in the larger one;
+// the buckets of the common neighbors are counted in buckets if given
+static long long common_neighbors(const Graph& g, v_index_t u, v_index_t v, double* buckets) {
+    const v_index_t *a = g.edge + g.vertex[u], *a_end = g.edge + g.vertex[u + 1];
+    const v_index_t *b = g.edge + g.vertex[v], *b_end = g.edge + g.vertex[v + 1];
+    if (a_end - a > b_end - b) {
+        std::swap(a, b);
+        std::swap(a_end, b_end);
+    }
+    long long cnt = 0;
+    for (; a < a_end && b < b_end; ++a) {
+        b = std::lower_bound(b, b_end, *a);
+        if (b < b_end && *b == *a) {
+            ++cnt;
+            if (buckets)
+                buckets[DegreeStatistics::get_bucket(g.vertex[*a + 1] - g.vertex[*a])] += 1;
+        }
+    }
+    return cnt;
+}
+
+void DegreeStatistics::compute(const Graph& g, long long sample_cnt, unsigned long long seed) {
+    memset(this, 0, sizeof(*this));
+    v_index_t v_cnt = g.v_cnt;
+    double degree_sum = 0, degree_square_sum = 0;
+    for (v_index_t v = 0; v < v_cnt; ++v) {
+        long long d = g.vertex[v + 1] - g.vertex[v];
+        int b = get_bucket(d);
+        vertex_cnt[b] += 1;
+        avg_degree[b] += d;
+        degree_sum += d;
+        degree_square_sum += (double)d * d;
+        for (e_index_t i = g.vertex[v]; i < g.vertex[v + 1]; ++i)
+            neighbor_rate[b][get_bucket(g.vertex[g.edge[i] + 1] - g.vertex[g.edge[i]])] += 1;
+    }
+    for (int b = 0; b < bucket_num; ++b) {
+        if (avg_degree[b] > 0)
+            for (int c = 0; c < bucket_num; ++c)
+                neighbor_rate[b][c] /= avg_degree[b];
+        if (vertex_cnt[b] > 0)
+            avg_degree[b] /= vertex_cnt[b];
+    }
+    random_common_rate = degree_sum > 0 ? (degree_square_sum - degree_sum) / degree_sum / degree_sum : 0;
+
+    // loaders and generators often number the vertices by degree, and the
+    // restrictions of a schedule compare ids: regress the id rank on the mid-rank
+    // of the degree bucket
+    double bucket_rank[bucket_num], below = 0;
+    for (int b = 0; b < bucket_num; ++b) {
+        bucket_rank[b] = v_cnt > 0 ? (below + vertex_cnt[b] / 2) / v_cnt : 0;
+        below += vertex_cnt[b];
+    }
+    double cov = 0, var = 0;
+    for (v_index_t v = 0; v < v_cnt; ++v) {
+        double r = bucket_rank[get_bucket(g.vertex[v + 1] - g.vertex[v])] - 0.5;
+        cov += r * ((v + 0.5) / v_cnt - 0.5);
+        var += r * r;
+    }
+    id_slope = var > 0 ? cov / var : 0;
+
+    // wedge_start[v]: wedges centered at vertices before v
+    long long *wedge_start = new long long[v_cnt + 1];
+    wedge_start[0] = 0;
+    for (v_index_t v = 0; v < v_cnt; ++v) {
+        long long d = g.vertex[v + 1] - g.vertex[v];
+        wedge_start[v + 1] = wedge_start[v] + d * (d - 1) / 2;
+    }
+    long long wedge_total = wedge_start[v_cnt];
+
+    double (*edge_sum)[bucket_num] = new double[bucket_num][bucket_num]();
+    double (*edge_num)[bucket_num] = new double[bucket_num][bucket_num]();
+    double (*wedge_sum)[bucket_num] = new double[bucket_num][bucket_num]();
+    double (*wedge_num)[bucket_num] = new double[bucket_num][bucket_num]();
+    double closed[bucket_num] = {}, wedges[bucket_num] = {};
+
+#pragma omp parallel
+    {
+        double (*local_edge_sum)[bucket_num] = new double[bucket_num][bucket_num]();
+        double (*local_edge_num)[bucket_num] = new double[bucket_num][bucket_num]();
+        double (*local_wedge_sum)[bucket_num] = new double[bucket_num][bucket_num]();
+        double (*local_wedge_num)[bucket_num] = new double[bucket_num][bucket_num]();
+        double local_closed[bucket_num] = {}, local_wedges[bucket_num] = {}, local_triangle[bucket_num] = {};
+
+        if (g.e_cnt > 0) {
+#pragma omp for schedule(dynamic, 256) nowait
+            for (long long i = 0; i < sample_cnt; ++i) {
+                e_index_t e = mix(seed ^ mix(i)) % g.e_cnt;
+                v_index_t u = std::upper_bound(g.vertex, g.vertex + v_cnt + 1, e) - g.vertex - 1;
+                v_index_t v = g.edge[e];
+                int bu = get_bucket(g.vertex[u + 1] - g.vertex[u]);
+                int bv = get_bucket(g.vertex[v + 1] - g.vertex[v]);
+                local_edge_sum[bu][bv] += common_neighbors(g, u, v, local_triangle);
+                local_edge_num[bu][bv] += 1;
+            }
+        }
+        if (wedge_total > 0) {
+#pragma omp for schedule(dynamic, 256) nowait
+            for (long long i = 0; i < sample_cnt; ++i) {
+                uint64_t rnd = mix(~seed ^ mix(i));
+                long long w = rnd % wedge_total;
+                v_index_t v = std::upper_bound(wedge_start, wedge_start + v_cnt + 1, w) - wedge_start - 1;
+                e_index_t d = g.vertex[v + 1] - g.vertex[v];
+                rnd = mix(rnd);
+                e_index_t a = rnd % d, b = (rnd >> 32) % (d - 1);
+                if (b >= a)
+                    ++b;
+                v_index_t x = g.edge[g.vertex[v] + a], y = g.edge[g.vertex[v] + b];
+                int bv = get_bucket(d);
+                int bx = get_bucket(g.vertex[x + 1] - g.vertex[x]);
+                int by = get_bucket(g.vertex[y + 1] - g.vertex[y]);
+                local_wedges[bv] += 1;
+                local_closed[bv] += g.get_edge_id(x, y) != -1;
+                long long cnt = common_neighbors(g, x, y, nullptr);
+                local_wedge_sum[bx][by] += cnt;
+                local_wedge_num[bx][by] += 1;
+                local_wedge_sum[by][bx] += cnt;
+                local_wedge_num[by][bx] += 1;
+            }
+        }
+
+#pragma omp critical
+        {
+            for (int b = 0; b < bucket_num; ++b) {
+                for (int c = 0; c < bucket_num; ++c) {
+                    edge_sum[b][c] += local_edge_sum[b][c];
+                    edge_num[b][c] += local_edge_num[b][c];
+                    wedge_sum[b][c] += local_wedge_sum[b][c];
+                    wedge_num[b][c] += local_wedge_num[b][c];
+                }
+                closed[b] += local_closed[b];
+                wedges[b] += local_wedges[b];
+                triangle_rate[b] += local_triangle[b];
+            }
+        }
+        delete[] local_edge_sum;
+        delete[] local_edge_num;
+        delete[] local_wedge_sum;
+        delete[] local_wedge_num;
+    }
+    delete[] wedge_start;
+
+    double triangle_total = 0;
+    for (int b = 0; b < bucket_num; ++b)
+        triangle_total += triangle_rate[b];
+    for (int b = 0; b < bucket_num; ++b) {
+        if (triangle_total > 0)
+            triangle_rate[b] /= triangle_total;
+        clustering[b] = wedges[b] > 0 ? closed[b] / wedges[b] : 0;
+        for (int c = 0; c < bucket_num; ++c) {
+            edge_common[b][c] = edge_num[b][c] >= min_samples ? edge_sum[b][c] / edge_num[b][c] : -1;
+            wedge_common[b][c] = wedge_num[b][c] >= min_samples ? wedge_sum[b][c] / wedge_num[b][c] : -1;
+        }
+    }
+    delete[] edge_sum;
+    delete[] edge_num;
+    delete[] wedge_sum;
+    delete[] wedge_num;
+}
@@ -0,0 +1,320 @@
+#include "../include/dynamic_graph.h"
+#include "../include/canonical_labeling.h"
+#include "../include/schedule_IEP.h"
+#include "../include/set_operation.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <omp.h>
+
+DynamicGraph::DynamicGraph(Graph *_graph, double _compact_ratio) : graph(_graph), compact_ratio(_compact_ratio), delta_size(0) {
+    delta.resize(graph->v_cnt);
+}
+
+DynamicGraph::~DynamicGraph() { delete graph; }
+
+bool DynamicGraph::in_base(v_index_t u, v_index_t v) const {
+    return std::binary_search(graph->edge + graph->vertex[u], graph->edge + graph->vertex[u + 1], v);
+}
+
+bool DynamicGraph::has_edge(v_index_t u, v_index_t v) const {
+    const std::vector<DeltaEntry> &list = delta[u];
+    auto it = std::lower_bound(list.begin(), list.end(), DeltaEntry{v, -1, false});
+    if (it != list.end() && it->v == v)
+        return it->insert;
+    return in_base(u, v);
+}
+
+void DynamicGraph::get_neighbors(v_index_t x, int time, v_index_t forced_u, v_index_t forced_v, std::vector<v_index_t> &neighbors) const {
+    neighbors.clear();
+    v_index_t forced = x == forced_u ? forced_v : (x == forced_v ? forced_u : -1);
+    const v_index_t *base = graph->edge + graph->vertex[x];
+    const v_index_t *base_end = graph->edge + graph->vertex[x + 1];
+    const std::vector<DeltaEntry> &list = delta[x];
+    size_t i = 0;
+    while (base != base_end || i < list.size()) {
+        v_index_t w;
+        bool present;
+        if (i == list.size() || (base != base_end && *base < list[i].v)) {
+            w = *base++;
+            present = true;
+        } else {
+            w = list[i].v;
+            present = base != base_end && *base == w;
+            if (present)
+                ++base;
+            // the entries of w are ordered by time, the applied one first
+            for (; i < list.size() && list[i].v == w; ++i)
+                if (list[i].time < time)
+                    present = list[i].insert;
+        }
+        if (forced != -1 && forced <= w) {
+            if (forced < w)
+                neighbors.push_back(forced);
+            else
+                present = true;
+            forced = -1;
+        }
+        if (present)
+            neighbors.push_back(w);
+    }
+    if (forced != -1)
+        neighbors.push_back(forced);
+}
+
+int DynamicGraph::add_pattern(const Pattern &pattern) {
+    int size = pattern.get_size();
+    const int *adj_mat = pattern.get_adj_mat_ptr();
+    assert(size >= 2 && pattern.check_connected());
+
+    MaintainedPattern p;
+    p.size = size;
+
+    CanonicalLabeling labeling(adj_mat, size);
+    std::vector<std::vector<int> > automorphisms = labeling.get_automorphisms();
+    p.automorphism_num = labeling.get_automorphism_num();
+
+    // one anchor per orbit of the ordered pattern edges, the smallest pair of the orbit
+    std::map<std::pair<int, int>, long long> orbit_size;
+    for (int a = 0; a < size; ++a)
+        for (int b = 0; b < size; ++b)
+            if (adj_mat[INDEX(a, b, size)]) {
+                std::pair<int, int> smallest(a, b);
+                for (const auto &aut : automorphisms)
+                    smallest = std::min(smallest, std::make_pair(aut[a], aut[b]));
+                ++orbit_size[smallest];
+            }
+    for (const auto &it : orbit_size) {
+        Anchor anchor;
+        anchor.multiplicity = it.second;
+        std::vector<bool> placed(size, false);
+        anchor.order.push_back(it.first.first);
+        anchor.order.push_back(it.first.second);
+        placed[it.first.first] = placed[it.first.second] = true;
+        // then the vertex with most placed neighbors, the smallest candidate sets come first
+        while ((int)anchor.order.size() < size) {
+            int best = -1, best_cnt = -1;
+            for (int x = 0; x < size; ++x) {
+                if (placed[x])
+                    continue;
+                int cnt = 0;
+                for (int y : anchor.order)
+                    cnt += adj_mat[INDEX(x, y, size)];
+                if (cnt > best_cnt) {
+                    best = x;
+                    best_cnt = cnt;
+                }
+            }
+            assert(best_cnt > 0);
+            anchor.order.push_back(best);
+            placed[best] = true;
+        }
+        anchor.neighbors.resize(size);
+        anchor.has_later_neighbor.assign(size, false);
+        for (int i = 0; i < size; ++i)
+            for (int j = 0; j < i; ++j)
+                if (adj_mat[INDEX(anchor.order[i], anchor.order[j], size)]) {
+                    anchor.neighbors[i].push_back(j);
+                    if (i >= 2)
+                        anchor.has_later_neighbor[j] = true;
+                }
+        p.anchors.push_back(anchor);
+    }
+
+    Graph *g = get_graph();
+    bool is_pattern_valid;
+    Schedule_IEP schedule(pattern, is_pattern_valid, 1, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt);
+    assert(is_pattern_valid);
+    p.count = g->pattern_matching(schedule);
+
+    patterns.push_back(p);
+    return patterns.size() - 1;
+}
+
+long long DynamicGraph::count_anchored(const MaintainedPattern &pattern, const Anchor &anchor, v_index_t u, v_index_t v, int time,
+                                       SearchBuffer &buffer) const {
+    int size = pattern.size;
+    if (size == 2)
+        return 1;
+    buffer.neighbors.resize(size);
+    buffer.candidates[0].resize(size);
+    buffer.candidates[1].resize(size);
+    buffer.embedding.resize(size);
+    buffer.embedding[0] = u;
+    buffer.embedding[1] = v;
+    for (int i = 0; i < 2; ++i)
+        if (anchor.has_later_neighbor[i])
+            get_neighbors(buffer.embedding[i], time, u, v, buffer.neighbors[i]);
+    return count_anchored_func(anchor, size, 2, time, u, v, buffer);
+}
+
+long long DynamicGraph::count_anchored_func(const Anchor &anchor, int size, int depth, int time, v_index_t forced_u, v_index_t forced_v,
+                                            SearchBuffer &buffer) const {
+    const std::vector<int> &neighbors = anchor.neighbors[depth];
+    const v_index_t *candidates = buffer.neighbors[neighbors[0]].data();
+    int candidate_num = buffer.neighbors[neighbors[0]].size();
+    for (int i = 1; i < (int)neighbors.size() && candidate_num > 0; ++i) {
+        const std::vector<v_index_t> &other = buffer.neighbors[neighbors[i]];
+        std::vector<v_index_t> &result = buffer.candidates[i & 1][depth];
+        // intersect_simd4x may store a few elements past the result
+        result.resize(std::min(candidate_num, (int)other.size()) + 16);
+        candidate_num = intersect_simd4x(candidates, candidate_num, other.data(), other.size(), result.data());
+        candidates = result.data();
+    }
+
+    long long ans = 0;
+    for (int c = 0; c < candidate_num; ++c) {
+        v_index_t w = candidates[c];
+        bool used = false;
+        for (int i = 0; i < depth && !used; ++i)
+            used = buffer.embedding[i] == w;
+        if (used)
+            continue;
+        if (depth == size - 1) {
+            ++ans;
+            continue;
+        }
+        buffer.embedding[depth] = w;
+        if (anchor.has_later_neighbor[depth])
+            get_neighbors(w, time, forced_u, forced_v, buffer.neighbors[depth]);
+        ans += count_anchored_func(anchor, size, depth + 1, time, forced_u, forced_v, buffer);
+    }
+    return ans;
+}
+
+int DynamicGraph::apply_batch(const std::vector<EdgeUpdate> &batch) {
+    // the updates that change the graph, in batch order
+    std::vector<EdgeUpdate> updates;
+    std::map<std::pair<v_index_t, v_index_t>, bool> state;
+    for (const EdgeUpdate &update : batch) {
+        assert(update.u >= 0 && update.u < graph->v_cnt && update.v >= 0 && update.v < graph->v_cnt);
+        if (update.u == update.v)
+            continue;
+        std::pair<v_index_t, v_index_t> key(std::min(update.u, update.v), std::max(update.u, update.v));
+        auto it = state.find(key);
+        bool present = it != state.end() ? it->second : has_edge(update.u, update.v);
+        if (present == update.insert)
+            continue;
+        state[key] = update.insert;
+        updates.push_back(update);
+    }
+    if (updates.empty())
+        return 0;
+
+    std::vector<v_index_t> touched;
+    for (int i = 0; i < (int)updates.size(); ++i) {
+        delta[updates[i].u].push_back(DeltaEntry{updates[i].v, i, updates[i].insert});
+        delta[updates[i].v].push_back(DeltaEntry{updates[i].u, i, updates[i].insert});
+        touched.push_back(updates[i].u);
+        touched.push_back(updates[i].v);
+    }
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+    for (v_index_t x : touched)
+        std::sort(delta[x].begin(), delta[x].end());
+
+    int pattern_num = patterns.size();
+    std::vector<long long> change(pattern_num, 0);
+#pragma omp parallel
+    {
+        SearchBuffer buffer;
+        std::vector<long long> local_change(pattern_num, 0);
+#pragma omp for schedule(dynamic) nowait
+        for (int i = 0; i < (int)updates.size(); ++i)
+            for (int p = 0; p < pattern_num; ++p) {
+                long long embedding_cnt = 0;
+                for (const Anchor &anchor : patterns[p].anchors)
+                    embedding_cnt += anchor.multiplicity * count_anchored(patterns[p], anchor, updates[i].u, updates[i].v, i, buffer);
+                local_change[p] += updates[i].insert ? embedding_cnt : -embedding_cnt;
+            }
+#pragma omp critical
+        for (int p = 0; p < pattern_num; ++p)
+            change[p] += local_change[p];
+    }
+    for (int p = 0; p < pattern_num; ++p)
+        patterns[p].count += change[p] / patterns[p].automorphism_num;
+
+    // fold the batch into one applied entry per neighbor that differs from the base
+    for (v_index_t x : touched) {
+        std::vector<DeltaEntry> &list = delta[x];
+        delta_size -= std::count_if(list.begin(), list.end(), [](const DeltaEntry &e) { return e.time == -1; });
+        std::vector<DeltaEntry> folded;
+        for (size_t i = 0; i < list.size();) {
+            size_t j = i;
+            while (j + 1 < list.size() && list[j + 1].v == list[i].v)
+                ++j;
+            if (list[j].insert != in_base(x, list[i].v))
+                folded.push_back(DeltaEntry{list[i].v, -1, list[j].insert});
+            i = j + 1;
+        }
+        delta_size += folded.size();
+        list.swap(folded);
+    }
+
+    if (delta_size > compact_ratio * graph->e_cnt)
+        compact();
+    return updates.size();
+}
+
+void DynamicGraph::compact() {
+    if (delta_size == 0)
+        return;
+    v_index_t v_cnt = graph->v_cnt;
+    e_index_t *vertex = new e_index_t[v_cnt + 1];
+    std::vector<std::vector<v_index_t> > neighbors(v_cnt);
+#pragma omp parallel for schedule(dynamic, 64)
+    for (v_index_t x = 0; x < v_cnt; ++x)
+        if (!delta[x].empty())
+            get_neighbors(x, 0, -1, -1, neighbors[x]);
+    vertex[0] = 0;
+    for (v_index_t x = 0; x < v_cnt; ++x)
+        vertex[x + 1] = vertex[x] + (delta[x].empty() ? graph->vertex[x + 1] - graph->vertex[x] : (e_index_t)neighbors[x].size());
+    v_index_t *edge = new v_index_t[vertex[v_cnt]];
+#pragma omp parallel for schedule(dynamic, 64)
+    for (v_index_t x = 0; x < v_cnt; ++x) {
+        if (delta[x].empty())
+            std::copy(graph->edge + graph->vertex[x], graph->edge + graph->vertex[x + 1], edge + vertex[x]);
+        else
+            std::copy(neighbors[x].begin(), neighbors[x].end(), edge + vertex[x]);
+    }
+
+    if (graph->mapped_data != nullptr) {
+        // the arrays of a graph loaded with use_mmap are in the mapping, the new ones are its own
+        munmap(graph->mapped_data, graph->mapped_len);
+        graph->mapped_data = nullptr;
+        graph->mapped_len = 0;
+    } else {
+        delete[] graph->vertex;
+        delete[] graph->edge;
+    }
+    if (graph->edge_from != nullptr) {
+        delete[] graph->edge_from;
+        graph->edge_from = nullptr;
+    }
+    graph->vertex = vertex;
+    graph->edge = edge;
+    graph->e_cnt = vertex[v_cnt];
+    for (auto &list : delta)
+        std::vector<DeltaEntry>().swap(list);
+    delta_size = 0;
+
+    // the intersection buffers of the pattern matching engine must hold the second largest degree
+    e_index_t max_degree = 0, second_degree = 0;
+    for (v_index_t x = 0; x < v_cnt; ++x) {
+        e_index_t degree = vertex[x + 1] - vertex[x];
+        if (degree > max_degree) {
+            second_degree = max_degree;
+            max_degree = degree;
+        } else if (degree > second_degree)
+            second_degree = degree;
+    }
+    graph->set_max_intersection_size(second_degree);
+    // the schedules of add_pattern, get_graph() and fast_dump use the statistics of the new CSR
+    graph->compute_statistics();
+}
+
+Graph *DynamicGraph::get_graph() {
+    compact();
+    return graph;
+}
@@ -0,0 +1,169 @@
+#include "../include/embedding.h"
+
+#include <cassert>
+#include <cstring>
+#include <thread>
+
+EmbeddingBatch::EmbeddingBatch(int _pattern_size, int _capacity) : size(0), capacity(_capacity), pattern_size(_pattern_size) {
+    assert(pattern_size > 0 && capacity > 0);
+    data = new v_index_t[(int64_t)capacity * pattern_size];
+}
+
+EmbeddingBatch::~EmbeddingBatch() {
+    if (data != nullptr)
+        delete[] data;
+}
+
+void EmbeddingBatch::swap(EmbeddingBatch &b) {
+    assert(pattern_size == b.pattern_size);
+    std::swap(data, b.data);
+    std::swap(size, b.size);
+    std::swap(capacity, b.capacity);
+}
+
+void EmbeddingQueue::Ring::init(int capacity) {
+    uint64_t n = 1;
+    while (n < (uint64_t)capacity)
+        n <<= 1;
+    cells = new Cell[n];
+    for (uint64_t i = 0; i < n; ++i)
+        cells[i].seq.store(i, std::memory_order_relaxed);
+    mask = n - 1;
+    head.store(0, std::memory_order_relaxed);
+    tail.store(0, std::memory_order_relaxed);
+}
+
+EmbeddingQueue::Ring::~Ring() {
+    if (cells != nullptr)
+        delete[] cells;
+}
+
+bool EmbeddingQueue::Ring::push(EmbeddingBatch *batch) {
+    uint64_t pos = tail.load(std::memory_order_relaxed);
+    for (;;) {
+        Cell &cell = cells[pos & mask];
+        uint64_t seq = cell.seq.load(std::memory_order_acquire);
+        int64_t dif = (int64_t)seq - (int64_t)pos;
+        if (dif == 0) {
+            if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                cell.batch = batch;
+                cell.seq.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (dif < 0)
+            return false; // full
+        else
+            pos = tail.load(std::memory_order_relaxed);
+    }
+}
+
+bool EmbeddingQueue::Ring::pop(EmbeddingBatch *&batch) {
+    uint64_t pos = head.load(std::memory_order_relaxed);
+    for (;;) {
+        Cell &cell = cells[pos & mask];
+        uint64_t seq = cell.seq.load(std::memory_order_acquire);
+        int64_t dif = (int64_t)seq - (int64_t)(pos + 1);
+        if (dif == 0) {
+            if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                batch = cell.batch;
+                cell.seq.store(pos + mask + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (dif < 0)
+            return false; // empty
+        else
+            pos = head.load(std::memory_order_relaxed);
+    }
+}
+
+EmbeddingQueue::EmbeddingQueue(int pattern_size, int batch_capacity, int queue_capacity) : batch_num(queue_capacity), closed(false) {
+    assert(queue_capacity > 0);
+    full_ring.init(batch_num);
+    free_ring.init(batch_num);
+    batches = new EmbeddingBatch *[batch_num];
+    for (int i = 0; i < batch_num; ++i) {
+        batches[i] = new EmbeddingBatch(pattern_size, batch_capacity);
+        free_ring.push(batches[i]);
+    }
+}
+
+EmbeddingQueue::~EmbeddingQueue() {
+    for (int i = 0; i < batch_num; ++i)
+        delete batches[i];
+    delete[] batches;
+}
+
+void EmbeddingQueue::consume(EmbeddingBatch &batch) {
+    EmbeddingBatch *empty;
+    // backpressure: wait until a consumer has released a batch
+    while (!free_ring.pop(empty))
+        std::this_thread::yield();
+    empty->swap(batch);
+    // every batch comes from the free list, so the full ring always has room
+    bool ok = full_ring.push(empty);
+    assert(ok);
+}
+
+EmbeddingBatch *EmbeddingQueue::pop() {
+    EmbeddingBatch *batch;
+    for (;;) {
+        if (full_ring.pop(batch))
+            return batch;
+        if (closed.load(std::memory_order_acquire)) {
+            // a producer may have pushed right before close()
+            if (full_ring.pop(batch))
+                return batch;
+            return nullptr;
+        }
+        std::this_thread::yield();
+    }
+}
+
+void EmbeddingQueue::release(EmbeddingBatch *batch) {
+    batch->clear();
+    bool ok = free_ring.push(batch);
+    assert(ok);
+}
+
+void EmbeddingQueue::close() { closed.store(true, std::memory_order_release); }
+
+EmbeddingFileSink::EmbeddingFileSink(const char *path, int _pattern_size, EmbeddingSink *_next)
+    : pattern_size(_pattern_size), embedding_cnt(0), next(_next) {
+    fp = fopen(path, "wb");
+    if (fp == nullptr) {
+        printf("Can not open embedding file %s\n", path);
+        return;
+    }
+    uint32_t header[4] = {magic, (uint32_t)pattern_size, 0, 0};
+    fwrite(header, sizeof(header), 1, fp);
+}
+
+EmbeddingFileSink::~EmbeddingFileSink() { close(); }
+
+void EmbeddingFileSink::consume(EmbeddingBatch &batch) {
+    assert(batch.get_pattern_size() == pattern_size);
+    if (fp != nullptr) {
+        std::lock_guard<std::mutex> guard(lock);
+        fwrite(batch.get_data_ptr(), sizeof(v_index_t), (size_t)batch.get_size() * pattern_size, fp);
+        embedding_cnt += batch.get_size();
+    }
+    if (next != nullptr)
+        next->consume(batch);
+}
+
+void EmbeddingFileSink::close() {
+    if (fp == nullptr)
+        return;
+    fseek(fp, 2 * sizeof(uint32_t), SEEK_SET);
+    fwrite(&embedding_cnt, sizeof(uint64_t), 1, fp);
+    fclose(fp);
+    fp = nullptr;
+}
+
+bool EmbeddingFileSink::read_header(FILE *fp, int &pattern_size, uint64_t &embedding_cnt) {
+    uint32_t header[2];
+    if (fread(header, sizeof(header), 1, fp) != 1 || header[0] != magic)
+        return false;
+    pattern_size = header[1];
+    return fread(&embedding_cnt, sizeof(uint64_t), 1, fp) == 1;
+}
@@ -4,6 +4,7 @@
 #include <vertex_set.h>
 #include <common.h>
 #include <schedule.h>
+#include <checkpoint.h>
 
 #include <cassert>
 #include <cstring>
@@ -23,6 +24,10 @@ int main(int argc,char *argv[]) {
     const std::string path = argv[1];
     const int max_edge = atoi(argv[2]);
     const int min_support = atoi(argv[3]);
+    // optional: checkpoint_file [restart]
+    Checkpoint* checkpoint = nullptr;
+    if (argc > 4)
+        checkpoint = new Checkpoint(argv[4], argc > 5 && strcmp(argv[5], "restart") == 0);
 
     DataType my_type;
     
@@ -41,10 +46,11 @@ int main(int argc,char *argv[]) {
     double total_time = 0; int times = 1;
     for(int i = 0; i < times; i++){
         double this_time = 0.0;
-        g->fsm(max_edge, min_support, &this_time);
+        g->fsm(max_edge, min_support, &this_time, checkpoint);
         total_time += this_time;
     }
     total_time /= times;
     printf("Counting time cost: %.6lf s\n", total_time);
+    delete checkpoint;
     return 0;
 }
@@ -1,12 +1,17 @@
 #include "../include/graph.h"
+#include "../include/cancel_token.h"
+#include "../include/checkpoint.h"
 #include "../include/common.h"
+#include "../include/embedding.h"
 #include "../include/graphmpi.h"
 #include "../include/motif_generator.h"
+#include "../include/set_operation.hpp"
 #include "../include/vertex_set.h"
 #include "timeinterval.h"
 #include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -24,6 +29,34 @@ void Graph::build_reverse_edges() {
             edge_from[v] = u;
 }
 
+int Graph::get_max_intersection_size() const {
+    int size = max_intersection_size.load(std::memory_order_relaxed);
+    if (size >= 0)
+        return size;
+    // |N(u) & N(v)| <= min(d(u), d(v)) is at most the second largest degree
+    e_index_t first = 0, second = 0;
+    for (v_index_t v = 0; v < v_cnt; ++v) {
+        e_index_t d = vertex[v + 1] - vertex[v];
+        if (d > first) {
+            second = first;
+            first = d;
+        }
+        else if (d > second)
+            second = d;
+    }
+    size = second;
+    max_intersection_size.store(size, std::memory_order_relaxed);
+    return size;
+}
+
+VertexSet *Graph::new_vertex_sets(int n) const {
+    int capacity = get_max_intersection_size();
+    VertexSet *vertex_sets = new VertexSet[n];
+    for (int i = 0; i < n; ++i)
+        vertex_sets[i].set_capacity(capacity);
+    return vertex_sets;
+}
+
 int Graph::intersection_size(v_index_t v1, v_index_t v2) {
     e_index_t l1, r1;
     get_edge_index(v1, l1, r1);
@@ -46,8 +79,7 @@ int Graph::intersection_size(v_index_t v1, v_index_t v2) {
     return ans;
 }
 
-int Graph::intersection_size_mpi(v_index_t v1, v_index_t v2) {
-    Graphmpi &gm = Graphmpi::getinstance();
+int Graph::intersection_size_mpi(Graphmpi &gm, v_index_t v1, v_index_t v2) {
     int ans = 0;
     if (gm.include(v2))
         return intersection_size(v1, v2);
@@ -112,63 +144,179 @@ long long Graph::triangle_counting() {
     return ans;
 }
 
-long long Graph::triangle_counting_mt() {
+// out(u) is marked in a bitmap instead of merged if it has this many vertices
+static const int triangle_hub_degree = 256;
+
+long long Graph::tc_out_edges(const e_index_t *out_vertex, v_index_t *out_edge,
+                              e_index_t begin, e_index_t end,
+                              Bitmap &hub_bitmap) const {
     long long ans = 0;
-#pragma omp parallel
-    { tc_mt(&ans); }
+    v_index_t u =
+        std::upper_bound(out_vertex, out_vertex + v_cnt + 1, begin) -
+        out_vertex - 1;
+    for (e_index_t i = begin; i < end; ++u) {
+        e_index_t stop = std::min(end, out_vertex[u + 1]);
+        int out_deg_u = out_vertex[u + 1] - out_vertex[u];
+        if (out_deg_u >= triangle_hub_degree) {
+            for (e_index_t j = out_vertex[u]; j < out_vertex[u + 1]; ++j)
+                hub_bitmap.set(out_edge[j], 1);
+            for (; i < stop; ++i) {
+                v_index_t v = out_edge[i];
+                for (e_index_t j = out_vertex[v]; j < out_vertex[v + 1]; ++j)
+                    ans += hub_bitmap.read(out_edge[j]);
+            }
+            for (e_index_t j = out_vertex[u]; j < out_vertex[u + 1]; ++j)
+                hub_bitmap.set(out_edge[j], 0);
+        } else {
+            for (; i < stop; ++i) {
+                v_index_t v = out_edge[i];
+                ans += intersect_simd4x_count(
+                    &out_edge[out_vertex[u]], out_deg_u,
+                    &out_edge[out_vertex[v]], out_vertex[v + 1] - out_vertex[v]);
+            }
+        }
+    }
     return ans;
 }
 
-void Graph::tc_mt(long long *global_ans) {
-    long long my_ans = 0;
+long long Graph::triangle_counting_mt() {
+    e_index_t *out_vertex;
+    v_index_t *out_edge;
+    build_oriented_csr(out_vertex, out_edge);
+    e_index_t out_cnt = out_vertex[v_cnt];
+
+    // the cost of u -> v is the length of the merge, or of the scan of out(v) for a hub
+    long long *cost = new long long[out_cnt + 1];
+    cost[0] = 0;
+    for (v_index_t u = 0; u < v_cnt; ++u) {
+        int out_deg_u = out_vertex[u + 1] - out_vertex[u];
+        for (e_index_t i = out_vertex[u]; i < out_vertex[u + 1]; ++i) {
+            v_index_t v = out_edge[i];
+            long long c = out_vertex[v + 1] - out_vertex[v] + 1;
+            if (out_deg_u < triangle_hub_degree)
+                c += out_deg_u;
+            cost[i + 1] = cost[i] + c;
+        }
+    }
+    int task_cnt = omp_get_max_threads() * 64;
+    std::vector<e_index_t> task_start(task_cnt + 1);
+    for (int t = 0; t <= task_cnt; ++t)
+        task_start[t] =
+            std::lower_bound(cost, cost + out_cnt + 1,
+                             (long long)((double)cost[out_cnt] * t / task_cnt)) -
+            cost;
+    task_start[task_cnt] = out_cnt;
+    delete[] cost;
+
+    long long ans = 0;
+#pragma omp parallel reduction(+ : ans)
+    {
+        Bitmap hub_bitmap(v_cnt);
 #pragma omp for schedule(dynamic)
-    for (int v = 0; v < v_cnt; ++v) {
-        // for v in G
-        e_index_t l, r;
-        get_edge_index(v, l, r);
-        for (e_index_t v1 = l; v1 < r; ++v1) {
-            if (v <= edge[v1])
-                break;
-            // for v1 in N(v)
-            my_ans += intersection_size_clique(v, edge[v1]);
+        for (int t = 0; t < task_cnt; ++t)
+            ans += tc_out_edges(out_vertex, out_edge, task_start[t],
+                                task_start[t + 1], hub_bitmap);
+    }
+    delete[] out_vertex;
+    delete[] out_edge;
+    return ans;
+}
+
+// cliques of rest more vertices among the candidates cand[0, cand_size), every
+// candidate is an out-neighbor of the vertices chosen so far; the candidates
+// of the next level are written to cand + stride
+static long long clique_extend(const e_index_t *out_vertex, v_index_t *out_edge,
+                               int *cand, int cand_size, int stride, int rest) {
+    if (rest == 1)
+        return cand_size;
+    long long ans = 0;
+    for (int i = 0; i < cand_size; ++i) {
+        v_index_t w = cand[i];
+        int out_deg_w = out_vertex[w + 1] - out_vertex[w];
+        if (rest == 2)
+            ans += intersect_simd4x_count(cand, cand_size,
+                                          &out_edge[out_vertex[w]], out_deg_w);
+        else {
+            int next_size = intersect_simd4x(cand, cand_size,
+                                             &out_edge[out_vertex[w]],
+                                             out_deg_w, cand + stride);
+            if (next_size >= rest - 1)
+                ans += clique_extend(out_vertex, out_edge, cand + stride,
+                                     next_size, stride, rest - 1);
         }
     }
-#pragma omp critical
-    { *global_ans += my_ans; }
+    return ans;
 }
 
-long long Graph::triangle_counting_mpi() {
-    /*int mynodel, mynoder;
-    long long tot_ans;
-    Graphmpi &gm = Graphmpi::getinstance();
-#pragma omp parallel
+long long Graph::clique_counting(int k) {
+    if (k <= 2)
+        return k == 2 ? e_cnt / 2 : k == 1 ? v_cnt : 0;
+    if (k == 3)
+        return triangle_counting_mt();
+
+    e_index_t *out_vertex;
+    v_index_t *out_edge;
+    build_oriented_csr(out_vertex, out_edge);
+    int max_out_degree = 0;
+    for (v_index_t u = 0; u < v_cnt; ++u)
+        max_out_degree = std::max(max_out_degree,
+                                  (int)(out_vertex[u + 1] - out_vertex[u]));
+    // intersect_simd4x may store a few elements past the result
+    int stride = max_out_degree + 16;
+
+    long long ans = 0;
+#pragma omp parallel reduction(+ : ans)
+    {
+        int *cand = new int[(long long)stride * (k - 2)];
+#pragma omp for schedule(dynamic)
+        for (v_index_t u = 0; u < v_cnt; ++u)
+            for (e_index_t i = out_vertex[u]; i < out_vertex[u + 1]; ++i) {
+                v_index_t v = out_edge[i];
+                int cand_size = intersect_simd4x(
+                    &out_edge[out_vertex[u]], out_vertex[u + 1] - out_vertex[u],
+                    &out_edge[out_vertex[v]], out_vertex[v + 1] - out_vertex[v],
+                    cand);
+                if (cand_size >= k - 2)
+                    ans += clique_extend(out_vertex, out_edge, cand, cand_size,
+                                         stride, k - 2);
+            }
+        delete[] cand;
+    }
+    delete[] out_vertex;
+    delete[] out_edge;
+    return ans;
+}
+
+long long Graph::triangle_counting_mpi(int thread_count) {
+    // every process orients its own copy of the graph
+    e_index_t *out_vertex;
+    v_index_t *out_edge;
+    build_oriented_csr(out_vertex, out_edge);
+
+    // the vertex range is set before the workers start
+    Graphmpi gm(thread_count, this);
+    long long global_ans = 0;
+#pragma omp parallel num_threads(thread_count)
     {
 #pragma omp master
-        {
-            auto k = gm.init(thread_count, this);
-            mynodel = k.first;
-            mynoder = k.second;
-        }
-#pragma omp barrier //mynodel have to be calculated before running other threads
-#pragma omp master
-        {
-            tot_ans = gm.runmajor();
-        }
-        long long thread_ans = 0;
-#pragma omp for schedule(dynamic) nowait
-        for(int v = mynodel; v < mynoder; v++) {
-            // for v in G
-            int l, r;
-            get_edge_index(v, l, r);
-            for(int v1 = l; v1 < r; ++v1) {
-                //for v1 in N(v)
-                thread_ans += intersection_size_mpi(v, edge[v1]);
+        { global_ans = gm.runmajor(); }
+        if (omp_get_thread_num()) {
+            Bitmap hub_bitmap(v_cnt);
+            long long local_ans = 0;
+            for (std::pair<int, int> range;;) {
+                if ((range = gm.get_vertex_range()).first == -1)
+                    break;
+                local_ans += tc_out_edges(
+                    out_vertex, out_edge, out_vertex[range.first],
+                    out_vertex[std::min(range.second, v_cnt)], hub_bitmap);
             }
+            gm.report(local_ans);
+            gm.end();
         }
-        //gm.idle(thread_ans);
     }
-    return tot_ans / 6ll;*/
-    return -1;
+    delete[] out_vertex;
+    delete[] out_edge;
+    return global_ans;
 }
 
 void Graph::get_edge_index(v_index_t v, e_index_t &l, e_index_t &r) const {
@@ -194,7 +342,8 @@ bool binary_search(const T data[], int n, const T &target) {
 
 void Graph::remove_anti_edge_vertices(VertexSet &out_buf,
                                       const VertexSet &in_buf,
-                                      const Schedule_IEP &sched,
+                                      const int *pattern_adj_mat,
+                                      int pattern_size,
                                       const VertexSet &partial_embedding,
                                       int vp) {
 
@@ -211,7 +360,7 @@ void Graph::remove_anti_edge_vertices(VertexSet &out_buf,
     for (int i = 0; i < n_in; i++) {
         bool produce_output = true;
         for (int u = 0; u < vp; ++u) {
-            if (sched.get_adj_mat_ptr()[u * sched.get_size() + vp] != 0)
+            if (pattern_adj_mat[u * pattern_size + vp] != 0)
                 continue;
 
             auto v = partial_embedding.get_data(u);
@@ -254,7 +403,8 @@ void Graph::pattern_matching_func(const Schedule_IEP &schedule,
             vertex_set[schedule.get_total_prefix_num() + depth];
         diff_buf.init();
         remove_anti_edge_vertices(diff_buf, vertex_set[loop_set_prefix_id],
-                                  schedule, subtraction_set, depth);
+                                  schedule.get_adj_mat_ptr(),
+                                  schedule.get_size(), subtraction_set, depth);
         loop_data_ptr = diff_buf.get_data_ptr();
         loop_size = diff_buf.get_size();
         vset = diff_buf;
@@ -302,56 +452,140 @@ void Graph::pattern_matching_func(const Schedule_IEP &schedule,
     }
 }
 
-long long Graph::pattern_matching(const Schedule_IEP &schedule, bool clique) {
-    //    intersection_times_low = intersection_times_high = 0;
-    //    dep1_cnt = dep2_cnt = dep3_cnt = 0;
+long long Graph::pattern_matching(const Schedule_IEP &schedule, bool clique,
+                                  Checkpoint *checkpoint) {
+    SchedulePlan *plan = SchedulePlan::create(schedule);
+    long long ans = pattern_matching(*plan, checkpoint);
+    SchedulePlan::destroy(plan);
+    return ans;
+}
+
+long long Graph::pattern_matching(const SchedulePlan &plan,
+                                  Checkpoint *checkpoint) {
+    PartialCount result = pattern_matching_partial(plan, nullptr, checkpoint);
+    if (!result.finished)
+        printf("pattern_matching stopped after %.0lf s with %.2lf%% of the start "
+               "vertices, estimated count %.0lf\n",
+               max_running_time, result.completed_fraction * 100,
+               result.estimate);
+    return result.ans;
+}
+
+PartialCount Graph::pattern_matching_partial(const Schedule_IEP &schedule,
+                                             const CancelToken *token,
+                                             Checkpoint *checkpoint) {
+    SchedulePlan *plan = SchedulePlan::create(schedule);
+    PartialCount result = pattern_matching_partial(*plan, token, checkpoint);
+    SchedulePlan::destroy(plan);
+    return result;
+}
+
+static long long gcd(long long a, long long b) {
+    while (b != 0) {
+        long long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+PartialCount Graph::pattern_matching_partial(const SchedulePlan &plan,
+                                             const CancelToken *token,
+                                             Checkpoint *checkpoint) {
+    CancelToken deadline(max_running_time);
+    if (token == nullptr)
+        token = &deadline;
+
+    // Chunks are visited in the order c -> (c * stride + offset) % chunk_cnt
+    // with stride coprime to chunk_cnt, which spreads the (usually degree
+    // sorted) vertex ids over the whole run.
+    // The chunks are part of the checkpoint key, so they only depend on the
+    // graph: a run may be resumed with another number of threads. 16384
+    // chunks leave enough of them to balance any thread count.
+    int chunk_len = std::max(1, std::min(chunk_size, v_cnt / 16384));
+    long long chunk_cnt = (v_cnt + chunk_len - 1) / chunk_len;
+    long long stride = (long long)(chunk_cnt * 0.6180339887) | 1;
+    while (gcd(stride, std::max(chunk_cnt, 1LL)) != 1)
+        stride += 2;
+    long long offset = chunk_cnt / 2;
+
     long long global_ans = 0;
-    // printf("pattern_matching extra memory: %.3lf MB\n", thread_count * (schedule.get_total_prefix_num() + 10) * sizeof(int) * (VertexSet::max_intersection_size * 2) / 1024.0 / 1024.0);
-    // fflush(stdout);
-#pragma omp parallel reduction(+ : global_ans)
+    long long done_vertex_cnt = 0;
+    if (checkpoint != nullptr) {
+        // the raw count depends on the graph, the schedule and the chunks
+        std::string key = "pattern_matching " + std::to_string(v_cnt) + " " +
+                          std::to_string(e_cnt) + " " +
+                          std::to_string(chunk_len) + " ";
+        int size = plan.get_size();
+        for (int i = 0; i < size * size; ++i)
+            key += plan.get_adj_mat_ptr()[i] ? '1' : '0';
+        for (int i = 0; i < plan.get_restrict_pair_num(); ++i)
+            key += " " + std::to_string(plan.get_restrict_pair_first(i)) + "<" +
+                   std::to_string(plan.get_restrict_pair_second(i));
+        key += " " + std::to_string(plan.get_in_exclusion_optimize_num());
+        checkpoint->restore(key);
+        global_ans = checkpoint->begin_stage(0, 0, chunk_cnt);
+        for (long long c = 0; c < chunk_cnt; ++c)
+            if (checkpoint->is_finished(c))
+                done_vertex_cnt +=
+                    std::min((long long)v_cnt, (c + 1) * chunk_len) -
+                    c * chunk_len;
+    }
+#pragma omp parallel reduction(+ : global_ans, done_vertex_cnt)
     {
-        //   double start_time = get_wall_time();
-        //   double current_time;
-        int *ans_buffer =
-            new int[schedule.in_exclusion_optimize_vertex_id.size()];
+        int *ans_buffer = new int[plan.iep_vertex_num];
         VertexSet *vertex_set =
-            new VertexSet[schedule.get_total_prefix_num() + 10];
-        VertexSet subtraction_set;
-        VertexSet tmp_set;
+            new_vertex_sets(plan.get_total_prefix_num() + 10);
+        VertexSet subtraction_set(get_max_intersection_size());
+        VertexSet tmp_set(get_max_intersection_size());
         subtraction_set.init();
-        long long local_ans = 0;
-        // TODO : try different chunksize
 #pragma omp for schedule(dynamic) nowait
-        for (int vertex = 0; vertex < v_cnt; ++vertex) {
-            e_index_t l, r;
-            get_edge_index(vertex, l, r);
-            for (int prefix_id = schedule.get_last(0); prefix_id != -1;
-                 prefix_id = schedule.get_next(prefix_id)) {
-                vertex_set[prefix_id].build_vertex_set(
-                    schedule, vertex_set, &edge[l], (int)(r - l), prefix_id);
-            }
-            // subtraction_set.insert_ans_sort(vertex);
-            subtraction_set.push_back(vertex);
-            // if (schedule.get_total_restrict_num() > 0 && clique == false)
-            if (true) {
-                pattern_matching_aggressive_func(schedule, vertex_set,
+        for (long long c = 0; c < chunk_cnt; ++c) {
+            if (token->is_cancelled())
+                continue;
+            long long chunk_id = (c * stride + offset) % chunk_cnt;
+            if (checkpoint != nullptr && checkpoint->is_finished(chunk_id))
+                continue;
+            int begin = chunk_id * chunk_len;
+            int end = std::min((long long)v_cnt, begin + (long long)chunk_len);
+            long long chunk_ans = 0;
+            for (int vertex = begin; vertex < end; ++vertex) {
+                e_index_t l, r;
+                get_edge_index(vertex, l, r);
+                for (int prefix_id = plan.get_last(0); prefix_id != -1;
+                     prefix_id = plan.get_next(prefix_id)) {
+                    vertex_set[prefix_id].build_vertex_set(
+                        plan, vertex_set, &edge[l], (int)(r - l), prefix_id);
+                }
+                subtraction_set.push_back(vertex);
+                pattern_matching_aggressive_func(plan, vertex_set,
                                                  subtraction_set, tmp_set,
-                                                 local_ans, 1, ans_buffer);
-            } else
-                pattern_matching_func(schedule, vertex_set, subtraction_set,
-                                      local_ans, 1, clique);
-            subtraction_set.pop_back();
-            // printf("for %d %d\n", omp_get_thread_num(), vertex);
+                                                 chunk_ans, 1, ans_buffer,
+                                                 token);
+                subtraction_set.pop_back();
+            }
+            // a chunk interrupted in the middle is dropped as a whole
+            if (token->is_cancelled())
+                continue;
+            global_ans += chunk_ans;
+            done_vertex_cnt += end - begin;
+            if (checkpoint != nullptr)
+                checkpoint->finish(chunk_id, chunk_ans);
         }
-        // double end_time = get_wall_time();
-        // printf("my thread time %d %.6lf\n", omp_get_thread_num(), end_time -
-        // start_time);
         delete[] vertex_set;
-        // TODO : Computing multiplicty for a pattern
-        global_ans += local_ans;
-        // printf("local_ans %d %lld\n", omp_get_thread_num(), local_ans);
+        delete[] ans_buffer;
     }
-    return global_ans / schedule.get_in_exclusion_optimize_redundancy();
+    if (checkpoint != nullptr)
+        checkpoint->save();
+
+    PartialCount result;
+    result.ans = global_ans / plan.get_in_exclusion_optimize_redundancy();
+    result.finished = done_vertex_cnt == v_cnt;
+    result.completed_fraction = v_cnt > 0 ? (double)done_vertex_cnt / v_cnt : 1;
+    result.estimate = result.completed_fraction > 0
+                          ? result.ans / result.completed_fraction
+                          : 0;
+    return result;
 }
 
 void Graph::clique_matching_func(const Schedule_IEP &schedule,
@@ -389,50 +623,81 @@ void Graph::clique_matching_func(const Schedule_IEP &schedule,
     }
 }
 
-long long Graph::pattern_matching_edge_task(const Schedule_IEP &schedule,
+long long Graph::pattern_matching_edge_task(const SchedulePlan &plan,
                                             int edge_id, VertexSet *vertex_sets,
                                             VertexSet &partial_embedding,
                                             VertexSet &tmp_set,
                                             int *ans_buffer) {
-    int v0, v1, l, r;
-    v0 = edge_from[edge_id];
-    v1 = edge[edge_id];
-    if (schedule.get_restrict_last(1) != -1 && v0 <= v1)
+    return pattern_matching_edge_task(plan, edge_from[edge_id],
+                                      edge[edge_id], vertex_sets,
+                                      partial_embedding, tmp_set, ans_buffer);
+}
+
+long long Graph::pattern_matching_edge_task(const SchedulePlan &plan,
+                                            v_index_t v0, v_index_t v1,
+                                            VertexSet *vertex_sets,
+                                            VertexSet &partial_embedding,
+                                            VertexSet &tmp_set,
+                                            int *ans_buffer) {
+    e_index_t l, r;
+    if (plan.get_restrict_last(1) != -1 && v0 <= v1)
         return 0;
 
     l = vertex[v0], r = vertex[v0 + 1];
-    for (int prefix_id = schedule.get_last(0); prefix_id != -1;
-         prefix_id = schedule.get_next(prefix_id))
-        vertex_sets[prefix_id].build_vertex_set(schedule, vertex_sets, &edge[l],
+    for (int prefix_id = plan.get_last(0); prefix_id != -1;
+         prefix_id = plan.get_next(prefix_id))
+        vertex_sets[prefix_id].build_vertex_set(plan, vertex_sets, &edge[l],
                                                 r - l, prefix_id);
 
     l = vertex[v1], r = vertex[v1 + 1];
-    for (int prefix_id = schedule.get_last(1); prefix_id != -1;
-         prefix_id = schedule.get_next(prefix_id)) {
-        vertex_sets[prefix_id].build_vertex_set(schedule, vertex_sets, &edge[l],
+    for (int prefix_id = plan.get_last(1); prefix_id != -1;
+         prefix_id = plan.get_next(prefix_id)) {
+        vertex_sets[prefix_id].build_vertex_set(plan, vertex_sets, &edge[l],
                                                 r - l, prefix_id);
         if (vertex_sets[prefix_id].get_size() == 0 &&
-            prefix_id < schedule.get_basic_prefix_num())
+            prefix_id < plan.get_basic_prefix_num())
             return 0;
     }
 
     partial_embedding.push_back(v0);
     partial_embedding.push_back(v1);
     long long ans = 0;
-    pattern_matching_aggressive_func(schedule, vertex_sets, partial_embedding,
+    pattern_matching_aggressive_func(plan, vertex_sets, partial_embedding,
                                      tmp_set, ans, 2, ans_buffer);
     partial_embedding.pop_back();
     partial_embedding.pop_back();
     return ans;
 }
 
-void Graph::pattern_matching_aggressive_func(const Schedule_IEP &schedule,
+long long Graph::pattern_matching_vertex_task(const SchedulePlan &plan,
+                                              v_index_t v0,
+                                              VertexSet *vertex_sets,
+                                              VertexSet &partial_embedding,
+                                              VertexSet &tmp_set,
+                                              int *ans_buffer) {
+    e_index_t l, r;
+    get_edge_index(v0, l, r);
+    for (int prefix_id = plan.get_last(0); prefix_id != -1;
+         prefix_id = plan.get_next(prefix_id))
+        vertex_sets[prefix_id].build_vertex_set(plan, vertex_sets, &edge[l],
+                                                (int)(r - l), prefix_id);
+
+    partial_embedding.push_back(v0);
+    long long ans = 0;
+    pattern_matching_aggressive_func(plan, vertex_sets, partial_embedding,
+                                     tmp_set, ans, 1, ans_buffer);
+    partial_embedding.pop_back();
+    return ans;
+}
+
+void Graph::pattern_matching_aggressive_func(const SchedulePlan &plan,
                                              VertexSet *vertex_set,
                                              VertexSet &subtraction_set,
                                              VertexSet &tmp_set,
                                              long long &local_ans, int depth,
-                                             int *ans_buffer) {
-    int loop_set_prefix_id = schedule.get_loop_set_prefix_id(depth);
+                                             int *ans_buffer,
+                                             const CancelToken *token) {
+    int loop_set_prefix_id = plan.get_loop_set_prefix_id(depth);
     auto vset = &vertex_set[loop_set_prefix_id];
 
     int loop_size = (*vset).get_size();
@@ -441,69 +706,69 @@ void Graph::pattern_matching_aggressive_func(const Schedule_IEP &schedule,
 
     int *loop_data_ptr = (*vset).get_data_ptr();
 
-    if (schedule.is_vertex_induced) {
+    if (plan.is_vertex_induced) {
         VertexSet &diff_buf =
-            vertex_set[schedule.get_total_prefix_num() + depth];
+            vertex_set[plan.get_total_prefix_num() + depth];
         // printf("depth:%d loop_set_prefix_id = %d diff_buf: %d\n",depth,
-        // loop_set_prefix_id, schedule.get_total_prefix_num() + depth);
+        // loop_set_prefix_id, plan.get_total_prefix_num() + depth);
         remove_anti_edge_vertices(diff_buf, vertex_set[loop_set_prefix_id],
-                                  schedule, subtraction_set, depth);
+                                  plan.get_adj_mat_ptr(),
+                                  plan.get_size(), subtraction_set, depth);
         loop_data_ptr = diff_buf.get_data_ptr();
         loop_size = diff_buf.get_size();
         vset = &diff_buf;
     }
     // Case: in_exclusion_optimize_num > 1
     if (depth ==
-        schedule.get_size() - schedule.get_in_exclusion_optimize_num()) {
+        plan.get_size() - plan.get_in_exclusion_optimize_num()) {
 
         int last_pos = -1;
         long long val;
 
-        for (int i = 0; i < schedule.in_exclusion_optimize_vertex_id.size();
-             ++i) {
-            if (schedule.in_exclusion_optimize_vertex_flag[i]) {
+        const int *vertex_id = plan.get_array(SchedulePlan::IepVertexId);
+        const int *vertex_flag = plan.get_array(SchedulePlan::IepVertexFlag);
+        const int *vertex_coef = plan.get_array(SchedulePlan::IepVertexCoef);
+        for (int i = 0; i < plan.iep_vertex_num; ++i) {
+            if (vertex_flag[i]) {
                 ans_buffer[i] =
-                    vertex_set[schedule.in_exclusion_optimize_vertex_id[i]]
-                        .get_size() -
-                    schedule.in_exclusion_optimize_vertex_coef[i];
+                    vertex_set[vertex_id[i]].get_size() - vertex_coef[i];
             } else {
                 ans_buffer[i] = VertexSet::unordered_subtraction_size(
-                    vertex_set[schedule.in_exclusion_optimize_vertex_id[i]],
-                    subtraction_set);
+                    vertex_set[vertex_id[i]], subtraction_set);
             }
         }
 
-        for (int pos = 0; pos < schedule.in_exclusion_optimize_coef.size();
-             ++pos) {
+        const int *coef = plan.get_array(SchedulePlan::IepCoef);
+        const int *flag = plan.get_array(SchedulePlan::IepFlag);
+        const int *ans_pos = plan.get_array(SchedulePlan::IepAnsPos);
+        for (int pos = 0; pos < plan.iep_term_num; ++pos) {
             if (pos == last_pos + 1)
-                val = ans_buffer[schedule.in_exclusion_optimize_ans_pos[pos]];
+                val = ans_buffer[ans_pos[pos]];
             else {
                 if (val != 0)
-                    val =
-                        val *
-                        ans_buffer[schedule.in_exclusion_optimize_ans_pos[pos]];
+                    val = val * ans_buffer[ans_pos[pos]];
             }
-            if (schedule.in_exclusion_optimize_flag[pos]) {
+            if (flag[pos]) {
                 last_pos = pos;
-                local_ans += val * schedule.in_exclusion_optimize_coef[pos];
+                local_ans += val * coef[pos];
             }
         }
 
         return;
     }
     // Case: in_exclusion_optimize_num <= 1
-    if (depth == schedule.get_size() - 1) {
+    if (depth == plan.get_size() - 1) {
         // TODO : try more kinds of calculation.
         // For example, we can maintain an ordered set, but it will cost more to
         // maintain itself when entering or exiting recursion.
-        if (schedule.get_total_restrict_num() > 0) {
+        if (plan.get_total_restrict_num() > 0) {
             int min_vertex = v_cnt;
-            for (int i = schedule.get_restrict_last(depth); i != -1;
-                 i = schedule.get_restrict_next(i))
+            for (int i = plan.get_restrict_last(depth); i != -1;
+                 i = plan.get_restrict_next(i))
                 if (min_vertex >
-                    subtraction_set.get_data(schedule.get_restrict_index(i)))
+                    subtraction_set.get_data(plan.get_restrict_index(i)))
                     min_vertex = subtraction_set.get_data(
-                        schedule.get_restrict_index(i));
+                        plan.get_restrict_index(i));
             int size_after_restrict =
                 std::lower_bound((*vset).get_data_ptr(),
                                  (*vset).get_data_ptr() + (*vset).get_size(),
@@ -526,30 +791,32 @@ void Graph::pattern_matching_aggressive_func(const Schedule_IEP &schedule,
         }*/
     // TODO : min_vertex is also a loop invariant
     int min_vertex = v_cnt;
-    for (int i = schedule.get_restrict_last(depth); i != -1;
-         i = schedule.get_restrict_next(i))
+    for (int i = plan.get_restrict_last(depth); i != -1;
+         i = plan.get_restrict_next(i))
         if (min_vertex >
-            subtraction_set.get_data(schedule.get_restrict_index(i)))
+            subtraction_set.get_data(plan.get_restrict_index(i)))
             min_vertex =
-                subtraction_set.get_data(schedule.get_restrict_index(i));
+                subtraction_set.get_data(plan.get_restrict_index(i));
     for (int i = 0; i < loop_size; ++i) {
         if (min_vertex <= loop_data_ptr[i])
             break;
+        if (depth == 1 && (i & 63) == 0 && token != nullptr &&
+            token->is_cancelled())
+            return;
         int vertex = loop_data_ptr[i];
         if (subtraction_set.has_data(vertex))
             continue;
         e_index_t l, r;
         get_edge_index(vertex, l, r);
         bool is_zero = false;
-        for (int prefix_id = schedule.get_last(depth); prefix_id != -1;
-             prefix_id = schedule.get_next(prefix_id)) {
-            vertex_set[prefix_id].build_vertex_set(schedule, vertex_set,
-                                                   &edge[l], (int)(r - l),
-                                                   prefix_id, vertex);
+        for (int prefix_id = plan.get_last(depth); prefix_id != -1;
+             prefix_id = plan.get_next(prefix_id)) {
+            vertex_set[prefix_id].build_vertex_set(
+                plan, vertex_set, &edge[l], (int)(r - l), prefix_id);
             // if( vertex_set[prefix_id].get_size() == 0 && prefix_id <
-            // schedule.get_basic_prefix_num()) {
+            // plan.get_basic_prefix_num()) {
             if (vertex_set[prefix_id].get_size() ==
-                schedule.break_size[prefix_id]) {
+                plan.get_break_size(prefix_id)) {
                 is_zero = true;
                 break;
             }
@@ -558,7 +825,7 @@ void Graph::pattern_matching_aggressive_func(const Schedule_IEP &schedule,
             continue;
         // subtraction_set.insert_ans_sort(vertex);
         subtraction_set.push_back(vertex);
-        pattern_matching_aggressive_func(schedule, vertex_set, subtraction_set,
+        pattern_matching_aggressive_func(plan, vertex_set, subtraction_set,
                                          tmp_set, local_ans, depth + 1,
                                          ans_buffer);
         subtraction_set.pop_back();
@@ -567,34 +834,31 @@ void Graph::pattern_matching_aggressive_func(const Schedule_IEP &schedule,
 
 long long Graph::pattern_matching_mpi(const Schedule_IEP &schedule,
                                       int thread_count, bool clique) {
-    Graphmpi &gm = Graphmpi::getinstance();
+    // mynodel has to be calculated before running other threads
+    Graphmpi gm(thread_count, this);
+    SchedulePlan *plan = SchedulePlan::create(schedule);
     long long global_ans = 0;
 #pragma omp parallel num_threads(thread_count)
     {
-#pragma omp master
-        { gm.init(thread_count, this); }
-#pragma omp barrier // mynodel have to be calculated before running other
-                    // threads
 #pragma omp master
         { global_ans = gm.runmajor(); }
         if (omp_get_thread_num()) {
-            int *ans_buffer =
-                new int[schedule.in_exclusion_optimize_vertex_id.size()];
+            int *ans_buffer = new int[plan->iep_vertex_num];
             VertexSet *vertex_set =
-                new VertexSet[schedule.get_total_prefix_num()];
+                new_vertex_sets(plan->get_total_prefix_num());
             long long local_ans = 0;
-            VertexSet subtraction_set;
-            VertexSet tmp_set;
+            VertexSet subtraction_set(get_max_intersection_size());
+            VertexSet tmp_set(get_max_intersection_size());
             subtraction_set.init();
             auto match_start_vertex = [&](int vertex, int *data, int size) {
-                for (int prefix_id = schedule.get_last(0); prefix_id != -1;
-                     prefix_id = schedule.get_next(prefix_id)) {
+                for (int prefix_id = plan->get_last(0); prefix_id != -1;
+                     prefix_id = plan->get_next(prefix_id)) {
                     vertex_set[prefix_id].build_vertex_set(
-                        schedule, vertex_set, data, size, prefix_id);
+                        *plan, vertex_set, data, size, prefix_id);
                 }
                 // subtraction_set.insert_ans_sort(vertex);
                 subtraction_set.push_back(vertex);
-                pattern_matching_aggressive_func(schedule, vertex_set,
+                pattern_matching_aggressive_func(*plan, vertex_set,
                                                  subtraction_set, tmp_set,
                                                  local_ans, 1, ans_buffer);
                 subtraction_set.pop_back();
@@ -616,32 +880,34 @@ long long Graph::pattern_matching_mpi(const Schedule_IEP &schedule,
             gm.end();
         }
     }
+    SchedulePlan::destroy(plan);
     return global_ans;
 }
 
-void Graph::pattern_matching_aggressive_func_mpi(const Schedule_IEP &schedule,
+void Graph::pattern_matching_aggressive_func_mpi(Graphmpi &gm,
+                                                 const SchedulePlan &plan,
                                                  VertexSet *vertex_set,
                                                  VertexSet &subtraction_set,
                                                  VertexSet &tmp_set,
                                                  long long &local_ans,
                                                  int depth) {
-    int loop_set_prefix_id = schedule.get_loop_set_prefix_id(depth);
+    int loop_set_prefix_id = plan.get_loop_set_prefix_id(depth);
     int loop_size = vertex_set[loop_set_prefix_id].get_size();
     if (loop_size <= 0)
         return;
     int *loop_data_ptr = vertex_set[loop_set_prefix_id].get_data_ptr();
-    if (depth == schedule.get_size() - 1) {
+    if (depth == plan.get_size() - 1) {
         // TODO : try more kinds of calculation.
         // For example, we can maintain an ordered set, but it will cost more to
         // maintain itself when entering or exiting recursion.
-        if (schedule.get_total_restrict_num() > 0) {
+        if (plan.get_total_restrict_num() > 0) {
             int min_vertex = v_cnt;
-            for (int i = schedule.get_restrict_last(depth); i != -1;
-                 i = schedule.get_restrict_next(i))
+            for (int i = plan.get_restrict_last(depth); i != -1;
+                 i = plan.get_restrict_next(i))
                 if (min_vertex >
-                    subtraction_set.get_data(schedule.get_restrict_index(i)))
+                    subtraction_set.get_data(plan.get_restrict_index(i)))
                     min_vertex = subtraction_set.get_data(
-                        schedule.get_restrict_index(i));
+                        plan.get_restrict_index(i));
             const VertexSet &vset = vertex_set[loop_set_prefix_id];
             int size_after_restrict =
                 std::lower_bound(vset.get_data_ptr(),
@@ -660,12 +926,12 @@ void Graph::pattern_matching_aggressive_func_mpi(const Schedule_IEP &schedule,
 
     // TODO : min_vertex is also a loop invariant
     int min_vertex = v_cnt;
-    for (int i = schedule.get_restrict_last(depth); i != -1;
-         i = schedule.get_restrict_next(i))
+    for (int i = plan.get_restrict_last(depth); i != -1;
+         i = plan.get_restrict_next(i))
         if (min_vertex >
-            subtraction_set.get_data(schedule.get_restrict_index(i)))
+            subtraction_set.get_data(plan.get_restrict_index(i)))
             min_vertex =
-                subtraction_set.get_data(schedule.get_restrict_index(i));
+                subtraction_set.get_data(plan.get_restrict_index(i));
     for (int i = 0; i < loop_size; ++i) {
         if (min_vertex <= loop_data_ptr[i])
             break;
@@ -673,7 +939,6 @@ void Graph::pattern_matching_aggressive_func_mpi(const Schedule_IEP &schedule,
         if (subtraction_set.has_data(vertex))
             continue;
         int *data, size;
-        Graphmpi &gm = Graphmpi::getinstance();
         // if (gm.include(vertex)) {
         if (true) {
             e_index_t l, r;
@@ -685,10 +950,10 @@ void Graph::pattern_matching_aggressive_func_mpi(const Schedule_IEP &schedule,
             size = gm.getdegree();
         }
         bool is_zero = false;
-        for (int prefix_id = schedule.get_last(depth); prefix_id != -1;
-             prefix_id = schedule.get_next(prefix_id)) {
-            vertex_set[prefix_id].build_vertex_set(schedule, vertex_set, data,
-                                                   size, prefix_id, vertex);
+        for (int prefix_id = plan.get_last(depth); prefix_id != -1;
+             prefix_id = plan.get_next(prefix_id)) {
+            vertex_set[prefix_id].build_vertex_set(plan, vertex_set, data,
+                                                   size, prefix_id);
             if (vertex_set[prefix_id].get_size() == 0) {
                 is_zero = true;
                 break;
@@ -698,90 +963,1063 @@ void Graph::pattern_matching_aggressive_func_mpi(const Schedule_IEP &schedule,
             continue;
         // subtraction_set.insert_ans_sort(vertex);
         subtraction_set.push_back(vertex);
-        int *ans_buffer =
-            new int[schedule.in_exclusion_optimize_vertex_id.size()];
-        pattern_matching_aggressive_func(schedule, vertex_set, subtraction_set,
+        int *ans_buffer = new int[plan.iep_vertex_num];
+        pattern_matching_aggressive_func(plan, vertex_set, subtraction_set,
                                          tmp_set, local_ans, depth + 1,
                                          ans_buffer);
         subtraction_set.pop_back();
     }
 }
 
-void erase_edge(Graph &g) {
-    int newe = 0;
-    printf("start erasing edge\n");
-    fflush(stdout);
-    for (int v = 0; v < g.v_cnt; v++) {
-        int l = newe;
-        for (long long e = g.vertex[v]; e < g.vertex[v + 1] && e < g.e_cnt;
-             e++) {
-            if (g.edge[e] >= v)
-                continue;
-            g.edge[newe] = g.edge[e];
-            newe++;
+long long Graph::pattern_enumeration(const Schedule_IEP &schedule,
+                                     EmbeddingSink &sink, int batch_size) {
+    long long global_ans = 0;
+#pragma omp parallel reduction(+ : global_ans)
+    {
+        VertexSet *vertex_set =
+            new_vertex_sets(schedule.get_total_prefix_num() + 10);
+        VertexSet subtraction_set(get_max_intersection_size());
+        subtraction_set.init();
+        EmbeddingBatch batch(schedule.get_size(), batch_size);
+        long long local_ans = 0;
+#pragma omp for schedule(dynamic) nowait
+        for (int vertex = 0; vertex < v_cnt; ++vertex) {
+            e_index_t l, r;
+            get_edge_index(vertex, l, r);
+            for (int prefix_id = schedule.get_last(0); prefix_id != -1;
+                 prefix_id = schedule.get_next(prefix_id)) {
+                vertex_set[prefix_id].build_vertex_set(
+                    schedule, vertex_set, &edge[l], (int)(r - l), prefix_id);
+            }
+            subtraction_set.push_back(vertex);
+            pattern_enumeration_func(schedule, vertex_set, subtraction_set,
+                                     batch, sink, local_ans, 1);
+            subtraction_set.pop_back();
         }
-        g.vertex[v] = l;
+        if (batch.get_size() > 0) {
+            sink.consume(batch);
+            batch.clear();
+        }
+        delete[] vertex_set;
+        global_ans += local_ans;
     }
-    g.vertex[g.v_cnt] = newe;
-    g.e_cnt = newe;
-    printf("newe: %ld\n", g.e_cnt);
-}
-
-// reduce two directed edge to one
-void reduce_edges_for_clique(Graph &g) {
-    printf("Trying to reduce edge. the pattern is a clique.\n");
-    erase_edge(g);
-    printf("Finish reduce.\n");
+    return global_ans;
 }
 
-void Graph::get_third_layer_size(const Schedule_IEP& schedule, int *count) const {
-    //    intersection_times_low = intersection_times_high = 0;
-    //    dep1_cnt = dep2_cnt = dep3_cnt = 0;
-    uint32_t *edge_from = new uint32_t[e_cnt];
-    for (uint32_t i = 0; i < v_cnt; ++i)
-        for (e_index_t j = vertex[i]; j < vertex[i + 1]; ++j)
-            edge_from[j] = i;
-    #pragma omp parallel num_threads(64)
+long long Graph::pattern_enumeration_mpi(const Schedule_IEP &schedule,
+                                         EmbeddingSink &sink,
+                                         int thread_count, int batch_size) {
+    Graphmpi gm(thread_count, this);
+    long long global_ans = 0;
+#pragma omp parallel num_threads(thread_count)
     {
-        VertexSet *vertex_set = new VertexSet[schedule.get_total_prefix_num()];
-        #pragma omp for schedule(dynamic) nowait
-        for (int e = 0; e < e_cnt; ++e) {
-            count[e] = 0;
-
-            int v0 = edge[e];
-            int v1 = edge_from[e];
-            e_index_t l, r;
-            get_edge_index(v0, l, r);
-
-            for (int prefix_id = schedule.get_last(0); prefix_id != -1; prefix_id = schedule.get_next(prefix_id)) {
-                vertex_set[prefix_id].build_vertex_set(
-                    schedule, vertex_set, &edge[l], (int)(r - l), prefix_id);
+#pragma omp master
+        { global_ans = gm.runmajor(); }
+        if (omp_get_thread_num()) {
+            VertexSet *vertex_set =
+                new_vertex_sets(schedule.get_total_prefix_num() + 10);
+            VertexSet subtraction_set(get_max_intersection_size());
+            subtraction_set.init();
+            EmbeddingBatch batch(schedule.get_size(), batch_size);
+            long long local_ans = 0;
+            for (std::pair<int, int> range;;) {
+                if ((range = gm.get_vertex_range()).first == -1)
+                    break;
+                for (int vertex = range.first; vertex < range.second;
+                     vertex++) {
+                    e_index_t l, r;
+                    get_edge_index(vertex, l, r);
+                    for (int prefix_id = schedule.get_last(0); prefix_id != -1;
+                         prefix_id = schedule.get_next(prefix_id)) {
+                        vertex_set[prefix_id].build_vertex_set(
+                            schedule, vertex_set, &edge[l], (int)(r - l),
+                            prefix_id);
+                    }
+                    subtraction_set.push_back(vertex);
+                    pattern_enumeration_func(schedule, vertex_set,
+                                             subtraction_set, batch, sink,
+                                             local_ans, 1);
+                    subtraction_set.pop_back();
+                }
             }
-            get_edge_index(v1, l, r);
-            for (int prefix_id = schedule.get_last(1); prefix_id != -1; prefix_id = schedule.get_next(prefix_id)) {
-                vertex_set[prefix_id].build_vertex_set(schedule, vertex_set, &edge[l], r - l, prefix_id);
-                count[e] += vertex_set[prefix_id].get_size();
+            if (batch.get_size() > 0) {
+                sink.consume(batch);
+                batch.clear();
             }
+            delete[] vertex_set;
+            gm.report(local_ans);
+            gm.end();
         }
-        
-        delete[] vertex_set;
     }
-    
+    return global_ans;
 }
 
-// direct reorder, which doesn't take the cache into account
-void Graph::reorder_edge(const Schedule_IEP& schedule, e_index_t * new_order, e_index_t *task_start, int total_devices) const {
-    int total_chunks = (e_cnt - 1) / chunk_size + 1;
-    
-    int *third_layer_count = new int[e_cnt];
-    // get_third_layer_size(schedule, third_layer_count);
+void Graph::pattern_enumeration_func(const Schedule_IEP &schedule,
+                                     VertexSet *vertex_set,
+                                     VertexSet &subtraction_set,
+                                     EmbeddingBatch &batch, EmbeddingSink &sink,
+                                     long long &local_ans, int depth) {
+    int loop_set_prefix_id = schedule.get_loop_set_prefix_id(depth);
+    int loop_size = vertex_set[loop_set_prefix_id].get_size();
+    if (loop_size <= 0)
+        return;
+    int *loop_data_ptr = vertex_set[loop_set_prefix_id].get_data_ptr();
 
+    if (schedule.is_vertex_induced) {
+        VertexSet &diff_buf =
+            vertex_set[schedule.get_total_prefix_num() + depth];
+        remove_anti_edge_vertices(diff_buf, vertex_set[loop_set_prefix_id],
+                                  schedule.get_adj_mat_ptr(),
+                                  schedule.get_size(), subtraction_set, depth);
+        loop_data_ptr = diff_buf.get_data_ptr();
+        loop_size = diff_buf.get_size();
+    }
 
-    int *chunk_size_sum = new int[total_chunks];
-    for(int i = 0; i < total_chunks; i++) chunk_size_sum[i] = 0;
-    for(int i = 0; i < e_cnt; i++) chunk_size_sum[i / chunk_size] += third_layer_count[i];
+    int min_vertex = v_cnt;
+    for (int i = schedule.get_restrict_last(depth); i != -1;
+         i = schedule.get_restrict_next(i))
+        if (min_vertex >
+            subtraction_set.get_data(schedule.get_restrict_index(i)))
+            min_vertex =
+                subtraction_set.get_data(schedule.get_restrict_index(i));
 
-    int *chunk_order = new int[total_chunks];
+    // The leaf is listed explicitly even if the schedule was built with IEP,
+    // the IEP prefixes are still maintained but simply not read.
+    if (depth == schedule.get_size() - 1) {
+        for (int i = 0; i < loop_size; ++i) {
+            int vertex = loop_data_ptr[i];
+            if (min_vertex <= vertex)
+                break;
+            if (subtraction_set.has_data(vertex))
+                continue;
+            v_index_t *embedding = batch.append();
+            memcpy(embedding, subtraction_set.get_data_ptr(),
+                   sizeof(v_index_t) * depth);
+            embedding[depth] = vertex;
+            ++local_ans;
+            if (batch.full()) {
+                sink.consume(batch);
+                batch.clear();
+            }
+        }
+        return;
+    }
+
+    for (int i = 0; i < loop_size; ++i) {
+        if (min_vertex <= loop_data_ptr[i])
+            break;
+        int vertex = loop_data_ptr[i];
+        if (subtraction_set.has_data(vertex))
+            continue;
+        e_index_t l, r;
+        get_edge_index(vertex, l, r);
+        bool is_zero = false;
+        for (int prefix_id = schedule.get_last(depth); prefix_id != -1;
+             prefix_id = schedule.get_next(prefix_id)) {
+            vertex_set[prefix_id].build_vertex_set(schedule, vertex_set,
+                                                   &edge[l], (int)(r - l),
+                                                   prefix_id, vertex);
+            if (vertex_set[prefix_id].get_size() ==
+                schedule.break_size[prefix_id]) {
+                is_zero = true;
+                break;
+            }
+        }
+        if (is_zero)
+            continue;
+        subtraction_set.push_back(vertex);
+        pattern_enumeration_func(schedule, vertex_set, subtraction_set, batch,
+                                 sink, local_ans, depth + 1);
+        subtraction_set.pop_back();
+    }
+}
+
+e_index_t Graph::get_edge_id(v_index_t u, v_index_t v) const {
+    e_index_t l, r;
+    get_edge_index(u, l, r);
+    v_index_t *pos = std::lower_bound(edge + l, edge + r, v);
+    if (pos == edge + r || *pos != v)
+        return -1;
+    return pos - edge;
+}
+
+long long Graph::local_pattern_matching(const Schedule_IEP &schedule,
+                                        long long *vertex_ans,
+                                        long long *edge_ans,
+                                        const int *vertex_column) {
+    int size = schedule.get_size();
+    int column_cnt = 1;
+    if (vertex_column != nullptr)
+        column_cnt = *std::max_element(vertex_column, vertex_column + size) + 1;
+    long long vertex_ans_len = (long long)column_cnt * v_cnt;
+    int thread_cnt = omp_get_max_threads();
+    long long **thread_vertex_ans = new long long *[thread_cnt];
+    long long **thread_edge_ans = new long long *[thread_cnt];
+    long long global_ans = 0;
+#pragma omp parallel num_threads(thread_cnt) reduction(+ : global_ans)
+    {
+        int thread_id = omp_get_thread_num();
+        long long *local_vertex_ans = new long long[vertex_ans_len];
+        memset(local_vertex_ans, 0, sizeof(long long) * vertex_ans_len);
+        // the counters of each schedule vertex
+        long long *column_ans[size];
+        for (int i = 0; i < size; ++i)
+            column_ans[i] =
+                local_vertex_ans +
+                (vertex_column == nullptr ? 0 : (long long)vertex_column[i] * v_cnt);
+        long long *local_edge_ans = nullptr;
+        if (edge_ans != nullptr) {
+            local_edge_ans = new long long[e_cnt];
+            memset(local_edge_ans, 0, sizeof(long long) * e_cnt);
+        }
+        thread_vertex_ans[thread_id] = local_vertex_ans;
+        thread_edge_ans[thread_id] = local_edge_ans;
+
+        VertexSet *vertex_set =
+            new_vertex_sets(schedule.get_total_prefix_num() + 10);
+        VertexSet subtraction_set(get_max_intersection_size());
+        subtraction_set.init();
+        long long local_ans = 0;
+#pragma omp for schedule(dynamic)
+        for (int vertex = 0; vertex < v_cnt; ++vertex) {
+            e_index_t l, r;
+            get_edge_index(vertex, l, r);
+            for (int prefix_id = schedule.get_last(0); prefix_id != -1;
+                 prefix_id = schedule.get_next(prefix_id)) {
+                vertex_set[prefix_id].build_vertex_set(
+                    schedule, vertex_set, &edge[l], (int)(r - l), prefix_id);
+            }
+            subtraction_set.push_back(vertex);
+            local_pattern_matching_func(schedule, vertex_set, subtraction_set,
+                                        column_ans, local_edge_ans, local_ans,
+                                        1);
+            subtraction_set.pop_back();
+        }
+        delete[] vertex_set;
+        global_ans += local_ans;
+
+        // the implicit barrier of the loop above makes every counter complete
+#pragma omp for schedule(static)
+        for (long long v = 0; v < vertex_ans_len; ++v) {
+            long long sum = 0;
+            for (int i = 0; i < thread_cnt; ++i)
+                sum += thread_vertex_ans[i][v];
+            vertex_ans[v] = sum;
+        }
+        if (edge_ans != nullptr) {
+#pragma omp for schedule(static)
+            for (e_index_t e = 0; e < e_cnt; ++e) {
+                long long sum = 0;
+                for (int i = 0; i < thread_cnt; ++i)
+                    sum += thread_edge_ans[i][e];
+                edge_ans[e] = sum;
+            }
+        }
+#pragma omp barrier
+        delete[] local_vertex_ans;
+        if (local_edge_ans != nullptr)
+            delete[] local_edge_ans;
+
+        // an edge may have been counted in either direction
+        if (edge_ans != nullptr) {
+#pragma omp for schedule(dynamic, 64)
+            for (int u = 0; u < v_cnt; ++u)
+                for (e_index_t e = vertex[u]; e < vertex[u + 1]; ++e)
+                    if (edge[e] > u) {
+                        e_index_t reverse = get_edge_id(edge[e], u);
+                        edge_ans[e] += edge_ans[reverse];
+                        edge_ans[reverse] = edge_ans[e];
+                    }
+        }
+    }
+    delete[] thread_vertex_ans;
+    delete[] thread_edge_ans;
+
+    // All counted copies of a subgraph contain the same vertices and edges, so
+    // the local counts share the divisor of the total count. Without
+    // restrictions every subgraph is found once per automorphism.
+    long long redundancy = 1;
+    if (schedule.get_in_exclusion_optimize_num() == 2)
+        redundancy = schedule.get_in_exclusion_optimize_redundancy();
+    if (schedule.get_total_restrict_num() == 0)
+        redundancy *= schedule.get_multiplicity();
+    if (redundancy > 1) {
+        global_ans /= redundancy;
+#pragma omp parallel for schedule(static)
+        for (long long v = 0; v < vertex_ans_len; ++v)
+            vertex_ans[v] /= redundancy;
+        if (edge_ans != nullptr) {
+#pragma omp parallel for schedule(static)
+            for (e_index_t e = 0; e < e_cnt; ++e)
+                edge_ans[e] /= redundancy;
+        }
+    }
+    return global_ans;
+}
+
+// For every earlier pattern neighbor of pattern_vertex, the neighbor list of
+// the vertex it is mapped to. The candidates of pattern_vertex are in all of
+// these lists and come in increasing order, so their edge ids are found by
+// moving the cursors forward.
+int Graph::get_neighbor_cursors(const Schedule_IEP &schedule,
+                                int pattern_vertex, const int *embedding,
+                                std::pair<v_index_t *, v_index_t *> *cursor) {
+    int size = schedule.get_size();
+    const int *adj_mat = schedule.get_adj_mat_ptr();
+    int cnt = 0;
+    for (int j = 0; j < pattern_vertex; ++j)
+        if (adj_mat[INDEX(pattern_vertex, j, size)])
+            cursor[cnt++] = std::make_pair(edge + vertex[embedding[j]],
+                                           edge + vertex[embedding[j] + 1]);
+    return cnt;
+}
+
+// Same traversal as pattern_enumeration_func. The leaf candidates are only
+// looped over for their own vertex and edges, everything fixed above the
+// leaf is credited once with the number of leaves. Two IEP vertices are
+// handled together in linear time.
+void Graph::local_pattern_matching_func(const Schedule_IEP &schedule,
+                                        VertexSet *vertex_set,
+                                        VertexSet &subtraction_set,
+                                        long long **vertex_ans,
+                                        long long *edge_ans,
+                                        long long &local_ans, int depth) {
+    int loop_set_prefix_id = schedule.get_loop_set_prefix_id(depth);
+    int loop_size = vertex_set[loop_set_prefix_id].get_size();
+    if (loop_size <= 0)
+        return;
+    int *loop_data_ptr = vertex_set[loop_set_prefix_id].get_data_ptr();
+
+    if (schedule.is_vertex_induced) {
+        VertexSet &diff_buf =
+            vertex_set[schedule.get_total_prefix_num() + depth];
+        remove_anti_edge_vertices(diff_buf, vertex_set[loop_set_prefix_id],
+                                  schedule.get_adj_mat_ptr(),
+                                  schedule.get_size(), subtraction_set, depth);
+        loop_data_ptr = diff_buf.get_data_ptr();
+        loop_size = diff_buf.get_size();
+    }
+
+    int size = schedule.get_size();
+    const int *adj_mat = schedule.get_adj_mat_ptr();
+    const int *embedding = subtraction_set.get_data_ptr();
+    std::pair<v_index_t *, v_index_t *> cursor[size];
+
+    // Two IEP vertices a and b: there are |A||B| - |A & B| tails, a vertex w
+    // of A is a in |B| - [w in B] of them (and symmetrically for B). The
+    // restrictions of a and b are ignored as in the IEP count and the result
+    // is divided by the IEP redundancy.
+    if (depth == size - 2 && schedule.get_in_exclusion_optimize_num() == 2) {
+        const VertexSet &a_set = vertex_set[loop_set_prefix_id];
+        const VertexSet &b_set =
+            vertex_set[schedule.get_loop_set_prefix_id(depth + 1)];
+        long long a_size =
+            VertexSet::unordered_subtraction_size(a_set, subtraction_set);
+        long long b_size =
+            VertexSet::unordered_subtraction_size(b_set, subtraction_set);
+        long long common_size = 0;
+        for (int i = 0, j = 0; i < a_set.get_size() && j < b_set.get_size();) {
+            if (a_set.get_data(i) < b_set.get_data(j))
+                ++i;
+            else if (a_set.get_data(i) > b_set.get_data(j))
+                ++j;
+            else {
+                if (!subtraction_set.has_data(a_set.get_data(i)))
+                    ++common_size;
+                ++i, ++j;
+            }
+        }
+        long long tail_cnt = a_size * b_size - common_size;
+        if (tail_cnt == 0)
+            return;
+        local_ans += tail_cnt;
+        for (int j = 0; j < depth; ++j)
+            vertex_ans[j][embedding[j]] += tail_cnt;
+        if (edge_ans != nullptr)
+            for (int j = 0; j < depth; ++j)
+                for (int k = 0; k < j; ++k)
+                    if (adj_mat[INDEX(j, k, size)])
+                        edge_ans[get_edge_id(embedding[j], embedding[k])] +=
+                            tail_cnt;
+
+        for (int side = 0; side < 2; ++side) {
+            const VertexSet &set = side == 0 ? a_set : b_set;
+            const VertexSet &other = side == 0 ? b_set : a_set;
+            long long other_size = side == 0 ? b_size : a_size;
+            int neighbor_cnt = edge_ans == nullptr
+                                   ? 0
+                                   : get_neighbor_cursors(schedule, depth + side,
+                                                          embedding, cursor);
+            const int *other_ptr = other.get_data_ptr();
+            const int *other_end = other_ptr + other.get_size();
+            for (int i = 0; i < set.get_size(); ++i) {
+                int vertex = set.get_data(i);
+                if (subtraction_set.has_data(vertex))
+                    continue;
+                while (other_ptr != other_end && *other_ptr < vertex)
+                    ++other_ptr;
+                long long cnt = other_size;
+                if (other_ptr != other_end && *other_ptr == vertex)
+                    --cnt;
+                vertex_ans[depth + side][vertex] += cnt;
+                for (int j = 0; j < neighbor_cnt; ++j) {
+                    cursor[j].first = std::lower_bound(cursor[j].first,
+                                                       cursor[j].second, vertex);
+                    edge_ans[cursor[j].first - edge] += cnt;
+                }
+            }
+        }
+        return;
+    }
+
+    int min_vertex = v_cnt;
+    for (int i = schedule.get_restrict_last(depth); i != -1;
+         i = schedule.get_restrict_next(i))
+        if (min_vertex >
+            subtraction_set.get_data(schedule.get_restrict_index(i)))
+            min_vertex =
+                subtraction_set.get_data(schedule.get_restrict_index(i));
+
+    if (depth == size - 1) {
+        int neighbor_cnt =
+            edge_ans == nullptr
+                ? 0
+                : get_neighbor_cursors(schedule, depth, embedding, cursor);
+        long long leaf_cnt = 0;
+        for (int i = 0; i < loop_size; ++i) {
+            int vertex = loop_data_ptr[i];
+            if (min_vertex <= vertex)
+                break;
+            if (subtraction_set.has_data(vertex))
+                continue;
+            ++leaf_cnt;
+            ++vertex_ans[depth][vertex];
+            for (int j = 0; j < neighbor_cnt; ++j) {
+                cursor[j].first = std::lower_bound(cursor[j].first,
+                                                   cursor[j].second, vertex);
+                ++edge_ans[cursor[j].first - edge];
+            }
+        }
+        if (leaf_cnt == 0)
+            return;
+        local_ans += leaf_cnt;
+        for (int j = 0; j < depth; ++j)
+            vertex_ans[j][embedding[j]] += leaf_cnt;
+        if (edge_ans != nullptr)
+            for (int j = 0; j < depth; ++j)
+                for (int k = 0; k < j; ++k)
+                    if (adj_mat[INDEX(j, k, size)])
+                        edge_ans[get_edge_id(embedding[j], embedding[k])] +=
+                            leaf_cnt;
+        return;
+    }
+
+    for (int i = 0; i < loop_size; ++i) {
+        if (min_vertex <= loop_data_ptr[i])
+            break;
+        int vertex = loop_data_ptr[i];
+        if (subtraction_set.has_data(vertex))
+            continue;
+        e_index_t l, r;
+        get_edge_index(vertex, l, r);
+        bool is_zero = false;
+        for (int prefix_id = schedule.get_last(depth); prefix_id != -1;
+             prefix_id = schedule.get_next(prefix_id)) {
+            vertex_set[prefix_id].build_vertex_set(schedule, vertex_set,
+                                                   &edge[l], (int)(r - l),
+                                                   prefix_id, vertex);
+            if (vertex_set[prefix_id].get_size() ==
+                schedule.break_size[prefix_id]) {
+                is_zero = true;
+                break;
+            }
+        }
+        if (is_zero)
+            continue;
+        subtraction_set.push_back(vertex);
+        local_pattern_matching_func(schedule, vertex_set, subtraction_set,
+                                    vertex_ans, edge_ans, local_ans,
+                                    depth + 1);
+        subtraction_set.pop_back();
+    }
+}
+
+// columns of small_orbit_counting, the edge-induced orbits of the graphlets
+// of 3 and 4 vertices
+enum SmallOrbit {
+    TriangleOrbit,
+    WedgeCenter,
+    WedgeEnd,
+    StarCenter,
+    StarLeaf,
+    PathEnd,
+    PathMiddle,
+    CycleOrbit,
+    TailedCenter, // the triangle vertex of the tail
+    TailedSide,   // the other two triangle vertices
+    TailedEnd,
+    DiamondChord, // the two vertices of degree 3
+    DiamondTip,
+    CliqueOrbit,
+    SmallOrbitNum
+};
+
+// the column of a vertex of the given degree in a graphlet of 3 or 4 vertices
+static int get_small_orbit(int size, int edge_num, int max_degree, int degree) {
+    if (size == 3)
+        return edge_num == 3 ? TriangleOrbit : degree == 2 ? WedgeCenter : WedgeEnd;
+    switch (edge_num) {
+    case 3:
+        if (max_degree == 3)
+            return degree == 3 ? StarCenter : StarLeaf;
+        return degree == 2 ? PathMiddle : PathEnd;
+    case 4:
+        if (max_degree == 2)
+            return CycleOrbit;
+        return degree == 3 ? TailedCenter : degree == 2 ? TailedSide : TailedEnd;
+    case 5:
+        return degree == 3 ? DiamondChord : DiamondTip;
+    default:
+        return CliqueOrbit;
+    }
+}
+
+void Graph::small_orbit_counting(int max_size, long long *local) {
+    memset(local, 0, sizeof(long long) * SmallOrbitNum * v_cnt);
+    long long *col[SmallOrbitNum];
+    for (int o = 0; o < SmallOrbitNum; ++o)
+        col[o] = local + (long long)o * v_cnt;
+    int *support = edge_support();
+
+    // t_v = sum_u t_uv / 2, wedge end = sum_u (d_u - 1), star leaf = sum_u C(d_u - 1, 2)
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (v_index_t v = 0; v < v_cnt; ++v) {
+        long long dv = vertex[v + 1] - vertex[v];
+        for (e_index_t i = vertex[v]; i < vertex[v + 1]; ++i) {
+            long long du = vertex[edge[i] + 1] - vertex[edge[i]];
+            col[TriangleOrbit][v] += support[i];
+            col[WedgeEnd][v] += du - 1;
+            col[StarLeaf][v] += (du - 1) * (du - 2) / 2;
+        }
+        col[TriangleOrbit][v] /= 2;
+        col[WedgeCenter][v] = dv * (dv - 1) / 2;
+    }
+    if (max_size < 4) {
+        delete[] support;
+        return;
+    }
+
+    // path end = sum_u wedge end_u - d_v (d_v - 1) - 2 t_v, path middle = (d_v - 1) wedge end_v - 2 t_v
+    // tailed side = sum_u t_uv (d_u - 2), tailed end = sum_u (t_u - t_uv), diamond chord = sum_u C(t_uv, 2)
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (v_index_t v = 0; v < v_cnt; ++v) {
+        long long dv = vertex[v + 1] - vertex[v], tv = col[TriangleOrbit][v];
+        col[StarCenter][v] = dv * (dv - 1) * (dv - 2) / 6;
+        col[PathEnd][v] = -dv * (dv - 1) - 2 * tv;
+        col[PathMiddle][v] = (dv - 1) * col[WedgeEnd][v] - 2 * tv;
+        col[TailedCenter][v] = tv * (dv - 2);
+        for (e_index_t i = vertex[v]; i < vertex[v + 1]; ++i) {
+            v_index_t u = edge[i];
+            long long du = vertex[u + 1] - vertex[u], t = support[i];
+            col[PathEnd][v] += col[WedgeEnd][u];
+            col[TailedSide][v] += t * (du - 2);
+            col[TailedEnd][v] += col[TriangleOrbit][u] - t;
+            col[DiamondChord][v] += t * (t - 1) / 2;
+        }
+    }
+
+    // diamond tips, 4-cliques and 4-cycles are listed on the oriented CSR,
+    // whose out neighbors keep the order of the adjacency lists
+    e_index_t *out_vertex;
+    v_index_t *out_edge;
+    build_oriented_csr(out_vertex, out_edge);
+    int *out_support = new int[out_vertex[v_cnt]];
+    int max_out_degree = 0;
+#pragma omp parallel for schedule(dynamic, 1024) reduction(max : max_out_degree)
+    for (v_index_t u = 0; u < v_cnt; ++u) {
+        e_index_t j = out_vertex[u];
+        for (e_index_t i = vertex[u]; i < vertex[u + 1]; ++i)
+            if (j < out_vertex[u + 1] && out_edge[j] == edge[i])
+                out_support[j++] = support[i];
+        max_out_degree = std::max(max_out_degree, (int)(out_vertex[u + 1] - out_vertex[u]));
+    }
+    delete[] support;
+    // intersect_simd4x may store a few elements past the result
+    int stride = max_out_degree + 16;
+
+    auto add = [](long long *counter, long long value) {
+        __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+    };
+#pragma omp parallel
+    {
+        int *common = new int[stride * 2];
+        int *wedge_cnt = new int[v_cnt];
+        memset(wedge_cnt, 0, sizeof(int) * v_cnt);
+        std::vector<v_index_t> touched;
+#pragma omp for schedule(dynamic)
+        for (v_index_t u = 0; u < v_cnt; ++u) {
+            int out_deg_u = out_vertex[u + 1] - out_vertex[u];
+            for (e_index_t i = out_vertex[u]; i < out_vertex[u + 1]; ++i) {
+                v_index_t v = out_edge[i];
+                int common_size = intersect_simd4x(
+                    &out_edge[out_vertex[u]], out_deg_u, &out_edge[out_vertex[v]],
+                    out_vertex[v + 1] - out_vertex[v], common);
+                // every triangle u -> v -> w is found once, from its edge u -> v;
+                // each of its vertices is the tip of t - 1 diamonds on the opposite edge
+                e_index_t j = out_vertex[u], k = out_vertex[v];
+                for (int c = 0; c < common_size; ++c) {
+                    v_index_t w = common[c];
+                    while (out_edge[j] != w)
+                        ++j;
+                    while (out_edge[k] != w)
+                        ++k;
+                    add(&col[DiamondTip][u], out_support[k] - 1);
+                    add(&col[DiamondTip][v], out_support[j] - 1);
+                    add(&col[DiamondTip][w], out_support[i] - 1);
+
+                    // and every 4-clique u -> v -> w -> x from its lowest triangle
+                    int clique_size = intersect_simd4x(
+                        common, common_size, &out_edge[out_vertex[w]],
+                        out_vertex[w + 1] - out_vertex[w], common + stride);
+                    if (clique_size == 0)
+                        continue;
+                    add(&col[CliqueOrbit][u], clique_size);
+                    add(&col[CliqueOrbit][v], clique_size);
+                    add(&col[CliqueOrbit][w], clique_size);
+                    for (int x = 0; x < clique_size; ++x)
+                        add(&col[CliqueOrbit][common[stride + x]], 1);
+                }
+            }
+
+            // every 4-cycle is found once from its highest vertex u: the
+            // wedges u - v - w with v, w lower than u, paired by w
+            for (int pass = 0; pass < 2; ++pass)
+                for (e_index_t i = vertex[u]; i < vertex[u + 1]; ++i) {
+                    v_index_t v = edge[i];
+                    if (!is_oriented(v, u))
+                        continue;
+                    long long cycle_cnt = 0;
+                    for (e_index_t j = vertex[v]; j < vertex[v + 1]; ++j) {
+                        v_index_t w = edge[j];
+                        if (!is_oriented(w, u))
+                            continue;
+                        if (pass == 1) {
+                            cycle_cnt += wedge_cnt[w] - 1;
+                            continue;
+                        }
+                        if (wedge_cnt[w] == 0)
+                            touched.push_back(w);
+                        ++wedge_cnt[w];
+                    }
+                    if (cycle_cnt > 0)
+                        add(&col[CycleOrbit][v], cycle_cnt);
+                }
+            long long cycle_cnt = 0;
+            for (v_index_t w : touched) {
+                long long pairs = (long long)wedge_cnt[w] * (wedge_cnt[w] - 1) / 2;
+                if (pairs > 0)
+                    add(&col[CycleOrbit][w], pairs);
+                cycle_cnt += pairs;
+                wedge_cnt[w] = 0;
+            }
+            touched.clear();
+            if (cycle_cnt > 0)
+                add(&col[CycleOrbit][u], cycle_cnt);
+        }
+        delete[] common;
+        delete[] wedge_cnt;
+    }
+    delete[] out_vertex;
+    delete[] out_edge;
+    delete[] out_support;
+}
+
+long long *Graph::orbit_counting(
+    int max_size, int &orbit_num,
+    std::vector<std::pair<Pattern, int>> *orbit_graphlet) {
+    assert(max_size >= 2);
+    // the graphlets of each size, those of 5 vertices in the vertex order of their schedules
+    std::vector<std::vector<Pattern>> graphlets(max_size + 1);
+    std::vector<std::vector<Schedule_IEP *>> schedules(max_size + 1);
+    std::vector<std::vector<std::vector<int>>> orbits(max_size + 1);
+    std::vector<int> size_orbit_start(max_size + 2, 0);
+    orbit_num = 1;
+    double planning_start = get_wall_time();
+    for (int size = 3; size <= max_size; ++size) {
+        size_orbit_start[size] = orbit_num;
+        std::vector<Pattern> motifs = MotifGenerator(size).generate();
+        int motif_num = motifs.size();
+        if (size <= 4) {
+            graphlets[size] = motifs;
+        } else {
+            schedules[size].resize(motif_num);
+#pragma omp parallel for schedule(dynamic) if (motif_num >= omp_get_max_threads())
+            for (int i = 0; i < motif_num; ++i) {
+                bool is_pattern_valid;
+                schedules[size][i] = new Schedule_IEP(
+                    motifs[i], is_pattern_valid, 1, 1, true, v_cnt, e_cnt, tri_cnt);
+                assert(is_pattern_valid);
+            }
+            for (Schedule_IEP *schedule : schedules[size]) {
+                Pattern graphlet(size);
+                const int *adj_mat = schedule->get_adj_mat_ptr();
+                for (int i = 0; i < size; ++i)
+                    for (int j = 0; j < i; ++j)
+                        if (adj_mat[INDEX(i, j, size)])
+                            graphlet.add_edge(i, j);
+                graphlets[size].push_back(graphlet);
+            }
+        }
+        for (const Pattern &graphlet : graphlets[size]) {
+            orbits[size].push_back(MotifGenerator::get_orbits(graphlet));
+            orbit_num += *std::max_element(orbits[size].back().begin(),
+                                           orbits[size].back().end()) +
+                         1;
+        }
+    }
+    size_orbit_start[max_size + 1] = orbit_num;
+    printf("Planning time cost: %.6lf s\n", get_wall_time() - planning_start);
+
+    if (orbit_graphlet != nullptr) {
+        orbit_graphlet->clear();
+        Pattern edge_graphlet(2);
+        edge_graphlet.add_edge(0, 1);
+        orbit_graphlet->push_back(std::make_pair(edge_graphlet, 0));
+        for (int size = 3; size <= max_size; ++size)
+            for (int i = 0; i < (int)graphlets[size].size(); ++i)
+                for (int v = 0; v < size; ++v)
+                    if (v == 0 || *std::max_element(orbits[size][i].begin(),
+                                                    orbits[size][i].begin() +
+                                                        v) < orbits[size][i][v])
+                        orbit_graphlet->push_back(
+                            std::make_pair(graphlets[size][i], v));
+    }
+
+    long long *ans = new long long[(long long)orbit_num * v_cnt];
+    for (int v = 0; v < v_cnt; ++v)
+        ans[v] = vertex[v + 1] - vertex[v];
+
+    long long *local = nullptr;
+    if (max_size >= 3) {
+        local = new long long[(long long)SmallOrbitNum * v_cnt];
+        small_orbit_counting(max_size, local);
+    }
+
+    for (int size = 3; size <= max_size; ++size) {
+        std::vector<Pattern> &patterns = graphlets[size];
+        int pattern_num = patterns.size();
+        long long *size_ans = ans + (long long)size_orbit_start[size] * v_cnt;
+        std::vector<int> orbit_start(pattern_num + 1, 0), edge_num;
+        for (int i = 0; i < pattern_num; ++i) {
+            const int *adj_mat = patterns[i].get_adj_mat_ptr();
+            orbit_start[i + 1] =
+                orbit_start[i] +
+                *std::max_element(orbits[size][i].begin(),
+                                  orbits[size][i].end()) +
+                1;
+            edge_num.push_back(std::count(adj_mat, adj_mat + size * size, 1) / 2);
+            if (size <= 4) {
+                std::vector<int> degree(size, 0);
+                for (int u = 0; u < size; ++u)
+                    for (int v = 0; v < size; ++v)
+                        degree[u] += adj_mat[INDEX(u, v, size)];
+                int max_degree = *std::max_element(degree.begin(), degree.end());
+                for (int u = 0; u < size; ++u) {
+                    int o = get_small_orbit(size, edge_num[i], max_degree, degree[u]);
+                    memcpy(size_ans + (long long)(orbit_start[i] + orbits[size][i][u]) * v_cnt,
+                           local + (long long)o * v_cnt, sizeof(long long) * v_cnt);
+                }
+                continue;
+            }
+            local_pattern_matching(*schedules[size][i],
+                                   size_ans + (long long)orbit_start[i] * v_cnt,
+                                   nullptr, orbits[size][i].data());
+            delete schedules[size][i];
+        }
+
+        // edge-induced to vertex-induced, denser graphlets first as in
+        // MotifGenerator::to_vertex_induced
+        std::vector<std::vector<long long>> containment =
+            MotifGenerator::get_orbit_containment_matrix(patterns);
+        std::vector<int> order(pattern_num);
+        for (int i = 0; i < pattern_num; ++i)
+            order[i] = i;
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            return edge_num[a] > edge_num[b];
+        });
+        std::vector<std::pair<int, std::vector<std::pair<int, long long>>>>
+            steps;
+        for (int p : order)
+            for (int o = orbit_start[p]; o < orbit_start[p + 1]; ++o) {
+                std::vector<std::pair<int, long long>> terms;
+                for (int q = 0; q < (int)containment[o].size(); ++q)
+                    if (containment[o][q] != 0 &&
+                        (q < orbit_start[p] || q >= orbit_start[p + 1]))
+                        terms.push_back(std::make_pair(q, containment[o][q]));
+                steps.push_back(std::make_pair(o, terms));
+            }
+#pragma omp parallel for schedule(static)
+        for (int v = 0; v < v_cnt; ++v)
+            for (const auto &step : steps)
+                for (const auto &term : step.second)
+                    size_ans[(long long)step.first * v_cnt + v] -=
+                        term.second * size_ans[(long long)term.first * v_cnt + v];
+    }
+    delete[] local;
+    return ans;
+}
+
+static inline uint64_t splitmix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// z such that a standard normal variable is within [-z, z] with the given probability
+static double normal_quantile(double confidence) {
+    double l = 0, r = 40;
+    for (int i = 0; i < 100; ++i) {
+        double mid = (l + r) / 2;
+        if (std::erf(mid / std::sqrt(2.0)) < confidence)
+            l = mid;
+        else
+            r = mid;
+    }
+    return r;
+}
+
+long long Graph::triangle_counting_estimate(long long sample_cnt,
+                                            unsigned long long seed) const {
+    // wedge_start[v]: wedges centered at vertices before v
+    long long *wedge_start = new long long[v_cnt + 1];
+    wedge_start[0] = 0;
+    for (v_index_t v = 0; v < v_cnt; ++v) {
+        long long d = vertex[v + 1] - vertex[v];
+        wedge_start[v + 1] = wedge_start[v] + d * (d - 1) / 2;
+    }
+    long long total = wedge_start[v_cnt];
+    if (total == 0) {
+        delete[] wedge_start;
+        return 0;
+    }
+    long long closed = 0;
+#pragma omp parallel for schedule(static) reduction(+ : closed)
+    for (long long i = 0; i < sample_cnt; ++i) {
+        uint64_t rnd = splitmix64(seed ^ splitmix64(i));
+        long long w = rnd % total;
+        v_index_t v = std::upper_bound(wedge_start, wedge_start + v_cnt + 1, w) -
+                      wedge_start - 1;
+        e_index_t d = vertex[v + 1] - vertex[v];
+        rnd = splitmix64(rnd);
+        e_index_t a = rnd % d, b = (rnd >> 32) % (d - 1);
+        if (b >= a)
+            ++b;
+        closed += get_edge_id(edge[vertex[v] + a], edge[vertex[v] + b]) != -1;
+    }
+    delete[] wedge_start;
+    return (long long)((double)closed / sample_cnt * total / 3 + 0.5);
+}
+
+void Graph::compute_statistics(e_index_t exact_triangle_limit) {
+    wedge_cnt = 0;
+    max_degree = 0;
+    for (v_index_t v = 0; v < v_cnt; ++v) {
+        long long d = vertex[v + 1] - vertex[v];
+        wedge_cnt += d * (d - 1) / 2;
+        max_degree = std::max(max_degree, (v_index_t)d);
+    }
+    tri_cnt = e_cnt <= exact_triangle_limit ? triangle_counting_mt()
+                                            : triangle_counting_estimate();
+    if (degree_stats == nullptr)
+        degree_stats = new DegreeStatistics();
+    degree_stats->compute(*this);
+}
+
+CountEstimate Graph::pattern_matching_estimate(const Schedule_IEP &schedule,
+                                               double relative_error,
+                                               double confidence,
+                                               SampleType sample_type,
+                                               long long max_sample_cnt,
+                                               unsigned long long seed) {
+    assert(schedule.get_size() >= 3);
+    assert(relative_error > 0 && confidence > 0 && confidence < 1);
+    double start_time = get_wall_time();
+    double z = normal_quantile(confidence);
+    double unit_cnt = sample_type == SampleType::Vertex ? v_cnt : e_cnt;
+    double scale = unit_cnt / schedule.get_in_exclusion_optimize_redundancy();
+    SchedulePlan *plan = SchedulePlan::create(schedule);
+
+    // never stop on the first few samples, they may all be 0
+    const long long min_sample_cnt = 4096;
+    long long round_size = std::max(1024LL, 64LL * omp_get_max_threads());
+    long long *counts = new long long[round_size];
+
+    // the scratch of each thread is allocated by its first round and kept
+    int thread_cnt = omp_get_max_threads();
+    int **thread_ans_buffer = new int *[thread_cnt]();
+    VertexSet **thread_vertex_sets = new VertexSet *[thread_cnt]();
+    VertexSet **thread_partial_embedding = new VertexSet *[thread_cnt]();
+    VertexSet **thread_tmp_set = new VertexSet *[thread_cnt]();
+
+    CountEstimate result;
+    result.sample_cnt = 0;
+    result.converged = false;
+    // Welford's running mean and sum of squared deviations
+    double mean = 0, m2 = 0;
+    while (result.sample_cnt < max_sample_cnt) {
+        long long first = result.sample_cnt;
+        long long cnt = std::min(round_size, max_sample_cnt - first);
+#pragma omp parallel num_threads(thread_cnt)
+        {
+            int thread_id = omp_get_thread_num();
+            if (thread_vertex_sets[thread_id] == nullptr) {
+                thread_ans_buffer[thread_id] = new int[plan->iep_vertex_num];
+                thread_vertex_sets[thread_id] =
+                    new_vertex_sets(plan->get_total_prefix_num() + 10);
+                thread_partial_embedding[thread_id] =
+                    new VertexSet(get_max_intersection_size());
+                thread_partial_embedding[thread_id]->init();
+                thread_tmp_set[thread_id] =
+                    new VertexSet(get_max_intersection_size());
+            }
+            int *ans_buffer = thread_ans_buffer[thread_id];
+            VertexSet *vertex_sets = thread_vertex_sets[thread_id];
+            VertexSet &partial_embedding = *thread_partial_embedding[thread_id];
+            VertexSet &tmp_set = *thread_tmp_set[thread_id];
+            // samples only depend on their index, not on the thread taking them
+#pragma omp for schedule(dynamic, 16)
+            for (long long i = 0; i < cnt; ++i) {
+                uint64_t rnd = splitmix64(seed ^ splitmix64(first + i));
+                if (sample_type == SampleType::Vertex) {
+                    counts[i] = pattern_matching_vertex_task(
+                        *plan, rnd % v_cnt, vertex_sets, partial_embedding,
+                        tmp_set, ans_buffer);
+                } else {
+                    e_index_t e = rnd % e_cnt;
+                    v_index_t v0 =
+                        std::upper_bound(vertex, vertex + v_cnt + 1, e) -
+                        vertex - 1;
+                    counts[i] = pattern_matching_edge_task(
+                        *plan, v0, edge[e], vertex_sets, partial_embedding,
+                        tmp_set, ans_buffer);
+                }
+            }
+        }
+        for (long long i = 0; i < cnt; ++i) {
+            ++result.sample_cnt;
+            double delta = counts[i] - mean;
+            mean += delta / result.sample_cnt;
+            m2 += delta * (counts[i] - mean);
+        }
+
+        double variance = result.sample_cnt > 1 ? m2 / (result.sample_cnt - 1) : 0;
+        double half_width = z * scale * std::sqrt(variance / result.sample_cnt);
+        result.estimate = scale * mean;
+        result.lower = std::max(0.0, result.estimate - half_width);
+        result.upper = result.estimate + half_width;
+        result.relative_error =
+            result.estimate > 0 ? half_width / result.estimate : 0;
+        // while every sample is 0 the interval is [0, 0] whatever the count,
+        // a rare pattern is only estimated once it was hit
+        if (result.sample_cnt >= min_sample_cnt && mean > 0 &&
+            half_width <= relative_error * result.estimate) {
+            result.converged = true;
+            break;
+        }
+        if (get_wall_time() - start_time > max_running_time)
+            break;
+    }
+    for (int i = 0; i < thread_cnt; ++i) {
+        delete[] thread_ans_buffer[i];
+        delete[] thread_vertex_sets[i];
+        delete thread_partial_embedding[i];
+        delete thread_tmp_set[i];
+    }
+    delete[] thread_ans_buffer;
+    delete[] thread_vertex_sets;
+    delete[] thread_partial_embedding;
+    delete[] thread_tmp_set;
+    SchedulePlan::destroy(plan);
+    delete[] counts;
+    return result;
+}
+
+void erase_edge(Graph &g) {
+    int newe = 0;
+    printf("start erasing edge\n");
+    fflush(stdout);
+    for (int v = 0; v < g.v_cnt; v++) {
+        int l = newe;
+        for (long long e = g.vertex[v]; e < g.vertex[v + 1] && e < g.e_cnt;
+             e++) {
+            if (g.edge[e] >= v)
+                continue;
+            g.edge[newe] = g.edge[e];
+            newe++;
+        }
+        g.vertex[v] = l;
+    }
+    g.vertex[g.v_cnt] = newe;
+    g.e_cnt = newe;
+    printf("newe: %ld\n", g.e_cnt);
+}
+
+// reduce two directed edge to one
+void reduce_edges_for_clique(Graph &g) {
+    printf("Trying to reduce edge. the pattern is a clique.\n");
+    erase_edge(g);
+    printf("Finish reduce.\n");
+}
+
+void Graph::get_third_layer_size(const Schedule_IEP& schedule, int *count) const {
+    //    intersection_times_low = intersection_times_high = 0;
+    //    dep1_cnt = dep2_cnt = dep3_cnt = 0;
+    uint32_t *edge_from = new uint32_t[e_cnt];
+    for (uint32_t i = 0; i < v_cnt; ++i)
+        for (e_index_t j = vertex[i]; j < vertex[i + 1]; ++j)
+            edge_from[j] = i;
+    #pragma omp parallel num_threads(64)
+    {
+        VertexSet *vertex_set = new_vertex_sets(schedule.get_total_prefix_num());
+        #pragma omp for schedule(dynamic) nowait
+        for (int e = 0; e < e_cnt; ++e) {
+            count[e] = 0;
+
+            int v0 = edge[e];
+            int v1 = edge_from[e];
+            e_index_t l, r;
+            get_edge_index(v0, l, r);
+
+            for (int prefix_id = schedule.get_last(0); prefix_id != -1; prefix_id = schedule.get_next(prefix_id)) {
+                vertex_set[prefix_id].build_vertex_set(
+                    schedule, vertex_set, &edge[l], (int)(r - l), prefix_id);
+            }
+            get_edge_index(v1, l, r);
+            for (int prefix_id = schedule.get_last(1); prefix_id != -1; prefix_id = schedule.get_next(prefix_id)) {
+                vertex_set[prefix_id].build_vertex_set(schedule, vertex_set, &edge[l], r - l, prefix_id);
+                count[e] += vertex_set[prefix_id].get_size();
+            }
+        }
+        
+        delete[] vertex_set;
+    }
+    
+}
+
+// direct reorder, which doesn't take the cache into account
+void Graph::reorder_edge(const Schedule_IEP& schedule, e_index_t * new_order, e_index_t *task_start, int total_devices) const {
+    int total_chunks = (e_cnt - 1) / chunk_size + 1;
+    
+    int *third_layer_count = new int[e_cnt];
+    // get_third_layer_size(schedule, third_layer_count);
+
+
+    int *chunk_size_sum = new int[total_chunks];
+    for(int i = 0; i < total_chunks; i++) chunk_size_sum[i] = 0;
+    for(int i = 0; i < e_cnt; i++) chunk_size_sum[i / chunk_size] += third_layer_count[i];
+
+    int *chunk_order = new int[total_chunks];
     for(int i = 0; i < total_chunks; i++) chunk_order[i] = i;
     // std::sort(chunk_order, chunk_order + total_chunks, [chunk_size_sum](int i, int j){
     //     return chunk_size_sum[i] > chunk_size_sum[j] || (chunk_size_sum[i] == chunk_size_sum[j] && i < j);
@@ -945,45 +2183,194 @@ void degeneracy_orientation_init(Graph *original_g, Graph *&g) {
     delete[] vector_ptr;
 }
 
-void Graph::motif_counting(int pattern_size) {
+void Graph::multi_pattern_matching(const MultiSchedule &schedule,
+                                   long long *ans) {
+    int pattern_num = schedule.get_pattern_num();
+    for (int i = 0; i < pattern_num; ++i)
+        ans[i] = 0;
+    const MultiScheduleNode &root = schedule.get_node(0);
+#pragma omp parallel
+    {
+        int *ans_buffer = new int[schedule.get_max_iep_vertex_num() + 1];
+        VertexSet *vertex_set = new_vertex_sets(schedule.get_slot_num() + 1);
+        VertexSet subtraction_set(get_max_intersection_size());
+        subtraction_set.init();
+        long long *local_ans = new long long[pattern_num];
+        for (int i = 0; i < pattern_num; ++i)
+            local_ans[i] = 0;
+#pragma omp for schedule(dynamic) nowait
+        for (int vertex = 0; vertex < v_cnt; ++vertex) {
+            e_index_t l, r;
+            get_edge_index(vertex, l, r);
+            for (int i = 0; i < (int)root.build_slot.size(); ++i)
+                vertex_set[root.build_slot[i]].build_vertex_set(
+                    nullptr, &edge[l], (int)(r - l));
+            subtraction_set.push_back(vertex);
+            multi_pattern_matching_extend(schedule, root, vertex_set,
+                                          subtraction_set, local_ans,
+                                          ans_buffer);
+            subtraction_set.pop_back();
+        }
+#pragma omp critical
+        {
+            for (int i = 0; i < pattern_num; ++i)
+                ans[i] += local_ans[i];
+        }
+        delete[] local_ans;
+        delete[] vertex_set;
+        delete[] ans_buffer;
+    }
+    for (int i = 0; i < pattern_num; ++i)
+        ans[i] /= schedule.get_redundancy(i);
+}
+
+// The vertex of `node` has just been chosen and its prefixes are built:
+// finish the patterns counted by IEP here and descend into the children.
+void Graph::multi_pattern_matching_extend(const MultiSchedule &schedule,
+                                          const MultiScheduleNode &node,
+                                          VertexSet *vertex_set,
+                                          VertexSet &subtraction_set,
+                                          long long *local_ans,
+                                          int *ans_buffer) {
+    for (int tail_id : node.iep_tail) {
+        const MultiScheduleIEP &tail = schedule.get_iep_tail(tail_id);
+        if (vertex_set[tail.loop_slot].get_size() <= 0)
+            continue;
+        for (int i = 0; i < (int)tail.vertex_slot.size(); ++i) {
+            if (tail.vertex_flag[i])
+                ans_buffer[i] = vertex_set[tail.vertex_slot[i]].get_size() -
+                                tail.vertex_coef[i];
+            else
+                ans_buffer[i] = VertexSet::unordered_subtraction_size(
+                    vertex_set[tail.vertex_slot[i]], subtraction_set);
+        }
+        int last_pos = -1;
+        long long val = 0;
+        for (int pos = 0; pos < (int)tail.coef.size(); ++pos) {
+            if (pos == last_pos + 1)
+                val = ans_buffer[tail.ans_pos[pos]];
+            else if (val != 0)
+                val = val * ans_buffer[tail.ans_pos[pos]];
+            if (tail.flag[pos]) {
+                last_pos = pos;
+                local_ans[tail.pattern_id] += val * tail.coef[pos];
+            }
+        }
+    }
+    for (int child : node.children)
+        multi_pattern_matching_func(schedule, child, vertex_set,
+                                    subtraction_set, local_ans, ans_buffer);
+}
+
+void Graph::multi_pattern_matching_func(const MultiSchedule &schedule,
+                                        int node_id, VertexSet *vertex_set,
+                                        VertexSet &subtraction_set,
+                                        long long *local_ans,
+                                        int *ans_buffer) {
+    const MultiScheduleNode &node = schedule.get_node(node_id);
+    const VertexSet &vset = vertex_set[node.loop_slot];
+    int loop_size = vset.get_size();
+    if (loop_size <= node.loop_break_size)
+        return;
+    const int *loop_data_ptr = vset.get_data_ptr();
+
+    int min_vertex = v_cnt;
+    for (int index : node.restrict_index)
+        if (min_vertex > subtraction_set.get_data(index))
+            min_vertex = subtraction_set.get_data(index);
+
+    if (!node.pattern_id.empty()) {
+        int size_after_restrict =
+            std::lower_bound(loop_data_ptr, loop_data_ptr + loop_size,
+                             min_vertex) -
+            loop_data_ptr;
+        long long cnt = 0;
+        if (size_after_restrict > 0)
+            cnt = VertexSet::unordered_subtraction_size(vset, subtraction_set,
+                                                        size_after_restrict);
+        for (int pattern_id : node.pattern_id)
+            local_ans[pattern_id] += cnt;
+    }
+    if (node.children.empty() && node.iep_tail.empty())
+        return;
+
+    for (int i = 0; i < loop_size; ++i) {
+        int vertex = loop_data_ptr[i];
+        if (min_vertex <= vertex)
+            break;
+        if (subtraction_set.has_data(vertex))
+            continue;
+        e_index_t l, r;
+        get_edge_index(vertex, l, r);
+        for (int j = 0; j < (int)node.build_slot.size(); ++j) {
+            int father = node.build_father_slot[j];
+            vertex_set[node.build_slot[j]].build_vertex_set(
+                father == -1 ? nullptr : &vertex_set[father], &edge[l],
+                (int)(r - l));
+        }
+        subtraction_set.push_back(vertex);
+        multi_pattern_matching_extend(schedule, node, vertex_set,
+                                      subtraction_set, local_ans, ans_buffer);
+        subtraction_set.pop_back();
+    }
+}
+
+void Graph::motif_counting(int pattern_size, bool vertex_induced, const char* motif_cache_dir) {
 
-    double total_counting_time = 0;
     TimeInterval allTime, tmpTime;
     allTime.check();
 
-    MotifGenerator mg(pattern_size);
+    MotifGenerator mg(pattern_size, 0, -1, motif_cache_dir);
     std::vector<Pattern> motifs = mg.generate();
-    for (int i = 0; i < motifs.size(); ++i) {
-        Pattern p = motifs[i];
+    printf("max intersection size %d\n", get_max_intersection_size());
+
+    tmpTime.check();
+    bool use_in_exclusion_optimize = true;
+    MultiSchedule schedule(motifs, use_in_exclusion_optimize, v_cnt, e_cnt,
+                           tri_cnt);
+    printf("%d patterns share %d trie nodes (%d without sharing)\n",
+           schedule.get_pattern_num(), schedule.get_node_num(),
+           schedule.get_unshared_node_num());
+    tmpTime.print("Planning time cost");
+
+    tmpTime.check();
+    long long *ans = new long long[motifs.size()];
+    multi_pattern_matching(schedule, ans);
+    if (vertex_induced) {
+        for (int i = 0; i < (int)motifs.size(); ++i)
+            assert(schedule.is_pattern_valid(i));
+        MotifGenerator::to_vertex_induced(
+            motifs, MotifGenerator::get_containment_matrix(motifs), ans, ans);
+    }
+    double total_counting_time = tmpTime.get_time();
 
+    for (int i = 0; i < (int)motifs.size(); ++i) {
         printf("pattern = \n");
-        p.print();
-
-        printf("max intersection size %d\n", VertexSet::max_intersection_size);
-        bool is_pattern_valid;
-        bool use_in_exclusion_optimize = true;
-
-        Schedule_IEP schedule_iep(p, is_pattern_valid, 1, 1,
-                                  use_in_exclusion_optimize, v_cnt, e_cnt,
-                                  tri_cnt);
-
-        if (!is_pattern_valid) {
+        motifs[i].print();
+        if (!schedule.is_pattern_valid(i)) {
             printf("pattern is invalid!\n");
             continue;
         }
-
-        tmpTime.check();
-        long long ans = this->pattern_matching(schedule_iep);
-        total_counting_time += tmpTime.print("Pattern counting time: ");
-
-        printf("ans: %lld\n", ans);
-
+        printf("ans: %lld\n", ans[i]);
     }
+    delete[] ans;
 
     printf("Counting time cost: %.6lf s\n", total_counting_time);
     allTime.print("Total time cost");
 }
 
+void Graph::motif_census(int pattern_size, long long *ans,
+                         bool vertex_induced) {
+    std::vector<Pattern> motifs = MotifGenerator(pattern_size).generate();
+    MultiSchedule schedule(motifs, true, v_cnt, e_cnt, tri_cnt);
+    for (int i = 0; i < (int)motifs.size(); ++i)
+        assert(schedule.is_pattern_valid(i));
+    multi_pattern_matching(schedule, ans);
+    if (vertex_induced)
+        MotifGenerator::to_vertex_induced(
+            motifs, MotifGenerator::get_containment_matrix(motifs), ans, ans);
+}
+
 int32_t get_intersection_size(const v_index_t *a, int32_t na,
                               const v_index_t *b, int32_t nb) {
     int32_t ans = 0;
@@ -1003,7 +2390,7 @@ int32_t get_intersection_size(const v_index_t *a, int32_t na,
     return ans;
 }
 
-void Graph::motif_counting_3() {
+void Graph::motif_counting_3(bool vertex_induced) {
     int64_t tri_cnt = 0, wedge_cnt = 0;
 
     uint32_t *edge_from = new uint32_t[e_cnt];
@@ -1031,7 +2418,9 @@ void Graph::motif_counting_3() {
             get_intersection_size(&edge[l0], r0 - l0, &edge[l1], r1 - l1);
     }
 
-    wedge_cnt -= tri_cnt;
+    // each triangle was counted once per edge and closes three wedges
+    if (vertex_induced)
+        wedge_cnt -= tri_cnt;
 
     tri_cnt /= 3;
     auto t2 = std::chrono::system_clock::now();
@@ -1041,3 +2430,371 @@ void Graph::motif_counting_3() {
 
     printf("triangle: %ld wedge: %ld time:%.6lf\n", tri_cnt, wedge_cnt, time);
 }
+
+void Graph::build_oriented_csr(e_index_t *&out_vertex,
+                               v_index_t *&out_edge) const {
+    // the out neighbors keep the id order of the adjacency lists
+    out_vertex = new e_index_t[v_cnt + 1];
+    out_vertex[0] = 0;
+    for (v_index_t u = 0; u < v_cnt; ++u) {
+        e_index_t out_deg = 0;
+        for (e_index_t i = vertex[u]; i < vertex[u + 1]; ++i)
+            out_deg += is_oriented(u, edge[i]);
+        out_vertex[u + 1] = out_vertex[u] + out_deg;
+    }
+    out_edge = new v_index_t[out_vertex[v_cnt]];
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (v_index_t u = 0; u < v_cnt; ++u) {
+        e_index_t pos = out_vertex[u];
+        for (e_index_t i = vertex[u]; i < vertex[u + 1]; ++i)
+            if (is_oriented(u, edge[i]))
+                out_edge[pos++] = edge[i];
+    }
+}
+
+void Graph::motif_counting_4(long long *ans, bool vertex_induced) {
+    auto t1 = std::chrono::system_clock::now();
+
+    e_index_t *out_vertex;
+    v_index_t *out_edge;
+    build_oriented_csr(out_vertex, out_edge);
+
+    // star = sum C(d, 3); path = sum_(u,v) (d_u - 1)(d_v - 1) - 3 triangles
+    // tailed triangle = sum_(u,v) t_uv (d_u + d_v - 4) / 2, diamond = sum_(u,v) C(t_uv, 2)
+    long long star_cnt = 0, path_cnt = 0, tri_cnt3 = 0, tailed_tri_cnt2 = 0,
+              diamond_cnt = 0, cycle_cnt = 0, clique_cnt = 0;
+    int capacity = get_max_intersection_size();
+#pragma omp parallel reduction(+ : star_cnt, path_cnt, tri_cnt3, tailed_tri_cnt2, diamond_cnt, cycle_cnt, clique_cnt)
+    {
+        // intersect_simd4x may store a few elements past the result
+        int *common = new int[capacity + 16];
+        int *wedge_cnt = new int[v_cnt];
+        memset(wedge_cnt, 0, sizeof(int) * v_cnt);
+        std::vector<v_index_t> touched;
+#pragma omp for schedule(dynamic)
+        for (v_index_t u = 0; u < v_cnt; ++u) {
+            long long du = vertex[u + 1] - vertex[u];
+            star_cnt += du * (du - 1) * (du - 2) / 6;
+            for (e_index_t i = out_vertex[u]; i < out_vertex[u + 1]; ++i) {
+                v_index_t v = out_edge[i];
+                long long dv = vertex[v + 1] - vertex[v];
+                long long t = intersect_simd4x_count(
+                    &edge[vertex[u]], du, &edge[vertex[v]], dv);
+                path_cnt += (du - 1) * (dv - 1);
+                tri_cnt3 += t;
+                tailed_tri_cnt2 += t * (du + dv - 4);
+                diamond_cnt += t * (t - 1) / 2;
+
+                // every 4-clique u < v < w < x is found once from its lowest edge
+                int common_size = intersect_simd4x(
+                    &out_edge[out_vertex[u]], out_vertex[u + 1] - out_vertex[u],
+                    &out_edge[out_vertex[v]], out_vertex[v + 1] - out_vertex[v],
+                    common);
+                for (int j = 0; j < common_size; ++j) {
+                    v_index_t w = common[j];
+                    clique_cnt += intersect_simd4x_count(
+                        common, common_size, &out_edge[out_vertex[w]],
+                        out_vertex[w + 1] - out_vertex[w]);
+                }
+            }
+
+            // every 4-cycle is found once from its highest vertex u: the
+            // wedges u - v - w with v, w lower than u, paired by w
+            for (e_index_t i = vertex[u]; i < vertex[u + 1]; ++i) {
+                v_index_t v = edge[i];
+                if (!is_oriented(v, u))
+                    continue;
+                for (e_index_t j = vertex[v]; j < vertex[v + 1]; ++j) {
+                    v_index_t w = edge[j];
+                    if (!is_oriented(w, u))
+                        continue;
+                    if (wedge_cnt[w] == 0)
+                        touched.push_back(w);
+                    cycle_cnt += wedge_cnt[w]++;
+                }
+            }
+            for (v_index_t w : touched)
+                wedge_cnt[w] = 0;
+            touched.clear();
+        }
+        delete[] common;
+        delete[] wedge_cnt;
+    }
+    delete[] out_vertex;
+    delete[] out_edge;
+
+    long long tri_cnt = tri_cnt3 / 3;
+    path_cnt -= 3 * tri_cnt;
+    long long tailed_tri_cnt = tailed_tri_cnt2 / 2;
+
+    std::vector<Pattern> motifs = MotifGenerator(4).generate();
+    std::vector<long long> motif_ans(motifs.size());
+    for (int i = 0; i < (int)motifs.size(); ++i) {
+        const int *adj_mat = motifs[i].get_adj_mat_ptr();
+        int edge_num = 0, max_degree = 0;
+        for (int u = 0; u < 4; ++u) {
+            int degree = 0;
+            for (int v = 0; v < 4; ++v)
+                degree += adj_mat[INDEX(u, v, 4)];
+            edge_num += degree;
+            max_degree = std::max(max_degree, degree);
+        }
+        edge_num /= 2;
+        if (edge_num == 3)
+            motif_ans[i] = max_degree == 3 ? star_cnt : path_cnt;
+        else if (edge_num == 4)
+            motif_ans[i] = max_degree == 2 ? cycle_cnt : tailed_tri_cnt;
+        else
+            motif_ans[i] = edge_num == 5 ? diamond_cnt : clique_cnt;
+    }
+    if (vertex_induced)
+        MotifGenerator::to_vertex_induced(
+            motifs, MotifGenerator::get_containment_matrix(motifs),
+            motif_ans.data(), motif_ans.data());
+
+    auto t2 = std::chrono::system_clock::now();
+    double time =
+        std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count() *
+        1e-6;
+
+    for (int i = 0; i < (int)motifs.size(); ++i) {
+        printf("pattern = \n");
+        motifs[i].print();
+        printf("ans: %lld\n", motif_ans[i]);
+        if (ans != nullptr)
+            ans[i] = motif_ans[i];
+    }
+    printf("triangle: %lld time:%.6lf\n", tri_cnt, time);
+}
+
+int *Graph::edge_support() {
+    e_index_t *out_vertex;
+    v_index_t *out_edge;
+    build_oriented_csr(out_vertex, out_edge);
+    int *out_support = new int[out_vertex[v_cnt]];
+    memset(out_support, 0, sizeof(int) * out_vertex[v_cnt]);
+
+    int capacity = get_max_intersection_size();
+#pragma omp parallel
+    {
+        // intersect_simd4x may store a few elements past the result
+        int *common = new int[capacity + 16];
+#pragma omp for schedule(dynamic)
+        for (v_index_t u = 0; u < v_cnt; ++u) {
+            // every triangle u -> v -> w is found once, from its edge u -> v;
+            // common is sorted, so u -> w and v -> w are found by scanning
+            // out(u) and out(v) forward
+            for (e_index_t i = out_vertex[u]; i < out_vertex[u + 1]; ++i) {
+                v_index_t v = out_edge[i];
+                int common_size = intersect_simd4x(
+                    &out_edge[out_vertex[u]], out_vertex[u + 1] - out_vertex[u],
+                    &out_edge[out_vertex[v]], out_vertex[v + 1] - out_vertex[v],
+                    common);
+                if (common_size == 0)
+                    continue;
+                __atomic_fetch_add(&out_support[i], common_size,
+                                   __ATOMIC_RELAXED);
+                e_index_t h = out_vertex[u], j = out_vertex[v];
+                for (int k = 0; k < common_size; ++k) {
+                    v_index_t w = common[k];
+                    while (out_edge[h] != w)
+                        ++h;
+                    while (out_edge[j] != w)
+                        ++j;
+                    __atomic_fetch_add(&out_support[h], 1, __ATOMIC_RELAXED);
+                    __atomic_fetch_add(&out_support[j], 1, __ATOMIC_RELAXED);
+                }
+            }
+        }
+        delete[] common;
+    }
+
+    // both directions of an edge get the support of its oriented copy
+    int *support = new int[e_cnt];
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (v_index_t u = 0; u < v_cnt; ++u) {
+        e_index_t j = out_vertex[u];
+        for (e_index_t i = vertex[u]; i < vertex[u + 1]; ++i) {
+            v_index_t v = edge[i];
+            if (j < out_vertex[u + 1] && out_edge[j] == v) {
+                support[i] = out_support[j++];
+            } else {
+                v_index_t *pos = std::lower_bound(&out_edge[out_vertex[v]],
+                                                  &out_edge[out_vertex[v + 1]], u);
+                support[i] = out_support[pos - out_edge];
+            }
+        }
+    }
+    delete[] out_vertex;
+    delete[] out_edge;
+    delete[] out_support;
+    return support;
+}
+
+int *Graph::truss_decomposition(const int *support) {
+    // reverse[i] is the position of the other direction of edge i, an edge is
+    // peeled at the position in the list of its lower endpoint
+    e_index_t *reverse = new e_index_t[e_cnt];
+    e_index_t *cursor = new e_index_t[v_cnt];
+    for (v_index_t v = 0; v < v_cnt; ++v)
+        cursor[v] = vertex[v];
+    for (v_index_t u = 0; u < v_cnt; ++u)
+        for (e_index_t i = vertex[u]; i < vertex[u + 1]; ++i)
+            reverse[i] = cursor[edge[i]]++;
+    delete[] cursor;
+    std::vector<e_index_t> edges;
+    for (v_index_t u = 0; u < v_cnt; ++u)
+        for (e_index_t i = vertex[u]; i < vertex[u + 1]; ++i)
+            if (u < edge[i])
+                edges.push_back(i);
+    e_index_t edge_num = edges.size();
+
+    int *sup;
+    if (support == nullptr) {
+        sup = edge_support();
+    } else {
+        sup = new int[e_cnt];
+        memcpy(sup, support, sizeof(int) * e_cnt);
+    }
+    int *truss = new int[e_cnt];
+    // 0: remaining, 1: in the current frontier, 2: peeled
+    char *state = new char[e_cnt];
+    memset(state, 0, sizeof(char) * e_cnt);
+    auto lower_position = [&](v_index_t u, v_index_t v, e_index_t i) {
+        return u < v ? i : reverse[i];
+    };
+
+    // bucket[s] holds remaining edges whose support was s when they were
+    // queued; an edge is queued again once its support drops, at the end of
+    // the round, so the stale entries are skipped
+    int max_sup = 0;
+    for (e_index_t k = 0; k < edge_num; ++k)
+        max_sup = std::max(max_sup, sup[edges[k]]);
+    std::vector<std::vector<e_index_t>> bucket(max_sup + 1);
+    for (e_index_t k = 0; k < edge_num; ++k)
+        bucket[sup[edges[k]]].push_back(edges[k]);
+    // 1 if the support of a remaining edge dropped in the current round
+    char *moved = new char[e_cnt];
+    memset(moved, 0, sizeof(char) * e_cnt);
+
+    std::vector<e_index_t> curr, next, requeue;
+    e_index_t remaining = edge_num;
+    for (int level = 0; remaining > 0; ++level) {
+        curr.clear();
+        for (e_index_t e : bucket[level])
+            if (state[e] == 0 && sup[e] == level) {
+                state[e] = 1;
+                curr.push_back(e);
+            }
+        std::vector<e_index_t>().swap(bucket[level]);
+
+        // peel the edges of support level, and those that drop to it
+        while (!curr.empty()) {
+            remaining -= curr.size();
+            for (e_index_t e : curr)
+                state[e] = 1;
+#pragma omp parallel
+            {
+                std::vector<e_index_t> local_next, local_requeue;
+                // the support of a remaining edge never drops below level
+                auto decrease = [&](e_index_t e) {
+                    if (__atomic_load_n(&sup[e], __ATOMIC_RELAXED) <= level)
+                        return;
+                    int s = __atomic_sub_fetch(&sup[e], 1, __ATOMIC_RELAXED);
+                    if (s == level)
+                        local_next.push_back(e);
+                    else if (s < level)
+                        __atomic_fetch_add(&sup[e], 1, __ATOMIC_RELAXED);
+                    else if (__atomic_exchange_n(&moved[e], 1, __ATOMIC_RELAXED) == 0)
+                        local_requeue.push_back(e);
+                };
+#pragma omp for schedule(dynamic, 64)
+                for (size_t k = 0; k < curr.size(); ++k) {
+                    e_index_t e = curr[k];
+                    v_index_t v = edge[e], u = edge[reverse[e]];
+                    e_index_t i = vertex[u], j = vertex[v];
+                    while (i < vertex[u + 1] && j < vertex[v + 1]) {
+                        if (edge[i] < edge[j]) {
+                            ++i;
+                        } else if (edge[i] > edge[j]) {
+                            ++j;
+                        } else {
+                            v_index_t w = edge[i];
+                            e_index_t e1 = lower_position(u, w, i);
+                            e_index_t e2 = lower_position(v, w, j);
+                            ++i;
+                            ++j;
+                            if (state[e1] == 2 || state[e2] == 2)
+                                continue;
+                            // a triangle with two edges in the frontier only
+                            // loses its third edge once, from the lower one
+                            if (state[e1] == 0 && state[e2] == 0) {
+                                decrease(e1);
+                                decrease(e2);
+                            } else if (state[e1] == 0) {
+                                if (e < e2)
+                                    decrease(e1);
+                            } else if (state[e2] == 0) {
+                                if (e < e1)
+                                    decrease(e2);
+                            }
+                        }
+                    }
+                }
+#pragma omp critical
+                {
+                    next.insert(next.end(), local_next.begin(), local_next.end());
+                    requeue.insert(requeue.end(), local_requeue.begin(), local_requeue.end());
+                }
+#pragma omp for
+                for (size_t k = 0; k < curr.size(); ++k) {
+                    state[curr[k]] = 2;
+                    truss[curr[k]] = truss[reverse[curr[k]]] = level + 2;
+                }
+            }
+            // those that dropped to level are in the next frontier instead
+            for (e_index_t e : requeue) {
+                moved[e] = 0;
+                if (sup[e] > level)
+                    bucket[sup[e]].push_back(e);
+            }
+            requeue.clear();
+            curr.swap(next);
+            next.clear();
+        }
+    }
+
+    delete[] reverse;
+    delete[] sup;
+    delete[] state;
+    delete[] moved;
+    return truss;
+}
+
+Graph *Graph::truss_subgraph(int k, const int *truss) {
+    const int *edge_truss = truss != nullptr ? truss : truss_decomposition();
+    Graph *g = new Graph();
+    g->v_cnt = v_cnt;
+    g->vertex = new e_index_t[v_cnt + 1];
+    g->vertex[0] = 0;
+    for (v_index_t u = 0; u < v_cnt; ++u) {
+        e_index_t degree = 0;
+        for (e_index_t i = vertex[u]; i < vertex[u + 1]; ++i)
+            degree += edge_truss[i] >= k;
+        g->vertex[u + 1] = g->vertex[u] + degree;
+    }
+    g->e_cnt = g->vertex[v_cnt];
+    g->edge = new v_index_t[g->e_cnt];
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (v_index_t u = 0; u < v_cnt; ++u) {
+        e_index_t pos = g->vertex[u];
+        for (e_index_t i = vertex[u]; i < vertex[u + 1]; ++i)
+            if (edge_truss[i] >= k)
+                g->edge[pos++] = edge[i];
+    }
+    g->tri_cnt = g->triangle_counting_mt();
+    g->max_running_time = max_running_time;
+    if (truss == nullptr)
+        delete[] edge_truss;
+    return g;
+}
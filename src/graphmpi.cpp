@@ -4,27 +4,44 @@
 #include <cstring>
 #include <omp.h>
 #include <cstdio>
+#include <cstdlib>
+#include <mutex>
 
-int Graphmpi::data[][Graphmpi::MAXN] = {}, Graphmpi::qrynode[] = {}, Graphmpi::qrydest[] = {}, Graphmpi::length[] = {};
+static std::mutex run_lock;
+static bool mpi_thread_multiple;
 
-Graphmpi& Graphmpi::getinstance() {
-    static Graphmpi gm;
-    return gm;
+static void finalize_mpi() {
+    MPI_Finalize();
+}
+
+static void init_mpi() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        int initialized, provided;
+        MPI_Initialized(&initialized);
+        if (initialized)
+            MPI_Query_thread(&provided);
+        else {
+            MPI_Init_thread(NULL, NULL, MPI_THREAD_MULTIPLE, &provided);
+            atexit(finalize_mpi);
+        }
+        mpi_thread_multiple = provided >= MPI_THREAD_MULTIPLE;
+    });
 }
 
-std::pair<int, int> Graphmpi::init(int _threadcnt, Graph* _graph) {
+Graphmpi::Graphmpi(int _threadcnt, Graph* _graph) {
     threadcnt = _threadcnt;
     graph = _graph;
-    int provided;
-    MPI_Init_thread(NULL, NULL, MPI_THREAD_FUNNELED, &provided);
-    MPI_Comm_size(MPI_COMM_WORLD, &comm_sz);
-    MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
-    MPI_Barrier(MPI_COMM_WORLD);
+    init_mpi();
+    serialized = !mpi_thread_multiple;
+    if (serialized)
+        run_lock.lock();
+    MPI_Comm_dup(MPI_COMM_WORLD, &comm);
+    MPI_Comm_size(comm, &comm_sz);
+    MPI_Comm_rank(comm, &my_rank);
+    MPI_Barrier(comm);
     starttime = get_wall_time();
     blocksize = (graph->v_cnt + comm_sz - 1) / comm_sz;
-    int k = comm_sz - my_rank - 1;
-    /*global_vertex = mynodel = blocksize * k;
-    mynoder = k < comm_sz - 1 ? blocksize * (k + 1) : graph->v_cnt;*/
     if (my_rank) {
         global_vertex = mynodel = mynoder = 0;
     }
@@ -33,18 +50,43 @@ std::pair<int, int> Graphmpi::init(int _threadcnt, Graph* _graph) {
         mynoder = graph->v_cnt;
     }
     idlethreadcnt = 0;
-    for (int i = 0; i < MAXTHREAD; i++) lock[i].test_and_set();
+    data = new int*[threadcnt];
+    qrynode = new int[threadcnt];
+    qrydest = new int[threadcnt];
+    length = new int[threadcnt];
+    vertex = new int[threadcnt];
+    lock = new std::atomic_flag[threadcnt];
+    for (int i = 0; i < threadcnt; i++) {
+        data[i] = nullptr;
+        lock[i].test_and_set();
+    }
     global_vertex_lock.clear();
-    return std::make_pair(mynodel, mynoder);
+}
+
+Graphmpi::~Graphmpi() {
+    // every process is done with the messages of the run
+    MPI_Barrier(comm);
+    MPI_Comm_free(&comm);
+    if (serialized)
+        run_lock.unlock();
+    for (int i = 0; i < threadcnt; i++)
+        delete[] data[i];
+    delete[] data;
+    delete[] qrynode;
+    delete[] qrydest;
+    delete[] length;
+    delete[] vertex;
+    delete[] lock;
 }
 
 long long Graphmpi::runmajor() {
     long long tot_ans = 0;
     const int /*REQ = 0, ANS = 1, */IDLE = 2, END = 3, OVERWORK = 4, REPORT = 5, SERVER = 0;
-    static int recv[MAXN * MAXTHREAD], send[MAXN * MAXTHREAD];
+    // the messages are an opcode and at most two ints
+    int *recv = recv_buf, *send = send_buf;
     MPI_Request sendrqst, recvrqst;
     MPI_Status status;
-    MPI_Irecv(recv, sizeof(recv), MPI_INT, MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &recvrqst);
+    MPI_Irecv(recv, message_len, MPI_INT, MPI_ANY_SOURCE, 0, comm, &recvrqst);
     int idlenodecnt = 0;
     std::queue<int> workq;
     for (;;) {
@@ -59,7 +101,8 @@ long long Graphmpi::runmajor() {
                 //MPI_Wait(&sendrqst, &status);
                 send[0] = ANS;
                 memcpy(send + 1, graph->edge + l, sizeof(graph->edge[0]) * (r - l));
-                MPI_Isend(send, r - l + 1, MPI_INT, status.MPI_SOURCE, 0, MPI_COMM_WORLD, &sendrqst);
+                MPI_Isend(send, r - l + 1, MPI_INT, status.MPI_SOURCE, 0, comm, &sendrqst);
+                MPI_Request_free(&sendrqst);
             }
             else if (recv[0] == ANS) {
                 int node;
@@ -82,7 +125,8 @@ long long Graphmpi::runmajor() {
                 global_vertex_lock.clear();
                 send[0] = OVERWORK;
                 send[1] = overworkflag ? tmpvertex : -1;
-                MPI_Isend(send, 3, MPI_INT, status.MPI_SOURCE, 0, MPI_COMM_WORLD, &sendrqst);
+                MPI_Isend(send, 3, MPI_INT, status.MPI_SOURCE, 0, comm, &sendrqst);
+                MPI_Request_free(&sendrqst);
             }
             else if (recv[0] == END) {
                 tot_ans = (((long long)(recv[1]) << 32) | (unsigned)recv[2]);
@@ -101,7 +145,7 @@ long long Graphmpi::runmajor() {
                 tot_ans += (((long long)(recv[1]) << 32) | (unsigned)recv[2]);
                 idlenodecnt++;
             }
-            MPI_Irecv(recv, sizeof(recv), MPI_INT, MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &recvrqst);
+            MPI_Irecv(recv, message_len, MPI_INT, MPI_ANY_SOURCE, 0, comm, &recvrqst);
         }
         /*if (!waitforans && !requestq.empty()) {
             int node;
@@ -112,7 +156,8 @@ long long Graphmpi::runmajor() {
             //MPI_Wait(&sendrqst, &status);
             send[0] = REQ;
             send[1] = qrynode[node];
-            MPI_Isend(send, 2, MPI_INT, qrydest[node], SERVER, MPI_COMM_WORLD, &sendrqst);
+            MPI_Isend(send, 2, MPI_INT, qrydest[node], SERVER, comm, &sendrqst);
+            MPI_Request_free(&sendrqst);
             waitforans = true;
         }*/
         bool idleflag;
@@ -128,7 +173,8 @@ long long Graphmpi::runmajor() {
         if (idleflag) {
             workq.push(tmpthread);
             send[0] = IDLE;
-            MPI_Isend(send, 1, MPI_INT, 0, SERVER, MPI_COMM_WORLD, &sendrqst);
+            MPI_Isend(send, 1, MPI_INT, 0, SERVER, comm, &sendrqst);
+            MPI_Request_free(&sendrqst);
         }
         if (idlethreadcnt == threadcnt - 1) {
             idlethreadcnt = -1;
@@ -137,7 +183,8 @@ long long Graphmpi::runmajor() {
                 send[0] = REPORT;
                 send[1] = node_ans >> 32;
                 send[2] = node_ans;
-                MPI_Isend(send, 3, MPI_INT, 0, SERVER, MPI_COMM_WORLD, &sendrqst);
+                MPI_Isend(send, 3, MPI_INT, 0, SERVER, comm, &sendrqst);
+                MPI_Request_free(&sendrqst);
             }
             else {
                 idlenodecnt++;
@@ -150,16 +197,26 @@ long long Graphmpi::runmajor() {
                 send[0] = END;
                 send[1] = tot_ans >> 32;
                 send[2] = tot_ans;
-                MPI_Isend(send, 3, MPI_INT, i, SERVER, MPI_COMM_WORLD, &sendrqst);
+                MPI_Isend(send, 3, MPI_INT, i, SERVER, comm, &sendrqst);
+                MPI_Request_free(&sendrqst);
             }
             break;
         }
     }
+    // the receive posted last by the master process is never matched
+    int testflag = 0;
+    MPI_Test(&recvrqst, &testflag, MPI_STATUS_IGNORE);
+    if (!testflag) {
+        MPI_Cancel(&recvrqst);
+        MPI_Wait(&recvrqst, MPI_STATUS_IGNORE);
+    }
     return tot_ans;
 }
 
 int* Graphmpi::getneighbor(int u) {
     int thread_num = omp_get_thread_num();
+    if (data[thread_num] == nullptr)
+        data[thread_num] = new int[MAXN];
     qrynode[thread_num] = u;
     qrydest[thread_num] = comm_sz - 1 - (u / blocksize);
 #pragma omp critical
@@ -176,12 +233,6 @@ bool Graphmpi::include(int u) {
     return mynodel <= u && u < mynoder;
 }
 
-Graphmpi::Graphmpi() {}
-
-Graphmpi::~Graphmpi() {
-    MPI_Finalize();
-}
-
 std::pair<int, int> Graphmpi::get_vertex_range() {
     for (;global_vertex_lock.test_and_set(););
     bool returnflag = global_vertex < mynoder;
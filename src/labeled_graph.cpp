@@ -1,7 +1,9 @@
 #include "../include/labeled_graph.h"
+#include "../include/checkpoint.h"
 #include "../include/vertex_set.h"
 #include "../include/common.h"
 #include "../include/motif_generator.h"
+#include "../include/canonical_labeling.h"
 #include <cstdio>
 #include <sys/time.h>
 #include <unistd.h>
@@ -14,6 +16,8 @@
 #include <vector>
 #include <bitset>
 #include <set>
+#include <map>
+#include <string>
 
 int get_pattern_edge_num(const Pattern& p)
 {
@@ -45,48 +49,30 @@ int get_schedule_edge_num(const Schedule_IEP& p, int n = -1)
 bool cmp_pattern_by_edge_num(const Pattern& p1, const Pattern& p2) {
     int num1 = get_pattern_edge_num(p1);
     int num2 = get_pattern_edge_num(p2);
-    return (num1 <= num2);
+    return num1 < num2;
 }
 
-//只判断s的子图是否与s0同构，而不考虑s0自同构的问题，只找到一个同构的匹配方案就可以了；如果我们在找到一个frequent pattern后把它所有的pattern都设置成frequent，就可以不用考虑自同构，因为无论记录的是哪个自同构的映射，都是频繁的
-bool check_isomorphism_dfs(int schedule_id, const Schedule_IEP& s, const Schedule_IEP& s0, std::vector<int>& mappings_vec, int size, int depth, int* mapping, const int* connected_v = NULL) {
-    if (depth - 1 == s0.get_size()) {
-        mappings_vec.push_back(schedule_id);
-        if (connected_v == NULL)
-        {
-            for (int i = 0; i < s0.get_size(); ++i)
-                mappings_vec.push_back(mapping[i]);
-            for (int i = s0.get_size(); i < size; ++i)
-                mappings_vec.push_back(-1);
-        } else {
-            for (int i = 0; i < s0.get_size(); ++i)
-                mappings_vec.push_back(connected_v[mapping[i]]);
-            for (int i = s0.get_size(); i < size; ++i)
-                mappings_vec.push_back(-1);
-        }
-        return true;
-    }
-    const int* s_adj = s.get_adj_mat_ptr();
-    const int* s0_adj = s0.get_adj_mat_ptr();
-    for (int i = 0; i < s0.get_size(); ++i) { //将s0的第depth - 1个点映射为s的第i个点
-        bool flag = true;
-        for (int j = 0; j < depth - 1; ++j)
-            if (mapping[j] == i || s_adj[mapping[j] * s.get_size() + i] != s0_adj[j * s0.get_size() + depth - 1]) {
-                flag = false;
-                break;
-            }
-        if (flag) {
-            mapping[depth - 1] = i;
-            if (check_isomorphism_dfs(schedule_id, s, s0,mappings_vec, size, depth + 1, mapping, connected_v))
-                return true;
-        }
-    }
-    return false;
-}
-
-bool check_isomorphism(int schedule_id, const Schedule_IEP& s, const Schedule_IEP& s0, std::vector<int>& mappings_vec, int size, const int* connected_v = NULL) {
-    int mapping[8]; //默认最大8个点，TODO：不要用magic number
-    return check_isomorphism_dfs(schedule_id, s, s0, mappings_vec, size, 1, mapping, connected_v); //搜索全排列
+// Finds the schedule among schedules[0, s_id) isomorphic to the graph adj of
+// n vertices by its canonical form, and records the mapping of the vertices of
+// that schedule to the vertices of adj (or to connected_v of them). Any
+// isomorphism will do: once a frequent pattern is found, all of its
+// automorphic labelings are marked frequent.
+bool find_isomorphic_schedule(const int* adj, int n, const std::map<std::string, std::pair<int, std::vector<int> > >& schedule_forms, int s_id, std::vector<int>& mappings_vec, int size, const int* connected_v = NULL) {
+    CanonicalLabeling labeling(adj, n);
+    auto it = schedule_forms.find(labeling.get_code());
+    if (it == schedule_forms.end() || it->second.first >= s_id)
+        return false;
+    const std::vector<int>& order0 = it->second.second;
+    const std::vector<int>& order = labeling.get_order();
+    std::vector<int> mapping(n);
+    for (int i = 0; i < n; ++i)
+        mapping[order0[i]] = order[i];
+    mappings_vec.push_back(it->second.first);
+    for (int i = 0; i < n; ++i)
+        mappings_vec.push_back(connected_v == NULL ? mapping[i] : connected_v[mapping[i]]);
+    for (int i = n; i < size; ++i)
+        mappings_vec.push_back(-1);
+    return true;
 }
 
 int get_connected_v(int* connected_v, const int* adj, int size) { //使用bfs，找到去掉一条边后仍与最后一个点连通的所有点，返回连通点数
@@ -109,21 +95,17 @@ int get_connected_v(int* connected_v, const int* adj, int size) { //使用bfs，
 }
 
 //找到s的所有两种子图：1、前depth个点组成的极大子图（depth < s.size）; 2、包含最后一个点且比s少一条边的子图
-void generate_mapping_plans(const Schedule_IEP& s, const Schedule_IEP* schedules, std::vector<int>& mappings_vec, int* mapping_start_idx, int& mapping_start_idx_pos, int s_id) {
+void generate_mapping_plans(const Schedule_IEP& s, const std::map<std::string, std::pair<int, std::vector<int> > >& schedule_forms, std::vector<int>& mappings_vec, int* mapping_start_idx, int& mapping_start_idx_pos, int s_id) {
+    int* prefix_adj = new int[s.get_size() * s.get_size()];
     for (int depth = 1; depth < s.get_size(); ++depth) {
         mapping_start_idx[mapping_start_idx_pos++] = mappings_vec.size();
-        int edge_num = get_schedule_edge_num(s, depth);
-        for (int s0_id = 0; s0_id < s_id; ++s0_id) { //已经按照边数排好序了，所以s的子图一定只在s_id之前
-            const Schedule_IEP& s0 = schedules[s0_id];
-            int edge_num0 = get_schedule_edge_num(s0);
-            if (edge_num0 > edge_num)
-                break;
-            if (edge_num0 != edge_num || s0.get_size() != depth) //当depth < s.size时，只找前depth个点组成的极大子图
-                continue;
-            if (check_isomorphism(s0_id, s, s0, mappings_vec, s.get_size())) //找到同构，则找下一层（depth+1），否则继续找是否有同构的schedules
-                break;
-        }
+        //当depth < s.size时，只找前depth个点组成的极大子图；已经按照边数排好序了，所以s的子图一定只在s_id之前
+        for (int i = 0; i < depth; ++i)
+            for (int j = 0; j < depth; ++j)
+                prefix_adj[i * depth + j] = s.get_adj_mat_ptr()[i * s.get_size() + j];
+        find_isomorphic_schedule(prefix_adj, depth, schedule_forms, s_id, mappings_vec, s.get_size());
     }
+    delete[] prefix_adj;
     //depth == s.size
     mapping_start_idx[mapping_start_idx_pos++] = mappings_vec.size();
     int* degree = new int[s.get_size()];
@@ -155,18 +137,7 @@ void generate_mapping_plans(const Schedule_IEP& s, const Schedule_IEP* schedules
                 tmp_adj[i * s.get_size() + j] = tmp_adj[j * s.get_size() + i] = 1;
                 if (edge_num != s_edge_num - 1) // 只需要查找比s少一条边的子图即可（因为少更多条边的子图一定是某个少一条边的子图的子图）
                     continue;
-                Schedule_IEP sub_s(sub_adj, connected_v_num); // TODO：其实这里不需要用schedule，只用pattern就可以了，schedule初始化还要做一些额外操作如IEP，浪费时间
-                //edge_num = get_schedule_edge_num(sub_s); //应该edge_num不变，所以这句话删了
-                for (int s0_id = 0; s0_id < s_id; ++s0_id) {
-                    const Schedule_IEP& s0 = schedules[s0_id];
-                    int edge_num0 = get_schedule_edge_num(s0);
-                    if (edge_num0 > edge_num)
-                        break;
-                    if (edge_num0 != edge_num || s0.get_size() != sub_s.get_size())
-                        continue;
-                    if (check_isomorphism(s0_id, sub_s, s0, mappings_vec, s.get_size(), connected_v))
-                        break;
-                }
+                find_isomorphic_schedule(sub_adj, connected_v_num, schedule_forms, s_id, mappings_vec, s.get_size(), connected_v);
             }
     
     delete[] degree;
@@ -181,14 +152,11 @@ std::vector<Pattern> generate_fsm_patterns(int max_edge) {
     res.push_back(Pattern(1));
 
     for (int i = 2; i <= max_edge + 1; ++i) {
-        MotifGenerator mg(i);
+        MotifGenerator mg(i, 0, max_edge);
         std::vector<Pattern> tmp = mg.generate();
-        for (const auto& p : tmp) {
-            if (get_pattern_edge_num(p) <= max_edge)
-                res.push_back(p);
-        }
+        res.insert(res.end(), tmp.begin(), tmp.end());
     }
-    std::sort(res.begin(), res.end(), cmp_pattern_by_edge_num);
+    std::stable_sort(res.begin(), res.end(), cmp_pattern_by_edge_num);
     return res;
 }
 
@@ -435,19 +403,20 @@ void LabeledGraph::traverse_all_labeled_patterns(const Schedule_IEP* schedules,
 void LabeledGraph::get_fsm_necessary_info(std::vector<Pattern>& patterns, int max_edge, Schedule_IEP*& schedules, int& schedules_num, int*& mapping_start_idx, int*& mappings, unsigned int*& pattern_is_frequent_index, unsigned int*& is_frequent) const {
     patterns = generate_fsm_patterns(max_edge);
     schedules = (Schedule_IEP*) malloc(sizeof(Schedule_IEP) * patterns.size());
-    for (size_t i = 0; i < patterns.size(); ++i) {
-        // printf("begin generate schedule %d\n", i);
-        // fflush(stdout);
+    double planning_start = get_wall_time();
+    int pattern_num = patterns.size();
+#pragma omp parallel for schedule(dynamic) if (pattern_num >= omp_get_max_threads())
+    for (int i = 0; i < pattern_num; ++i) {
         const Pattern& p = patterns[i];
         bool is_pattern_valid;
-        // printf("before generate schedule %d\n", i);
         // printf("v_cnt: %d e_cnt: %d tri_cnt: %lld\n", this->v_cnt, this->e_cnt, this->tri_cnt);
         // p.print();
-        // fflush(stdout);
         new (&schedules[i]) Schedule_IEP(p, is_pattern_valid, 1, 1, 1, this->v_cnt, this->e_cnt, this->tri_cnt);
-        schedules[i].print_schedule();
-        // fflush(stdout);
     }
+    double planning_time = get_wall_time() - planning_start;
+    for (int i = 0; i < pattern_num; ++i)
+        schedules[i].print_schedule();
+    printf("Planning time cost: %.6lf s\n", planning_time);
     // printf("after generate schedules\n");
     // fflush(stdout);
 
@@ -458,11 +427,16 @@ void LabeledGraph::get_fsm_necessary_info(std::vector<Pattern>& patterns, int ma
     mappings_vec.clear();
     mapping_start_idx = new int[patterns.size() * schedules[patterns.size() - 1].get_size() + 1]; //每个schedule的每个点都有一个index，这只是估了一个上界，+1是因为第一位存放对应子图ID
     mapping_start_idx[0] = 0;
+    std::map<std::string, std::pair<int, std::vector<int> > > schedule_forms;
+    for (int i = 0; i < pattern_num; ++i) {
+        CanonicalLabeling labeling(schedules[i].get_adj_mat_ptr(), schedules[i].get_size());
+        schedule_forms.insert(std::make_pair(labeling.get_code(), std::make_pair(i, labeling.get_order())));
+    }
     // Check whether the j-th pattern is a subgraph of the i-th pattern.
     int mapping_start_idx_pos = 1;
     for (size_t i = 1; i < patterns.size(); ++i) {
         const Schedule_IEP& s = schedules[i];
-        generate_mapping_plans(s, schedules, mappings_vec, mapping_start_idx, mapping_start_idx_pos, i);
+        generate_mapping_plans(s, schedule_forms, mappings_vec, mapping_start_idx, mapping_start_idx_pos, i);
     }
     mapping_start_idx[mapping_start_idx_pos] = mappings_vec.size();
 
@@ -537,7 +511,7 @@ void LabeledGraph::get_fsm_necessary_info(std::vector<Pattern>& patterns, int ma
     memset(is_frequent, 0, sizeof(unsigned int) * ((index + 31) / 32 * 10));
 }
 
-int LabeledGraph::fsm(int max_edge, long long min_support, double *time_out) {
+int LabeledGraph::fsm(int max_edge, long long min_support, double *time_out, Checkpoint* checkpoint) {
     std::vector<Pattern> patterns;
     Schedule_IEP* schedules;
     int schedules_num;
@@ -565,7 +539,23 @@ int LabeledGraph::fsm(int max_edge, long long min_support, double *time_out) {
         global_fsm_cnt = 0;
     int mapping_start_idx_pos = 1;
 
+    // a stage is an unlabeled pattern, a unit is a job (labeling) of it
+    size_t is_frequent_len = (pattern_is_frequent_index[patterns.size()] + 31) / 32 * 10;
+    int restored_stage = 1;
+    if (checkpoint != nullptr) {
+        std::string key = "fsm " + std::to_string(v_cnt) + " " + std::to_string(e_cnt) + " " + std::to_string(l_cnt) + " " + std::to_string(max_edge) + " " + std::to_string(min_support);
+        if (checkpoint->restore(key) && checkpoint->get_restored_bits(is_frequent, is_frequent_len)) {
+            restored_stage = checkpoint->get_restored_stage();
+            global_fsm_cnt = checkpoint->get_restored_base();
+        }
+        checkpoint->set_bits(is_frequent, is_frequent_len);
+    }
+
     for (int i = 1; i < schedules_num; ++i) {
+        if (i < restored_stage) {
+            mapping_start_idx_pos += schedules[i].get_size();
+            continue;
+        }
         std::vector<std::vector<int> > automorphisms;
         automorphisms.clear();
         schedules[i].GraphZero_get_automorphisms(automorphisms);
@@ -574,11 +564,17 @@ int LabeledGraph::fsm(int max_edge, long long min_support, double *time_out) {
         size_t all_p_label_idx = 0;
         traverse_all_labeled_patterns(schedules, all_p_label, tmp_p_label, mapping_start_idx, mappings, pattern_is_frequent_index, is_frequent, i, 0, mapping_start_idx_pos, all_p_label_idx);
         size_t job_num = all_p_label_idx / schedules[i].get_size();
-        global_fsm_cnt += fsm_pattern_matching(0, job_num, schedules[i], all_p_label, automorphisms, is_frequent, pattern_is_frequent_index[i], max_edge, min_support);
+        if (checkpoint != nullptr)
+            global_fsm_cnt += checkpoint->begin_stage(i, global_fsm_cnt, job_num);
+        global_fsm_cnt += fsm_pattern_matching(0, job_num, schedules[i], all_p_label, automorphisms, is_frequent, pattern_is_frequent_index[i], max_edge, min_support, checkpoint);
 
         mapping_start_idx_pos += schedules[i].get_size();
         if (get_pattern_edge_num(patterns[i]) != max_edge) //为了使得边数小于max_edge的pattern不被统计。正确性依赖于pattern按照边数排序
             global_fsm_cnt = 0;
+        if (checkpoint != nullptr) {
+            checkpoint->begin_stage(i + 1, global_fsm_cnt, 0);
+            checkpoint->save();
+        }
         gettimeofday(&end, NULL);
         timersub(&end, &start, &total_time);
         printf("time = %ld.%06ld s.\n", total_time.tv_sec, total_time.tv_usec);
@@ -594,6 +590,8 @@ int LabeledGraph::fsm(int max_edge, long long min_support, double *time_out) {
     fsm_cnt = global_fsm_cnt;
     printf("fsm_cnt = %d\n", fsm_cnt);
 
+    if (checkpoint != nullptr)
+        checkpoint->set_bits(nullptr, 0);
     free(schedules);
     delete[] mapping_start_idx;
     delete[] mappings;
@@ -605,7 +603,7 @@ int LabeledGraph::fsm(int max_edge, long long min_support, double *time_out) {
     return fsm_cnt;
 }
 
-int LabeledGraph::fsm_pattern_matching(int job_start, int job_end, const Schedule_IEP &schedule, const char *all_p_label, std::vector<std::vector<int> > &automorphisms, unsigned int* is_frequent, unsigned int& pattern_is_frequent_index, int max_edge, int min_support) const {
+int LabeledGraph::fsm_pattern_matching(int job_start, int job_end, const Schedule_IEP &schedule, const char *all_p_label, std::vector<std::vector<int> > &automorphisms, unsigned int* is_frequent, unsigned int& pattern_is_frequent_index, int max_edge, int min_support, Checkpoint* checkpoint) const {
     long long fsm_cnt = 0;
     #pragma omp parallel reduction(+: fsm_cnt)
     {
@@ -621,6 +619,8 @@ int LabeledGraph::fsm_pattern_matching(int job_start, int job_end, const Schedul
         char* p_label = new char[max_edge + 1];
         #pragma omp for schedule(dynamic) nowait
         for (size_t job_id = job_start; job_id < job_end; ++job_id) {
+            if (checkpoint != nullptr && checkpoint->is_finished(job_id))
+                continue;
             size_t job_start_idx = job_id * schedule.get_size();
             for (int j = 0; j < schedule.get_size(); ++j)
                 p_label[j] = all_p_label[job_start_idx + j];
@@ -658,6 +658,9 @@ int LabeledGraph::fsm_pattern_matching(int job_start, int job_end, const Schedul
                     }
                 }
             }
+            // after is_frequent, so a saved finished job always has its bits
+            if (checkpoint != nullptr)
+                checkpoint->finish(job_id, support >= min_support ? 1 : 0);
             // if(job_id % 100 == 0) {
                 // #pragma omp critical
                 // {
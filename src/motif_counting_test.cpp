@@ -7,6 +7,7 @@
 #include "omp.h"
 
 #include <assert.h>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <algorithm>
@@ -15,10 +16,22 @@ int main(int argc,char *argv[]) {
     Graph *g;
     DataLoader D;
 
-    if(argc != 3) {
-        printf("usage: %s graph_file pattern_size\n", argv[0]);
+    // --motif-cache dir may come anywhere after the program name
+    const char* motif_cache_dir = nullptr;
+    for (int i = 1; i + 1 < argc; ++i)
+        if (strcmp(argv[i], "--motif-cache") == 0) {
+            motif_cache_dir = argv[i + 1];
+            for (int j = i; j + 2 <= argc; ++j)
+                argv[j] = argv[j + 2];
+            argc -= 2;
+            break;
+        }
+
+    if((argc != 3 && argc != 4) || (argc == 4 && strcmp(argv[3], "induced") != 0)) {
+        printf("usage: %s graph_file pattern_size [induced] [--motif-cache dir]\n", argv[0]);
         return 0;
     }
+    bool vertex_induced = argc == 4;
     
     bool ok = D.fast_load(g, argv[1]);
     if(!ok) { printf("Load data failed\n"); return 0; }
@@ -29,10 +42,16 @@ int main(int argc,char *argv[]) {
 
     printf("thread num: %d\n", omp_get_max_threads());
 
+    // the hand optimized kernels do not generate the motifs
+    if((size == 3 || size == 4) && motif_cache_dir != nullptr)
+        printf("--motif-cache is not used for pattern size %d\n", size);
+
     if(size == 3)
-        g->motif_counting_3();
+        g->motif_counting_3(vertex_induced);
+    else if(size == 4)
+        g->motif_counting_4(nullptr, vertex_induced);
     else
-        g->motif_counting(size);
+        g->motif_counting(size, vertex_induced, motif_cache_dir);
     delete g;
     return 0;
 }
@@ -1,44 +1,381 @@
 #include "../include/motif_generator.h"
+#include "../include/canonical_labeling.h"
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <vector>
-#include <set>
 
-void MotifGenerator::generate_all_pattern(std::vector<Pattern>& vec, std::set<int> edge_set, Pattern& p, int depth, int i, int j)
+// edges of p with its vertex i renamed to perm[i], one bit per vertex pair
+static uint64_t get_edge_mask(const Pattern& p, const int* perm)
 {
-    if (i == size - 1)
-    {
-        // its isomorphism graph has not been generated and it's connected
-        if (s.count(edge_set) == 0 && p.check_connected())
-        {
-            vec.push_back(p);
-            p.count_all_isomorphism(s);
+    int size = p.get_size();
+    const int* adj_mat = p.get_adj_mat_ptr();
+    uint64_t mask = 0;
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < size; ++j)
+            if (adj_mat[INDEX(i, j, size)] && perm[i] < perm[j])
+                mask |= 1ULL << INDEX(perm[i], perm[j], size);
+    return mask;
+}
+
+static const char catalog_magic[] = "GMMOTIF1";
+
+static int get_edge_num(const std::vector<uint32_t>& g)
+{
+    int edge_num = 0;
+    for (uint32_t mask : g)
+        edge_num += __builtin_popcount(mask);
+    return edge_num / 2;
+}
+
+// whether g stays connected without v
+static bool is_non_cut_vertex(const std::vector<uint32_t>& g, int v)
+{
+    int n = g.size();
+    uint32_t rest = ((1U << n) - 1) & ~(1U << v);
+    if (rest == 0)
+        return true;
+    uint32_t reached = rest & -rest, frontier = reached;
+    while (frontier != 0) {
+        int u = __builtin_ctz(frontier);
+        frontier &= frontier - 1;
+        uint32_t next = g[u] & rest & ~reached;
+        reached |= next;
+        frontier |= next;
+    }
+    return reached == rest;
+}
+
+static std::vector<int> get_adj_mat(const std::vector<uint32_t>& g)
+{
+    int n = g.size();
+    std::vector<int> adj_mat(n * n, 0);
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+            adj_mat[INDEX(i, j, n)] = (g[i] >> j) & 1;
+    return adj_mat;
+}
+
+static int find_root(std::vector<int>& parent, int x)
+{
+    while (parent[x] != x)
+        x = parent[x] = parent[parent[x]];
+    return x;
+}
+
+// Schedules without performance modeling keep the order of the pattern, which
+// needs every prefix of it to be connected. The breadth-first order from vertex
+// 0, neighbors in increasing order, is one.
+static Pattern get_bfs_relabeled(const Pattern& p)
+{
+    int n = p.get_size();
+    const int* adj_mat = p.get_adj_mat_ptr();
+    std::vector<int> order(1, 0), id(n, -1);
+    id[0] = 0;
+    for (int k = 0; k < (int)order.size(); ++k)
+        for (int v = 0; v < n; ++v)
+            if (adj_mat[INDEX(order[k], v, n)] && id[v] == -1) {
+                id[v] = order.size();
+                order.push_back(v);
+            }
+    assert((int)order.size() == n);
+    Pattern relabeled(n);
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < i; ++j)
+            if (adj_mat[INDEX(i, j, n)])
+                relabeled.add_edge(id[i], id[j]);
+    return relabeled;
+}
+
+void MotifGenerator::augment(const NeighborMasks& g, std::vector<NeighborMasks>& children) const
+{
+    int n = g.size();
+    int edge_num = get_edge_num(g);
+    std::vector<int> adj_mat = get_adj_mat(g);
+    CanonicalLabeling labeling(adj_mat.data(), n);
+
+    // orbits of the neighbor sets of the new vertex, the smallest set of each
+    // orbit is its root
+    std::vector<int> parent(1 << n);
+    for (int s = 0; s < (1 << n); ++s)
+        parent[s] = s;
+    for (const auto& automorphism : labeling.get_generators())
+        for (int s = 1; s < (1 << n); ++s) {
+            int image = 0;
+            for (int v = 0; v < n; ++v)
+                if ((s >> v) & 1)
+                    image |= 1 << automorphism[v];
+            int a = find_root(parent, s), b = find_root(parent, image);
+            if (a != b)
+                parent[std::max(a, b)] = std::min(a, b);
         }
-        return;
-    }
-    //use edge(i,j)
-    edge_set.insert(i * size + j);
-    p.add_edge(i, j);
-    if (j == size - 1)
-        generate_all_pattern(vec, edge_set, p, depth + 1, i + 1, i + 2);
-    else
-        generate_all_pattern(vec, edge_set, p, depth + 1, i, j + 1);
-    p.del_edge(i, j);
-    edge_set.erase(i * size + j);
-    //not use edge(i,j)
-    if (j == size - 1)
-        generate_all_pattern(vec, edge_set, p, depth + 1, i + 1, i + 2);
-    else
-        generate_all_pattern(vec, edge_set, p, depth + 1, i, j + 1);
+
+    NeighborMasks child(n + 1);
+    std::vector<int> candidates;
+    for (int s = 1; s < (1 << n); ++s) {
+        int degree = __builtin_popcount(s);
+        if (find_root(parent, s) != s || (max_edge >= 0 && edge_num + degree > max_edge))
+            continue;
+        for (int v = 0; v < n; ++v)
+            child[v] = g[v] | (((uint32_t)s >> v & 1) << n);
+        child[n] = s;
+
+        // The canonical deletion vertex is the non-cut vertex of the smallest
+        // degree, ties broken by the last position in the canonical order. The
+        // new vertex is never a cut vertex, so the degree alone may decide.
+        candidates.clear();
+        bool rejected = false;
+        for (int v = 0; v < n && !rejected; ++v) {
+            int d = __builtin_popcount(child[v]);
+            if (d > degree || !is_non_cut_vertex(child, v))
+                continue;
+            if (d < degree)
+                rejected = true;
+            candidates.push_back(v);
+        }
+        if (rejected)
+            continue;
+        if (!candidates.empty()) {
+            std::vector<int> child_adj_mat = get_adj_mat(child);
+            CanonicalLabeling child_labeling(child_adj_mat.data(), n + 1);
+            const std::vector<int>& order = child_labeling.get_order();
+            candidates.push_back(n);
+            int last = -1;
+            for (int i = 0; i <= n; ++i)
+                if (std::find(candidates.begin(), candidates.end(), order[i]) != candidates.end())
+                    last = order[i];
+            const std::vector<int>& orbits = child_labeling.get_orbits();
+            if (orbits[last] != orbits[n])
+                continue;
+        }
+        children.push_back(child);
+    }
 }
 
 std::vector<Pattern> MotifGenerator::generate()
 {
-    s.clear();
-    std::set<int> edge_set;
-    edge_set.clear();
-
+    assert(size >= 1 && size <= 16);
     std::vector<Pattern> vec;
-    vec.clear();
-    Pattern p(size);
-    generate_all_pattern(vec, edge_set, p, 0, 0, 1);
+    if (load(vec))
+        return vec;
+
+    // every connected graph has a non-cut vertex, so each one is a child of
+    // a connected graph with one vertex less
+    std::vector<NeighborMasks> level(1, NeighborMasks(1, 0));
+    for (int n = 1; n < size; ++n) {
+        int parent_num = level.size();
+        std::vector< std::vector<NeighborMasks> > children(parent_num);
+#pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < parent_num; ++i)
+            augment(level[i], children[i]);
+        std::vector<NeighborMasks> next;
+        for (auto& c : children)
+            next.insert(next.end(), c.begin(), c.end());
+        level.swap(next);
+    }
+
+    // the canonical relabeling of each pattern, which also orders the patterns
+    int pattern_num = level.size();
+    std::vector< std::pair< std::pair<int, std::string>, int > > codes(pattern_num);
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < pattern_num; ++i) {
+        std::vector<int> adj_mat = get_adj_mat(level[i]);
+        codes[i] = std::make_pair(std::make_pair(get_edge_num(level[i]), CanonicalLabeling(adj_mat.data(), size).get_code()), i);
+    }
+    std::sort(codes.begin(), codes.end());
+    for (const auto& c : codes)
+        if (c.first.first >= min_edge)
+            vec.push_back(get_bfs_relabeled(Pattern(size, c.first.second.c_str())));
+
+    if (!cache_dir.empty() && !save(vec))
+        printf("motif cache: cannot write %s\n", get_cache_file_name().c_str());
     return vec;
-}
\ No newline at end of file
+}
+
+MotifGenerator::MotifGenerator(int input_size, int _min_edge, int _max_edge, const char* _cache_dir)
+    : size(input_size), min_edge(_min_edge), max_edge(_max_edge), cache_dir(_cache_dir == nullptr ? "" : _cache_dir)
+{
+    if (!cache_dir.empty() && cache_dir.back() == '/')
+        cache_dir.pop_back();
+}
+
+std::string MotifGenerator::get_cache_file_name() const
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), "/motifs_%d_%d_%d.txt", size, std::max(min_edge, 0), std::max(max_edge, -1));
+    return cache_dir + buf;
+}
+
+// The file is the magic, the size, the edge bounds and the pattern number on
+// the first line, then the canonical code of each pattern. A torn or
+// mismatching file is regenerated.
+bool MotifGenerator::load(std::vector<Pattern>& patterns) const
+{
+    if (cache_dir.empty())
+        return false;
+    FILE* fp = fopen(get_cache_file_name().c_str(), "r");
+    if (fp == nullptr)
+        return false;
+    char magic[16];
+    int file_size, file_min_edge, file_max_edge, pattern_num;
+    bool ok = fscanf(fp, "%15s %d %d %d %d", magic, &file_size, &file_min_edge, &file_max_edge, &pattern_num) == 5
+        && strcmp(magic, catalog_magic) == 0 && file_size == size && pattern_num >= 0
+        && file_min_edge == std::max(min_edge, 0) && file_max_edge == std::max(max_edge, -1);
+    std::vector<char> code(size * size + 1);
+    char format[16];
+    snprintf(format, sizeof(format), "%%%ds", size * size);
+    for (int i = 0; ok && i < pattern_num; ++i) {
+        ok = fscanf(fp, format, code.data()) == 1 && (int)strlen(code.data()) == size * size;
+        if (ok)
+            patterns.push_back(Pattern(size, code.data()));
+    }
+    ok = ok && fscanf(fp, "%15s", magic) == EOF;
+    fclose(fp);
+    if (!ok)
+        patterns.clear();
+    return ok;
+}
+
+bool MotifGenerator::save(const std::vector<Pattern>& patterns) const
+{
+    if (mkdir(cache_dir.c_str(), 0755) != 0 && errno != EEXIST)
+        printf("motif cache: cannot create %s\n", cache_dir.c_str());
+    std::string file_name = get_cache_file_name();
+    std::string tmp_name = file_name + ".tmp" + std::to_string(getpid());
+    FILE* fp = fopen(tmp_name.c_str(), "w");
+    if (fp == nullptr)
+        return false;
+    bool ok = fprintf(fp, "%s %d %d %d %d\n", catalog_magic, size, std::max(min_edge, 0), std::max(max_edge, -1), (int)patterns.size()) > 0;
+    for (const Pattern& p : patterns) {
+        std::string code;
+        for (int i = 0; i < size * size; ++i)
+            code += p.get_adj_mat_ptr()[i] ? '1' : '0';
+        ok = ok && fprintf(fp, "%s\n", code.c_str()) > 0;
+    }
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || rename(tmp_name.c_str(), file_name.c_str()) != 0) {
+        remove(tmp_name.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::vector< std::vector<long long> > MotifGenerator::get_containment_matrix(const std::vector<Pattern>& patterns)
+{
+    int n = patterns.size();
+    std::vector< std::vector<long long> > containment(n, std::vector<long long>(n, 0));
+    if (n == 0)
+        return containment;
+    int size = patterns[0].get_size();
+    assert(size * size <= 64);
+    std::vector<int> perm(size);
+    for (int i = 0; i < size; ++i)
+        perm[i] = i;
+    std::vector<uint64_t> mask(n);
+    for (int q = 0; q < n; ++q)
+        mask[q] = get_edge_mask(patterns[q], perm.data());
+
+    for (int p = 0; p < n; ++p) {
+        // every labeled copy of p on the same vertices, each one is a subgraph of q or not
+        std::vector<uint64_t> copies;
+        for (int i = 0; i < size; ++i)
+            perm[i] = i;
+        do {
+            copies.push_back(get_edge_mask(patterns[p], perm.data()));
+        } while (std::next_permutation(perm.begin(), perm.end()));
+        std::sort(copies.begin(), copies.end());
+        copies.erase(std::unique(copies.begin(), copies.end()), copies.end());
+        int edge_num = __builtin_popcountll(copies[0]);
+        for (int q = 0; q < n; ++q) {
+            if (__builtin_popcountll(mask[q]) < edge_num)
+                continue;
+            for (uint64_t c : copies)
+                if ((c & mask[q]) == c)
+                    ++containment[p][q];
+        }
+    }
+    return containment;
+}
+
+void MotifGenerator::to_vertex_induced(const std::vector<Pattern>& patterns, const std::vector< std::vector<long long> >& containment,
+    const long long* edge_induced_ans, long long* vertex_induced_ans)
+{
+    int n = patterns.size();
+    std::vector<int> edge_num(n, 0), order(n);
+    for (int p = 0; p < n; ++p) {
+        const int* adj_mat = patterns[p].get_adj_mat_ptr();
+        for (int i = 0; i < patterns[p].get_size() * patterns[p].get_size(); ++i)
+            edge_num[p] += adj_mat[i];
+        order[p] = p;
+    }
+    // a pattern is only contained in itself and in patterns with more edges
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return edge_num[a] > edge_num[b]; });
+    for (int p : order) {
+        assert(containment[p][p] == 1);
+        long long ans = edge_induced_ans[p];
+        for (int q = 0; q < n; ++q)
+            if (q != p && containment[p][q] != 0)
+                ans -= containment[p][q] * vertex_induced_ans[q];
+        vertex_induced_ans[p] = ans;
+    }
+}
+
+std::vector<int> MotifGenerator::get_orbits(const Pattern& p)
+{
+    return CanonicalLabeling(p.get_adj_mat_ptr(), p.get_size()).get_orbits();
+}
+
+std::vector< std::vector<long long> > MotifGenerator::get_orbit_containment_matrix(const std::vector<Pattern>& patterns)
+{
+    int n = patterns.size();
+    std::vector< std::vector<int> > orbits(n);
+    std::vector<int> orbit_start(n + 1, 0);
+    for (int p = 0; p < n; ++p) {
+        orbits[p] = get_orbits(patterns[p]);
+        orbit_start[p + 1] = orbit_start[p] + *std::max_element(orbits[p].begin(), orbits[p].end()) + 1;
+    }
+    std::vector< std::vector<long long> > containment(orbit_start[n], std::vector<long long>(orbit_start[n], 0));
+    if (n == 0)
+        return containment;
+    int size = patterns[0].get_size();
+    assert(size * size <= 64);
+    std::vector<int> perm(size);
+    for (int i = 0; i < size; ++i)
+        perm[i] = i;
+    std::vector<uint64_t> mask(n);
+    for (int q = 0; q < n; ++q)
+        mask[q] = get_edge_mask(patterns[q], perm.data());
+
+    for (int p = 0; p < n; ++p) {
+        // every relabeling sigma of p that is a subgraph of q, each subgraph
+        // is found once per automorphism of p
+        long long automorphism_num = 0;
+        for (int i = 0; i < size; ++i)
+            perm[i] = i;
+        std::vector<int> inverse(size);
+        do {
+            uint64_t c = get_edge_mask(patterns[p], perm.data());
+            if (c == mask[p])
+                ++automorphism_num;
+            for (int i = 0; i < size; ++i)
+                inverse[perm[i]] = i;
+            for (int q = 0; q < n; ++q) {
+                if ((c & mask[q]) != c)
+                    continue;
+                // x is the first vertex of each orbit of q
+                for (int x = 0; x < size; ++x)
+                    if (x == 0 || *std::max_element(orbits[q].begin(), orbits[q].begin() + x) < orbits[q][x])
+                        ++containment[orbit_start[p] + orbits[p][inverse[x]]][orbit_start[q] + orbits[q][x]];
+            }
+        } while (std::next_permutation(perm.begin(), perm.end()));
+        for (int o = orbit_start[p]; o < orbit_start[p + 1]; ++o)
+            for (auto& c : containment[o])
+                c /= automorphism_num;
+    }
+    return containment;
+}
@@ -0,0 +1,203 @@
+#include "../include/multi_schedule.h"
+
+#include <omp.h>
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
+static inline int high_bit(int mask) { return 31 - __builtin_clz(mask); }
+
+MultiSchedule::MultiSchedule(const std::vector<Pattern> &patterns, bool use_in_exclusion_optimize, int v_cnt, e_index_t e_cnt, long long tri_cnt) {
+    pattern_num = patterns.size();
+    pattern_valid.assign(pattern_num, false);
+    redundancy.assign(pattern_num, 1);
+    max_iep_vertex_num = 0;
+    unshared_node_num = 1;
+
+    MultiScheduleNode root;
+    root.depth = 0;
+    root.loop_slot = -1;
+    root.loop_break_size = 0;
+    root.neighbor_mask = 0;
+    nodes.push_back(root);
+
+    // the patterns are planned in parallel if there are enough of them to
+    // keep the threads busy, otherwise each one searches its orders in parallel
+    std::vector<Schedule_IEP *> schedules(pattern_num, nullptr);
+#pragma omp parallel for schedule(dynamic) if (pattern_num >= omp_get_max_threads())
+    for (int i = 0; i < pattern_num; ++i) {
+        assert(patterns[i].get_size() <= 31);
+        bool is_pattern_valid;
+        schedules[i] = new Schedule_IEP(patterns[i], is_pattern_valid, 1, 1, use_in_exclusion_optimize, v_cnt, e_cnt, tri_cnt);
+        if (!is_pattern_valid) {
+            delete schedules[i];
+            schedules[i] = nullptr;
+        }
+    }
+    for (int i = 0; i < pattern_num; ++i) {
+        if (schedules[i] == nullptr)
+            continue;
+        pattern_valid[i] = true;
+        redundancy[i] = schedules[i]->get_in_exclusion_optimize_redundancy();
+        insert(*schedules[i], i);
+        delete schedules[i];
+    }
+
+    std::vector<int> path;
+    slot_num = 0;
+    assign_slots(0, 0, path);
+}
+
+int MultiSchedule::get_child(int node_id, int neighbor_mask, const std::vector<int> &restrict_index) {
+    for (int child : nodes[node_id].children)
+        if (nodes[child].neighbor_mask == neighbor_mask && nodes[child].restrict_index == restrict_index)
+            return child;
+    MultiScheduleNode node;
+    node.depth = nodes[node_id].depth + 1;
+    node.loop_slot = -1;
+    node.loop_break_size = 0;
+    node.restrict_index = restrict_index;
+    node.neighbor_mask = neighbor_mask;
+    nodes.push_back(node);
+    int child = nodes.size() - 1;
+    nodes[node_id].children.push_back(child);
+    return child;
+}
+
+// Registers the prefix `mask` and all its fathers at the nodes of `path` that
+// choose their last vertices.
+void MultiSchedule::add_prefix(const std::vector<int> &path, int mask) {
+    while (mask != 0) {
+        int last = high_bit(mask);
+        std::map<int, int> &build_mask = nodes[path[last]].build_mask;
+        if (build_mask.count(mask))
+            return;
+        build_mask[mask] = -1;
+        mask ^= 1 << last;
+    }
+}
+
+int MultiSchedule::get_slot(const std::vector<int> &path, int mask) const {
+    if (mask == 0)
+        return -1;
+    return nodes[path[high_bit(mask)]].build_mask.at(mask);
+}
+
+void MultiSchedule::insert(const Schedule_IEP &schedule, int pattern_id) {
+    int size = schedule.get_size();
+    const int *adj_mat = schedule.get_adj_mat_ptr();
+    int iep_num = schedule.get_in_exclusion_optimize_num();
+    int loop_depth = iep_num > 0 ? size - iep_num : size;
+
+    std::vector<int> neighbor_mask(size, 0);
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < i; ++j)
+            if (adj_mat[INDEX(i, j, size)])
+                neighbor_mask[i] |= 1 << j;
+
+    std::vector<int> path;
+    path.push_back(0);
+    for (int depth = 1; depth < loop_depth; ++depth) {
+        std::vector<int> restrict_index;
+        for (int i = schedule.get_restrict_last(depth); i != -1; i = schedule.get_restrict_next(i))
+            restrict_index.push_back(schedule.get_restrict_index(i));
+        std::sort(restrict_index.begin(), restrict_index.end());
+        path.push_back(get_child(path.back(), neighbor_mask[depth], restrict_index));
+        add_prefix(path, neighbor_mask[depth]);
+    }
+    unshared_node_num += loop_depth - 1;
+
+    if (iep_num == 0) {
+        nodes[path.back()].pattern_id.push_back(pattern_id);
+        return;
+    }
+
+    // the prefix of each schedule prefix id as a bitmask of its vertices
+    int prefix_num = schedule.get_total_prefix_num();
+    std::vector<int> last_bit(prefix_num, 0), prefix_mask(prefix_num, 0);
+    for (int depth = 0; depth < size; ++depth)
+        for (int prefix_id = schedule.get_last(depth); prefix_id != -1; prefix_id = schedule.get_next(prefix_id))
+            last_bit[prefix_id] = 1 << depth;
+    for (int prefix_id = 0; prefix_id < prefix_num; ++prefix_id)
+        for (int id = prefix_id; id != -1; id = schedule.get_father_prefix_id(id))
+            prefix_mask[prefix_id] |= last_bit[id];
+
+    MultiScheduleIEP tail;
+    tail.pattern_id = pattern_id;
+    tail.loop_slot = -1;
+    tail.loop_mask = neighbor_mask[loop_depth];
+    add_prefix(path, tail.loop_mask);
+    for (int i = 0; i < (int)schedule.in_exclusion_optimize_vertex_id.size(); ++i) {
+        int mask = prefix_mask[schedule.in_exclusion_optimize_vertex_id[i]];
+        assert(mask < (1 << loop_depth));
+        add_prefix(path, mask);
+        tail.vertex_mask.push_back(mask);
+    }
+    tail.vertex_flag = schedule.in_exclusion_optimize_vertex_flag;
+    tail.vertex_coef = schedule.in_exclusion_optimize_vertex_coef;
+    tail.coef = schedule.in_exclusion_optimize_coef;
+    tail.flag = schedule.in_exclusion_optimize_flag;
+    tail.ans_pos = schedule.in_exclusion_optimize_ans_pos;
+    max_iep_vertex_num = std::max(max_iep_vertex_num, (int)tail.vertex_mask.size());
+    iep_tails.push_back(tail);
+    nodes[path.back()].iep_tail.push_back(iep_tails.size() - 1);
+}
+
+// Slots are handed out like a stack: the prefixes of a node only have to be
+// distinct from those of its ancestors, so siblings reuse the same slots.
+void MultiSchedule::assign_slots(int node_id, int base, std::vector<int> &path) {
+    path.push_back(node_id);
+    MultiScheduleNode &node = nodes[node_id];
+    if (node_id != 0) {
+        node.loop_slot = get_slot(path, node.neighbor_mask);
+        // earlier vertices adjacent to every vertex of the loop set's prefix are always in it
+        node.loop_break_size = 0;
+        for (int j = 0; j < node.depth; ++j) {
+            if (node.neighbor_mask >> j & 1)
+                continue;
+            bool full_connect = true;
+            for (int i = 0; i < node.depth && full_connect; ++i)
+                if (node.neighbor_mask >> i & 1) {
+                    int u = std::max(i, j), v = std::min(i, j);
+                    if (!(nodes[path[u]].neighbor_mask >> v & 1))
+                        full_connect = false;
+                }
+            if (full_connect)
+                ++node.loop_break_size;
+        }
+    }
+    node.build_slot.clear();
+    node.build_father_slot.clear();
+    for (auto &it : node.build_mask) {
+        it.second = base++;
+        node.build_slot.push_back(it.second);
+    }
+    // fathers are resolved after all slots of this node are known
+    for (auto &it : node.build_mask)
+        node.build_father_slot.push_back(get_slot(path, it.first ^ (1 << high_bit(it.first))));
+    slot_num = std::max(slot_num, base);
+
+    for (int tail_id : node.iep_tail) {
+        MultiScheduleIEP &tail = iep_tails[tail_id];
+        tail.loop_slot = get_slot(path, tail.loop_mask);
+        tail.vertex_slot.clear();
+        for (int mask : tail.vertex_mask)
+            tail.vertex_slot.push_back(get_slot(path, mask));
+    }
+    for (int child : node.children)
+        assign_slots(child, base, path);
+    path.pop_back();
+}
+
+void MultiSchedule::print_schedule() const {
+    printf("merged schedule: %d patterns, %d trie nodes (%d unshared), %d slots, %d IEP tails\n", pattern_num, (int)nodes.size(), unshared_node_num,
+           slot_num, (int)iep_tails.size());
+    for (int node_id = 0; node_id < (int)nodes.size(); ++node_id) {
+        const MultiScheduleNode &node = nodes[node_id];
+        printf("node %d depth %d loop_slot %d neighbors %x restricts", node_id, node.depth, node.loop_slot, node.neighbor_mask);
+        for (int i : node.restrict_index)
+            printf(" %d", i);
+        printf(" builds %d children %d patterns %d iep %d\n", (int)node.build_slot.size(), (int)node.children.size(), (int)node.pattern_id.size(),
+               (int)node.iep_tail.size());
+    }
+}
@@ -0,0 +1,63 @@
+#include <../include/graph.h>
+#include <../include/dataloader.h>
+#include "../include/pattern.h"
+#include "../include/common.h"
+
+#include <assert.h>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <omp.h>
+
+// Graphlet orbit counts of every vertex. The optional output file has one line
+// per vertex with its orbit counts, as the output of ORCA.
+int main(int argc,char *argv[]) {
+    Graph *g;
+    DataLoader D;
+
+    if(argc != 3 && argc != 4) {
+        printf("usage: %s graph_file max_graphlet_size(2-5) [output_file]\n", argv[0]);
+        return 0;
+    }
+
+    bool ok = D.fast_load(g, argv[1]);
+    if(!ok) { printf("Load data failed\n"); return 0; }
+
+    printf("Load data success!\n");
+    fflush(stdout);
+    int max_size = atoi(argv[2]);
+    printf("thread count: %d\n", omp_get_max_threads());
+
+    int orbit_num;
+    std::vector< std::pair<Pattern, int> > orbit_graphlet;
+    double t1 = get_wall_time();
+    long long *ans = g->orbit_counting(max_size, orbit_num, &orbit_graphlet);
+    double t2 = get_wall_time();
+
+    for (int o = 0; o < orbit_num; ++o) {
+        long long total = 0;
+        for (int v = 0; v < g->v_cnt; ++v)
+            total += ans[(long long)o * g->v_cnt + v];
+        printf("orbit %d: vertex %d of\n", o, orbit_graphlet[o].second);
+        orbit_graphlet[o].first.print();
+        printf("total: %lld\n", total);
+    }
+    printf("Counting time cost: %.6lf s\n", t2 - t1);
+
+    if (argc == 4) {
+        FILE *fp = fopen(argv[3], "w");
+        if (fp == nullptr) {
+            printf("cannot open %s\n", argv[3]);
+        } else {
+            for (int v = 0; v < g->v_cnt; ++v)
+                for (int o = 0; o < orbit_num; ++o)
+                    fprintf(fp, o + 1 == orbit_num ? "%lld\n" : "%lld ", ans[(long long)o * g->v_cnt + v]);
+            fclose(fp);
+        }
+    }
+
+    delete[] ans;
+    delete g;
+    return 0;
+}
@@ -1,7 +1,8 @@
 #include "../include/pattern.h"
+#include "../include/canonical_labeling.h"
 #include <assert.h>
 #include <cstring>
-#include <set>
+#include <string>
 #include <vector>
 #include <cstdio>
 #include <algorithm>
@@ -224,6 +225,25 @@ void Pattern::del_edge(int x, int y)
     adj_mat[INDEX(y, x, size)] = 0;
 }
 
+int Pattern::get_truss_number() const
+{
+    // the pattern is its own (s + 2)-truss, where s is the least support of
+    // its edges, and the edge of support s is in no larger truss
+    int min_support = -1;
+    for (int i = 0; i < size; ++i)
+        for (int j = i + 1; j < size; ++j)
+            if (adj_mat[INDEX(i, j, size)] != 0)
+            {
+                int support = 0;
+                for (int k = 0; k < size; ++k)
+                    if (adj_mat[INDEX(i, k, size)] != 0 && adj_mat[INDEX(j, k, size)] != 0)
+                        ++support;
+                if (min_support == -1 || support < min_support)
+                    min_support = support;
+            }
+    return min_support == -1 ? 2 : min_support + 2;
+}
+
 bool Pattern::check_connected() const
 {
     bool vis[size];
@@ -252,38 +272,6 @@ bool Pattern::check_connected() const
 }
 
 
-void Pattern::count_all_isomorphism(std::set< std::set<int> >& s) const
-{
-    unsigned int pow = 1;
-    for (int i = 2; i <= size; ++i)
-        pow *= i;
-    std::vector< std::vector<int> > vec;
-    vec.clear();
-    bool use[size];
-    for (int i = 0; i < size; ++i)
-        use[i] = false;
-    std::vector<int> tmp_vec;
-    get_full_permutation(vec, use, tmp_vec, 0);
-    assert(vec.size() == pow);
-    std::set<int> edge_set;
-    for (const std::vector<int>& v : vec)
-    {
-        edge_set.clear();
-        for (int i = 0; i < size; ++i)
-            for (int j = i + 1; j < size; ++j)
-                if (adj_mat[INDEX(i, j, size)] != 0)
-                {
-                    if (v[i] < v[j])
-                        edge_set.insert(v[i] * size + v[j]);
-                    else
-                        edge_set.insert(v[j] * size + v[i]);
-                }
-                    
-        if (s.count(edge_set) == 0)
-            s.insert(edge_set);
-    }
-}
-
 void Pattern::print() const
 {
     for (int i = 0; i < size; ++i)
@@ -324,20 +312,7 @@ bool Pattern::is_dag() const
         return false;
 }
 
-void Pattern::get_full_permutation(std::vector< std::vector<int> >& vec, bool use[], std::vector<int> tmp_vec, int depth) const
+std::string Pattern::get_canonical_form() const
 {
-    if (depth == size)
-    {
-        vec.push_back(tmp_vec);
-        return;
-    }
-    for (int i = 0; i < size; ++i)
-        if (use[i] == false)
-        {
-            use[i] = true;
-            tmp_vec.push_back(i);
-            get_full_permutation(vec, use, tmp_vec, depth + 1);
-            tmp_vec.pop_back();
-            use[i] = false;
-        }
+    return std::to_string(size) + ":" + CanonicalLabeling(adj_mat, size).get_code();
 }
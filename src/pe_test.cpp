@@ -0,0 +1,71 @@
+#include <../include/graph.h>
+#include <../include/dataloader.h>
+#include "../include/pattern.h"
+#include "../include/common.h"
+#include "../include/embedding.h"
+
+#include <assert.h>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <omp.h>
+
+// Enumerates all embeddings of a pattern. With an output file the embeddings
+// are written in the compact binary format of EmbeddingFileSink, otherwise a
+// consumer thread drains them through an EmbeddingQueue and only checks them.
+int main(int argc,char *argv[]) {
+    Graph *g;
+    DataLoader D;
+
+    if(argc != 4 && argc != 5) {
+        printf("usage: %s graph_file pattern_size pattern_adj_string [output_file]\n", argv[0]);
+        return 0;
+    }
+
+    bool ok = D.fast_load(g, argv[1]);
+    if(!ok) { printf("Load data failed\n"); return 0; }
+
+    printf("Load data success!\n");
+    fflush(stdout);
+    int pattern_size = atoi(argv[2]);
+    const char* pattern_str= argv[3];
+
+    Pattern p(pattern_size, pattern_str);
+    bool is_pattern_valid;
+    Schedule_IEP schedule(p, is_pattern_valid, 1, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt);
+    assert(is_pattern_valid==true);
+    schedule.print_schedule();
+    printf("thread count: %d\n", omp_get_max_threads());
+
+    double t1 = get_wall_time();
+    long long ans;
+    if (argc == 5) {
+        EmbeddingFileSink sink(argv[4], pattern_size);
+        if (!sink.is_open())
+            return 0;
+        ans = g->pattern_enumeration(schedule, sink);
+    }
+    else {
+        EmbeddingQueue queue(pattern_size, 4096);
+        std::atomic<long long> consumed(0);
+        std::thread consumer([&]() {
+            long long cnt = 0;
+            for (EmbeddingBatch *batch; (batch = queue.pop()) != nullptr; queue.release(batch)) {
+                for (int i = 0; i < batch->get_size(); ++i)
+                    assert(batch->get_embedding(i)[0] < g->v_cnt);
+                cnt += batch->get_size();
+            }
+            consumed = cnt;
+        });
+        ans = g->pattern_enumeration(schedule, queue);
+        queue.close();
+        consumer.join();
+        assert(consumed == ans);
+    }
+    double t2 = get_wall_time();
+
+    printf("Embeddings: %lld time: %.6lf\n", ans, t2 - t1);
+    delete g;
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include "../include/plan_cache.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+static const char plan_magic[8] = {'G', 'M', 'P', 'L', 'A', 'N', '0', '1'};
+
+// 64-bit FNV-1a
+static uint64_t fnv1a(const void* data, size_t len) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+PlanCache::PlanCache(const char* _dir) : dir(_dir), hit_cnt(0), miss_cnt(0), last_hit(false) {
+    if (!dir.empty() && dir.back() == '/')
+        dir.pop_back();
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+        printf("plan cache: cannot create %s\n", dir.c_str());
+}
+
+std::string PlanCache::get_key(const Pattern& pattern, int performance_modeling_type, int restricts_type,
+    bool use_in_exclusion_optimize, const Graph* g, bool vertex_induced, bool use_degree_stats) const {
+    std::string key;
+    if (performance_modeling_type != 0)
+        key = pattern.get_canonical_form();
+    else {
+        int size = pattern.get_size();
+        const int* adj_mat = pattern.get_adj_mat_ptr();
+        key = std::to_string(size) + "=";
+        for (int i = 0; i < size * size; ++i)
+            key += adj_mat[i] ? '1' : '0';
+    }
+    bool degree_aware = use_degree_stats && g->degree_stats != nullptr && performance_modeling_type == 1;
+    char buf[256];
+    snprintf(buf, sizeof(buf), " planner%d pm%d r%d iep%d vi%d da%d v%lld e%lld t%lld w%lld d%lld",
+        Schedule_IEP::planner_version, performance_modeling_type, restricts_type, (int)use_in_exclusion_optimize, (int)vertex_induced, (int)degree_aware,
+        (long long)g->v_cnt, (long long)g->e_cnt, g->tri_cnt, g->wedge_cnt, (long long)g->max_degree);
+    key += buf;
+    // the degree-aware plans depend on all the statistics, which are hashed
+    // without their checksum (not set on the graphs that were not loaded)
+    if (degree_aware) {
+        DegreeStatistics stats = *g->degree_stats;
+        stats.checksum = 0;
+        snprintf(buf, sizeof(buf), " s%016llx", (unsigned long long)fnv1a(&stats, sizeof(stats)));
+        key += buf;
+    }
+    return key;
+}
+
+std::string PlanCache::get_file_name(const std::string& key) const {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "/%016llx.plan", (unsigned long long)fnv1a(key.data(), key.size()));
+    return dir + buf;
+}
+
+Schedule_IEP* PlanCache::get_schedule(const Pattern& pattern, bool& is_pattern_valid,
+    int performance_modeling_type, int restricts_type, bool use_in_exclusion_optimize,
+    const Graph* g, bool vertex_induced, bool use_degree_stats, double planning_time_limit) {
+    std::string key = get_key(pattern, performance_modeling_type, restricts_type, use_in_exclusion_optimize, g, vertex_induced, use_degree_stats);
+    Schedule_IEP* schedule = load(key);
+    last_hit = schedule != nullptr;
+    if (schedule != nullptr) {
+        ++hit_cnt;
+        is_pattern_valid = true;
+        return schedule;
+    }
+    ++miss_cnt;
+    schedule = new Schedule_IEP(pattern, is_pattern_valid, performance_modeling_type, restricts_type, use_in_exclusion_optimize,
+        g->v_cnt, g->e_cnt, g->tri_cnt, vertex_induced, use_degree_stats ? g->degree_stats : nullptr, planning_time_limit);
+    if (is_pattern_valid && !schedule->is_planning_truncated() && !save(key, *schedule))
+        printf("plan cache: cannot write %s\n", get_file_name(key).c_str());
+    return schedule;
+}
+
+Schedule_IEP* PlanCache::load(const std::string& key) const {
+    FILE* fp = fopen(get_file_name(key).c_str(), "rb");
+    if (fp == nullptr)
+        return nullptr;
+    char magic[8];
+    uint64_t key_len = 0;
+    bool ok = fread(magic, 1, 8, fp) == 8 && memcmp(magic, plan_magic, 8) == 0;
+    ok = ok && fread(&key_len, sizeof(key_len), 1, fp) == 1 && key_len == key.size();
+    if (ok) {
+        std::string file_key(key_len, ' ');
+        ok = fread(&file_key[0], 1, key_len, fp) == key_len && file_key == key;
+    }
+    Schedule_IEP* schedule = ok ? Schedule_IEP::load(fp) : nullptr;
+    fclose(fp);
+    return schedule;
+}
+
+bool PlanCache::save(const std::string& key, const Schedule_IEP& schedule) const {
+    std::string file_name = get_file_name(key);
+    std::string tmp_name = file_name + ".tmp" + std::to_string(getpid());
+    FILE* fp = fopen(tmp_name.c_str(), "wb");
+    if (fp == nullptr)
+        return false;
+    uint64_t key_len = key.size();
+    bool ok = fwrite(plan_magic, 1, 8, fp) == 8;
+    ok = ok && fwrite(&key_len, sizeof(key_len), 1, fp) == 1;
+    ok = ok && fwrite(key.data(), 1, key_len, fp) == key_len;
+    ok = ok && schedule.save(fp);
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || rename(tmp_name.c_str(), file_name.c_str()) != 0) {
+        remove(tmp_name.c_str());
+        return false;
+    }
+    return true;
+}
@@ -4,14 +4,19 @@
 #include "../include/schedule.h"
 #include "../include/common.h"
 #include "../include/motif_generator.h"
+#include "../include/checkpoint.h"
+#include "../include/plan_cache.h"
+#include "../include/schedule_tuner.h"
+#include "../include/query_router.h"
 
 #include <assert.h>
 #include <iostream>
 #include <string>
+#include <cstring>
 #include <algorithm>
 #include <omp.h>
 
-double test_pattern(Graph* g, Pattern &pattern) {
+double test_pattern(Graph* g, Pattern &pattern, Checkpoint* checkpoint, PlanCache* plan_cache, bool autotune, bool degree_model) {
 
     bool is_pattern_valid;
     int performance_modeling_type;
@@ -19,10 +24,40 @@ double test_pattern(Graph* g, Pattern &pattern) {
 
     performance_modeling_type = 1;
     use_in_exclusion_optimize = true;
-    Schedule_IEP schedule_our(pattern, is_pattern_valid, performance_modeling_type, 1, use_in_exclusion_optimize, g->v_cnt, g->e_cnt);
+    double t1,t2;
+
+    // triangles, cliques, stars and double stars have engines of their own,
+    // which need no schedule
+    // (a checkpoint or --autotune asks for the generic one)
+    if (checkpoint == nullptr && !autotune) {
+        QueryRouter router(g);
+        long long ans;
+        t1 = get_wall_time();
+        if (router.count_direct(pattern, false, ans)) {
+            t2 = get_wall_time();
+            printf("Pattern class: %s, engine: %s\n", QueryRouter::get_class_name(QueryRouter::classify(pattern)), router.get_last_engine());
+            printf("Ans: %lld time: %.6lf\n", ans, t2 - t1);
+            printf("Counting time cost: %.6lf s\n", t2 - t1);
+            return t2 - t1;
+        }
+    }
+
+    t1 = get_wall_time();
+    Schedule_IEP* schedule_ptr;
+    if (autotune) {
+        ScheduleTuner tuner(g);
+        schedule_ptr = tuner.tune(pattern, is_pattern_valid, 1, use_in_exclusion_optimize, degree_model);
+    }
+    else if (plan_cache != nullptr)
+        schedule_ptr = plan_cache->get_schedule(pattern, is_pattern_valid, performance_modeling_type, 1, use_in_exclusion_optimize, g, false, degree_model);
+    else
+        schedule_ptr = new Schedule_IEP(pattern, is_pattern_valid, performance_modeling_type, 1, use_in_exclusion_optimize, g->v_cnt, g->e_cnt, g->tri_cnt, false,
+            degree_model ? g->degree_stats : nullptr);
     assert(is_pattern_valid==true);
+    Schedule_IEP& schedule_our = *schedule_ptr;
+    t2 = get_wall_time();
+    printf("Planning time: %.6lf s%s\n", t2 - t1, !autotune && plan_cache != nullptr && plan_cache->get_last_hit() ? " (plan cache hit)" : "");
 
-    double t1,t2;
     double total_time = 0;
 
     printf("thread count: %d\n", omp_get_max_threads());
@@ -31,7 +66,7 @@ double test_pattern(Graph* g, Pattern &pattern) {
     int times = 1;
     for(int i = 0; i < times; ++i) {
         t1 = get_wall_time();
-        long long ans_our = g->pattern_matching(schedule_our);
+        long long ans_our = g->pattern_matching(schedule_our, false, checkpoint);
         t2 = get_wall_time();
 
         printf("Ans: %lld time: %.6lf\n", ans_our, t2 - t1);
@@ -43,6 +78,7 @@ double test_pattern(Graph* g, Pattern &pattern) {
     }
     total_time /= 1;
     printf("Counting time cost: %.6lf s\n",total_time);
+    delete schedule_ptr;
     return total_time;
 }
 
@@ -50,8 +86,38 @@ int main(int argc,char *argv[]) {
     Graph *g;
     DataLoader D;
 
-    if(argc != 4) {
-        printf("usage: %s graph_file pattern_size pattern_adj_string\n", argv[0]);
+    // --plan-cache dir, --autotune and --degree-model may come anywhere after
+    // the program name; --degree-model plans with the degree-aware cost model
+    PlanCache* plan_cache = nullptr;
+    for (int i = 1; i + 1 < argc; ++i)
+        if (strcmp(argv[i], "--plan-cache") == 0) {
+            plan_cache = new PlanCache(argv[i + 1]);
+            for (int j = i; j + 2 <= argc; ++j)
+                argv[j] = argv[j + 2];
+            argc -= 2;
+            break;
+        }
+    bool autotune = false;
+    for (int i = 1; i < argc; ++i)
+        if (strcmp(argv[i], "--autotune") == 0) {
+            autotune = true;
+            for (int j = i; j + 1 <= argc; ++j)
+                argv[j] = argv[j + 1];
+            argc -= 1;
+            break;
+        }
+    bool degree_model = false;
+    for (int i = 1; i < argc; ++i)
+        if (strcmp(argv[i], "--degree-model") == 0) {
+            degree_model = true;
+            for (int j = i; j + 1 <= argc; ++j)
+                argv[j] = argv[j + 1];
+            argc -= 1;
+            break;
+        }
+
+    if(argc < 4 || argc > 6) {
+        printf("usage: %s graph_file pattern_size pattern_adj_string [checkpoint_file [restart]] [--plan-cache dir] [--autotune] [--degree-model]\n", argv[0]);
         return 0;
     }
 
@@ -66,7 +132,12 @@ int main(int argc,char *argv[]) {
 
     Pattern p(pattern_size, pattern_str);
 
-    test_pattern(g, p);
+    Checkpoint* checkpoint = nullptr;
+    if (argc > 4)
+        checkpoint = new Checkpoint(argv[4], argc > 5 && strcmp(argv[5], "restart") == 0);
+    test_pattern(g, p, checkpoint, plan_cache, autotune, degree_model);
+    delete checkpoint;
+    delete plan_cache;
     delete g;
     return 0;
 }
\ No newline at end of file
@@ -16,6 +16,11 @@ Prefix::~Prefix()
 
 void Prefix::init(int input_size, const int* input_data)
 {
+    // a schedule rebuilds its prefixes for every candidate order
+    if (data != nullptr)
+        delete[] data;
+    has_child = false;
+    only_need_size = false;
     size = input_size;
     data = new int[input_size];
     memcpy(data, input_data, size * sizeof(int));
@@ -0,0 +1,110 @@
+#include "../include/query_router.h"
+#include "../include/schedule_IEP.h"
+
+#include <algorithm>
+
+QueryRouter::QueryRouter(Graph* _g, PlanCache* _plan_cache, AnalyticCounter* _counter)
+    : g(_g), plan_cache(_plan_cache), counter(_counter), last_engine("")
+{
+    if (counter == nullptr) {
+        own_counter.reset(new AnalyticCounter(g));
+        counter = own_counter.get();
+    }
+}
+
+PatternClass QueryRouter::classify(const Pattern& pattern)
+{
+    int size = pattern.get_size();
+    const int* adj_mat = pattern.get_adj_mat_ptr();
+    if (size == 0 || !pattern.check_connected())
+        return PatternClass::Other;
+    int edge_num = 0, max_degree = 0;
+    for (int u = 0; u < size; ++u) {
+        int degree = 0;
+        for (int v = 0; v < size; ++v)
+            degree += adj_mat[INDEX(u, v, size)] != 0;
+        edge_num += degree;
+        max_degree = std::max(max_degree, degree);
+    }
+    edge_num /= 2;
+    if (edge_num == size * (size - 1) / 2)
+        return size == 3 ? PatternClass::Triangle : PatternClass::Clique;
+    // the remaining trees have at least 3 vertices
+    if (edge_num == size - 1) {
+        if (size == 3)
+            return PatternClass::Wedge;
+        if (max_degree == size - 1)
+            return PatternClass::Star;
+        if (max_degree == 2)
+            return PatternClass::Path;
+        int center_num = 0;
+        for (int u = 0; u < size; ++u) {
+            int degree = 0;
+            for (int v = 0; v < size; ++v)
+                degree += adj_mat[INDEX(u, v, size)] != 0;
+            center_num += degree > 1;
+        }
+        // two inner vertices of a tree are adjacent
+        if (center_num == 2)
+            return PatternClass::DoubleStar;
+    }
+    return PatternClass::Other;
+}
+
+const char* QueryRouter::get_class_name(PatternClass pattern_class)
+{
+    switch (pattern_class) {
+        case PatternClass::Triangle: return "triangle";
+        case PatternClass::Clique: return "clique";
+        case PatternClass::Wedge: return "wedge";
+        case PatternClass::Star: return "star";
+        case PatternClass::Path: return "path";
+        case PatternClass::DoubleStar: return "double star";
+        default: return "other";
+    }
+}
+
+bool QueryRouter::count_direct(const Pattern& pattern, bool vertex_induced, long long& ans)
+{
+    // a complete pattern is its own vertex-induced pattern
+    switch (classify(pattern)) {
+        case PatternClass::Triangle:
+            ans = g->triangle_counting_mt();
+            last_engine = "triangle_counting_mt";
+            return true;
+        case PatternClass::Clique:
+            ans = g->clique_counting(pattern.get_size());
+            last_engine = "clique_counting";
+            return true;
+        case PatternClass::Wedge:
+        case PatternClass::Star:
+        case PatternClass::Path:
+        case PatternClass::DoubleStar:
+            // longer paths and most vertex-induced trees need the generic engine
+            if (!AnalyticCounter::is_supported(pattern, vertex_induced))
+                return false;
+            ans = counter->count(pattern, vertex_induced);
+            last_engine = "analytic";
+            return true;
+        default:
+            return false;
+    }
+}
+
+long long QueryRouter::count(const Pattern& pattern, bool& is_pattern_valid, bool vertex_induced)
+{
+    long long ans;
+    is_pattern_valid = true;
+    if (count_direct(pattern, vertex_induced, ans))
+        return ans;
+
+    Schedule_IEP* schedule;
+    if (plan_cache != nullptr)
+        schedule = plan_cache->get_schedule(pattern, is_pattern_valid, 1, 1, true, g, vertex_induced);
+    else
+        schedule = new Schedule_IEP(pattern, is_pattern_valid, 1, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt, vertex_induced);
+    ans = is_pattern_valid ? g->pattern_matching(*schedule) : 0;
+    delete schedule;
+    last_engine = "pattern_matching";
+    return ans;
+}
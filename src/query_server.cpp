@@ -0,0 +1,274 @@
+#include "../include/query_server.h"
+#include "../include/dataloader.h"
+#include "../include/pattern.h"
+#include "../include/schedule_IEP.h"
+#include "../include/query_router.h"
+#include "../include/canonical_labeling.h"
+#include "../include/cancel_token.h"
+#include "../include/common.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <thread>
+#include <omp.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+bool QueryServer::serve(FILE* in, FILE* out) {
+    if (thread_num > 0)
+        omp_set_num_threads(thread_num);
+    char* line = nullptr;
+    size_t cap = 0;
+    bool running = true;
+    while (getline(&line, &cap, in) != -1) {
+        std::istringstream request(line);
+        std::string command;
+        if (!(request >> command))
+            continue;
+        if (command == "quit")
+            break;
+        if (command == "shutdown") {
+            fprintf(out, "ok\n");
+            running = false;
+            break;
+        }
+        fprintf(out, "%s\n", handle(command, request).c_str());
+        fflush(out);
+    }
+    fflush(out);
+    free(line);
+    return running;
+}
+
+bool QueryServer::serve_socket(const char* socket_path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (fd < 0 || strlen(socket_path) >= sizeof(addr.sun_path)) {
+        printf("cannot create socket %s\n", socket_path);
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+    strcpy(addr.sun_path, socket_path);
+    unlink(socket_path);
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+        printf("cannot listen on %s\n", socket_path);
+        close(fd);
+        return false;
+    }
+    printf("listening on %s\n", socket_path);
+    fflush(stdout);
+
+    std::atomic<bool> running(true);
+    std::mutex connection_mutex;
+    std::condition_variable connection_done;
+    std::set<int> connections; // the sockets to disconnect on shutdown
+    int connection_num = 0;
+    int backoff_ms = 10;
+    bool ok = true;
+    while (running) {
+        int conn = accept(fd, nullptr, nullptr);
+        int conn_out = conn < 0 ? -1 : dup(conn);
+        if (conn_out < 0) {
+            int error = errno;
+            if (conn >= 0)
+                close(conn);
+            if (!running)
+                break;
+            if (error == EINTR || error == ECONNABORTED)
+                continue;
+            if (error != EMFILE && error != ENFILE && error != ENOBUFS && error != ENOMEM) {
+                printf("cannot accept on %s: %s\n", socket_path, strerror(error));
+                ok = false;
+                break;
+            }
+            // out of descriptors or memory until some connection is closed
+            std::this_thread::sleep_for(std::chrono::milliseconds(backoff_ms));
+            backoff_ms = std::min(backoff_ms * 2, 1000);
+            continue;
+        }
+        backoff_ms = 10;
+        {
+            std::lock_guard<std::mutex> guard(connection_mutex);
+            connections.insert(conn);
+            ++connection_num;
+        }
+        std::thread([&, conn, conn_out] {
+            FILE* in = fdopen(conn, "r");
+            FILE* out = fdopen(conn_out, "w");
+            if (!serve(in, out)) {
+                // wakes up the accept() of the main thread
+                running = false;
+                shutdown(fd, SHUT_RDWR);
+            }
+            {
+                // conn may be reused by accept() once it is closed
+                std::lock_guard<std::mutex> guard(connection_mutex);
+                connections.erase(conn);
+            }
+            fclose(out);
+            fclose(in);
+            std::lock_guard<std::mutex> guard(connection_mutex);
+            --connection_num;
+            connection_done.notify_all();
+        }).detach();
+    }
+    running = false;
+
+    // The reads of the clients end: idle ones, which would never send
+    // another line, stop at once, the others after the lines they have sent.
+    std::unique_lock<std::mutex> lock(connection_mutex);
+    for (int conn : connections)
+        shutdown(conn, SHUT_RD);
+    connection_done.wait(lock, [&] { return connection_num == 0; });
+    lock.unlock();
+    close(fd);
+    unlink(socket_path);
+    return ok;
+}
+
+std::string QueryServer::load(const std::string& name, const std::string& path) {
+    double t1 = get_wall_time();
+    Graph* g;
+    bool ok;
+    {
+        // the loader logs and updates the default of VertexSet
+        std::lock_guard<std::mutex> guard(load_mutex);
+        DataLoader D;
+        ok = D.fast_load(g, path.c_str(), true);
+    }
+    if (!ok)
+        return "error cannot load " + path;
+    double t2 = get_wall_time();
+    std::shared_ptr<ResidentGraph> resident(new ResidentGraph());
+    resident->g.reset(g);
+    resident->counter.reset(new AnalyticCounter(g));
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        graphs[name] = resident;
+    }
+    char reply[256];
+    snprintf(reply, sizeof(reply), "ok %s %u %ld %.6lf", name.c_str(), g->v_cnt, (long)g->e_cnt, t2 - t1);
+    return reply;
+}
+
+std::shared_ptr<QueryServer::ResidentGraph> QueryServer::find(const std::string& name) {
+    std::lock_guard<std::mutex> guard(mutex);
+    auto it = graphs.find(name);
+    return it == graphs.end() ? nullptr : it->second;
+}
+
+std::shared_ptr<SchedulePlan> QueryServer::find_plan(ResidentGraph& resident, const std::string& key) {
+    std::lock_guard<std::mutex> guard(mutex);
+    auto it = resident.plans.find(key);
+    return it == resident.plans.end() ? nullptr : it->second;
+}
+
+std::string QueryServer::handle(const std::string& command, std::istringstream& request) {
+    std::string name;
+    if (command == "load") {
+        std::string path;
+        if (!(request >> name >> path))
+            return "error usage: load NAME PATH";
+        return load(name, path);
+    }
+    if (command == "drop") {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (!(request >> name) || graphs.erase(name) == 0)
+            return "error unknown graph";
+        return "ok";
+    }
+    if (command == "graphs") {
+        std::lock_guard<std::mutex> guard(mutex);
+        std::string reply = "ok " + std::to_string(graphs.size());
+        for (auto& it : graphs)
+            reply += " " + it.first;
+        return reply;
+    }
+    if (command == "count")
+        return count(request);
+    return "error unknown command " + command;
+}
+
+std::string QueryServer::count(std::istringstream& request) {
+    std::string name, adj, option;
+    int size;
+    if (!(request >> name >> size >> adj))
+        return "error usage: count NAME SIZE ADJ [induced] [timeout SECONDS]";
+    bool vertex_induced = false;
+    double timeout = -1;
+    while (request >> option) {
+        if (option == "induced")
+            vertex_induced = true;
+        else if (option == "timeout" && (request >> timeout))
+            continue;
+        else
+            return "error bad option " + option;
+    }
+    std::shared_ptr<ResidentGraph> resident = find(name);
+    if (resident == nullptr)
+        return "error unknown graph " + name;
+    Graph* g = resident->g.get();
+    if (size < 2 || size > 16 || (int)adj.size() != size * size)
+        return "error the pattern needs 2 to 16 vertices and SIZE * SIZE adjacency characters";
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < size; ++j)
+            if ((adj[INDEX(i, j, size)] != '0' && adj[INDEX(i, j, size)] != '1') ||
+                adj[INDEX(i, j, size)] != adj[INDEX(j, i, size)] || (i == j && adj[INDEX(i, j, size)] == '1'))
+                return "error the adjacency matrix must be symmetric 0/1 without loops";
+    Pattern pattern(size, adj.c_str());
+    if (!pattern.check_connected())
+        return "error the pattern is not connected";
+
+    double t1 = get_wall_time();
+    long long ans;
+    if (QueryRouter(g, nullptr, resident->counter.get()).count_direct(pattern, vertex_induced, ans)) {
+        char reply[256];
+        snprintf(reply, sizeof(reply), "ok %lld %.6lf %.6lf direct", ans, 0.0, get_wall_time() - t1);
+        return reply;
+    }
+    std::string key = (vertex_induced ? "1 " : "0 ") + CanonicalLabeling(pattern.get_adj_mat_ptr(), size).get_code();
+    std::shared_ptr<SchedulePlan> plan = find_plan(*resident, key);
+    bool hit = plan != nullptr;
+    if (!hit) {
+        std::lock_guard<std::mutex> guard(plan_mutex);
+        plan = find_plan(*resident, key);
+        if (plan == nullptr) {
+            bool is_pattern_valid;
+            Schedule_IEP* schedule;
+            if (plan_cache != nullptr)
+                schedule = plan_cache->get_schedule(pattern, is_pattern_valid, 1, 1, true, g, vertex_induced);
+            else
+                schedule = new Schedule_IEP(pattern, is_pattern_valid, 1, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt, vertex_induced);
+            if (!is_pattern_valid) {
+                delete schedule;
+                return "error invalid pattern";
+            }
+            plan.reset(SchedulePlan::create(*schedule), SchedulePlan::destroy);
+            delete schedule;
+            std::lock_guard<std::mutex> plans_guard(mutex);
+            resident->plans[key] = plan;
+        }
+    }
+    double t2 = get_wall_time();
+    CancelToken token(timeout);
+    PartialCount result = g->pattern_matching_partial(*plan, timeout >= 0 ? &token : nullptr);
+    double t3 = get_wall_time();
+
+    char reply[256];
+    if (result.finished)
+        snprintf(reply, sizeof(reply), "ok %lld %.6lf %.6lf %s", result.ans, t2 - t1, t3 - t2, hit ? "hit" : "miss");
+    else
+        snprintf(reply, sizeof(reply), "partial %lld %.6lf %.6lf %.6lf %.6lf %s", result.ans, result.estimate,
+                 result.completed_fraction, t2 - t1, t3 - t2, hit ? "hit" : "miss");
+    return reply;
+}
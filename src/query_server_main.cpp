@@ -0,0 +1,65 @@
+#include "../include/query_server.h"
+#include "../include/plan_cache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <csignal>
+#include <unistd.h>
+
+// The QueryServer of the graphs given as name=file, on stdin and stdout or on
+// a unix socket, where --threads partitions the cores between the queries of
+// the clients.
+int main(int argc, char *argv[]) {
+    const char* socket_path = nullptr;
+    PlanCache* plan_cache = nullptr;
+    int thread_num = 0;
+    std::vector<std::string> initial_graphs;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc)
+            socket_path = argv[++i];
+        else if (strcmp(argv[i], "--plan-cache") == 0 && i + 1 < argc)
+            plan_cache = new PlanCache(argv[++i]);
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            thread_num = atoi(argv[++i]);
+        else if (strchr(argv[i], '=') != nullptr)
+            initial_graphs.push_back(argv[i]);
+        else {
+            printf("usage: %s [--socket path] [--plan-cache dir] [--threads per_query] [name=graph_file ...]\n", argv[0]);
+            return 0;
+        }
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    // on stdin the replies keep stdout to themselves, the logs of the engine go to stderr
+    FILE* reply_out = stdout;
+    if (socket_path == nullptr) {
+        fflush(stdout);
+        reply_out = fdopen(dup(STDOUT_FILENO), "w");
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    }
+
+    QueryServer server(plan_cache, thread_num);
+    for (const std::string& arg : initial_graphs) {
+        size_t pos = arg.find('=');
+        std::string reply = server.load(arg.substr(0, pos), arg.substr(pos + 1));
+        printf("%s\n", reply.c_str());
+        if (reply.compare(0, 2, "ok") != 0) {
+            delete plan_cache;
+            return 1;
+        }
+    }
+    fflush(stdout);
+
+    int ret = 0;
+    if (socket_path == nullptr) {
+        server.serve(stdin, reply_out);
+        fclose(reply_out);
+    }
+    else if (!server.serve_socket(socket_path))
+        ret = 1;
+    delete plan_cache;
+    return ret;
+}
@@ -1,6 +1,5 @@
 #include "../include/schedule_IEP.h"
-#include "../include/graph.h"
-#include "../include/dataloader.h"
+#include "../include/canonical_labeling.h"
 #include <cmath>
 #include <cstdio>
 #include <cstring>
@@ -8,11 +7,86 @@
 #include <stdexcept>
 #include <iostream>
 #include <algorithm>
+#include <chrono>
+#include <map>
+#include <set>
+#include <omp.h>
+
+constexpr double Schedule_IEP::default_planning_time_limit;
+
+struct Schedule_IEP::OrderSearch {
+    const int* pattern_adj_mat;
+    int performance_modeling_type;
+    int restricts_type;
+    bool use_in_exclusion_optimize;
+    int v_cnt;
+    e_index_t e_cnt;
+    long long tri_cnt;
+    const DegreeStatistics* degree_stats;
+    std::vector< std::vector<int> > automorphisms;
+    bool all_restricts;
+    int optimize_num; // required get_vec_optimize_num() of the candidates, 0 for no requirement
+    int loop_size;    // vertices before the ones counted by inclusion-exclusion
+
+    // terms of new_estimate_schedule_restrict()
+    bool use_bound;
+    double p_size1;
+    std::vector<double> pp_size;
+    double restrict_rate; // lower bound of the product of the restriction rates
+    std::map< std::vector< std::pair<int,int> >, long long > extension_cnt_cache; // of count_linear_extensions()
+
+    std::chrono::steady_clock::time_point start;
+    double time_limit; // seconds
+    bool stopped;
+
+    std::vector<int> order;
+    std::vector<bool> used;
+
+    bool have_best;
+    double min_val;
+    std::vector<int> best_order;
+    std::vector< std::pair<int,int> > best_pairs;
+
+    int candidate_num; // the best orders and restrictions kept in candidates, cheapest first
+    std::vector<ScheduleCandidate> candidates;
+
+    // the prefixes of split_depth vertices (and their stabilizers) are
+    // collected in tasks instead of being searched, if tasks is given
+    int split_depth;
+    std::vector< std::pair< std::vector<int>, std::vector<int> > >* tasks;
+    const double* shared_min_val; // the best cost found by all threads, if searching in parallel
+
+    // cost a prefix has to be able to beat to be searched further
+    double prune_val() const {
+        if(candidate_num > 1)
+            return (int)candidates.size() < candidate_num ? 1e18 : candidates.back().cost;
+        if(shared_min_val == nullptr)
+            return min_val;
+        double val;
+#pragma omp atomic read
+        val = *shared_min_val;
+        return std::min(val, min_val);
+    }
+
+    void add_candidate(const ScheduleCandidate& c) {
+        // the greedy order and the best one can be evaluated twice
+        for(const auto& old : candidates)
+            if(old.order == c.order && old.restricts == c.restricts)
+                return;
+        auto pos = std::upper_bound(candidates.begin(), candidates.end(), c,
+            [](const ScheduleCandidate& a, const ScheduleCandidate& b) { return a.cost < b.cost || (a.cost == b.cost && a.order < b.order); });
+        if((int)(pos - candidates.begin()) < candidate_num) {
+            candidates.insert(pos, c);
+            if((int)candidates.size() > candidate_num)
+                candidates.pop_back();
+        }
+    }
+};
 
 Schedule_IEP::Schedule_IEP(const Pattern& pattern, bool &is_pattern_valid, 
     int performance_modeling_type, int restricts_type, bool use_in_exclusion_optimize ,
     int v_cnt, e_index_t e_cnt, long long tri_cnt,
-    bool vertex_induced)
+    bool vertex_induced, const DegreeStatistics* degree_stats, double planning_time_limit)
 {
     // if (!use_in_exclusion_optimize) {
     //     throw std::logic_error("Schedule_IEP: must set use_in_exclusion_optimize to true.\n");
@@ -30,34 +104,11 @@ Schedule_IEP::Schedule_IEP(const Pattern& pattern, bool &is_pattern_valid,
 
     is_pattern_valid = true;
     size = pattern.get_size();
-    adj_mat = new int[size * size];
+    init_arrays();
     
     // not use performance_modeling, simply copy the adj_mat from pattern
     memcpy(adj_mat, pattern.get_adj_mat_ptr(), size * size * sizeof(int));
 
-    // The I-th loop consists of at most the intersection of i-1 VertexSet.
-    // So the max number of prefix = 0 + 1 + ... + size-1 = size * (size-1) / 2
-    int max_prefix_num = size * (size - 1) / 2 + 1;
-    father_prefix_id = new int[max_prefix_num];
-    last = new int[size];
-    next = new int[max_prefix_num];
-    break_size = new int[max_prefix_num];
-    loop_set_prefix_id = new int[size];
-    prefix = new Prefix[max_prefix_num];
-    restrict_last = new int[size];
-    restrict_next = new int[max_prefix_num];
-    restrict_index = new int[max_prefix_num];
-
-    memset(father_prefix_id, -1, max_prefix_num * sizeof(int));
-    memset(loop_set_prefix_id, -1, sizeof(int) * size);
-    memset(last, -1, size * sizeof(int));
-    memset(next, -1, max_prefix_num * sizeof(int));
-    memset(restrict_next, -1, max_prefix_num * sizeof(int));
-    memset(break_size, -1, max_prefix_num * sizeof(int));
-    memset(restrict_last, -1, size * sizeof(int));
-    memset(restrict_next, -1, max_prefix_num * sizeof(int));
-    memset(restrict_next, -1, max_prefix_num * sizeof(int));
-
     std::vector< std::pair<int,int> > best_pairs;
     best_pairs.clear();
     //Initialize adj_mat
@@ -65,127 +116,8 @@ Schedule_IEP::Schedule_IEP(const Pattern& pattern, bool &is_pattern_valid,
     //the best order produced by performance_modeling(...) is saved in best_order[]
     //Finally, we use best_order[] to relocate adj_mat
     if( performance_modeling_type != 0) { 
-        unsigned int pow = 1;
-        for (int i = 2; i <= size; ++i) pow *= i;
-        
-        std::vector< std::vector<int> > candidate_permutations;
-        candidate_permutations.clear();
-        
-        bool use[size];
-        for (int i = 0; i < size; ++i) use[i] = false;
-        std::vector<int> tmp_vec;
-        get_full_permutation(candidate_permutations, use, tmp_vec, 0);
-        assert(candidate_permutations.size() == pow);
-
-        remove_invalid_permutation(candidate_permutations);
-
-        if(performance_modeling_type == 1) {
-            //reduce candidates
-            int max_val = 0;
-            for(const auto &vec : candidate_permutations) {
-                max_val = std::max(max_val, get_vec_optimize_num(vec));
-            }
-            k_val = max_val;
-            std::vector< std::vector<int> > tmp;
-            tmp.clear();
-            for(const auto &vec : candidate_permutations) 
-                if( get_vec_optimize_num(vec) == max_val) {
-                    tmp.push_back(vec);
-                }
-            candidate_permutations = tmp;
-        }
-
-        std::vector<int> best_order(size);
-        double min_val = 1e18;
-        bool have_best = false;
-        const int* pattern_adj_mat = pattern.get_adj_mat_ptr();
-
-        // printf("number of candidate permutations: %ld\n", candidate_permutations.size());
-
-        for(const auto &vec : candidate_permutations) {
-            copy_adj_mat_from(vec, pattern_adj_mat);
-
-            setup_optimization_info(use_in_exclusion_optimize);
-
-            std::vector< std::vector< std::pair<int,int> > > restricts_vector;
-            restricts_vector.clear();
-
-            if(restricts_type == 1) {
-                restricts_generate(adj_mat, restricts_vector);
-            }
-            else {
-                Schedule_IEP schedule(adj_mat, size);
-
-                std::vector< std::pair<int,int> > pairs;
-                schedule.GraphZero_aggressive_optimize(pairs);
-
-                restricts_vector.clear();
-                restricts_vector.push_back(pairs);
-            }
-
-            if( restricts_vector.size() == 0) {
-                std::vector< std::pair<int,int> > Empty;
-                Empty.clear();
-
-                double val = 1e18;
-                if (performance_modeling_type == 1) {
-                    val = new_estimate_schedule_restrict(Empty, v_cnt, e_cnt, tri_cnt);
-                }
-                // if(performance_modeling_type == 1) {
-                //     val = our_estimate_schedule_restrict(vec, Empty, v_cnt, e_cnt, tri_cnt);
-                // }
-                // else {
-                //     if(performance_modeling_type == 2) {
-                //         val = GraphZero_estimate_schedule_restrict(vec, Empty, v_cnt, e_cnt);
-                //     }
-                //     else {
-                //         val = Naive_estimate_schedule_restrict(vec, Empty, v_cnt, e_cnt);
-                //     }
-                // }
-
-                if(have_best == false || val < min_val) {
-                    have_best = true;
-                    min_val = val;
-                    for(int i = 0; i < size; ++i) best_order[i] = vec[i];
-                    best_pairs = Empty;
-                }
-            }
-
-
-            for(const auto& pairs : restricts_vector) {
-                double val = 1e18;
-                if (performance_modeling_type == 1) {
-                    val = new_estimate_schedule_restrict(pairs, v_cnt, e_cnt, tri_cnt);
-                }
-                // if(performance_modeling_type == 1) {
-                //     val = our_estimate_schedule_restrict(vec, pairs, v_cnt, e_cnt, tri_cnt);
-                // }
-                // else {
-                //     if(performance_modeling_type == 2) {
-                //         val = GraphZero_estimate_schedule_restrict(vec, pairs, v_cnt, e_cnt);
-                //     }
-                //     else {
-                //         val = Naive_estimate_schedule_restrict(vec, pairs, v_cnt, e_cnt);
-                //     }
-                // }
-
-                if(have_best == false || val < min_val) {
-                    have_best = true;
-                    min_val = val;
-                    for(int i = 0; i < size; ++i) best_order[i] = vec[i];
-                    best_pairs = pairs;
-                }
-            }
-
-        }
-
-        copy_adj_mat_from(best_order, pattern_adj_mat);
-
-        // printf("best order:\n");
-        // for(auto i: best_order) {
-        //     printf("%d ",i);
-        // }
-        // printf("\n");
+        plan_order(pattern, performance_modeling_type, restricts_type, use_in_exclusion_optimize, v_cnt, e_cnt, tri_cnt, degree_stats,
+            planning_time_limit, best_pairs);
     }
     else {
         // std::vector< int > I;
@@ -207,6 +139,17 @@ Schedule_IEP::Schedule_IEP(const Pattern& pattern, bool &is_pattern_valid,
                 restricts_vector.clear();
                 restricts_vector.push_back(pairs);
             }
+
+            if (use_in_exclusion_optimize) {
+                std::vector<int> I;
+                for (int i = 0; i < size; ++i) I.push_back(i);
+                std::vector< std::vector< std::pair<int,int> > > all_restricts = restricts_vector;
+                if (!remove_in_exclusion_invalid_restricts(restricts_vector, get_vec_optimize_num(I))) {
+                    // no restrictions that IEP can keep
+                    use_in_exclusion_optimize = false;
+                    restricts_vector = all_restricts;
+                }
+            }
         }
 
         bool have_best = false;
@@ -221,7 +164,7 @@ Schedule_IEP::Schedule_IEP(const Pattern& pattern, bool &is_pattern_valid,
             //     val = GraphZero_estimate_schedule_restrict(I, pairs, v_cnt, e_cnt);
             // }
             if (restricts_type) {
-                val = new_estimate_schedule_restrict(pairs, v_cnt, e_cnt, tri_cnt);
+                val = new_estimate_schedule_restrict(pairs, v_cnt, e_cnt, tri_cnt, degree_stats);
             }
 
             if(have_best == false || val < min_val) {
@@ -246,13 +189,179 @@ Schedule_IEP::Schedule_IEP(const Pattern& pattern, bool &is_pattern_valid,
     // print_schedule();
 }
 
+// Chooses the matching order (copied into adj_mat) and its restrictions with
+// the performance model. The best candidate_num orders and restrictions are
+// kept in candidates if given, cheapest first.
+void Schedule_IEP::plan_order(const Pattern& pattern, int performance_modeling_type, int restricts_type, bool& use_in_exclusion_optimize,
+    int v_cnt, e_index_t e_cnt, long long tri_cnt, const DegreeStatistics* degree_stats, double planning_time_limit,
+    std::vector< std::pair<int,int> >& best_pairs, int candidate_num, std::vector<ScheduleCandidate>* candidates)
+{
+    // The candidate orders are searched depth first, every vertex after
+    // the first one must be adjacent to an earlier one. Orders that only
+    // differ by an automorphism give the same schedule, so only the
+    // smallest of them is visited. With our modeling, the search starts
+    // from a greedy order and cuts a prefix once a lower bound of its cost
+    // exceeds the best complete order, see order_lower_bound(). It stops
+    // after planning_time_limit seconds; only a search that was not stopped
+    // picks the same order whatever the load and the thread count.
+    OrderSearch search;
+    search.pattern_adj_mat = pattern.get_adj_mat_ptr();
+    search.performance_modeling_type = performance_modeling_type;
+    search.restricts_type = restricts_type;
+    search.use_in_exclusion_optimize = use_in_exclusion_optimize;
+    search.v_cnt = v_cnt;
+    search.e_cnt = e_cnt;
+    search.tri_cnt = tri_cnt;
+    search.degree_stats = degree_stats;
+    search.automorphisms = get_isomorphism_vec();
+
+    std::vector<int> optimize_vertices;
+    get_max_optimize_vertices(optimize_vertices);
+    std::vector<int> greedy_order;
+    get_greedy_order(optimize_vertices, greedy_order);
+    search.optimize_num = 0;
+    if(performance_modeling_type == 1) {
+        // only orders with the largest in_exclusion_optimize_num are candidates
+        k_val = get_vec_optimize_num(greedy_order);
+        search.optimize_num = k_val;
+    }
+    int optimize_num = (use_in_exclusion_optimize && search.optimize_num > 1) ? search.optimize_num : 0;
+    search.loop_size = size - optimize_num;
+
+    search.p_size1 = e_cnt * 1.0 / v_cnt;
+    double p1 = tri_cnt * 1.0 * v_cnt / e_cnt / e_cnt;
+    search.pp_size.resize(size);
+    search.pp_size[0] = 1;
+    for(int i = 1; i < size; ++i)
+        search.pp_size[i] = search.pp_size[i - 1] * p1;
+    search.restrict_rate = 1.0 / search.automorphisms.size();
+    // the intersection costs are only non-negative if the average degree is
+    // at least 1, the bound does not hold for the degree-aware set sizes
+    search.use_bound = performance_modeling_type == 1 && search.p_size1 >= 1 && degree_stats == nullptr;
+
+    // larger patterns have too many candidate restrictions to generate
+    // them all for each order, the orders are compared with GraphZero's
+    // restrictions and ours are only generated for the best one
+    search.all_restricts = restricts_type != 1 || size <= max_all_restricts_size;
+
+    search.start = std::chrono::steady_clock::now();
+    search.time_limit = planning_time_limit;
+    search.stopped = false;
+    search.have_best = false;
+    search.min_val = 1e18;
+    search.best_order = greedy_order;
+    search.candidate_num = candidates != nullptr ? candidate_num : 0;
+    search.tasks = nullptr;
+    search.shared_min_val = nullptr;
+    if(performance_modeling_type == 1) {
+        search.order = greedy_order;
+        evaluate_order(search);
+    }
+
+    search.order.assign(size, -1);
+    search.used.assign(size, false);
+    std::vector<int> stabilizer(search.automorphisms.size());
+    for(int i = 0; i < (int)stabilizer.size(); ++i) stabilizer[i] = i;
+    if(omp_get_max_threads() > 1 && !omp_in_parallel() && size > 2)
+        parallel_search_order(search, stabilizer);
+    else
+        search_order(search, 0, stabilizer);
+    if(!search.all_restricts) {
+        search.all_restricts = true;
+        search.order = search.best_order;
+        evaluate_order(search);
+    }
+    if(!search.have_best) {
+        // no order has restrictions that IEP can keep
+        use_in_exclusion_optimize = search.use_in_exclusion_optimize = false;
+        search.order = search.best_order;
+        evaluate_order(search);
+    }
+
+    copy_adj_mat_from(search.best_order, search.pattern_adj_mat);
+    best_pairs = search.best_pairs;
+    planning_truncated = search.stopped;
+    if(candidates != nullptr)
+        *candidates = search.candidates;
+}
+
 Schedule_IEP::Schedule_IEP(const int* _adj_mat, int _size)
 {
     size = _size;
-    adj_mat = new int[size * size];
+    init_arrays();
 
     memcpy(adj_mat, _adj_mat, size * size * sizeof(int));
 
+    total_prefix_num = 0;
+    total_restrict_num = 0;
+    in_exclusion_optimize_num = 0;
+    is_vertex_induced = true;
+
+    if (!check_connectivity())
+        throw std::runtime_error("pattern is not connected");
+
+    build_loop_invariant();
+
+    set_in_exclusion_optimize_redundancy();
+
+    // print_schedule();
+}
+
+Schedule_IEP::~Schedule_IEP()
+{
+    delete[] adj_mat;
+    delete[] father_prefix_id;
+    delete[] last;
+    delete[] next;
+    delete[] loop_set_prefix_id;
+    delete[] prefix;
+    delete[] restrict_last;
+    delete[] restrict_next;
+    delete[] restrict_index;
+}
+
+Schedule_IEP::Schedule_IEP(const Pattern& pattern, const ScheduleCandidate& candidate, bool vertex_induced)
+{
+    is_vertex_induced = vertex_induced;
+    size = pattern.get_size();
+    init_arrays();
+    copy_adj_mat_from(candidate.order, pattern.get_adj_mat_ptr());
+
+    if (!check_connectivity())
+        throw std::runtime_error("pattern is not connected");
+
+    k_val = get_in_exclusion_optimize_num_when_not_optimize();
+    setup_optimization_info(candidate.use_in_exclusion_optimize && !vertex_induced);
+    add_restrict(candidate.restricts);
+    set_in_exclusion_optimize_redundancy();
+}
+
+std::vector<ScheduleCandidate> Schedule_IEP::get_candidates(const Pattern& pattern, int candidate_num,
+    int restricts_type, bool use_in_exclusion_optimize, int v_cnt, e_index_t e_cnt, long long tri_cnt, const DegreeStatistics* degree_stats)
+{
+    if (tri_cnt == -1)
+        throw std::logic_error("Fatal: Can not use performance modeling if not have triangle number of this dataset.\n");
+
+    Schedule_IEP schedule;
+    schedule.is_vertex_induced = false;
+    schedule.size = pattern.get_size();
+    schedule.init_arrays();
+    memcpy(schedule.adj_mat, pattern.get_adj_mat_ptr(), schedule.size * schedule.size * sizeof(int));
+
+    std::vector<ScheduleCandidate> candidates;
+    std::vector< std::pair<int,int> > best_pairs;
+    schedule.plan_order(pattern, 1, restricts_type, use_in_exclusion_optimize, v_cnt, e_cnt, tri_cnt, degree_stats,
+        default_planning_time_limit, best_pairs,
+        std::max(candidate_num, 1), &candidates);
+    if (!schedule.check_connectivity())
+        throw std::runtime_error("pattern is not connected");
+    return candidates;
+}
+
+void Schedule_IEP::init_arrays()
+{
+    adj_mat = new int[size * size];
+
     // The I-th loop consists of at most the intersection of i-1 VertexSet.
     // So the max number of prefix = 0 + 1 + ... + size-1 = size * (size-1) / 2
     int max_prefix_num = size * (size - 1) / 2 + 1;
@@ -273,38 +382,362 @@ Schedule_IEP::Schedule_IEP(const int* _adj_mat, int _size)
     memset(restrict_last, -1, size * sizeof(int));
     memset(restrict_next, -1, max_prefix_num * sizeof(int));
     memset(restrict_index, -1, max_prefix_num * sizeof(int));
+}
 
+void Schedule_IEP::search_order(OrderSearch& search, int depth, const std::vector<int>& stabilizer)
+{
+    if(search.stopped) return;
+    // without our modeling all the orders cost the same, the first one is taken
+    if(search.performance_modeling_type != 1 && search.have_best) return;
+    if(search.have_best) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - search.start;
+        if(elapsed.count() > search.time_limit) {
+            search.stopped = true;
+            return;
+        }
+        if(search.use_bound && depth > 0 && order_lower_bound(search, depth) > search.prune_val() * (1 + 1e-9))
+            return;
+    }
+    if(depth == size) {
+        evaluate_order(search);
+        return;
+    }
+    if(search.tasks != nullptr && depth == search.split_depth) {
+        search.tasks->push_back(std::make_pair(std::vector<int>(search.order.begin(), search.order.begin() + depth), stabilizer));
+        return;
+    }
+    if(search.optimize_num > 1 && depth == size - search.optimize_num) {
+        // the remaining vertices must be pairwise non-adjacent
+        for(int i = 0; i < size; ++i)
+            for(int j = 0; j < i; ++j)
+                if(!search.used[i] && !search.used[j] && search.pattern_adj_mat[INDEX(i, j, size)])
+                    return;
+    }
 
-    total_prefix_num = 0;
-    total_restrict_num = 0;
-    in_exclusion_optimize_num = 0;
-    is_vertex_induced = true;
+    const int* pattern_adj_mat = search.pattern_adj_mat;
+    std::vector<int> next_stabilizer;
+    for(int v = 0; v < size; ++v) {
+        if(search.used[v]) continue;
+        bool have_edge = depth == 0;
+        for(int i = 0; i < depth && !have_edge; ++i)
+            if(pattern_adj_mat[INDEX(v, search.order[i], size)])
+                have_edge = true;
+        if(!have_edge) continue;
+        // v must be the smallest of its orbit under the automorphisms that fix the prefix
+        bool is_smallest = true;
+        for(int i : stabilizer)
+            if(search.automorphisms[i][v] < v) {
+                is_smallest = false;
+                break;
+            }
+        if(!is_smallest) continue;
+
+        next_stabilizer.clear();
+        for(int i : stabilizer)
+            if(search.automorphisms[i][v] == v)
+                next_stabilizer.push_back(i);
+        search.order[depth] = v;
+        search.used[v] = true;
+        search_order(search, depth + 1, next_stabilizer);
+        search.used[v] = false;
+    }
+}
 
-    if (!check_connectivity())
-        throw std::runtime_error("pattern is not connected");
+// The prefixes are split until there are enough of them to balance the
+// threads. Each thread searches its prefixes with its own copy of the search,
+// and its own schedule to evaluate the orders in, and the prefixes are cut
+// with the best cost found by any thread. The result is the same as that of
+// search_order(), as ties are broken by the order in both.
+void Schedule_IEP::parallel_search_order(OrderSearch& search, const std::vector<int>& stabilizer)
+{
+    int thread_num = omp_get_max_threads();
+    std::vector< std::pair< std::vector<int>, std::vector<int> > > tasks;
+    search.tasks = &tasks;
+    search.split_depth = 0;
+    do {
+        ++search.split_depth;
+        tasks.clear();
+        search_order(search, 0, stabilizer);
+    } while((int)tasks.size() < 4 * thread_num && search.split_depth + 1 < size && !search.stopped);
+    search.tasks = nullptr;
+
+    double shared_min_val = search.min_val;
+#pragma omp parallel
+    {
+        OrderSearch local = search;
+        local.shared_min_val = &shared_min_val;
+        Schedule_IEP schedule;
+        schedule.size = size;
+        schedule.is_vertex_induced = is_vertex_induced;
+        schedule.k_val = k_val;
+        schedule.init_arrays();
+        memcpy(schedule.adj_mat, adj_mat, size * size * sizeof(int));
+#pragma omp for schedule(dynamic)
+        for(int i = 0; i < (int)tasks.size(); ++i) {
+            const std::vector<int>& prefix = tasks[i].first;
+            local.order.assign(size, -1);
+            local.used.assign(size, false);
+            for(int j = 0; j < (int)prefix.size(); ++j) {
+                local.order[j] = prefix[j];
+                local.used[prefix[j]] = true;
+            }
+            schedule.search_order(local, prefix.size(), tasks[i].second);
+            if(local.have_best) {
+#pragma omp critical
+                {
+                    if(local.min_val < shared_min_val) {
+#pragma omp atomic write
+                        shared_min_val = local.min_val;
+                    }
+                }
+            }
+        }
+#pragma omp critical
+        {
+            if(local.have_best && (!search.have_best || local.min_val < search.min_val ||
+                (local.min_val == search.min_val && local.best_order < search.best_order))) {
+                search.have_best = true;
+                search.min_val = local.min_val;
+                search.best_order = local.best_order;
+                search.best_pairs = local.best_pairs;
+            }
+            for(const auto& c : local.candidates)
+                search.add_candidate(c);
+            search.stopped |= local.stopped;
+        }
+    }
+}
 
-    build_loop_invariant();
+void Schedule_IEP::evaluate_order(OrderSearch& search)
+{
+    const std::vector<int>& vec = search.order;
+    copy_adj_mat_from(vec, search.pattern_adj_mat);
 
-    set_in_exclusion_optimize_redundancy();
+    setup_optimization_info(search.use_in_exclusion_optimize);
 
-    // print_schedule();
+    std::vector< std::vector< std::pair<int,int> > > restricts_vector;
+    restricts_vector.clear();
+
+    if(search.restricts_type == 1 && search.all_restricts) {
+        restricts_generate(adj_mat, restricts_vector);
+    }
+    else {
+        Schedule_IEP schedule(adj_mat, size);
+
+        std::vector< std::pair<int,int> > pairs;
+        schedule.GraphZero_aggressive_optimize(pairs);
+
+        restricts_vector.clear();
+        restricts_vector.push_back(pairs);
+    }
+    if (!remove_in_exclusion_invalid_restricts(restricts_vector, in_exclusion_optimize_num, &search.extension_cnt_cache))
+        return;
+
+    if( restricts_vector.size() == 0) {
+        std::vector< std::pair<int,int> > Empty;
+        Empty.clear();
+        restricts_vector.push_back(Empty);
+    }
+
+    // among the orders of the same cost, the lexicographically smallest one is taken
+    bool is_smaller = !search.have_best || vec < search.best_order;
+    for(const auto& pairs : restricts_vector) {
+        double val = 1e18;
+        if (search.performance_modeling_type == 1) {
+            val = new_estimate_schedule_restrict(pairs, search.v_cnt, search.e_cnt, search.tri_cnt, search.degree_stats, &search.extension_cnt_cache);
+        }
+
+        if(search.candidate_num > 0) {
+            ScheduleCandidate c;
+            c.order = vec;
+            c.restricts = pairs;
+            c.use_in_exclusion_optimize = search.use_in_exclusion_optimize;
+            c.cost = val;
+            search.add_candidate(c);
+        }
+
+        if(search.have_best == false || val < search.min_val || (val == search.min_val && is_smaller)) {
+            search.have_best = true;
+            search.min_val = val;
+            search.best_order = vec;
+            search.best_pairs = pairs;
+            is_smaller = false;
+        }
+    }
 }
 
-Schedule_IEP::~Schedule_IEP()
+// The cost of new_estimate_schedule_restrict() is a sum of non-negative terms
+// (if p_size[1] >= 1): the innermost loop size, and for each loop, the
+// intersections it does for the later vertices. The sizes of the loops of a
+// prefix are known, and so are its intersections: a vertex after the prefix
+// has all of its prefix neighbors before it. Only the vertices counted by
+// inclusion-exclusion, at most size - loop_size of those after the prefix,
+// have no intersections. The loop of a vertex after the prefix is at least
+// p_size[1] * pp_size[degree - 1] (or p_size[1]), and the restrictions
+// multiply the total by at least 1 / |automorphisms| (exactly that much if they
+// remove all the automorphisms).
+double Schedule_IEP::order_lower_bound(const OrderSearch& search, int depth) const
 {
-    delete[] adj_mat;
-    delete[] father_prefix_id;
-    delete[] last;
-    delete[] next;
-    delete[] loop_set_prefix_id;
-    delete[] prefix;
-    delete[] restrict_last;
-    delete[] restrict_next;
-    delete[] restrict_index;
+    const int* pattern_adj_mat = search.pattern_adj_mat;
+    const std::vector<int>& order = search.order;
+    double log_size = std::log2(search.p_size1);
+    int loop_num = std::min(depth, search.loop_size);
+    double loop_size[size];
+    double val = 0;
+    for(int i = 0; i < loop_num; ++i) {
+        int cnt_forward = 0;
+        for(int j = 0; j < i; ++j)
+            if(pattern_adj_mat[INDEX(order[j], order[i], size)])
+                ++cnt_forward;
+        loop_size[i] = i ? loop_size[i - 1] * search.p_size1 * search.pp_size[cnt_forward - 1] : search.v_cnt;
+
+        for(int t = i + 1; t < loop_num; ++t) {
+            if(!pattern_adj_mat[INDEX(order[i], order[t], size)]) continue;
+            int c = 0;
+            for(int j = 0; j <= i; ++j)
+                if(pattern_adj_mat[INDEX(order[j], order[t], size)])
+                    ++c;
+            if(c > 1)
+                val += loop_size[i] * search.p_size1 * search.pp_size[c - 2] * log_size;
+        }
+    }
+    if(depth >= search.loop_size)
+        return (val + loop_size[loop_num - 1]) * search.restrict_rate;
+
+    std::vector<double> later_costs;
+    double later_loop_size = 1;
+    for(int v = 0; v < size; ++v) {
+        if(search.used[v]) continue;
+        double cost = 0;
+        int c = 0, degree = 0;
+        for(int i = 0; i < depth; ++i)
+            if(pattern_adj_mat[INDEX(order[i], v, size)]) {
+                ++c;
+                if(c > 1)
+                    cost += loop_size[i] * search.p_size1 * search.pp_size[c - 2] * log_size;
+            }
+        later_costs.push_back(cost);
+        for(int u = 0; u < size; ++u)
+            degree += pattern_adj_mat[INDEX(u, v, size)] != 0;
+        double min_loop_size = search.p_size1 * std::min(search.pp_size[0], search.pp_size[degree - 1]);
+        later_loop_size *= std::min(1.0, min_loop_size);
+    }
+    std::sort(later_costs.begin(), later_costs.end());
+    for(int i = 0; i + size - search.loop_size < (int)later_costs.size(); ++i)
+        val += later_costs[i];
+    val += loop_size[loop_num - 1] * later_loop_size;
+    return val * search.restrict_rate;
+}
+
+// the largest set of pairwise non-adjacent vertices whose removal leaves the
+// pattern connected, i.e. that can end a valid order
+void Schedule_IEP::get_max_optimize_vertices(std::vector<int>& optimize_vertices) const
+{
+    int best_cnt = 0, best_mask = 0;
+    for(int mask = 1; mask < (1 << size); ++mask) {
+        int cnt = __builtin_popcount(mask);
+        if(cnt <= best_cnt || cnt > size - 2) continue;
+        bool independent = true;
+        for(int i = 0; i < size && independent; ++i)
+            for(int j = 0; j < i; ++j)
+                if((mask >> i & 1) && (mask >> j & 1) && adj_mat[INDEX(i, j, size)]) {
+                    independent = false;
+                    break;
+                }
+        if(!independent) continue;
+        int rest = ((1 << size) - 1) ^ mask;
+        int reached = rest & -rest;
+        for(bool changed = true; changed; ) {
+            changed = false;
+            for(int i = 0; i < size; ++i)
+                if((rest >> i & 1) && !(reached >> i & 1))
+                    for(int j = 0; j < size; ++j)
+                        if((reached >> j & 1) && adj_mat[INDEX(i, j, size)]) {
+                            reached |= 1 << i;
+                            changed = true;
+                            break;
+                        }
+        }
+        if(reached == rest) {
+            best_cnt = cnt;
+            best_mask = mask;
+        }
+    }
+    optimize_vertices.clear();
+    for(int i = 0; i < size; ++i)
+        if(best_mask >> i & 1)
+            optimize_vertices.push_back(i);
+}
+
+// Starts from a vertex of the largest degree and takes the vertex with the most
+// edges to the prefix next, the optimize_vertices last.
+void Schedule_IEP::get_greedy_order(const std::vector<int>& optimize_vertices, std::vector<int>& order) const
+{
+    std::vector<bool> used(size, false);
+    for(int v : optimize_vertices) used[v] = true;
+    int degree[size];
+    for(int i = 0; i < size; ++i) {
+        degree[i] = 0;
+        for(int j = 0; j < size; ++j)
+            degree[i] += adj_mat[INDEX(i, j, size)];
+    }
+    order.clear();
+    while(order.size() + optimize_vertices.size() < (unsigned int)size) {
+        int best = -1, best_edge = 0;
+        for(int v = 0; v < size; ++v) {
+            if(used[v]) continue;
+            int edge_cnt = 0;
+            for(int u : order)
+                edge_cnt += adj_mat[INDEX(u, v, size)];
+            if(!order.empty() && edge_cnt == 0) continue;
+            if(best == -1 || edge_cnt > best_edge || (edge_cnt == best_edge && degree[v] > degree[best])) {
+                best = v;
+                best_edge = edge_cnt;
+            }
+        }
+        if(best == -1) break; // not connected
+        used[best] = true;
+        order.push_back(best);
+    }
+    for(int v = 0; v < size; ++v)
+        if(!used[v] || std::find(optimize_vertices.begin(), optimize_vertices.end(), v) != optimize_vertices.end())
+            order.push_back(v);
+}
+
+long long Schedule_IEP::count_linear_extensions(const std::vector< std::pair<int,int> >& pairs,
+    std::map< std::vector< std::pair<int,int> >, long long >* cache) const
+{
+    if(cache != nullptr) {
+        auto it = cache->find(pairs);
+        if(it == cache->end())
+            it = cache->insert(std::make_pair(pairs, count_linear_extensions(pairs))).first;
+        return it->second;
+    }
+    // count[s]: orders of the vertex set s that can begin an order of all the
+    // vertices, only the sets closed under the pairs are reached
+    std::vector<int> before(size, 0);
+    for(const auto& p : pairs)
+        before[p.first] |= 1 << p.second;
+    std::vector<long long> count(1 << size, 0);
+    std::vector<int> sets(1, 0), next_sets;
+    count[0] = 1;
+    for(int i = 0; i < size; ++i) {
+        next_sets.clear();
+        for(int s : sets)
+            for(int v = 0; v < size; ++v)
+                if(!(s >> v & 1) && (before[v] & s) == before[v]) {
+                    if(count[s | 1 << v] == 0)
+                        next_sets.push_back(s | 1 << v);
+                    count[s | 1 << v] += count[s];
+                }
+        sets.swap(next_sets);
+    }
+    return count[(1 << size) - 1];
 }
 
 // note: this function no longer takes `order` as a parameter, instead, it uses `this->adj_mat` directly
-double Schedule_IEP::new_estimate_schedule_restrict(const std::vector<std::pair<int, int>>& pairs, int v_cnt, e_index_t e_cnt, long long tri_cnt)
+double Schedule_IEP::new_estimate_schedule_restrict(const std::vector<std::pair<int, int>>& pairs, int v_cnt, e_index_t e_cnt, long long tri_cnt,
+    const DegreeStatistics* degree_stats, std::map< std::vector< std::pair<int,int> >, long long >* extension_cnt_cache)
 {
     int max_degree = get_max_degree();
 
@@ -327,18 +760,12 @@ double Schedule_IEP::new_estimate_schedule_restrict(const std::vector<std::pair<
     int restricts_size = restricts.size();
     std::sort(restricts.begin(), restricts.end());
 
+    // sum[i]: number of vertex orders satisfying restricts[0..i]
     double sum[restricts_size];
-    for(int i = 0; i < restricts_size; ++i) sum[i] = 0;
-    
-    int tmp[size];
-    for(int i = 0; i < size; ++i) tmp[i] = i;
-    do {
-        for(int i = 0; i < restricts_size; ++i)
-            if(tmp[restricts[i].first] > tmp[restricts[i].second]) {
-                sum[i] += 1;
-            }
-            else break;
-    } while( std::next_permutation(tmp, tmp + size));
+    for(int i = 0; i < restricts_size; ++i) {
+        std::vector< std::pair<int,int> > prefix_restricts(restricts.begin(), restricts.begin() + i + 1);
+        sum[i] = count_linear_extensions(prefix_restricts, extension_cnt_cache);
+    }
     
     double total = 1;
     for(int i = 2; i <= size; ++i) total *= i;
@@ -347,6 +774,31 @@ double Schedule_IEP::new_estimate_schedule_restrict(const std::vector<std::pair<
     for(int i = restricts_size - 1; i > 0; --i)
         sum[i] /= sum[i - 1];
 
+    if(degree_stats != nullptr) {
+        // the same terms with the set sizes of the degree statistics: loop i
+        // intersects N(v_i) with the prefix sets of the later vertices (those
+        // of the in-exclusion ones too), by a merge that is linear in both sizes
+        std::vector< std::vector<double> > set_size;
+        std::vector<double> degree, restrict_rate;
+        get_degree_aware_set_sizes(*degree_stats, restricts, std::vector<double>(sum, sum + restricts_size), set_size, degree, restrict_rate);
+        int loop_size = size - in_exclusion_optimize_num;
+        double val = 1;
+        for(int i = loop_size - 1; i >= 0; --i) {
+            for(int t = i + 1; t < size; ++t) {
+                if(!adj_mat[INDEX(i, t, size)]) continue;
+                int c = 0;
+                for(int j = 0; j < i; ++j)
+                    if(adj_mat[INDEX(j, t, size)])
+                        ++c;
+                if(c > 0)
+                    val += set_size[t][c - 1] + degree[i];
+            }
+            val *= restrict_rate[i];
+            val *= i ? set_size[i].back() : v_cnt;
+        }
+        return val;
+    }
+
     std::vector<int> invariant_size[size];
     for(int i = 0; i < size; ++i) invariant_size[i].clear();
     
@@ -381,6 +833,237 @@ double Schedule_IEP::new_estimate_schedule_restrict(const std::vector<std::pair<
     return val;
 }
 
+double Schedule_IEP::estimate_cost(int v_cnt, e_index_t e_cnt, long long tri_cnt, const DegreeStatistics* degree_stats)
+{
+    return new_estimate_schedule_restrict(restrict_pair, v_cnt, e_cnt, tri_cnt, degree_stats);
+}
+
+// Expected sizes of the candidate sets of the current order on a graph with
+// the given statistics. set_size[i][m] is the size of the intersection of the
+// neighborhoods of the first m + 1 earlier neighbors of vertex i, degree[i]
+// the mean degree of vertex i.
+//
+// Each vertex has a distribution over the degree buckets, weighted by the
+// number of partial embeddings: the first one is a uniform vertex, a vertex
+// with one earlier neighbor is a neighbor of it, one with more is a common
+// neighbor of an edge. Once the loop of vertex i runs over the neighbors of
+// its first earlier neighbor p, the embeddings with p of high degree are more,
+// so p gets the loop size as a weight, and later loops over N(p) are larger
+// (E[d^2] / E[d] instead of E[d] for the second one). The vertices with one
+// earlier neighbor form a forest, and the distributions are the marginals of
+// the weights on it: a weight of p also moves the vertices found from p (and
+// the one p was found from) to its buckets, not only the later ones.
+//
+// The intersection of two neighborhoods is the sampled mean for the bucket
+// pair, of an edge if the two vertices are adjacent in the pattern, of a wedge
+// if they have a common neighbor before vertex i, and of two random vertices
+// otherwise. Every further neighborhood keeps the fraction of the set that the
+// closest earlier one keeps of its own neighborhood.
+//
+// restrict_rate[i] is the fraction of the candidates of vertex i kept by its
+// restrictions (sorted, with the conditional fractions sum of uniform ids).
+// If the ids follow the degrees (stats.id_slope), a restriction also keeps
+// the vertices of some buckets more than others: the fraction is scaled by
+// the chance that the two vertices are in the order of the restriction, and
+// both get the chance of their bucket as a weight. The id rank of a vertex of
+// bucket b is taken as normal, with the mean of the regression and the
+// variance of the rest, so a bucket covers a range of its own size if the
+// slope is +-1.
+void Schedule_IEP::get_degree_aware_set_sizes(const DegreeStatistics& stats, const std::vector< std::pair<int,int> >& restricts,
+    const std::vector<double>& sum, std::vector< std::vector<double> >& set_size, std::vector<double>& degree, std::vector<double>& restrict_rate) const
+{
+    const int bucket_num = DegreeStatistics::bucket_num;
+    std::vector< std::vector<double> > dist(size, std::vector<double>(bucket_num, 0));
+    set_size.assign(size, std::vector<double>());
+    degree.assign(size, 0);
+    restrict_rate.assign(size, 1);
+
+    double v_total = 0, triangle_total = 0;
+    std::vector<int> buckets;
+    for(int b = 0; b < bucket_num; ++b) {
+        v_total += stats.vertex_cnt[b];
+        triangle_total += stats.triangle_rate[b];
+        if(stats.vertex_cnt[b] > 0)
+            buckets.push_back(b);
+    }
+
+    double slope = std::max(-1.0, std::min(1.0, (double)stats.id_slope));
+    std::vector<double> id_mean(bucket_num), id_var(bucket_num);
+    double below = 0;
+    for(int b = 0; b < bucket_num; ++b) {
+        double width = v_total > 0 ? stats.vertex_cnt[b] / v_total : 0;
+        id_mean[b] = 0.5 + slope * (below + width / 2 - 0.5);
+        id_var[b] = ((1 - slope * slope) + slope * slope * width * width) / 12;
+        below += width;
+    }
+    // P(id of x > id of y) for x in bucket bx and y in bucket by
+    auto id_greater = [&](int bx, int by) {
+        double var = id_var[bx] + id_var[by];
+        if(bx == by || var <= 0) return bx == by ? 0.5 : (id_mean[bx] > id_mean[by] ? 1.0 : 0.0);
+        return 0.5 * std::erfc((id_mean[by] - id_mean[bx]) / std::sqrt(2 * var));
+    };
+
+    // the forest: tree_parent[x] is the earlier neighbor x is found from, -1
+    // for the roots, which have prior as their distribution
+    std::vector<int> tree_parent(size, -1);
+    std::vector< std::vector<double> > prior(size, std::vector<double>(bucket_num, 0));
+    std::vector< std::vector<double> > weight(size, std::vector<double>(bucket_num, 1));
+    std::vector< std::vector<double> > up(size, std::vector<double>(bucket_num)), down(size, std::vector<double>(bucket_num));
+    // message of the subtree of y to the buckets of its tree parent
+    auto message = [&](int y, int b) {
+        double val = 0;
+        for(int c : buckets)
+            val += stats.neighbor_rate[b][c] * up[y][c];
+        return val;
+    };
+    // dist of the first n vertices
+    auto update_dist = [&](int n) {
+        for(int x = n - 1; x >= 0; --x) {
+            double total = 0;
+            for(int b : buckets) {
+                up[x][b] = weight[x][b];
+                for(int y = x + 1; y < n; ++y)
+                    if(tree_parent[y] == x)
+                        up[x][b] *= message(y, b);
+                total += up[x][b];
+            }
+            if(total > 0)
+                for(int b : buckets)
+                    up[x][b] /= total;
+        }
+        for(int x = 0; x < n; ++x) {
+            int p = tree_parent[x];
+            for(int c : buckets) {
+                if(p < 0) {
+                    down[x][c] = prior[x][c];
+                    continue;
+                }
+                down[x][c] = 0;
+                for(int b : buckets) {
+                    double val = down[p][b] * weight[p][b] * stats.neighbor_rate[b][c];
+                    for(int y = p + 1; y < n && val != 0; ++y)
+                        if(y != x && tree_parent[y] == p)
+                            val *= message(y, b);
+                    down[x][c] += val;
+                }
+            }
+            double total = 0;
+            for(int b : buckets)
+                total += down[x][b] * up[x][b];
+            for(int b : buckets)
+                dist[x][b] = total > 0 ? down[x][b] * up[x][b] / total : 0;
+        }
+    };
+
+    auto mean_degree = [&](int x) {
+        double val = 0;
+        for(int b = 0; b < bucket_num; ++b)
+            val += dist[x][b] * stats.avg_degree[b];
+        return val;
+    };
+    // mean |N(x) & N(y)| if x is in bucket bx
+    auto common = [&](int x, int bx, int y, int i) {
+        bool adjacent = adj_mat[INDEX(x, y, size)] != 0;
+        bool wedge = false;
+        for(int j = 0; j < i && !wedge; ++j)
+            wedge = adj_mat[INDEX(j, x, size)] && adj_mat[INDEX(j, y, size)];
+        double val = 0;
+        for(int by = 0; by < bucket_num; ++by) {
+            if(dist[y][by] == 0) continue;
+            double c;
+            if(adjacent) {
+                c = stats.edge_common[bx][by];
+                if(c < 0) c = stats.clustering[bx] * std::max(0.0, stats.avg_degree[bx] - 1);
+            }
+            else {
+                c = stats.avg_degree[bx] * stats.avg_degree[by] * stats.random_common_rate;
+                if(wedge) c = stats.wedge_common[bx][by] < 0 ? 1 + c : stats.wedge_common[bx][by];
+            }
+            val += dist[y][by] * c;
+        }
+        return val;
+    };
+
+    std::vector<double> cur(bucket_num);
+    for(int i = 0; i < size; ++i) {
+        std::vector<int> parents;
+        for(int j = 0; j < i; ++j)
+            if(adj_mat[INDEX(j, i, size)])
+                parents.push_back(j);
+
+        if(parents.size() == 0) {
+            for(int b = 0; b < bucket_num; ++b)
+                prior[i][b] = v_total > 0 ? stats.vertex_cnt[b] / v_total : 0;
+        }
+        else {
+            // fractions of the later neighborhoods kept, not conditioned on the first one
+            std::vector<double> rate(parents.size(), 1);
+            for(int m = 2; m < (int)parents.size(); ++m) {
+                rate[m] = 0;
+                for(int k = 0; k < m; ++k) {
+                    double degree = mean_degree(parents[k]);
+                    if(degree == 0) continue;
+                    double c = 0;
+                    for(int b = 0; b < bucket_num; ++b)
+                        if(dist[parents[k]][b] > 0)
+                            c += dist[parents[k]][b] * common(parents[k], b, parents[m], i);
+                    rate[m] = std::max(rate[m], std::min(1.0, c / degree));
+                }
+            }
+
+            // cur[b]: the candidate set size if the first earlier neighbor is in bucket b
+            int p = parents[0];
+            set_size[i].assign(parents.size(), 0);
+            double total = 0;
+            for(int b = 0; b < bucket_num; ++b) {
+                cur[b] = 0;
+                if(dist[p][b] == 0) continue;
+                double val = stats.avg_degree[b];
+                set_size[i][0] += dist[p][b] * val;
+                for(int m = 1; m < (int)parents.size(); ++m) {
+                    val = m == 1 ? std::min(val, common(p, b, parents[1], i)) : val * rate[m];
+                    set_size[i][m] += dist[p][b] * val;
+                }
+                cur[b] = val;
+                total += dist[p][b] * val;
+            }
+
+            if(parents.size() > 1 && triangle_total > 0) {
+                for(int b = 0; b < bucket_num; ++b)
+                    prior[i][b] = stats.triangle_rate[b] / triangle_total;
+            }
+            else
+                tree_parent[i] = p;
+            if(total > 0)
+                for(int b = 0; b < bucket_num; ++b)
+                    weight[p][b] *= cur[b] / total;
+        }
+        update_dist(i + 1);
+
+        for(int j = 0; j < (int)restricts.size(); ++j) {
+            if(restricts[j].second != i) continue;
+            int x = restricts[j].first;
+            std::vector<double> x_rate(bucket_num, 0), i_rate(bucket_num, 0);
+            double kept = 0;
+            for(int bx : buckets)
+                for(int bi : buckets) {
+                    double q = id_greater(bx, bi);
+                    x_rate[bx] += dist[i][bi] * q;
+                    i_rate[bi] += dist[x][bx] * q;
+                    kept += dist[x][bx] * dist[i][bi] * q;
+                }
+            if(kept <= 0) continue;
+            restrict_rate[i] *= std::min(1.0, sum[j] * kept / 0.5);
+            for(int b = 0; b < bucket_num; ++b) {
+                weight[x][b] *= x_rate[b] / kept;
+                weight[i][b] *= i_rate[b] / kept;
+            }
+            update_dist(i + 1);
+        }
+        degree[i] = mean_degree(i);
+    }
+}
+
 void Schedule_IEP::copy_adj_mat_from(const std::vector<int>& vec, const int* src_adj_mat)
 {
     int rank[size];
@@ -518,8 +1201,11 @@ void Schedule_IEP::build_loop_invariant(int in_exclusion_optimize_num)
         // printf("begin to build IEP loop invariant, basic prefix num = %d\n", basic_prefix_num);
         //IEP loop invariant
         in_exclusion_optimize_vertex_id.clear();
+        in_exclusion_optimize_vertex_flag.clear();
+        in_exclusion_optimize_vertex_coef.clear();
         in_exclusion_optimize_coef.clear();
         in_exclusion_optimize_flag.clear();
+        in_exclusion_optimize_ans_pos.clear();
 
         for(int optimize_rank = 0; optimize_rank < in_exclusion_optimize_group.size(); ++optimize_rank) {
             const std::vector< std::vector<int> >& cur_graph = in_exclusion_optimize_group[optimize_rank];
@@ -684,8 +1370,7 @@ void Schedule_IEP::add_restrict(const std::vector< std::pair<int, int> >& restri
 }
 
 int Schedule_IEP::get_multiplicity() const{
-    std::vector< std::vector<int> > isomorphism_vec = get_isomorphism_vec();
-    return isomorphism_vec.size();
+    return CanonicalLabeling(adj_mat, size).get_automorphism_num();
 }
 
 void Schedule_IEP::aggressive_optimize(std::vector< std::pair<int, int> >& ordered_pairs) const
@@ -785,6 +1470,7 @@ void Schedule_IEP::aggressive_optimize(std::vector< std::pair<int, int> >& order
 void Schedule_IEP::aggressive_optimize_get_all_pairs(std::vector< std::vector< std::pair<int, int> > >& ordered_pairs_vector) 
 {
     std::vector< std::vector<int> > isomorphism_vec = get_isomorphism_vec();
+    long long multiplicity = isomorphism_vec.size();
 
     std::vector< std::vector< std::vector<int> > > permutation_groups;
     permutation_groups.clear();
@@ -828,11 +1514,30 @@ void Schedule_IEP::aggressive_optimize_get_all_pairs(std::vector< std::vector< s
     for (const std::pair<int, int>& pair : ordered_pairs)
         base_dag.add_ordered_edge(pair.first, pair.second);
 
-    aggressive_optimize_dfs(base_dag, isomorphism_vec, permutation_groups, ordered_pairs, ordered_pairs_vector);
+    // a valid restriction set is satisfied by n! / |automorphisms| vertex orders (see restricts_generate)
+    long long min_extension_cnt = 1;
+    for (int i = 2; i <= size; ++i)
+        min_extension_cnt *= i;
+    min_extension_cnt /= multiplicity;
+
+    std::set< std::vector< std::pair<int,int> > > visited;
+    aggressive_optimize_dfs(base_dag, isomorphism_vec, permutation_groups, ordered_pairs, ordered_pairs_vector, visited, min_extension_cnt);
 
 }
 
-void Schedule_IEP::aggressive_optimize_dfs(Pattern base_dag, std::vector< std::vector<int> > isomorphism_vec, std::vector< std::vector< std::vector<int> > > permutation_groups, std::vector< std::pair<int,int> > ordered_pairs, std::vector< std::vector< std::pair<int,int> > >& ordered_pairs_vector) {
+// The state of the search only depends on the set of the chosen pairs, not on
+// the order they were chosen in, so each set is only expanded once, and at
+// most max_restricts_search_states sets are. Adding pairs never makes more
+// vertex orders satisfy them, so a set already satisfied by fewer than
+// min_extension_cnt orders can't lead to a valid one.
+void Schedule_IEP::aggressive_optimize_dfs(Pattern base_dag, std::vector< std::vector<int> > isomorphism_vec, std::vector< std::vector< std::vector<int> > > permutation_groups, std::vector< std::pair<int,int> > ordered_pairs, std::vector< std::vector< std::pair<int,int> > >& ordered_pairs_vector, std::set< std::vector< std::pair<int,int> > >& visited, long long min_extension_cnt) {
+    std::vector< std::pair<int,int> > sorted_pairs = ordered_pairs;
+    std::sort(sorted_pairs.begin(), sorted_pairs.end());
+    if (visited.size() >= max_restricts_search_states || !visited.insert(sorted_pairs).second)
+        return;
+    if (count_linear_extensions(ordered_pairs) < min_extension_cnt)
+        return;
+
 
     for (unsigned int i = 0; i < isomorphism_vec.size(); )
     {
@@ -875,7 +1580,7 @@ void Schedule_IEP::aggressive_optimize_dfs(Pattern base_dag, std::vector< std::v
                 next_ordered_pairs.push_back(found_pair);
                 next_base_dag.add_ordered_edge(found_pair.first, found_pair.second);
                 
-                aggressive_optimize_dfs(next_base_dag, next_isomorphism_vec, next_permutation_groups, next_ordered_pairs, ordered_pairs_vector);
+                aggressive_optimize_dfs(next_base_dag, next_isomorphism_vec, next_permutation_groups, next_ordered_pairs, ordered_pairs_vector, visited, min_extension_cnt);
             }
         if( two_element_number >= 1) {
             break;
@@ -940,77 +1645,13 @@ void Schedule_IEP::GraphZero_aggressive_optimize(std::vector< std::pair<int, int
 }
 
 void Schedule_IEP::GraphZero_get_automorphisms(std::vector< std::vector<int> > &Aut) const {
-    int p[size];
-    Aut.clear();
-    for(int i = 0; i < size; ++i) p[i] = i;
-    do{
-        bool tag = true;
-        for(int i = 0; i < size; ++i) {
-            for(int j = 0; j < size; ++j)
-                if( adj_mat[INDEX(i, j, size)] != adj_mat[INDEX(p[i], p[j], size)]) {
-                    tag = false;
-                    break;
-                }
-            if( !tag ) break;
-        }
-        if(tag) {
-            std::vector<int> tmp;
-            tmp.clear();
-            for(int i = 0; i < size; ++i) tmp.push_back(p[i]);
-            Aut.push_back(tmp);
-        }
-    } while( std::next_permutation(p, p + size) );
-
+    Aut = get_isomorphism_vec();
 }
 
+// the automorphisms in lexicographical order
 std::vector< std::vector<int> > Schedule_IEP::get_isomorphism_vec() const
 {
-    unsigned int pow = 1;
-    for (int i = 2; i <= size; ++i)
-        pow *= i;
-    std::vector< std::vector<int> > vec;
-    vec.clear();
-    bool use[size];
-    for (int i = 0; i < size; ++i)
-        use[i] = false;
-    std::vector<int> tmp_vec;
-    get_full_permutation(vec, use, tmp_vec, 0);
-    assert(vec.size() == pow);
-    std::vector< std::vector<int> > isomorphism_vec;
-    isomorphism_vec.clear();
-    for (const std::vector<int>& v : vec)
-    {
-        bool flag = true;
-        for (int i = 0; i < size; ++i)
-            for (int j = i + 1; j < size; ++j)
-                if (adj_mat[INDEX(i, j, size)] != 0)
-                    if (adj_mat[INDEX(v[i], v[j], size)] == 0) // not isomorphism
-                    {
-                        flag = false;
-                        break;
-                    }
-        if (flag == true)
-            isomorphism_vec.push_back(v);
-    }
-    return isomorphism_vec;
-}
-
-void Schedule_IEP::get_full_permutation(std::vector< std::vector<int> >& vec, bool use[], std::vector<int> tmp_vec, int depth) const
-{
-    if (depth == size)
-    {
-        vec.push_back(tmp_vec);
-        return;
-    }
-    for (int i = 0; i < size; ++i)
-        if (use[i] == false)
-        {
-            use[i] = true;
-            tmp_vec.push_back(i);
-            get_full_permutation(vec, use, tmp_vec, depth + 1);
-            tmp_vec.pop_back();
-            use[i] = false;
-        }
+    return CanonicalLabeling(adj_mat, size).get_automorphisms();
 }
 
 std::vector< std::vector<int> > Schedule_IEP::calc_permutation_group(const std::vector<int> vec, int size)
@@ -1408,38 +2049,16 @@ void Schedule_IEP::init_in_exclusion_optimize() {
     int* in_exclusion_val;
     in_exclusion_val = new int[ optimize_num * 2];
 
+    // in_exclusion_val[2n-2] - in_exclusion_val[2n-1] is the number of the
+    // connected spanning subgraphs of K_n with an even number of edges minus
+    // those with an odd number, which is (-1)^(n-1) * (n-1)!. Only this
+    // difference matters in get_in_exclusion_optimize_group().
+    int factorial = 1;
     for(int n = 1; n <= optimize_num; ++n) {
-        DisjointSetUnion dsu(n);
-        int m = n * (n - 1) / 2;
-
-        in_exclusion_val[ 2 * n - 2 ] = 0;
-        in_exclusion_val[ 2 * n - 1 ] = 0;
-
-        if( n == 1) {
-            ++in_exclusion_val[0];
-            continue;
-        }
-
-        std::pair<int,int> edge[m];
-        e_index_t e_cnt = 0;
-        for(int i = 0; i < n; ++i)
-            for(int j = 0; j < i; ++j)
-                edge[e_cnt++] = std::make_pair(i,j);
-
-        for(int s = 0; s < (1<<m); ++s) {
-            dsu.init();
-            int bit_cnt = 0;
-            for(int i = 0; i < m; ++i) 
-                if( s & (1<<i)) {
-                    ++bit_cnt;
-                    dsu.merge(edge[i].first, edge[i].second);
-                }
-            if( dsu.get_set_size() == 1) {
-                if( bit_cnt & 1) ++in_exclusion_val[2 * n -1];
-                else ++in_exclusion_val[ 2 * n - 2];
-            }
-        }
-    }        
+        if( n > 1) factorial *= n - 1;
+        in_exclusion_val[ 2 * n - 2 ] = (n & 1) ? factorial : 0;
+        in_exclusion_val[ 2 * n - 1 ] = (n & 1) ? 0 : factorial;
+    }
 
     in_exclusion_optimize_group.clear();
     in_exclusion_optimize_val.clear();
@@ -1523,6 +2142,133 @@ void Schedule_IEP::print_schedule() const{
     printf("\n");
 }
 
+template <typename T>
+static bool write_vector(FILE* fp, const std::vector<T>& vec)
+{
+    uint64_t len = vec.size();
+    return fwrite(&len, sizeof(len), 1, fp) == 1 && fwrite(vec.data(), sizeof(T), len, fp) == len;
+}
+
+template <typename T>
+static bool read_vector(FILE* fp, std::vector<T>& vec)
+{
+    uint64_t len;
+    if (fread(&len, sizeof(len), 1, fp) != 1 || len > (1 << 24))
+        return false;
+    vec.resize(len);
+    return fread(vec.data(), sizeof(T), len, fp) == len;
+}
+
+static bool write_bool_vector(FILE* fp, const std::vector<bool>& vec)
+{
+    return write_vector(fp, std::vector<char>(vec.begin(), vec.end()));
+}
+
+static bool read_bool_vector(FILE* fp, std::vector<bool>& vec)
+{
+    std::vector<char> buf;
+    if (!read_vector(fp, buf))
+        return false;
+    vec.assign(buf.begin(), buf.end());
+    return true;
+}
+
+bool Schedule_IEP::save(FILE* fp) const
+{
+    int max_prefix_num = size * (size - 1) / 2 + 1;
+    int header[8] = {size, is_vertex_induced, total_prefix_num, basic_prefix_num, total_restrict_num, in_exclusion_optimize_num, k_val, 0};
+    bool ok = fwrite(header, sizeof(int), 8, fp) == 8;
+    ok = ok && fwrite(&in_exclusion_optimize_redundancy, sizeof(long long), 1, fp) == 1;
+    ok = ok && fwrite(adj_mat, sizeof(int), size * size, fp) == (size_t)(size * size);
+    for (int* arr : {last, loop_set_prefix_id, restrict_last})
+        ok = ok && fwrite(arr, sizeof(int), size, fp) == (size_t)size;
+    for (int* arr : {father_prefix_id, next, break_size, restrict_next, restrict_index})
+        ok = ok && fwrite(arr, sizeof(int), max_prefix_num, fp) == (size_t)max_prefix_num;
+    for (int i = 0; i < total_prefix_num && ok; ++i) {
+        int info[3] = {prefix[i].get_size(), prefix[i].get_has_child(), prefix[i].get_only_need_size()};
+        ok = fwrite(info, sizeof(int), 3, fp) == 3 && fwrite(prefix[i].get_data_ptr(), sizeof(int), info[0], fp) == (size_t)info[0];
+    }
+    ok = ok && write_vector(fp, restrict_pair);
+    ok = ok && write_vector(fp, in_exclusion_optimize_vertex_id);
+    ok = ok && write_bool_vector(fp, in_exclusion_optimize_vertex_flag);
+    ok = ok && write_vector(fp, in_exclusion_optimize_vertex_coef);
+    ok = ok && write_vector(fp, in_exclusion_optimize_coef);
+    ok = ok && write_bool_vector(fp, in_exclusion_optimize_flag);
+    ok = ok && write_vector(fp, in_exclusion_optimize_ans_pos);
+    ok = ok && write_vector(fp, in_exclusion_optimize_val);
+    uint64_t group_num = in_exclusion_optimize_group.size();
+    ok = ok && fwrite(&group_num, sizeof(group_num), 1, fp) == 1;
+    for (const auto& group : in_exclusion_optimize_group) {
+        uint64_t set_num = group.size();
+        ok = ok && fwrite(&set_num, sizeof(set_num), 1, fp) == 1;
+        for (const auto& vertices : group)
+            ok = ok && write_vector(fp, vertices);
+    }
+    return ok;
+}
+
+Schedule_IEP* Schedule_IEP::load(FILE* fp)
+{
+    int header[8];
+    if (fread(header, sizeof(int), 8, fp) != 8 || header[0] <= 0 || header[0] > 64)
+        return nullptr;
+    Schedule_IEP* s = new Schedule_IEP();
+    int size = s->size = header[0];
+    s->is_vertex_induced = header[1];
+    s->total_prefix_num = header[2];
+    s->basic_prefix_num = header[3];
+    s->total_restrict_num = header[4];
+    s->in_exclusion_optimize_num = header[5];
+    s->k_val = header[6];
+
+    int max_prefix_num = size * (size - 1) / 2 + 1;
+    s->init_arrays();
+
+    bool ok = s->total_prefix_num >= 0 && s->total_prefix_num <= max_prefix_num;
+    ok = ok && fread(&s->in_exclusion_optimize_redundancy, sizeof(long long), 1, fp) == 1;
+    ok = ok && fread(s->adj_mat, sizeof(int), size * size, fp) == (size_t)(size * size);
+    for (int* arr : {s->last, s->loop_set_prefix_id, s->restrict_last})
+        ok = ok && fread(arr, sizeof(int), size, fp) == (size_t)size;
+    for (int* arr : {s->father_prefix_id, s->next, s->break_size, s->restrict_next, s->restrict_index})
+        ok = ok && fread(arr, sizeof(int), max_prefix_num, fp) == (size_t)max_prefix_num;
+    int data[size];
+    for (int i = 0; i < s->total_prefix_num && ok; ++i) {
+        int info[3];
+        ok = fread(info, sizeof(int), 3, fp) == 3 && info[0] > 0 && info[0] <= size && fread(data, sizeof(int), info[0], fp) == (size_t)info[0];
+        if (ok) {
+            s->prefix[i].init(info[0], data);
+            s->prefix[i].set_has_child(info[1]);
+            s->prefix[i].set_only_need_size(info[2]);
+        }
+    }
+    ok = ok && read_vector(fp, s->restrict_pair);
+    ok = ok && read_vector(fp, s->in_exclusion_optimize_vertex_id);
+    ok = ok && read_bool_vector(fp, s->in_exclusion_optimize_vertex_flag);
+    ok = ok && read_vector(fp, s->in_exclusion_optimize_vertex_coef);
+    ok = ok && read_vector(fp, s->in_exclusion_optimize_coef);
+    ok = ok && read_bool_vector(fp, s->in_exclusion_optimize_flag);
+    ok = ok && read_vector(fp, s->in_exclusion_optimize_ans_pos);
+    ok = ok && read_vector(fp, s->in_exclusion_optimize_val);
+    uint64_t group_num = 0;
+    ok = ok && fread(&group_num, sizeof(group_num), 1, fp) == 1 && group_num <= (1 << 24);
+    if (ok)
+        s->in_exclusion_optimize_group.resize(group_num);
+    for (auto& group : s->in_exclusion_optimize_group) {
+        uint64_t set_num = 0;
+        ok = ok && fread(&set_num, sizeof(set_num), 1, fp) == 1 && set_num <= (uint64_t)size;
+        if (!ok)
+            break;
+        group.resize(set_num);
+        for (auto& vertices : group)
+            ok = ok && read_vector(fp, vertices);
+    }
+    if (!ok) {
+        delete s;
+        return nullptr;
+    }
+    return s;
+}
+
 void Schedule_IEP::GraphZero_performance_modeling(int* best_order, int v_cnt, e_index_t e_cnt) {
     int* order;
     int* rank;
@@ -1657,11 +2403,11 @@ void Schedule_IEP::restrict_selection(int v_cnt, e_index_t e_cnt, long long tri_
         pp_size[i] = pp_size[i-1] * p1;
     }
 
-    double min_val;
-    bool have_best = false;
-    std::vector<int> invariant_size[size];
-
-    for(int cur_restricts = 0; cur_restricts < ordered_pairs_vector.size(); ++cur_restricts) {
+    // the restriction sets are independent, each one takes size! steps
+    std::vector<double> vals(ordered_pairs_vector.size());
+#pragma omp parallel for schedule(dynamic)
+    for(int cur_restricts = 0; cur_restricts < (int)ordered_pairs_vector.size(); ++cur_restricts) {
+        std::vector<int> invariant_size[size];
         std::vector< std::pair<int,int> > &restricts = ordered_pairs_vector[cur_restricts];
         int restricts_size = restricts.size();
         std::sort(restricts.begin(), restricts.end());
@@ -1691,8 +2437,6 @@ void Schedule_IEP::restrict_selection(int v_cnt, e_index_t e_cnt, long long tri_
             sum[i] /= sum[i - 1];
 
         double val = 1;
-        for(int i = 0; i < size; ++i) invariant_size[i].clear();
-        
         for(int i = size - 1; i >= 0; --i) {
             int cnt_forward = 0;
             int cnt_backward = 0;
@@ -1718,45 +2462,117 @@ void Schedule_IEP::restrict_selection(int v_cnt, e_index_t e_cnt, long long tri_
             val *= p_size[1] * pp_size[cnt_forward-1];
         
         }
-        if( have_best == false || val < min_val) {
-            have_best = true;
-            best_restricts = restricts;
-            min_val = val;
-        }
+        vals[cur_restricts] = val;
         
         delete[] sum;
         delete[] tmp;
 
     }
 
+    double min_val;
+    bool have_best = false;
+    for(int cur_restricts = 0; cur_restricts < (int)ordered_pairs_vector.size(); ++cur_restricts)
+        if( have_best == false || vals[cur_restricts] < min_val) {
+            have_best = true;
+            best_restricts = ordered_pairs_vector[cur_restricts];
+            min_val = vals[cur_restricts];
+        }
+
     delete[] p_size;
     delete[] pp_size;
     assert(have_best);
 }
 
+// A restriction set is kept if it counts each subgraph once. On a complete
+// graph with size + 1 vertices, that is if the restrictions are satisfied by
+// n! / |automorphisms| of the n! orders of the vertex ids of an embedding.
 void Schedule_IEP::restricts_generate(const int* cur_adj_mat, std::vector< std::vector< std::pair<int,int> > > &restricts) {
     Schedule_IEP schedule(cur_adj_mat, get_size());
     schedule.aggressive_optimize_get_all_pairs(restricts);
-    int size = schedule.get_size();
-    Graph* complete;
-    DataLoader* D = new DataLoader();
-    assert(D->load_data(complete, size + 1));
-    long long ans = complete->pattern_matching( schedule, 1) / schedule.get_multiplicity();
-    int thread_num = 1;
+    long long total = 1;
+    for(int i = 2; i <= size; ++i) total *= i;
+    long long multiplicity = schedule.get_multiplicity();
     for(int i = 0; i < restricts.size(); ) {
-        Schedule_IEP cur_schedule(schedule.get_adj_mat_ptr(), schedule.get_size());
-        cur_schedule.add_restrict(restricts[i]);
-        long long cur_ans = complete->pattern_matching( cur_schedule, thread_num);
-        if( cur_ans != ans) {
+        if( schedule.count_linear_extensions(restricts[i]) * multiplicity != total) {
             restricts.erase(restricts.begin() + i);
         }
         else {
             ++i;
         }
     }
+    // the search of aggressive_optimize_get_all_pairs() may stop before it finds one
+    if( restricts.size() == 0) {
+        std::vector< std::pair<int,int> > pairs;
+        schedule.GraphZero_aggressive_optimize(pairs);
+        restricts.push_back(pairs);
+    }
+}
 
-    delete complete;
-    delete D;
+// IEP counts the last optimize_num vertices without their restrictions and the
+// answer is then divided by a redundancy measured on a complete graph. That is
+// only exact if, whatever the relative order of the vertex ids of an
+// embedding, the same number of its automorphic copies passes the remaining
+// restrictions. Restriction sets that break this are removed.
+//
+// For an order of the vertex ids, let f be the number of automorphic copies
+// that pass the restrictions of the loops. Over the n! orders,
+// E[f] = |Aut| * L(R) / n! and E[f^2] = |Aut| * sum_iso L(R + iso(R)) / n!,
+// with L the number of orders satisfying a set of restrictions. f is constant
+// iff E[f^2] = E[f]^2.
+//
+// Returns false if every set was removed. The order must then not be used
+// with IEP: an empty restrictions_vector would be taken for a pattern without
+// restrictions and every subgraph counted once per automorphism.
+bool Schedule_IEP::remove_in_exclusion_invalid_restricts(std::vector< std::vector< std::pair<int,int> > > &restricts_vector, int optimize_num,
+    std::map< std::vector< std::pair<int,int> >, long long >* extension_cnt_cache) const {
+    if (optimize_num <= 1 || restricts_vector.empty())
+        return true;
+    int loop_size = size - optimize_num;
+    std::vector< std::vector<int> > isomorphism_vec = get_isomorphism_vec();
+    long long total = 1;
+    for (int i = 2; i <= size; ++i)
+        total *= i;
+    for (int i = 0; i < (int)restricts_vector.size(); ) {
+        const std::vector< std::pair<int,int> > &pairs = restricts_vector[i];
+        bool has_ignored = false;
+        std::vector< std::pair<int,int> > loop_pairs;
+        for (const auto &p : pairs)
+            if (p.second >= loop_size)
+                has_ignored = true;
+            else
+                loop_pairs.push_back(p);
+        bool is_valid = true;
+        if (has_ignored) {
+            long long extension_cnt = count_linear_extensions(loop_pairs, extension_cnt_cache);
+            long long expected = isomorphism_vec.size() * extension_cnt;
+            if (expected % total != 0)
+                is_valid = false;
+            else {
+                expected /= total;
+                // many automorphisms map the restrictions to the same pairs
+                std::map< std::vector< std::pair<int,int> >, long long > images;
+                for (const auto &iso : isomorphism_vec) {
+                    std::vector< std::pair<int,int> > image;
+                    for (const auto &p : loop_pairs)
+                        image.push_back(std::make_pair(iso[p.first], iso[p.second]));
+                    std::sort(image.begin(), image.end());
+                    ++images[image];
+                }
+                long long square_sum = 0;
+                for (const auto &image : images) {
+                    std::vector< std::pair<int,int> > both = loop_pairs;
+                    both.insert(both.end(), image.first.begin(), image.first.end());
+                    square_sum += image.second * count_linear_extensions(both, extension_cnt_cache);
+                }
+                is_valid = square_sum == expected * extension_cnt;
+            }
+        }
+        if (is_valid)
+            ++i;
+        else
+            restricts_vector.erase(restricts_vector.begin() + i);
+    }
+    return !restricts_vector.empty();
 }
 
 int Schedule_IEP::get_vec_optimize_num(const std::vector<int> &vec) {
@@ -1819,18 +2635,12 @@ double Schedule_IEP::our_estimate_schedule_restrict(const std::vector<int> &orde
     int restricts_size = restricts.size();
     std::sort(restricts.begin(), restricts.end());
 
+    // sum[i]: number of vertex orders satisfying restricts[0..i]
     double sum[restricts_size];
-    for(int i = 0; i < restricts_size; ++i) sum[i] = 0;
-    
-    int tmp[size];
-    for(int i = 0; i < size; ++i) tmp[i] = i;
-    do {
-        for(int i = 0; i < restricts_size; ++i)
-            if(tmp[restricts[i].first] > tmp[restricts[i].second]) {
-                sum[i] += 1;
-            }
-            else break;
-    } while( std::next_permutation(tmp, tmp + size));
+    for(int i = 0; i < restricts_size; ++i) {
+        std::vector< std::pair<int,int> > prefix_restricts(restricts.begin(), restricts.begin() + i + 1);
+        sum[i] = count_linear_extensions(prefix_restricts);
+    }
     
     double total = 1;
     for(int i = 2; i <= size; ++i) total *= i;
@@ -1901,18 +2711,12 @@ double Schedule_IEP::GraphZero_estimate_schedule_restrict(const std::vector<int>
     int restricts_size = restricts.size();
     std::sort(restricts.begin(), restricts.end());
     
+    // sum[i]: number of vertex orders satisfying restricts[0..i]
     double sum[restricts_size];
-    for(int i = 0; i < restricts_size; ++i) sum[i] = 0;
-    
-    int tmp[size];
-    for(int i = 0; i < size; ++i) tmp[i] = i;
-    do {
-        for(int i = 0; i < restricts_size; ++i)
-            if(tmp[restricts[i].first] > tmp[restricts[i].second]) {
-                sum[i] += 1;
-            }
-            else break;
-    } while( std::next_permutation(tmp, tmp + size));
+    for(int i = 0; i < restricts_size; ++i) {
+        std::vector< std::pair<int,int> > prefix_restricts(restricts.begin(), restricts.begin() + i + 1);
+        sum[i] = count_linear_extensions(prefix_restricts);
+    }
     
     double total = 1;
     for(int i = 2; i <= size; ++i) total *= i;
@@ -2016,53 +2820,25 @@ double Schedule_IEP::Naive_estimate_schedule_restrict(const std::vector<int> &or
     return val;
 }
 
-void Schedule_IEP::remove_invalid_permutation(std::vector< std::vector<int> > &candidate_permutations) {
-    for(unsigned int i = 0; i < candidate_permutations.size(); ) {
-        const auto& vec = candidate_permutations[i];
-        bool tag = true;
-        for(int x = 1; x < size; ++x) {
-            bool have_edge = false;
-            for(int y = 0; y < x; ++y)
-                if(adj_mat[INDEX(vec[x],vec[y],size)]) {
-                    have_edge = true;
-                    break;
-                }
-            if(!have_edge) {
-                tag = false;
-                break;
-            }
-        }
-        if(tag) {
-            ++i;
-        }
-        else {
-            candidate_permutations.erase(candidate_permutations.begin() + i);
-        }
-    }
-}
-
 int Schedule_IEP::get_in_exclusion_optimize_num_when_not_optimize() {
     std::vector<int> I;
     for(int i = 0; i < size; ++i) I.push_back(i);
     return get_vec_optimize_num(I);
 }
 
+// IEP ignores the restrictions of the last in_exclusion_optimize_num vertices,
+// so on a complete graph it counts each subgraph once per vertex id order that
+// satisfies the other restrictions, instead of once per order satisfying all.
 void Schedule_IEP::set_in_exclusion_optimize_redundancy() {
     int tmp = get_in_exclusion_optimize_num();
     if(tmp <= 1) {
         in_exclusion_optimize_redundancy = 1;
     }
     else {
-        Graph* complete;
-        DataLoader* D = new DataLoader();
-        assert(D->load_complete(complete, get_size()));
-        delete D;
-        in_exclusion_optimize_redundancy = 1;
-        long long ans = complete->pattern_matching( *this, 1);
-        set_in_exclusion_optimize_num(0);
-        long long true_ans = complete->pattern_matching( *this, 1);
-        set_in_exclusion_optimize_num(tmp);
-        delete complete;
-        in_exclusion_optimize_redundancy = ans / true_ans;
+        std::vector< std::pair<int,int> > loop_pairs;
+        for(const auto& p : restrict_pair)
+            if(p.second < size - tmp)
+                loop_pairs.push_back(p);
+        in_exclusion_optimize_redundancy = count_linear_extensions(loop_pairs) / count_linear_extensions(restrict_pair);
     }
 }
@@ -0,0 +1,186 @@
+#include "../include/schedule_plan.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+static const char schedule_plan_magic[8] = {'G', 'M', 'S', 'P', 'L', 'N', '0', '1'};
+
+// header, then the arrays in the order of SchedulePlan::Array
+static void get_array_lengths(const SchedulePlan& plan, int* len)
+{
+    len[SchedulePlan::AdjMat] = plan.size * plan.size;
+    len[SchedulePlan::LoopSetPrefixId] = plan.size;
+    len[SchedulePlan::Last] = plan.size;
+    len[SchedulePlan::Next] = plan.total_prefix_num;
+    len[SchedulePlan::FatherPrefixId] = plan.total_prefix_num;
+    len[SchedulePlan::BreakSize] = plan.total_prefix_num;
+    len[SchedulePlan::RestrictLast] = plan.size;
+    len[SchedulePlan::RestrictNext] = plan.total_restrict_num;
+    len[SchedulePlan::RestrictIndex] = plan.total_restrict_num;
+    len[SchedulePlan::RestrictPair] = 2 * plan.restrict_pair_num;
+    len[SchedulePlan::IepVertexId] = plan.iep_vertex_num;
+    len[SchedulePlan::IepVertexFlag] = plan.iep_vertex_num;
+    len[SchedulePlan::IepVertexCoef] = plan.iep_vertex_num;
+    len[SchedulePlan::IepCoef] = plan.iep_term_num;
+    len[SchedulePlan::IepFlag] = plan.iep_term_num;
+    len[SchedulePlan::IepAnsPos] = plan.iep_term_num;
+}
+
+static uint32_t get_byte_size(int end_offset)
+{
+    return ((uint32_t)end_offset * sizeof(int) + 63) / 64 * 64;
+}
+
+static SchedulePlan* allocate(uint32_t byte_size)
+{
+    void* data = aligned_alloc(64, byte_size);
+    memset(data, 0, byte_size);
+    return static_cast<SchedulePlan*>(data);
+}
+
+SchedulePlan* SchedulePlan::create(const Schedule_IEP& schedule)
+{
+    SchedulePlan header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, schedule_plan_magic, 8);
+    header.size = schedule.get_size();
+    header.total_prefix_num = schedule.get_total_prefix_num();
+    header.basic_prefix_num = schedule.get_basic_prefix_num();
+    header.total_restrict_num = schedule.get_total_restrict_num();
+    header.restrict_pair_num = schedule.restrict_pair.size();
+    header.in_exclusion_optimize_num = schedule.get_in_exclusion_optimize_num();
+    // the IEP arrays are left over from the planning if IEP is not used
+    if (header.in_exclusion_optimize_num > 0) {
+        header.iep_vertex_num = schedule.in_exclusion_optimize_vertex_id.size();
+        header.iep_term_num = schedule.in_exclusion_optimize_coef.size();
+    }
+    header.is_vertex_induced = schedule.is_vertex_induced;
+    header.in_exclusion_optimize_redundancy = schedule.get_in_exclusion_optimize_redundancy();
+
+    int len[ArrayNum];
+    get_array_lengths(header, len);
+    header.offset[0] = sizeof(SchedulePlan) / sizeof(int);
+    for (int a = 0; a < ArrayNum; ++a)
+        header.offset[a + 1] = header.offset[a] + len[a];
+    header.byte_size = get_byte_size(header.offset[ArrayNum]);
+
+    SchedulePlan* plan = allocate(header.byte_size);
+    memcpy(plan, &header, sizeof(header));
+    int* data = reinterpret_cast<int*>(plan);
+    int size = header.size;
+    memcpy(data + header.offset[AdjMat], schedule.get_adj_mat_ptr(), sizeof(int) * size * size);
+    for (int i = 0; i < size; ++i) {
+        data[header.offset[LoopSetPrefixId] + i] = schedule.get_loop_set_prefix_id(i);
+        data[header.offset[Last] + i] = schedule.get_last(i);
+        data[header.offset[RestrictLast] + i] = schedule.get_restrict_last(i);
+    }
+    for (int i = 0; i < header.total_prefix_num; ++i) {
+        data[header.offset[Next] + i] = schedule.get_next(i);
+        data[header.offset[FatherPrefixId] + i] = schedule.get_father_prefix_id(i);
+        data[header.offset[BreakSize] + i] = schedule.break_size[i];
+    }
+    for (int i = 0; i < header.total_restrict_num; ++i) {
+        data[header.offset[RestrictNext] + i] = schedule.get_restrict_next(i);
+        data[header.offset[RestrictIndex] + i] = schedule.get_restrict_index(i);
+    }
+    for (int i = 0; i < header.restrict_pair_num; ++i) {
+        data[header.offset[RestrictPair] + 2 * i] = schedule.restrict_pair[i].first;
+        data[header.offset[RestrictPair] + 2 * i + 1] = schedule.restrict_pair[i].second;
+    }
+    for (int i = 0; i < header.iep_vertex_num; ++i) {
+        data[header.offset[IepVertexId] + i] = schedule.in_exclusion_optimize_vertex_id[i];
+        data[header.offset[IepVertexFlag] + i] = schedule.in_exclusion_optimize_vertex_flag[i];
+        data[header.offset[IepVertexCoef] + i] = schedule.in_exclusion_optimize_vertex_coef[i];
+    }
+    for (int i = 0; i < header.iep_term_num; ++i) {
+        data[header.offset[IepCoef] + i] = schedule.in_exclusion_optimize_coef[i];
+        data[header.offset[IepFlag] + i] = schedule.in_exclusion_optimize_flag[i];
+        data[header.offset[IepAnsPos] + i] = schedule.in_exclusion_optimize_ans_pos[i];
+    }
+    assert(check(plan, plan->byte_size));
+    return plan;
+}
+
+void SchedulePlan::destroy(SchedulePlan* plan)
+{
+    free(plan);
+}
+
+SchedulePlan* SchedulePlan::clone() const
+{
+    SchedulePlan* plan = allocate(byte_size);
+    memcpy(plan, this, byte_size);
+    return plan;
+}
+
+static bool in_range(const int* arr, int len, int lo, int hi)
+{
+    for (int i = 0; i < len; ++i)
+        if (arr[i] < lo || arr[i] >= hi)
+            return false;
+    return true;
+}
+
+// Every index the engine follows stays inside its array, so a corrupted plan
+// is rejected instead of read out of bounds.
+bool SchedulePlan::check(const void* data, size_t len)
+{
+    if (len < sizeof(SchedulePlan))
+        return false;
+    const SchedulePlan& plan = *static_cast<const SchedulePlan*>(data);
+    if (memcmp(plan.magic, schedule_plan_magic, 8) != 0 || plan.byte_size != len)
+        return false;
+    int size = plan.size, max_prefix_num = size * (size - 1) / 2 + 1;
+    if (size <= 0 || size > 64 || plan.total_prefix_num < 0 || plan.total_prefix_num > max_prefix_num
+        || plan.basic_prefix_num < 0 || plan.basic_prefix_num > plan.total_prefix_num
+        || plan.total_restrict_num < 0 || plan.total_restrict_num > max_prefix_num
+        || plan.restrict_pair_num < 0 || plan.restrict_pair_num > max_prefix_num
+        || plan.in_exclusion_optimize_num < 0 || plan.in_exclusion_optimize_num > size
+        || plan.iep_vertex_num < 0 || plan.iep_vertex_num > (1 << 20)
+        || plan.iep_term_num < 0 || plan.iep_term_num > (1 << 20)
+        || plan.in_exclusion_optimize_redundancy <= 0)
+        return false;
+    int array_len[ArrayNum];
+    get_array_lengths(plan, array_len);
+    if (plan.offset[0] != (int)(sizeof(SchedulePlan) / sizeof(int)))
+        return false;
+    for (int a = 0; a < ArrayNum; ++a)
+        if (plan.offset[a + 1] != plan.offset[a] + array_len[a])
+            return false;
+    if (plan.byte_size != get_byte_size(plan.offset[ArrayNum]))
+        return false;
+
+    int prefix_num = plan.total_prefix_num, restrict_num = plan.total_restrict_num;
+    return in_range(plan.get_array(LoopSetPrefixId) + 1, size - 1, 0, prefix_num)
+        && in_range(plan.get_array(Last), size, -1, prefix_num)
+        && in_range(plan.get_array(Next), prefix_num, -1, prefix_num)
+        && in_range(plan.get_array(FatherPrefixId), prefix_num, -1, prefix_num)
+        && in_range(plan.get_array(RestrictLast), size, -1, restrict_num)
+        && in_range(plan.get_array(RestrictNext), restrict_num, -1, restrict_num)
+        && in_range(plan.get_array(RestrictIndex), restrict_num, 0, size)
+        && in_range(plan.get_array(RestrictPair), 2 * plan.restrict_pair_num, 0, size)
+        && in_range(plan.get_array(IepVertexId), plan.iep_vertex_num, 0, prefix_num)
+        && in_range(plan.get_array(IepAnsPos), plan.iep_term_num, 0, plan.iep_vertex_num);
+}
+
+bool SchedulePlan::save(FILE* fp) const
+{
+    return fwrite(this, 1, byte_size, fp) == byte_size;
+}
+
+SchedulePlan* SchedulePlan::load(FILE* fp)
+{
+    SchedulePlan header;
+    if (fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, schedule_plan_magic, 8) != 0
+        || header.byte_size < sizeof(header) || header.byte_size % 64 != 0 || header.byte_size > (1u << 28))
+        return nullptr;
+    SchedulePlan* plan = allocate(header.byte_size);
+    memcpy(plan, &header, sizeof(header));
+    size_t rest = header.byte_size - sizeof(header);
+    if (fread(reinterpret_cast<char*>(plan) + sizeof(header), 1, rest, fp) != rest || !check(plan, plan->byte_size)) {
+        destroy(plan);
+        return nullptr;
+    }
+    return plan;
+}
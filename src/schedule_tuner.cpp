@@ -0,0 +1,152 @@
+#include "../include/schedule_tuner.h"
+#include "../include/common.h"
+#include "../include/degree_statistics.h"
+
+#include <omp.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+ScheduleTuner::ScheduleTuner(Graph* _g, int _candidate_num, double _budget_fraction, unsigned int seed)
+    : g(_g), candidate_num(_candidate_num), budget_fraction(_budget_fraction), candidate_cnt(0), picked_rank(0), round_cnt(0),
+      sample_cnt(0), tuning_time(0), expected_time(0), estimated_count(0) {
+    buckets.resize(DegreeStatistics::bucket_num);
+    for (v_index_t v = 0; v < g->v_cnt; ++v)
+        buckets[DegreeStatistics::get_bucket(g->vertex[v + 1] - g->vertex[v])].push_back(v);
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    for (auto& bucket : buckets) {
+        std::shuffle(bucket.begin(), bucket.end(), rng);
+        rounding.push_back(uniform(rng));
+    }
+}
+
+int ScheduleTuner::sample_size(int b, double rate) const {
+    if (rate >= 1)
+        return buckets[b].size();
+    return std::min((int)buckets[b].size(), (int)std::floor(rate * buckets[b].size() + rounding[b]));
+}
+
+void ScheduleTuner::run_sample(const Schedule_IEP& schedule, const std::vector<int>& begin, const std::vector<int>& end,
+    double& time_sum, double& count_sum) {
+    std::vector<v_index_t> sample;
+    for (int b = 0; b < (int)buckets.size(); ++b)
+        sample.insert(sample.end(), buckets[b].begin() + begin[b], buckets[b].begin() + end[b]);
+
+    SchedulePlan* plan = SchedulePlan::create(schedule);
+    double time = 0, count = 0;
+#pragma omp parallel reduction(+ : time, count)
+    {
+        int* ans_buffer = new int[plan->iep_vertex_num];
+        VertexSet* vertex_set = g->new_vertex_sets(plan->get_total_prefix_num() + 10);
+        VertexSet subtraction_set(g->get_max_intersection_size());
+        VertexSet tmp_set(g->get_max_intersection_size());
+        subtraction_set.init();
+#pragma omp for schedule(dynamic) nowait
+        for (int i = 0; i < (int)sample.size(); ++i) {
+            double t = omp_get_wtime();
+            count += g->pattern_matching_vertex_task(*plan, sample[i], vertex_set, subtraction_set, tmp_set, ans_buffer);
+            time += omp_get_wtime() - t;
+        }
+        delete[] vertex_set;
+        delete[] ans_buffer;
+    }
+    SchedulePlan::destroy(plan);
+    time_sum += time;
+    count_sum += count;
+}
+
+Schedule_IEP* ScheduleTuner::tune(const Pattern& pattern, bool& is_pattern_valid, int restricts_type, bool use_in_exclusion_optimize,
+    bool use_degree_stats) {
+    double start = get_wall_time();
+    candidate_cnt = 0;
+    is_pattern_valid = pattern.check_connected();
+    if (!is_pattern_valid)
+        return nullptr;
+    std::vector<ScheduleCandidate> candidates = Schedule_IEP::get_candidates(pattern, candidate_num, restricts_type, use_in_exclusion_optimize,
+        g->v_cnt, g->e_cnt, g->tri_cnt, use_degree_stats ? g->degree_stats : nullptr);
+    if (candidates.empty()) {
+        is_pattern_valid = false;
+        return nullptr;
+    }
+    int n = candidate_cnt = candidates.size();
+    std::vector<Schedule_IEP*> schedules(n);
+    for (int i = 0; i < n; ++i)
+        schedules[i] = new Schedule_IEP(pattern, candidates[i]);
+
+    int bucket_num = buckets.size();
+    std::vector<double> time_sum(n, 0), count_sum(n, 0);
+    std::vector<int> alive;
+    for (int i = 0; i < n; ++i)
+        alive.push_back(i);
+    std::vector<int> sampled(bucket_num, 0), next_sampled(bucket_num, 0);
+    double rate = std::min(1.0, (double)first_round_samples / std::max(g->v_cnt, 1));
+    round_cnt = 0;
+    sample_cnt = 0;
+    int best = 0;
+    while (n > 1) {
+        long long new_cnt = 0;
+        for (int b = 0; b < bucket_num; ++b) {
+            next_sampled[b] = sample_size(b, rate);
+            new_cnt += next_sampled[b] - sampled[b];
+        }
+        double round_start = get_wall_time();
+        bool over_budget = false;
+        for (int c : alive) {
+            run_sample(*schedules[c], sampled, next_sampled, time_sum[c], count_sum[c]);
+            // the first round has no earlier one to extrapolate: the candidate
+            // ranked best runs first, and the others run only if as many times
+            // its time fit in the budget
+            if (round_cnt == 0 && c == alive[0]) {
+                double first_time = get_wall_time() - round_start;
+                double expected = time_sum[c] / rate / omp_get_max_threads();
+                over_budget = get_wall_time() - start + first_time * (alive.size() - 1) > budget_fraction * expected;
+                if (over_budget)
+                    break;
+            }
+        }
+        double round_time = get_wall_time() - round_start;
+        sampled = next_sampled;
+        sample_cnt += new_cnt;
+        if (over_budget) {
+            best = alive[0];
+            break;
+        }
+        ++round_cnt;
+
+        best = alive[0];
+        for (int c : alive)
+            if (time_sum[c] < time_sum[best])
+                best = c;
+        int alive_cnt = alive.size();
+        std::vector<int> next_alive;
+        for (int c : alive)
+            if (time_sum[c] <= drop_ratio * time_sum[best])
+                next_alive.push_back(c);
+        alive = next_alive;
+
+        if (alive.size() == 1 || rate >= 1)
+            break;
+        double next_rate = std::min(1.0, rate * 4);
+        long long next_cnt = 0;
+        for (int b = 0; b < bucket_num; ++b)
+            next_cnt += sample_size(b, next_rate) - sampled[b];
+        double next_round_time = new_cnt > 0 ? round_time * alive.size() / alive_cnt * next_cnt / new_cnt : 0;
+        double expected = time_sum[best] / rate / omp_get_max_threads();
+        if (get_wall_time() - start + next_round_time > budget_fraction * expected)
+            break;
+        rate = next_rate;
+    }
+
+    picked_rank = best;
+    expected_time = n > 1 ? time_sum[best] / rate / omp_get_max_threads() : 0;
+    estimated_count = n > 1 ? count_sum[best] / rate / schedules[best]->get_in_exclusion_optimize_redundancy() : 0;
+    for (int i = 0; i < n; ++i)
+        if (i != best)
+            delete schedules[i];
+    tuning_time = get_wall_time() - start;
+    printf("autotune: %d candidates, %d rounds, %lld start vertices, picked rank %d, tuning %.6lf s, expected %.6lf s\n",
+        n, round_cnt, sample_cnt, picked_rank, tuning_time, expected_time);
+    return schedules[best];
+}
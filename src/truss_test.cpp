@@ -0,0 +1,73 @@
+#include <../include/graph.h>
+#include <../include/dataloader.h>
+#include "../include/pattern.h"
+#include "../include/common.h"
+
+#include <assert.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+// Edge support and truss decomposition. With a pattern, the pattern is also
+// counted on the k-truss of its truss number.
+int main(int argc,char *argv[]) {
+    Graph *g;
+    DataLoader D;
+
+    if(argc != 2 && argc != 4) {
+        printf("usage: %s graph_file [pattern_size pattern_adjacency_matrix]\n", argv[0]);
+        return 0;
+    }
+
+    bool ok = D.fast_load(g, argv[1]);
+    if(!ok) { printf("Load data failed\n"); return 0; }
+
+    printf("Load data success!\n");
+    fflush(stdout);
+    printf("thread count: %d\n", omp_get_max_threads());
+
+    double t1 = get_wall_time();
+    int *support = g->edge_support();
+    double t2 = get_wall_time();
+    int *truss = g->truss_decomposition(support);
+    double t3 = get_wall_time();
+
+    int max_truss = 2;
+    for (e_index_t i = 0; i < g->e_cnt; ++i)
+        max_truss = std::max(max_truss, truss[i]);
+    // edges of each truss number, each edge is stored twice
+    std::vector<long long> truss_edge_cnt(max_truss + 1, 0);
+    for (e_index_t i = 0; i < g->e_cnt; ++i)
+        ++truss_edge_cnt[truss[i]];
+    for (int k = 2; k <= max_truss; ++k)
+        if (truss_edge_cnt[k] != 0)
+            printf("truss %d: %lld edges\n", k, truss_edge_cnt[k] / 2);
+    printf("max truss: %d\n", max_truss);
+    printf("Support time cost: %.6lf s\n", t2 - t1);
+    printf("Peeling time cost: %.6lf s\n", t3 - t2);
+
+    if (argc == 4) {
+        Pattern p(atoi(argv[2]), argv[3]);
+        int k = p.get_truss_number();
+        Graph *h = g->truss_subgraph(k, truss);
+        printf("pattern truss number: %d, %lld of %lld edges kept\n", k, (long long)h->e_cnt / 2, (long long)g->e_cnt / 2);
+        bool is_pattern_valid;
+        Schedule_IEP schedule(p, is_pattern_valid, 1, 1, true, h->v_cnt, h->e_cnt, h->tri_cnt);
+        if (!is_pattern_valid) {
+            printf("pattern is invalid!\n");
+        } else {
+            double t4 = get_wall_time();
+            long long ans = h->pattern_matching(schedule);
+            double t5 = get_wall_time();
+            printf("ans %lld\n", ans);
+            printf("Counting time cost: %.6lf s\n", t5 - t4);
+        }
+        delete h;
+    }
+
+    delete[] support;
+    delete[] truss;
+    delete g;
+    return 0;
+}
@@ -5,7 +5,11 @@
 int VertexSet::max_intersection_size = -1;
 
 VertexSet::VertexSet()
-:data(nullptr), size(0), allocate(false)
+:data(nullptr), size(0), allocate(false), capacity(-1)
+{}
+
+VertexSet::VertexSet(int _capacity)
+:data(nullptr), size(0), allocate(false), capacity(_capacity)
 {}
 
 void VertexSet::init()
@@ -16,7 +20,8 @@ void VertexSet::init()
     {
         size = 0;
         allocate = true;
-        data = new int[max_intersection_size * 2];
+        // at least room for the vertices of an embedding, on graphs of tiny degrees
+        data = new int[std::max(capacity >= 0 ? capacity : max_intersection_size, 32) * 2];
     }
 }
 
@@ -214,6 +219,25 @@ void VertexSet::build_vertex_set(const Schedule_IEP& schedule, const VertexSet*
     }
 }
 
+void VertexSet::build_vertex_set(const SchedulePlan& plan, const VertexSet* vertex_set, int* input_data, int input_size, int prefix_id)
+{
+    int father_id = plan.get_father_prefix_id(prefix_id);
+    build_vertex_set(father_id == -1 ? nullptr : &vertex_set[father_id], input_data, input_size);
+}
+
+void VertexSet::build_vertex_set(const VertexSet* father, int* input_data, int input_size)
+{
+    if (father == nullptr)
+        init(input_size, input_data);
+    else
+    {
+        init();
+        VertexSet tmp_vset;
+        tmp_vset.init(input_size, input_data);
+        intersection(*father, tmp_vset);
+    }
+}
+
 void VertexSet::build_vertex_set_bs_only_size(const Schedule_IEP& schedule, const VertexSet* vertex_set, Bitmap *bs, int* input_data, int input_size, int prefix_id, int depth)
 {
     int father_id = schedule.get_father_prefix_id(prefix_id);
@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+#include "../include/canonical_labeling.h"
+#include "../include/motif_generator.h"
+#include "../include/pattern.h"
+#include "../include/common.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+struct ColoredGraph {
+    int size;
+    std::vector<int> adj_mat;
+    std::vector<int> color;
+};
+
+static ColoredGraph random_graph(std::mt19937& rng, int size, double p, bool directed, int color_num) {
+    std::uniform_real_distribution<double> uniform(0, 1);
+    ColoredGraph g;
+    g.size = size;
+    g.adj_mat.assign(size * size, 0);
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < i; ++j)
+            if (uniform(rng) < p) {
+                bool forward = !directed || uniform(rng) < 0.5;
+                g.adj_mat[INDEX(i, j, size)] = forward || uniform(rng) < 0.3;
+                g.adj_mat[INDEX(j, i, size)] = !directed || !forward || g.adj_mat[INDEX(i, j, size)] == 0;
+            }
+    for (int i = 0; i < size; ++i)
+        g.color.push_back(rng() % color_num);
+    return g;
+}
+
+// vertex perm[i] of the result is vertex i of g
+static ColoredGraph relabel(const ColoredGraph& g, const std::vector<int>& perm) {
+    ColoredGraph h = g;
+    for (int i = 0; i < g.size; ++i) {
+        h.color[perm[i]] = g.color[i];
+        for (int j = 0; j < g.size; ++j)
+            h.adj_mat[INDEX(perm[i], perm[j], g.size)] = g.adj_mat[INDEX(i, j, g.size)];
+    }
+    return h;
+}
+
+static bool is_isomorphism(const ColoredGraph& g, const ColoredGraph& h, const std::vector<int>& perm) {
+    for (int i = 0; i < g.size; ++i) {
+        if (g.color[i] != h.color[perm[i]])
+            return false;
+        for (int j = 0; j < g.size; ++j)
+            if (g.adj_mat[INDEX(i, j, g.size)] != h.adj_mat[INDEX(perm[i], perm[j], g.size)])
+                return false;
+    }
+    return true;
+}
+
+static std::vector< std::vector<int> > brute_force_automorphisms(const ColoredGraph& g) {
+    std::vector< std::vector<int> > automorphisms;
+    std::vector<int> perm(g.size);
+    for (int i = 0; i < g.size; ++i)
+        perm[i] = i;
+    do {
+        if (is_isomorphism(g, g, perm))
+            automorphisms.push_back(perm);
+    } while (std::next_permutation(perm.begin(), perm.end()));
+    return automorphisms;
+}
+
+static bool brute_force_isomorphic(const ColoredGraph& g, const ColoredGraph& h) {
+    std::vector<int> perm(g.size);
+    for (int i = 0; i < g.size; ++i)
+        perm[i] = i;
+    do {
+        if (is_isomorphism(g, h, perm))
+            return true;
+    } while (std::next_permutation(perm.begin(), perm.end()));
+    return false;
+}
+
+TEST(canonical_labeling_test, random_graphs) {
+    std::mt19937 rng(2022);
+    for (int t = 0; t < 300; ++t) {
+        int size = 2 + t % 7;
+        bool directed = t % 3 == 1;
+        int color_num = t % 4 == 3 ? 2 : 1;
+        // sparse and dense graphs have more automorphisms
+        double p = t % 5 == 0 ? 0.15 : t % 5 == 1 ? 0.85 : 0.5;
+        ColoredGraph g = random_graph(rng, size, p, directed, color_num);
+        CanonicalLabeling labeling(g.adj_mat.data(), size, g.color.data());
+
+        std::vector< std::vector<int> > automorphisms = brute_force_automorphisms(g);
+        ASSERT_EQ(labeling.get_automorphism_num(), (long long)automorphisms.size());
+        ASSERT_EQ(labeling.get_automorphisms(), automorphisms);
+        for (int i = 0; i < size; ++i)
+            for (int j = 0; j < size; ++j) {
+                bool same_orbit = false;
+                for (const auto& a : automorphisms)
+                    if (a[i] == j)
+                        same_orbit = true;
+                ASSERT_EQ(labeling.get_orbits()[i] == labeling.get_orbits()[j], same_orbit);
+            }
+
+        std::vector<int> perm(size);
+        for (int i = 0; i < size; ++i)
+            perm[i] = i;
+        std::shuffle(perm.begin(), perm.end(), rng);
+        ColoredGraph h = relabel(g, perm);
+        CanonicalLabeling h_labeling(h.adj_mat.data(), size, h.color.data());
+        ASSERT_EQ(h_labeling.get_code(), labeling.get_code());
+        // both canonical orders give the same graph
+        std::vector<int> mapping(size);
+        for (int i = 0; i < size; ++i)
+            mapping[labeling.get_order()[i]] = h_labeling.get_order()[i];
+        ASSERT_TRUE(is_isomorphism(g, h, mapping));
+
+        // another graph has the same code only if it is isomorphic
+        ColoredGraph other = random_graph(rng, size, p, directed, color_num);
+        CanonicalLabeling other_labeling(other.adj_mat.data(), size, other.color.data());
+        ASSERT_EQ(other_labeling.get_code() == labeling.get_code(), brute_force_isomorphic(g, other));
+    }
+}
+
+TEST(canonical_labeling_test, motifs) {
+    // connected graphs of 3 to 6 vertices, up to isomorphism
+    int motif_num[] = {2, 6, 21, 112};
+    for (int size = 3; size <= 6; ++size) {
+        std::vector<Pattern> motifs = MotifGenerator(size).generate();
+        ASSERT_EQ((int)motifs.size(), motif_num[size - 3]);
+        for (const Pattern& p : motifs) {
+            ColoredGraph g;
+            g.size = size;
+            g.adj_mat.assign(p.get_adj_mat_ptr(), p.get_adj_mat_ptr() + size * size);
+            g.color.assign(size, 0);
+            std::vector< std::vector<int> > automorphisms = brute_force_automorphisms(g);
+            ASSERT_EQ(CanonicalLabeling(p.get_adj_mat_ptr(), size).get_automorphisms(), automorphisms);
+        }
+    }
+}
+
+TEST(canonical_labeling_test, symmetric_patterns) {
+    // these have up to 16! automorphisms, which are not enumerated
+    int size = 16;
+    long long factorial = 1;
+    for (int i = 2; i < size; ++i)
+        factorial *= i;
+    Pattern clique(size, true), star(size), cycle(size), cube(size);
+    for (int i = 1; i < size; ++i)
+        star.add_edge(0, i);
+    for (int i = 0; i < size; ++i)
+        cycle.add_edge(i, (i + 1) % size);
+    for (int i = 0; i < size; ++i)
+        for (int b = 0; b < 4; ++b)
+            if (i < (i ^ (1 << b)))
+                cube.add_edge(i, i ^ (1 << b));
+
+    double t1 = get_wall_time();
+    ASSERT_EQ(CanonicalLabeling(clique.get_adj_mat_ptr(), size).get_automorphism_num(), factorial * size);
+    ASSERT_EQ(CanonicalLabeling(star.get_adj_mat_ptr(), size).get_automorphism_num(), factorial);
+    ASSERT_EQ(CanonicalLabeling(cycle.get_adj_mat_ptr(), size).get_automorphism_num(), 2 * size);
+    ASSERT_EQ(CanonicalLabeling(cube.get_adj_mat_ptr(), size).get_automorphism_num(), 384);
+    ASSERT_EQ(CanonicalLabeling(cube.get_adj_mat_ptr(), size).get_automorphisms().size(), 384u);
+    double t2 = get_wall_time();
+    ASSERT_LT(t2 - t1, 1.0);
+}
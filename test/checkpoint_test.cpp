@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include <../include/graph.h>
+#include <../include/dataloader.h>
+#include "../include/pattern.h"
+#include "../include/common.h"
+#include "../include/cancel_token.h"
+#include "../include/checkpoint.h"
+
+#include <cstdio>
+#include <omp.h>
+
+TEST(checkpoint_test, resume_wiki_vote_house) {
+    Graph *g;
+    DataLoader D;
+    ASSERT_EQ(D.fast_load(g, "../../dataset/wiki-vote.g"), true);
+
+    Pattern pattern(House);
+    bool is_pattern_valid;
+    Schedule_IEP schedule(pattern, is_pattern_valid, 1, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt);
+    ASSERT_EQ(is_pattern_valid, true);
+    long long ans = g->pattern_matching(schedule);
+
+    const char *file_name = "checkpoint_test.ckpt";
+    remove(file_name);
+    PartialCount first;
+    {
+        Checkpoint checkpoint(file_name);
+        CancelToken token(0.5);
+        first = g->pattern_matching_partial(schedule, &token, &checkpoint);
+    }
+    ASSERT_LE(first.ans, ans);
+
+    {
+        // the finished start vertices are not counted twice
+        Checkpoint checkpoint(file_name, true);
+        CancelToken token;
+        PartialCount second = g->pattern_matching_partial(schedule, &token, &checkpoint);
+        ASSERT_TRUE(second.finished);
+        ASSERT_EQ(second.ans, ans);
+    }
+
+    {
+        // a finished run is not repeated
+        Checkpoint checkpoint(file_name, true);
+        CancelToken token(0);
+        PartialCount third = g->pattern_matching_partial(schedule, &token, &checkpoint);
+        ASSERT_TRUE(third.finished);
+        ASSERT_EQ(third.ans, ans);
+    }
+
+    {
+        // without the restart flag the file is ignored
+        Checkpoint checkpoint(file_name);
+        CancelToken token(0);
+        PartialCount fourth = g->pattern_matching_partial(schedule, &token, &checkpoint);
+        ASSERT_FALSE(fourth.finished);
+    }
+
+    remove(file_name);
+    delete g;
+}
+
+TEST(checkpoint_test, resume_with_other_thread_count) {
+    Graph *g;
+    DataLoader D;
+    ASSERT_EQ(D.fast_load(g, "../../dataset/wiki-vote.g"), true);
+
+    Pattern pattern(House);
+    bool is_pattern_valid;
+    Schedule_IEP schedule(pattern, is_pattern_valid, 1, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt);
+    ASSERT_EQ(is_pattern_valid, true);
+
+    const char *file_name = "checkpoint_test_threads.ckpt";
+    remove(file_name);
+    int thread_num = omp_get_max_threads();
+    PartialCount first;
+    {
+        omp_set_num_threads(thread_num + 3);
+        Checkpoint checkpoint(file_name);
+        CancelToken token(0.5);
+        first = g->pattern_matching_partial(schedule, &token, &checkpoint);
+    }
+    ASSERT_FALSE(first.finished);
+    ASSERT_GT(first.completed_fraction, 0);
+
+    {
+        // with fewer threads the saved chunks still match, nothing new is counted
+        omp_set_num_threads(1);
+        Checkpoint checkpoint(file_name, true);
+        CancelToken token(0);
+        PartialCount second = g->pattern_matching_partial(schedule, &token, &checkpoint);
+        ASSERT_EQ(second.ans, first.ans);
+        ASSERT_EQ(second.completed_fraction, first.completed_fraction);
+    }
+    omp_set_num_threads(thread_num);
+
+    remove(file_name);
+    delete g;
+}
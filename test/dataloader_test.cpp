@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include <../include/graph.h>
+#include <../include/dataloader.h>
+#include "../include/common.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utime.h>
+
+TEST(dataloader_test, statistics_in_header) {
+    Graph *g;
+    DataLoader D;
+    // wiki-vote.g has no statistics header, they are counted on its first load
+    ASSERT_EQ(D.fast_load(g, "../../dataset/wiki-vote.g"), true);
+    ASSERT_EQ(g->tri_cnt, 608389);
+    long long wedge_cnt = 0;
+    v_index_t max_degree = 0;
+    for (v_index_t v = 0; v < g->v_cnt; ++v) {
+        long long d = g->vertex[v + 1] - g->vertex[v];
+        wedge_cnt += d * (d - 1) / 2;
+        max_degree = std::max(max_degree, (v_index_t)d);
+    }
+    ASSERT_EQ(g->wedge_cnt, wedge_cnt);
+    ASSERT_EQ(g->max_degree, max_degree);
+
+    const char *file_name = "dataloader_test.g";
+    ASSERT_EQ(D.fast_dump(g, file_name), true);
+    Graph *h;
+    ASSERT_EQ(D.fast_load(h, file_name), true);
+    ASSERT_EQ(h->v_cnt, g->v_cnt);
+    ASSERT_EQ(h->e_cnt, g->e_cnt);
+    ASSERT_EQ(h->tri_cnt, g->tri_cnt);
+    ASSERT_EQ(h->wedge_cnt, g->wedge_cnt);
+    ASSERT_EQ(h->max_degree, g->max_degree);
+    ASSERT_NE(h->degree_stats, nullptr);
+    ASSERT_EQ(memcmp(h->degree_stats, g->degree_stats, sizeof(DegreeStatistics)), 0);
+    for (v_index_t v = 0; v <= g->v_cnt; ++v)
+        ASSERT_EQ(h->vertex[v], g->vertex[v]);
+    for (e_index_t i = 0; i < g->e_cnt; ++i)
+        ASSERT_EQ(h->edge[i], g->edge[i]);
+
+    // both file versions are mapped, in place of the arrays that were read
+    for (const char *name : {file_name, "../../dataset/wiki-vote.g"}) {
+        Graph *m;
+        ASSERT_EQ(D.fast_load(m, name, true), true);
+        ASSERT_NE(m->mapped_data, nullptr);
+        ASSERT_EQ(m->tri_cnt, g->tri_cnt);
+        ASSERT_EQ(memcmp(m->vertex, g->vertex, sizeof(e_index_t) * (g->v_cnt + 1)), 0);
+        ASSERT_EQ(memcmp(m->edge, g->edge, sizeof(v_index_t) * g->e_cnt), 0);
+        delete m;
+    }
+
+    remove(file_name);
+    delete g;
+    delete h;
+}
+
+TEST(dataloader_test, statistics_saved_for_old_format) {
+    const char *file_name = "dataloader_test_old.g";
+    std::string stats_name = std::string(file_name) + ".stats";
+    {
+        std::ifstream src("../../dataset/wiki-vote.g", std::ios::binary);
+        std::ofstream dst(file_name, std::ios::binary);
+        dst << src.rdbuf();
+    }
+    remove(stats_name.c_str());
+
+    DataLoader D;
+    Graph *g;
+    testing::internal::CaptureStdout();
+    ASSERT_EQ(D.fast_load(g, file_name), true);
+    ASSERT_NE(testing::internal::GetCapturedStdout().find("counting triangles"), std::string::npos);
+    ASSERT_EQ(g->tri_cnt, 608389);
+    FILE *fp = fopen(stats_name.c_str(), "rb");
+    ASSERT_NE(fp, nullptr);
+    fclose(fp);
+
+    // read back instead of counted
+    Graph *h;
+    testing::internal::CaptureStdout();
+    ASSERT_EQ(D.fast_load(h, file_name, true), true);
+    ASSERT_EQ(testing::internal::GetCapturedStdout().find("counting triangles"), std::string::npos);
+    ASSERT_EQ(h->tri_cnt, g->tri_cnt);
+    ASSERT_EQ(h->wedge_cnt, g->wedge_cnt);
+    ASSERT_EQ(h->max_degree, g->max_degree);
+    ASSERT_NE(h->degree_stats, nullptr);
+    ASSERT_EQ(memcmp(h->degree_stats, g->degree_stats, sizeof(DegreeStatistics)), 0);
+    delete h;
+
+    // a modified file is counted again
+    struct utimbuf times = {1000000000, 1000000000};
+    ASSERT_EQ(utime(file_name, &times), 0);
+    testing::internal::CaptureStdout();
+    ASSERT_EQ(D.fast_load(h, file_name), true);
+    ASSERT_NE(testing::internal::GetCapturedStdout().find("counting triangles"), std::string::npos);
+    ASSERT_EQ(h->tri_cnt, g->tri_cnt);
+    delete h;
+
+    remove(file_name);
+    remove(stats_name.c_str());
+    delete g;
+}
+
+TEST(dataloader_test, triangle_estimate) {
+    Graph *g;
+    DataLoader D;
+    ASSERT_EQ(D.fast_load(g, "../../dataset/wiki-vote.g"), true);
+    long long estimate = g->triangle_counting_estimate();
+    ASSERT_LT(std::fabs((double)estimate / g->tri_cnt - 1), 0.02);
+
+    g->compute_statistics(0);
+    ASSERT_EQ(g->tri_cnt, estimate);
+    delete g;
+}
@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+#include <../include/graph.h>
+#include "../include/pattern.h"
+#include "../include/common.h"
+#include "../include/dynamic_graph.h"
+#include "../include/dataloader.h"
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <cstdio>
+#include <vector>
+
+static Graph *build_graph(int n, const std::set<std::pair<int, int>> &edges) {
+    std::vector<std::vector<int>> adj(n);
+    for (const auto &e : edges) {
+        adj[e.first].push_back(e.second);
+        adj[e.second].push_back(e.first);
+    }
+
+    Graph *g = new Graph();
+    g->v_cnt = n;
+    g->e_cnt = edges.size() * 2;
+    g->vertex = new e_index_t[n + 1];
+    g->edge = new v_index_t[g->e_cnt];
+    std::vector<int> degree;
+    e_index_t pos = 0;
+    for (int i = 0; i < n; ++i) {
+        std::sort(adj[i].begin(), adj[i].end());
+        g->vertex[i] = pos;
+        for (int v : adj[i])
+            g->edge[pos++] = v;
+        degree.push_back(adj[i].size());
+    }
+    g->vertex[n] = pos;
+    std::sort(degree.begin(), degree.end());
+    VertexSet::max_intersection_size = std::max(VertexSet::max_intersection_size, degree[n - 2]);
+    g->tri_cnt = g->triangle_counting();
+    return g;
+}
+
+static long long count(Graph *g, const Pattern &pattern) {
+    bool is_pattern_valid;
+    Schedule_IEP schedule(pattern, is_pattern_valid, 1, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt);
+    EXPECT_EQ(is_pattern_valid, true);
+    return g->pattern_matching(schedule);
+}
+
+static void random_batches(double compact_ratio) {
+    const int n = 60;
+    std::mt19937 rng(2022);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::uniform_int_distribution<int> vertex(0, n - 1);
+    std::set<std::pair<int, int>> edges;
+    for (int i = 0; i < n; ++i)
+        for (int j = i + 1; j < n; ++j)
+            if (uniform(rng) < 0.15)
+                edges.insert(std::make_pair(i, j));
+
+    std::vector<Pattern> patterns;
+    patterns.push_back(Pattern(3, true));
+    patterns.push_back(Pattern(Rectangle));
+    patterns.push_back(Pattern(House));
+    patterns.push_back(Pattern(4, true));
+
+    DynamicGraph dynamic_graph(build_graph(n, edges), compact_ratio);
+    std::vector<int> ids;
+    for (const Pattern &p : patterns)
+        ids.push_back(dynamic_graph.add_pattern(p));
+
+    for (int round = 0; round < 8; ++round) {
+        std::vector<EdgeUpdate> batch;
+        int effective = 0;
+        for (int i = 0; i < 40; ++i) {
+            int u = vertex(rng), v = vertex(rng);
+            // small vertex ids for dense changes in the same neighborhood
+            if (i % 4 == 0)
+                v = vertex(rng) % 8;
+            bool insert = uniform(rng) < 0.5;
+            batch.push_back(EdgeUpdate{u, v, insert});
+            if (u == v)
+                continue;
+            auto e = std::make_pair(std::min(u, v), std::max(u, v));
+            if (insert)
+                effective += edges.insert(e).second;
+            else
+                effective += edges.erase(e);
+        }
+        ASSERT_EQ(dynamic_graph.apply_batch(batch), effective);
+        for (const auto &e : edges)
+            ASSERT_TRUE(dynamic_graph.has_edge(e.second, e.first));
+
+        Graph *g = build_graph(n, edges);
+        for (int i = 0; i < (int)patterns.size(); ++i)
+            ASSERT_EQ(dynamic_graph.get_count(ids[i]), count(g, patterns[i]));
+        delete g;
+    }
+
+    Graph *g = dynamic_graph.get_graph();
+    ASSERT_EQ(dynamic_graph.get_delta_size(), 0);
+    ASSERT_EQ(g->e_cnt, (e_index_t)edges.size() * 2);
+    for (int i = 0; i < (int)patterns.size(); ++i)
+        ASSERT_EQ(dynamic_graph.get_count(ids[i]), count(g, patterns[i]));
+    // the statistics are those of the current graph
+    Graph *expected = build_graph(n, edges);
+    ASSERT_EQ(g->tri_cnt, expected->tri_cnt);
+    ASSERT_EQ(g->tri_cnt, dynamic_graph.get_count(ids[0]));
+    expected->compute_statistics();
+    ASSERT_EQ(g->wedge_cnt, expected->wedge_cnt);
+    ASSERT_EQ(g->max_degree, expected->max_degree);
+    delete expected;
+}
+
+TEST(dynamic_graph_test, random_batches_delta) {
+    random_batches(100);
+}
+
+TEST(dynamic_graph_test, random_batches_compacted) {
+    random_batches(0);
+}
+
+TEST(dynamic_graph_test, mapped_graph) {
+    const int n = 40;
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::set<std::pair<int, int>> edges;
+    for (int i = 0; i < n; ++i)
+        for (int j = i + 1; j < n; ++j)
+            if (uniform(rng) < 0.2)
+                edges.insert(std::make_pair(i, j));
+    const char *path = "dynamic_graph_test.g";
+    DataLoader D;
+    Graph *base = build_graph(n, edges);
+    ASSERT_TRUE(D.fast_dump(base, path));
+    delete base;
+
+    Graph *mapped;
+    ASSERT_TRUE(D.fast_load(mapped, path, true));
+    ASSERT_NE(mapped->mapped_data, nullptr);
+    DynamicGraph dynamic_graph(mapped);
+    int triangle = dynamic_graph.add_pattern(Pattern(3, true));
+    std::vector<EdgeUpdate> batch;
+    for (int i = 0; i < 10; ++i) {
+        batch.push_back(EdgeUpdate{i, i + 10, true});
+        edges.insert(std::make_pair(i, i + 10));
+    }
+    batch.push_back(EdgeUpdate{edges.begin()->first, edges.begin()->second, false});
+    edges.erase(edges.begin());
+    dynamic_graph.apply_batch(batch);
+
+    // the compacted arrays replace the mapping
+    Graph *g = dynamic_graph.get_graph();
+    ASSERT_EQ(g->mapped_data, nullptr);
+    ASSERT_EQ(g->e_cnt, (e_index_t)edges.size() * 2);
+    Graph *expected = build_graph(n, edges);
+    ASSERT_EQ(dynamic_graph.get_count(triangle), count(expected, Pattern(3, true)));
+    ASSERT_EQ(count(g, Pattern(3, true)), count(expected, Pattern(3, true)));
+    delete expected;
+    remove(path);
+}
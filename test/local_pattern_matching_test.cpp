@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+#include <../include/graph.h>
+#include <../include/dataloader.h>
+#include "../include/pattern.h"
+#include "../include/embedding.h"
+#include "../include/common.h"
+#include "../include/motif_generator.h"
+#include "test_graph.h"
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <vector>
+
+// local counts computed from the listed embeddings
+static void enumerated_local_counts(Graph *g, const Schedule_IEP &schedule, std::vector<long long> &vertex_ans, std::vector<long long> &edge_ans) {
+    int size = schedule.get_size();
+    const int *adj_mat = schedule.get_adj_mat_ptr();
+    vertex_ans.assign(g->v_cnt, 0);
+    edge_ans.assign(g->e_cnt, 0);
+    std::mutex lock;
+    EmbeddingCallbackSink sink([&](const EmbeddingBatch &batch) {
+        std::lock_guard<std::mutex> guard(lock);
+        for (int i = 0; i < batch.get_size(); ++i) {
+            const v_index_t *emb = batch.get_embedding(i);
+            for (int j = 0; j < size; ++j) {
+                ++vertex_ans[emb[j]];
+                for (int k = 0; k < j; ++k)
+                    if (adj_mat[INDEX(j, k, size)]) {
+                        ++edge_ans[g->get_edge_id(emb[j], emb[k])];
+                        ++edge_ans[g->get_edge_id(emb[k], emb[j])];
+                    }
+            }
+        }
+    });
+    g->pattern_enumeration(schedule, sink);
+}
+
+TEST(local_pattern_matching_test, local_counts_random) {
+    Graph *g = random_graph(40, 0.3, 11);
+    const char *patterns[3][2] = {{"3", "011101110"}, {"4", "0111101111011110"}, {"5", "0111010011100011100001100"}};
+
+    for (auto &s : patterns) {
+        Pattern pattern(atoi(s[0]), s[1]);
+        for (int restricts_type = 0; restricts_type < 2; ++restricts_type) {
+            bool is_pattern_valid;
+            Schedule_IEP schedule(pattern, is_pattern_valid, 1, restricts_type, true, g->v_cnt, g->e_cnt, g->tri_cnt);
+            ASSERT_EQ(is_pattern_valid, true);
+
+            std::vector<long long> vertex_ans(g->v_cnt), edge_ans(g->e_cnt);
+            long long ans = g->local_pattern_matching(schedule, vertex_ans.data(), edge_ans.data());
+            long long expected = g->pattern_matching(schedule);
+            if (restricts_type == 0)
+                expected /= schedule.get_multiplicity();
+            ASSERT_EQ(ans, expected);
+
+            Schedule_IEP restricted(pattern, is_pattern_valid, 1, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt);
+            std::vector<long long> expected_vertex_ans, expected_edge_ans;
+            enumerated_local_counts(g, restricted, expected_vertex_ans, expected_edge_ans);
+            ASSERT_EQ(vertex_ans, expected_vertex_ans);
+            ASSERT_EQ(edge_ans, expected_edge_ans);
+
+            std::vector<long long> vertex_only(g->v_cnt);
+            ASSERT_EQ(g->local_pattern_matching(schedule, vertex_only.data()), ans);
+            ASSERT_EQ(vertex_only, vertex_ans);
+        }
+    }
+
+    delete g;
+}
+
+// orbit counts of every connected vertex subset of 3 to max_size vertices, matched against the graphlets
+static std::vector<long long> enumerated_orbit_counts(Graph *g, int max_size, int orbit_num, const std::vector<std::pair<Pattern, int>> &orbit_graphlet) {
+    int n = g->v_cnt;
+    std::vector<long long> expected((long long)orbit_num * n, 0);
+    for (int v = 0; v < n; ++v)
+        expected[v] = g->vertex[v + 1] - g->vertex[v];
+    auto adjacent = [&](int u, int v) { return g->get_edge_id(u, v) != -1; };
+    std::vector<int> subset;
+    std::function<void(int)> search = [&](int start) {
+        int k = subset.size();
+        for (int o = 1; k >= 3 && o < orbit_num; ++o) {
+            const Pattern &p = orbit_graphlet[o].first;
+            // the first orbit of each graphlet
+            const Pattern &last = orbit_graphlet[o - 1].first;
+            if (p.get_size() != k || (last.get_size() == k && std::equal(p.get_adj_mat_ptr(), p.get_adj_mat_ptr() + k * k, last.get_adj_mat_ptr())))
+                continue;
+            std::vector<int> perm(k);
+            for (int i = 0; i < k; ++i)
+                perm[i] = i;
+            bool found = false;
+            do {
+                bool same = true;
+                for (int i = 0; i < k && same; ++i)
+                    for (int j = 0; j < i && same; ++j)
+                        same = (p.get_adj_mat_ptr()[INDEX(i, j, k)] != 0) == adjacent(subset[perm[i]], subset[perm[j]]);
+                found = same;
+            } while (!found && std::next_permutation(perm.begin(), perm.end()));
+            if (!found)
+                continue;
+            // orbits of this graphlet are o, o + 1, ... in the order of their first vertex
+            std::vector<int> orbits = MotifGenerator::get_orbits(p);
+            for (int i = 0; i < k; ++i)
+                ++expected[(long long)(o + orbits[i]) * n + subset[perm[i]]];
+            break;
+        }
+        if (k == max_size)
+            return;
+        for (int v = start; v < n; ++v) {
+            subset.push_back(v);
+            search(v + 1);
+            subset.pop_back();
+        }
+    };
+    search(0);
+    return expected;
+}
+
+TEST(local_pattern_matching_test, orbit_counts_random) {
+    Graph *g = random_graph(18, 0.35, 3);
+    int orbit_num;
+    std::vector<std::pair<Pattern, int>> orbit_graphlet;
+    long long *ans = g->orbit_counting(5, orbit_num, &orbit_graphlet);
+    ASSERT_EQ(orbit_num, 73);
+    ASSERT_EQ(orbit_graphlet.size(), 73);
+    ASSERT_EQ(std::vector<long long>(ans, ans + (long long)orbit_num * g->v_cnt), enumerated_orbit_counts(g, 5, orbit_num, orbit_graphlet));
+    delete[] ans;
+    delete g;
+}
+
+TEST(local_pattern_matching_test, orbit_counts_4_dense) {
+    // the closed forms of 3 and 4 vertices, with many diamonds, 4-cycles and 4-cliques
+    for (int max_size = 3; max_size <= 4; ++max_size) {
+        Graph *g = random_graph(40, 0.3, 11, 0.8);
+        int orbit_num;
+        std::vector<std::pair<Pattern, int>> orbit_graphlet;
+        long long *ans = g->orbit_counting(max_size, orbit_num, &orbit_graphlet);
+        ASSERT_EQ(orbit_num, max_size == 3 ? 4 : 15);
+        ASSERT_EQ(std::vector<long long>(ans, ans + (long long)orbit_num * g->v_cnt), enumerated_orbit_counts(g, max_size, orbit_num, orbit_graphlet));
+        delete[] ans;
+        delete g;
+    }
+}
@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+#include "../include/motif_generator.h"
+#include "../include/pattern.h"
+#include "../include/common.h"
+
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <set>
+#include <string>
+#include <vector>
+
+static int edge_num(const Pattern& p) {
+    int n = p.get_size(), cnt = 0;
+    for (int i = 0; i < n * n; ++i)
+        cnt += p.get_adj_mat_ptr()[i];
+    return cnt / 2;
+}
+
+TEST(motif_generator_test, connected_graphs) {
+    // connected graphs of 1 to 8 vertices, up to isomorphism
+    int motif_num[] = {1, 1, 2, 6, 21, 112, 853, 11117};
+    for (int size = 1; size <= 8; ++size) {
+        std::vector<Pattern> motifs = MotifGenerator(size).generate();
+        ASSERT_EQ((int)motifs.size(), motif_num[size - 1]);
+        std::set<std::string> forms;
+        for (int i = 0; i < (int)motifs.size(); ++i) {
+            // every vertex but the first has an earlier neighbor, so every prefix is connected
+            for (int v = 1; v < size; ++v)
+                ASSERT_NE(std::count(motifs[i].get_adj_mat_ptr() + v * size, motifs[i].get_adj_mat_ptr() + v * size + v, 1), 0);
+            ASSERT_TRUE(forms.insert(motifs[i].get_canonical_form()).second);
+            if (i > 0) {
+                ASSERT_LE(edge_num(motifs[i - 1]), edge_num(motifs[i]));
+            }
+        }
+    }
+}
+
+TEST(motif_generator_test, edge_bounds) {
+    for (int size = 2; size <= 7; ++size) {
+        std::vector<Pattern> motifs = MotifGenerator(size).generate();
+        for (int min_edge = 0; min_edge <= size * (size - 1) / 2; min_edge += 2)
+            for (int max_edge = min_edge; max_edge <= size * (size - 1) / 2 + 1; max_edge += 3) {
+                std::vector<Pattern> bounded = MotifGenerator(size, min_edge, max_edge).generate();
+                std::vector<std::string> expected, forms;
+                for (const Pattern& p : motifs)
+                    if (edge_num(p) >= min_edge && edge_num(p) <= max_edge)
+                        expected.push_back(p.get_canonical_form());
+                for (const Pattern& p : bounded)
+                    forms.push_back(p.get_canonical_form());
+                ASSERT_EQ(forms, expected);
+            }
+    }
+    // trees only
+    ASSERT_EQ(MotifGenerator(10, 0, 9).generate().size(), 106u);
+}
+
+TEST(motif_generator_test, cache) {
+    const char *dir = "motif_generator_test.dir";
+    MotifGenerator mg(6, 0, 8, dir);
+    remove(mg.get_cache_file_name().c_str());
+    std::vector<Pattern> generated = mg.generate();
+
+    FILE *fp = fopen(mg.get_cache_file_name().c_str(), "r");
+    ASSERT_NE(fp, nullptr);
+    std::vector<char> buf(1 << 20);
+    size_t len = fread(buf.data(), 1, buf.size(), fp);
+    fclose(fp);
+    std::vector<Pattern> loaded = mg.generate();
+    ASSERT_EQ(loaded.size(), generated.size());
+    for (int i = 0; i < (int)loaded.size(); ++i)
+        for (int j = 0; j < 36; ++j)
+            ASSERT_EQ(loaded[i].get_adj_mat_ptr()[j], generated[i].get_adj_mat_ptr()[j]);
+
+    // a torn file is generated again and rewritten
+    fp = fopen(mg.get_cache_file_name().c_str(), "w");
+    fwrite(buf.data(), 1, len / 2, fp);
+    fclose(fp);
+    ASSERT_EQ(mg.generate().size(), generated.size());
+    fp = fopen(mg.get_cache_file_name().c_str(), "r");
+    ASSERT_EQ(fread(buf.data(), 1, buf.size(), fp), len);
+    fclose(fp);
+
+    // without a directory nothing is cached
+    MotifGenerator uncached(6, 0, 8);
+    ASSERT_EQ(uncached.generate().size(), generated.size());
+    ASSERT_NE(access(uncached.get_cache_file_name().c_str(), F_OK), 0);
+
+    remove(mg.get_cache_file_name().c_str());
+    rmdir(dir);
+}
@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+#include <../include/graph.h>
+#include <../include/dataloader.h>
+#include "../include/pattern.h"
+#include "../include/motif_generator.h"
+#include "../include/multi_schedule.h"
+#include "../include/common.h"
+#include "test_graph.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+// reference count: no IEP, no restrictions, every embedding divided by the automorphisms
+static long long plain_count(Graph *g, const Pattern &p) {
+    bool is_pattern_valid;
+    Schedule_IEP schedule(p, is_pattern_valid, 0, 0, false, g->v_cnt, g->e_cnt, g->tri_cnt);
+    return g->pattern_matching(schedule) / schedule.get_multiplicity();
+}
+
+TEST(multi_pattern_matching_test, motif_counting_wiki_vote_size4) {
+    Graph *g;
+    DataLoader D;
+    ASSERT_EQ(D.fast_load(g, "../../dataset/wiki-vote.g"), true);
+
+    std::vector<Pattern> patterns = MotifGenerator(4).generate();
+    ASSERT_EQ(patterns.size(), 6);
+    MultiSchedule schedule(patterns, true, g->v_cnt, g->e_cnt, g->tri_cnt);
+    ASSERT_LT(schedule.get_node_num(), schedule.get_unshared_node_num());
+
+    std::vector<long long> ans(patterns.size());
+    g->multi_pattern_matching(schedule, ans.data());
+
+    for (int i = 0; i < (int)patterns.size(); ++i) {
+        bool is_pattern_valid;
+        Schedule_IEP single(patterns[i], is_pattern_valid, 1, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt);
+        ASSERT_EQ(ans[i], g->pattern_matching(single));
+    }
+    std::sort(ans.begin(), ans.end());
+    std::vector<long long> expected = {2077903LL, 40544543LL, 57654491LL, 421175645LL, 1475572967LL, 1903444290LL};
+    ASSERT_EQ(ans, expected);
+
+    delete g;
+}
+
+TEST(multi_pattern_matching_test, motif_counting_random_size5) {
+    Graph *g = random_graph(25, 0.4, 7);
+
+    std::vector<Pattern> patterns = MotifGenerator(5).generate();
+    ASSERT_EQ(patterns.size(), 21);
+    MultiSchedule schedule(patterns, true, g->v_cnt, g->e_cnt, g->tri_cnt);
+    std::vector<long long> ans(patterns.size());
+    g->multi_pattern_matching(schedule, ans.data());
+
+    for (int i = 0; i < (int)patterns.size(); ++i) {
+        long long expected = plain_count(g, patterns[i]);
+        ASSERT_EQ(ans[i], expected);
+        // the single pattern schedules the trie is built from
+        for (int restricts_type = 0; restricts_type < 2; ++restricts_type) {
+            bool is_pattern_valid;
+            Schedule_IEP single(patterns[i], is_pattern_valid, 1, restricts_type, true, g->v_cnt, g->e_cnt, g->tri_cnt);
+            long long single_ans = g->pattern_matching(single);
+            if (restricts_type == 0)
+                single_ans /= single.get_multiplicity();
+            ASSERT_EQ(single_ans, expected);
+        }
+    }
+
+    delete g;
+}
+
+TEST(multi_pattern_matching_test, induced_motif_census_random_size5) {
+    Graph *g = random_graph(25, 0.4, 11);
+
+    std::vector<Pattern> patterns = MotifGenerator(5).generate();
+    std::vector<long long> ans(patterns.size());
+    g->motif_census(5, ans.data(), true);
+
+    for (int i = 0; i < (int)patterns.size(); ++i) {
+        bool is_pattern_valid;
+        Schedule_IEP induced(patterns[i], is_pattern_valid, 1, 1, false, g->v_cnt, g->e_cnt, g->tri_cnt, true);
+        ASSERT_EQ(ans[i], g->pattern_matching(induced));
+    }
+
+    // K4 has 16 spanning trees and 15 + 6 + 1 connected spanning subgraphs with 4, 5 and 6 edges
+    std::vector<Pattern> size4 = MotifGenerator(4).generate();
+    std::vector<std::vector<long long>> containment = MotifGenerator::get_containment_matrix(size4);
+    int clique = -1;
+    for (int q = 0; q < (int)size4.size(); ++q)
+        if (std::count(size4[q].get_adj_mat_ptr(), size4[q].get_adj_mat_ptr() + 16, 1) == 12)
+            clique = q;
+    ASSERT_NE(clique, -1);
+    long long spanning_subgraph_cnt = 0;
+    for (int p = 0; p < (int)size4.size(); ++p)
+        spanning_subgraph_cnt += containment[p][clique];
+    ASSERT_EQ(spanning_subgraph_cnt, 38);
+
+    delete g;
+}
+
+TEST(multi_pattern_matching_test, motif_counting_4_random) {
+    Graph *g = random_graph(60, 0.3, 5);
+
+    for (int vertex_induced = 0; vertex_induced < 2; ++vertex_induced) {
+        std::vector<long long> expected(6), ans(6);
+        g->motif_census(4, expected.data(), vertex_induced);
+        g->motif_counting_4(ans.data(), vertex_induced);
+        ASSERT_EQ(ans, expected);
+    }
+
+    delete g;
+}
+
+TEST(multi_pattern_matching_test, iep_without_valid_restricts) {
+    // IEP can keep none of GraphZero's restriction sets of the hourglass;
+    // counting the order without restrictions was 12 times too high
+    Graph *g = random_graph(25, 0.4, 7);
+    Pattern hourglass(Hourglass);
+    long long expected = plain_count(g, hourglass);
+    for (int performance_modeling_type = 0; performance_modeling_type < 2; ++performance_modeling_type)
+        for (int restricts_type = 1; restricts_type <= 2; ++restricts_type) {
+            bool is_pattern_valid;
+            Schedule_IEP schedule(hourglass, is_pattern_valid, performance_modeling_type, restricts_type, true, g->v_cnt, g->e_cnt, g->tri_cnt);
+            ASSERT_EQ(g->pattern_matching(schedule), expected);
+        }
+    for (const Pattern &p : MotifGenerator(5).generate()) {
+        bool is_pattern_valid;
+        Schedule_IEP schedule(p, is_pattern_valid, 1, 2, true, g->v_cnt, g->e_cnt, g->tri_cnt);
+        ASSERT_EQ(g->pattern_matching(schedule), plain_count(g, p));
+    }
+    delete g;
+}
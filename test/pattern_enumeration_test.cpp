@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include <../include/graph.h>
+#include <../include/dataloader.h>
+#include "../include/pattern.h"
+#include "../include/embedding.h"
+#include "../include/common.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+static bool has_edge(const Graph *g, int u, int v) {
+    return std::binary_search(g->edge + g->vertex[u], g->edge + g->vertex[u + 1], v);
+}
+
+// every listed embedding must be injective and cover all pattern edges
+static bool check_embedding(const Graph *g, const Schedule_IEP &schedule, const v_index_t *emb) {
+    int size = schedule.get_size();
+    const int *adj_mat = schedule.get_adj_mat_ptr();
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < i; ++j) {
+            if (emb[i] == emb[j])
+                return false;
+            if (adj_mat[INDEX(i, j, size)] && !has_edge(g, emb[i], emb[j]))
+                return false;
+        }
+    return true;
+}
+
+TEST(pattern_enumeration_test, enumeration_complete_house) {
+    Graph *g;
+    DataLoader D;
+    ASSERT_EQ(D.load_complete(g, 9), true);
+
+    Pattern pattern(PatternType::House);
+    bool is_pattern_valid;
+    Schedule_IEP schedule(pattern, is_pattern_valid, 1, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt);
+    ASSERT_EQ(is_pattern_valid, true);
+
+    long long expected = g->pattern_matching(schedule);
+
+    std::atomic<long long> valid(0);
+    EmbeddingCallbackSink sink([&](const EmbeddingBatch &batch) {
+        for (int i = 0; i < batch.get_size(); ++i)
+            if (check_embedding(g, schedule, batch.get_embedding(i)))
+                ++valid;
+    });
+    long long ans = g->pattern_enumeration(schedule, sink, 7);
+    ASSERT_EQ(ans, expected);
+    ASSERT_EQ(valid, expected);
+
+    delete g;
+}
+
+TEST(pattern_enumeration_test, enumeration_wiki_vote_queue_and_file) {
+    Graph *g;
+    DataLoader D;
+    ASSERT_EQ(D.fast_load(g, "../../dataset/wiki-vote.g"), true);
+
+    Pattern pattern(3, "011101110");
+    bool is_pattern_valid;
+    Schedule_IEP schedule(pattern, is_pattern_valid, 1, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt);
+    ASSERT_EQ(is_pattern_valid, true);
+    long long expected = g->pattern_matching(schedule);
+
+    EmbeddingQueue queue(schedule.get_size(), 1024, 4);
+    long long valid = 0, total = 0;
+    std::thread consumer([&]() {
+        for (EmbeddingBatch *batch; (batch = queue.pop()) != nullptr; queue.release(batch)) {
+            total += batch->get_size();
+            for (int i = 0; i < batch->get_size(); ++i)
+                valid += check_embedding(g, schedule, batch->get_embedding(i));
+        }
+    });
+    long long ans = g->pattern_enumeration(schedule, queue);
+    queue.close();
+    consumer.join();
+    ASSERT_EQ(ans, expected);
+    ASSERT_EQ(total, expected);
+    ASSERT_EQ(valid, expected);
+
+    const char *path = "pattern_enumeration_test.bin";
+    {
+        EmbeddingFileSink sink(path, schedule.get_size());
+        ASSERT_EQ(sink.is_open(), true);
+        ASSERT_EQ(g->pattern_enumeration(schedule, sink), expected);
+    }
+    FILE *fp = fopen(path, "rb");
+    ASSERT_NE(fp, nullptr);
+    int pattern_size;
+    uint64_t embedding_cnt;
+    ASSERT_EQ(EmbeddingFileSink::read_header(fp, pattern_size, embedding_cnt), true);
+    ASSERT_EQ(pattern_size, schedule.get_size());
+    ASSERT_EQ((long long)embedding_cnt, expected);
+    v_index_t emb[3];
+    long long read_cnt = 0;
+    while (fread(emb, sizeof(v_index_t), pattern_size, fp) == (size_t)pattern_size) {
+        ASSERT_EQ(check_embedding(g, schedule, emb), true);
+        ++read_cnt;
+    }
+    ASSERT_EQ(read_cnt, expected);
+    fclose(fp);
+    remove(path);
+
+    delete g;
+}
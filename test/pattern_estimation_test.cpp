@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+#include <../include/graph.h>
+#include <../include/dataloader.h>
+#include "../include/pattern.h"
+#include "../include/common.h"
+#include "../include/cancel_token.h"
+#include "test_graph.h"
+
+#include <vector>
+
+TEST(pattern_estimation_test, estimation_wiki_vote_K4) {
+    Graph *g;
+    DataLoader D;
+    ASSERT_EQ(D.fast_load(g, "../../dataset/wiki-vote.g"), true);
+
+    Pattern pattern(4, "0111101111011110");
+    bool is_pattern_valid;
+    Schedule_IEP schedule(pattern, is_pattern_valid, 1, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt);
+    ASSERT_EQ(is_pattern_valid, true);
+    long long ans = g->pattern_matching(schedule);
+
+    CountEstimate edge_estimate = g->pattern_matching_estimate(schedule, 0.05, 0.99, SampleType::Edge);
+    ASSERT_TRUE(edge_estimate.converged);
+    ASSERT_LE(edge_estimate.relative_error, 0.05);
+    ASSERT_LE(edge_estimate.lower, ans);
+    ASSERT_GE(edge_estimate.upper, ans);
+
+    CountEstimate vertex_estimate = g->pattern_matching_estimate(schedule, 0.1, 0.99, SampleType::Vertex);
+    ASSERT_TRUE(vertex_estimate.converged);
+    ASSERT_LE(vertex_estimate.lower, ans);
+    ASSERT_GE(vertex_estimate.upper, ans);
+
+    // the same seed gives the same samples whatever the thread count
+    CountEstimate again = g->pattern_matching_estimate(schedule, 0.05, 0.99, SampleType::Edge);
+    ASSERT_EQ(again.sample_cnt, edge_estimate.sample_cnt);
+    ASSERT_EQ(again.estimate, edge_estimate.estimate);
+
+    CountEstimate limited = g->pattern_matching_estimate(schedule, 1e-6, 0.99, SampleType::Edge, 5000);
+    ASSERT_FALSE(limited.converged);
+    ASSERT_EQ(limited.sample_cnt, 5000);
+
+    delete g;
+}
+
+// a cycle of n vertices with one K5 planted on its first vertices
+static Graph *planted_clique_graph(int n) {
+    std::vector<std::vector<int>> adj(n);
+    for (int i = 0; i < n; ++i) {
+        int j = (i + 1) % n;
+        if (i < 4 && j < 5)
+            continue;
+        adj[i].push_back(j);
+        adj[j].push_back(i);
+    }
+    for (int i = 0; i < 5; ++i)
+        for (int j = 0; j < 5; ++j)
+            if (i != j)
+                adj[i].push_back(j);
+    return graph_from_adj(adj);
+}
+
+TEST(pattern_estimation_test, estimation_rare_pattern) {
+    Pattern pattern(5, true);
+    bool is_pattern_valid;
+
+    // no sample hits the clique, the estimate of 0 is not trusted
+    Graph *g = planted_clique_graph(1000000);
+    Schedule_IEP schedule(pattern, is_pattern_valid, 1, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt);
+    ASSERT_EQ(is_pattern_valid, true);
+    ASSERT_EQ(g->pattern_matching(schedule), 1);
+    CountEstimate missed = g->pattern_matching_estimate(schedule, 0.1, 0.95, SampleType::Edge, 8192);
+    ASSERT_FALSE(missed.converged);
+    ASSERT_EQ(missed.sample_cnt, 8192);
+    ASSERT_EQ(missed.estimate, 0);
+    delete g;
+
+    // enough samples hit it
+    g = planted_clique_graph(2000);
+    Schedule_IEP small_schedule(pattern, is_pattern_valid, 1, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt);
+    ASSERT_EQ(is_pattern_valid, true);
+    CountEstimate found = g->pattern_matching_estimate(small_schedule, 0.2, 0.99, SampleType::Edge, 1 << 22);
+    ASSERT_TRUE(found.converged);
+    ASSERT_LE(found.lower, 1);
+    ASSERT_GE(found.upper, 1);
+    delete g;
+}
+
+TEST(pattern_estimation_test, partial_wiki_vote_house) {
+    Graph *g;
+    DataLoader D;
+    ASSERT_EQ(D.fast_load(g, "../../dataset/wiki-vote.g"), true);
+
+    Pattern pattern(House);
+    bool is_pattern_valid;
+    Schedule_IEP schedule(pattern, is_pattern_valid, 1, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt);
+    ASSERT_EQ(is_pattern_valid, true);
+
+    CancelToken no_deadline;
+    PartialCount full = g->pattern_matching_partial(schedule, &no_deadline);
+    ASSERT_TRUE(full.finished);
+    ASSERT_EQ(full.completed_fraction, 1);
+    ASSERT_EQ(full.ans, g->pattern_matching(schedule));
+
+    CancelToken expired(0);
+    PartialCount none = g->pattern_matching_partial(schedule, &expired);
+    ASSERT_FALSE(none.finished);
+    ASSERT_EQ(none.ans, 0);
+    ASSERT_EQ(none.completed_fraction, 0);
+
+    CancelToken short_deadline(0.2);
+    PartialCount partial = g->pattern_matching_partial(schedule, &short_deadline);
+    ASSERT_LE(partial.ans, full.ans);
+    if (!partial.finished) {
+        ASSERT_LT(partial.completed_fraction, 1);
+    }
+
+    // max_running_time is honored by the plain interface as well
+    g->max_running_time = 0;
+    ASSERT_EQ(g->pattern_matching(schedule), 0);
+
+    delete g;
+}
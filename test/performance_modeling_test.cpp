@@ -2,61 +2,249 @@
 #include <../include/graph.h>
 #include <../include/dataloader.h>
 #include "../include/pattern.h"
-#include "../include/schedule.h"
+#include "../include/schedule_IEP.h"
 #include "../include/common.h"
+#include "test_graph.h"
 
 #include <iostream>
 #include <string>
 #include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+#include <vector>
 
-TEST(performance_modeling_test, performance_modeling_patents_qg3) {
+struct CandidateSchedule {
+    std::vector<int> order;
+    double uniform_cost, degree_cost, time;
+    long long ans;
+};
+
+// the orders whose prefixes are connected, one per distinct relabeled pattern
+static std::vector< std::vector<int> > candidate_orders(const Pattern& pattern) {
+    int size = pattern.get_size();
+    const int* adj_mat = pattern.get_adj_mat_ptr();
+    std::vector< std::vector<int> > orders;
+    std::set< std::vector<int> > seen;
+    std::vector<int> order(size);
+    for (int i = 0; i < size; ++i) order[i] = i;
+    do {
+        bool connected = true;
+        for (int i = 1; i < size && connected; ++i) {
+            connected = false;
+            for (int j = 0; j < i; ++j)
+                if (adj_mat[INDEX(order[i], order[j], size)])
+                    connected = true;
+        }
+        if (!connected) continue;
+        std::vector<int> relabeled(size * size);
+        for (int i = 0; i < size; ++i)
+            for (int j = 0; j < size; ++j)
+                relabeled[INDEX(i, j, size)] = adj_mat[INDEX(order[i], order[j], size)];
+        if (seen.insert(relabeled).second)
+            orders.push_back(order);
+    } while (std::next_permutation(order.begin(), order.end()));
+    return orders;
+}
+
+static Pattern relabel(const Pattern& pattern, const std::vector<int>& order) {
+    int size = pattern.get_size();
+    const int* adj_mat = pattern.get_adj_mat_ptr();
+    Pattern p(size);
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < i; ++j)
+            if (adj_mat[INDEX(order[i], order[j], size)])
+                p.add_edge(i, j);
+    return p;
+}
+
+static std::vector<double> ranks(const std::vector<double>& val) {
+    std::vector<int> id(val.size());
+    for (int i = 0; i < (int)id.size(); ++i) id[i] = i;
+    std::sort(id.begin(), id.end(), [&](int a, int b) { return val[a] < val[b]; });
+    std::vector<double> rank(val.size());
+    for (int i = 0; i < (int)id.size(); ++i) rank[id[i]] = i;
+    return rank;
+}
+
+static double spearman(const std::vector<double>& x, const std::vector<double>& y) {
+    std::vector<double> rx = ranks(x), ry = ranks(y);
+    double n = x.size(), d2 = 0;
+    for (int i = 0; i < (int)x.size(); ++i)
+        d2 += (rx[i] - ry[i]) * (rx[i] - ry[i]);
+    return n > 1 ? 1 - 6 * d2 / (n * (n * n - 1)) : 1;
+}
+
+static double model_cost(Graph* g, const Pattern& pattern, const std::vector<int>& order, bool degree_aware) {
+    bool is_pattern_valid;
+    Schedule_IEP schedule(relabel(pattern, order), is_pattern_valid, 0, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt, false, g->degree_stats);
+    EXPECT_EQ(is_pattern_valid, true);
+    return schedule.estimate_cost(g->v_cnt, g->e_cnt, g->tri_cnt, degree_aware ? g->degree_stats : nullptr);
+}
+
+// the candidate order of the pattern with the least cost in the degree-aware modeling
+static std::vector<int> degree_aware_pick(Graph* g, const Pattern& pattern) {
+    std::vector<int> best;
+    double best_cost = 1e300;
+    for (const auto& order : candidate_orders(pattern)) {
+        double cost = model_cost(g, pattern, order, true);
+        if (cost < best_cost) {
+            best_cost = cost;
+            best = order;
+        }
+    }
+    return best;
+}
+
+// Runs every candidate schedule of the pattern and prints the cost predicted by
+// the uniform and the degree-aware modeling next to the measured time (the
+// best of a few runs for the fast ones). The summary has the rank correlation
+// of each model with the measured times and the time of the order each model
+// picks, relative to the fastest one. Timings depend on the machine, so this
+// is a validation tool (the DISABLED_ tests below), not a unit test.
+static void validate_pattern(Graph* g, const Pattern& pattern, const char* name) {
+    std::vector<CandidateSchedule> candidates;
+    for (const auto& order : candidate_orders(pattern)) {
+        bool is_pattern_valid;
+        Schedule_IEP schedule(relabel(pattern, order), is_pattern_valid, 0, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt, false, g->degree_stats);
+        EXPECT_EQ(is_pattern_valid, true);
+
+        CandidateSchedule c;
+        c.order = order;
+        c.uniform_cost = schedule.estimate_cost(g->v_cnt, g->e_cnt, g->tri_cnt);
+        c.degree_cost = schedule.estimate_cost(g->v_cnt, g->e_cnt, g->tri_cnt, g->degree_stats);
+        double total = 0;
+        c.time = 1e18;
+        for (int run = 0; run < 5 && total < 0.1; ++run) {
+            double t1 = get_wall_time();
+            c.ans = g->pattern_matching(schedule);
+            double t = get_wall_time() - t1;
+            c.time = std::min(c.time, t);
+            total += t;
+        }
+        candidates.push_back(c);
+    }
+
+    printf("%s: %d candidate schedules\n", name, (int)candidates.size());
+    printf("%-20s %14s %14s %10s\n", "order", "uniform", "degree-aware", "time");
+    std::vector<double> uniform_cost, degree_cost, time;
+    int uniform_best = 0, degree_best = 0, best = 0;
+    for (int i = 0; i < (int)candidates.size(); ++i) {
+        const CandidateSchedule& c = candidates[i];
+        ASSERT_EQ(c.ans, candidates[0].ans);
+        std::string order;
+        for (int v : c.order) order += std::to_string(v) + " ";
+        printf("%-20s %14.4g %14.4g %10.6lf\n", order.c_str(), c.uniform_cost, c.degree_cost, c.time);
+        uniform_cost.push_back(c.uniform_cost);
+        degree_cost.push_back(c.degree_cost);
+        time.push_back(c.time);
+        if (c.uniform_cost < candidates[uniform_best].uniform_cost) uniform_best = i;
+        if (c.degree_cost < candidates[degree_best].degree_cost) degree_best = i;
+        if (c.time < candidates[best].time) best = i;
+    }
+    printf("%s: rank correlation uniform %.3lf degree-aware %.3lf, picked order time / best uniform %.2lf degree-aware %.2lf\n\n",
+           name, spearman(uniform_cost, time), spearman(degree_cost, time),
+           candidates[uniform_best].time / candidates[best].time, candidates[degree_best].time / candidates[best].time);
+    fflush(stdout);
+}
+
+TEST(performance_modeling_test, degree_statistics_wiki_vote) {
     Graph *g;
     DataLoader D;
-    
-    std::string type = "Patents";
-    std::string path = "/home/zms/patents_input";
-    DataType my_type;
-    if(type == "Patents") my_type = DataType::Patents;
-    else {
-        printf("invalid DataType!\n");
+    ASSERT_EQ(D.fast_load(g, "../../dataset/wiki-vote.g"), true);
+    ASSERT_NE(g->degree_stats, nullptr);
+    const DegreeStatistics& stats = *g->degree_stats;
+
+    double v_total = 0, degree_total = 0, triangle_rate = 0;
+    for (int b = 0; b < DegreeStatistics::bucket_num; ++b) {
+        v_total += stats.vertex_cnt[b];
+        degree_total += stats.vertex_cnt[b] * stats.avg_degree[b];
+        triangle_rate += stats.triangle_rate[b];
+        double neighbor_rate = 0;
+        for (int c = 0; c < DegreeStatistics::bucket_num; ++c)
+            neighbor_rate += stats.neighbor_rate[b][c];
+        if (stats.vertex_cnt[b] > 0 && stats.avg_degree[b] > 0) {
+            ASSERT_NEAR(neighbor_rate, 1, 1e-9);
+        }
+        ASSERT_GE(stats.clustering[b], 0);
+        ASSERT_LE(stats.clustering[b], 1);
     }
+    ASSERT_EQ(v_total, g->v_cnt);
+    ASSERT_NEAR(degree_total, g->e_cnt, 1e-6 * g->e_cnt);
+    ASSERT_NEAR(triangle_rate, 1, 1e-9);
 
-    ASSERT_EQ(D.load_data(g,my_type,path.c_str()),true);
-    
-    printf("Load data success!\n");
-    fflush(stdout);
-    
-    Pattern pattern(PatternType::House);
+    // the mean common neighbors of the sampled edges estimates 3 * tri_cnt / (e_cnt / 2)
+    double edge_common = 0, edge_weight = 0;
+    for (int b = 0; b < DegreeStatistics::bucket_num; ++b)
+        for (int c = 0; c < DegreeStatistics::bucket_num; ++c)
+            if (stats.edge_common[b][c] >= 0) {
+                double w = stats.vertex_cnt[b] * stats.avg_degree[b] * stats.neighbor_rate[b][c];
+                edge_common += w * stats.edge_common[b][c];
+                edge_weight += w;
+            }
+    ASSERT_NEAR(edge_common / edge_weight, 6.0 * g->tri_cnt / g->e_cnt, 0.1 * 6.0 * g->tri_cnt / g->e_cnt);
 
-    bool is_pattern_valid = false;
-    int performance_modeling_type = 1;
-    bool use_in_exclusion_optimize = false;
-    Schedule schedule(pattern, is_pattern_valid, performance_modeling_type, use_in_exclusion_optimize, g->v_cnt, g->e_cnt);
-    ASSERT_EQ(is_pattern_valid, true);
+    delete g;
+}
 
-    printf("performance modeling adj_mat\n");
-    schedule.print_schedule();
+TEST(performance_modeling_test, DISABLED_predicted_vs_measured_wiki_vote) {
+    Graph *g;
+    DataLoader D;
+    ASSERT_EQ(D.fast_load(g, "../../dataset/wiki-vote.g"), true);
+    ASSERT_NE(g->degree_stats, nullptr);
 
+    validate_pattern(g, Pattern(PatternType::QG3), "qg3");
 
-    std::vector< std::pair<int,int> > pairs;
-    schedule.aggressive_optimize(pairs);
-    schedule.add_restrict(pairs);
+    delete g;
+}
 
-    printf("aggressive optimize success!\n");
-    fflush(stdout);
+// The generator numbers the hubs first, the restrictions then keep the
+// vertices of low degree at the larger ids; the same graph is also run with
+// the ids reversed, which makes other orders the fast ones.
+static Graph *reverse_ids(Graph *g) {
+    std::vector<std::vector<int>> adj(g->v_cnt);
+    for (int v = 0; v < g->v_cnt; ++v)
+        for (e_index_t i = g->vertex[v]; i < g->vertex[v + 1]; ++i)
+            adj[g->v_cnt - 1 - v].push_back(g->v_cnt - 1 - g->edge[i]);
+    return graph_from_adj(adj);
+}
 
-    int thread_num = 24;
-    double t1,t2;
-    long long ans;
-    
-    printf("pattern_matching begin\n");
-    fflush(stdout);
-    
-    t1 = get_wall_time();
-    ans = g->pattern_matching(schedule, thread_num);
-    t2 = get_wall_time();
+TEST(performance_modeling_test, DISABLED_predicted_vs_measured_power_law) {
+    Graph *g = power_law_graph(3000, 6, 2.2, 2022);
+    validate_pattern(g, Pattern(PatternType::Rectangle), "rectangle");
+    validate_pattern(g, Pattern(PatternType::House), "house");
+    validate_pattern(g, Pattern(PatternType::Pentagon), "pentagon");
+
+    Graph *reversed = reverse_ids(g);
+    validate_pattern(reversed, Pattern(PatternType::House), "house, reversed ids");
+    validate_pattern(reversed, Pattern(PatternType::Pentagon), "pentagon, reversed ids");
+
+    delete reversed;
+    delete g;
+}
+
+// The picks of the degree-aware modeling on the fixed statistics of the power
+// law graph. The allowed orders are those measured within 1.2 times the
+// fastest by DISABLED_predicted_vs_measured_power_law, they differ between
+// the two numberings.
+TEST(performance_modeling_test, degree_aware_picks) {
+    typedef std::vector<int> Order;
+    Graph *g = power_law_graph(3000, 6, 2.2, 2022);
+    Graph *reversed = reverse_ids(g);
+    ASSERT_LT(g->degree_stats->id_slope, -0.5);
+    ASSERT_GT(reversed->degree_stats->id_slope, 0.5);
 
-    printf("ans: %lld time: %.6lf\n", ans, t2 - t1);
+    Pattern house(PatternType::House), pentagon(PatternType::Pentagon);
+    ASSERT_EQ(degree_aware_pick(g, Pattern(PatternType::Rectangle)), (Order{0, 1, 2, 3}));
+    std::set<Order> house_fast = {{0, 1, 2, 3, 4}, {0, 1, 2, 4, 3}};
+    std::set<Order> reversed_house_fast = {{0, 1, 4, 2, 3}, {0, 1, 4, 3, 2}};
+    std::set<Order> pentagon_fast = {{0, 1, 2, 3, 4}, {0, 1, 3, 2, 4}};
+    std::set<Order> reversed_pentagon_fast = {{0, 1, 2, 4, 3}, {0, 1, 3, 4, 2}};
+    ASSERT_EQ(house_fast.count(degree_aware_pick(g, house)), 1u);
+    ASSERT_EQ(reversed_house_fast.count(degree_aware_pick(reversed, house)), 1u);
+    ASSERT_EQ(pentagon_fast.count(degree_aware_pick(g, pentagon)), 1u);
+    ASSERT_EQ(reversed_pentagon_fast.count(degree_aware_pick(reversed, pentagon)), 1u);
 
+    delete reversed;
     delete g;
 }
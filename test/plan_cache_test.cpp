@@ -0,0 +1,230 @@
+#include <gtest/gtest.h>
+#include <../include/graph.h>
+#include "../include/pattern.h"
+#include "../include/common.h"
+#include "../include/schedule_IEP.h"
+#include "../include/plan_cache.h"
+#include "test_graph.h"
+
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+static Pattern relabel(const Pattern& pattern, const std::vector<int>& perm) {
+    int size = pattern.get_size();
+    const int* adj_mat = pattern.get_adj_mat_ptr();
+    Pattern p(size);
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < size; ++j)
+            if (adj_mat[INDEX(i, j, size)])
+                p.add_ordered_edge(perm[i], perm[j]);
+    return p;
+}
+
+static Pattern cycle(int size) {
+    Pattern p(size);
+    for (int i = 0; i < size; ++i)
+        p.add_edge(i, (i + 1) % size);
+    return p;
+}
+
+static void expect_same_schedule(const Schedule_IEP& a, const Schedule_IEP& b) {
+    int size = a.get_size();
+    ASSERT_EQ(size, b.get_size());
+    for (int i = 0; i < size * size; ++i)
+        ASSERT_EQ(a.get_adj_mat_ptr()[i], b.get_adj_mat_ptr()[i]);
+    ASSERT_EQ(a.get_total_prefix_num(), b.get_total_prefix_num());
+    ASSERT_EQ(a.get_basic_prefix_num(), b.get_basic_prefix_num());
+    for (int i = 0; i < a.get_total_prefix_num(); ++i) {
+        ASSERT_EQ(a.get_father_prefix_id(i), b.get_father_prefix_id(i));
+        ASSERT_EQ(a.get_next(i), b.get_next(i));
+        ASSERT_EQ(a.get_break_size_ptr()[i], b.get_break_size_ptr()[i]);
+        ASSERT_EQ(a.get_prefix_only_need_size(i), b.get_prefix_only_need_size(i));
+    }
+    for (int i = 0; i < size; ++i) {
+        ASSERT_EQ(a.get_last(i), b.get_last(i));
+        ASSERT_EQ(a.get_loop_set_prefix_id(i), b.get_loop_set_prefix_id(i));
+        ASSERT_EQ(a.get_restrict_last(i), b.get_restrict_last(i));
+    }
+    ASSERT_EQ(a.get_total_restrict_num(), b.get_total_restrict_num());
+    for (int i = 0; i < a.get_total_restrict_num(); ++i) {
+        ASSERT_EQ(a.get_restrict_next(i), b.get_restrict_next(i));
+        ASSERT_EQ(a.get_restrict_index(i), b.get_restrict_index(i));
+    }
+    ASSERT_EQ(a.restrict_pair, b.restrict_pair);
+    ASSERT_EQ(a.get_in_exclusion_optimize_num(), b.get_in_exclusion_optimize_num());
+    ASSERT_EQ(a.get_in_exclusion_optimize_redundancy(), b.get_in_exclusion_optimize_redundancy());
+    ASSERT_EQ(a.in_exclusion_optimize_vertex_id, b.in_exclusion_optimize_vertex_id);
+    ASSERT_EQ(a.in_exclusion_optimize_vertex_flag, b.in_exclusion_optimize_vertex_flag);
+    ASSERT_EQ(a.in_exclusion_optimize_vertex_coef, b.in_exclusion_optimize_vertex_coef);
+    ASSERT_EQ(a.in_exclusion_optimize_coef, b.in_exclusion_optimize_coef);
+    ASSERT_EQ(a.in_exclusion_optimize_flag, b.in_exclusion_optimize_flag);
+    ASSERT_EQ(a.in_exclusion_optimize_ans_pos, b.in_exclusion_optimize_ans_pos);
+    ASSERT_EQ(a.is_vertex_induced, b.is_vertex_induced);
+}
+
+TEST(plan_cache_test, canonical_form) {
+    std::mt19937 rng(2022);
+    std::vector<Pattern> patterns = {Pattern(House), Pattern(QG3), Pattern(Pentagon), Pattern(Hourglass), Pattern(Cycle_6_Tri), cycle(9)};
+    for (const Pattern& pattern : patterns) {
+        std::string form = pattern.get_canonical_form();
+        std::vector<int> perm(pattern.get_size());
+        for (int i = 0; i < (int)perm.size(); ++i) perm[i] = i;
+        for (int t = 0; t < 10; ++t) {
+            std::shuffle(perm.begin(), perm.end(), rng);
+            ASSERT_EQ(relabel(pattern, perm).get_canonical_form(), form);
+        }
+    }
+    for (int i = 0; i < (int)patterns.size(); ++i)
+        for (int j = 0; j < i; ++j)
+            ASSERT_NE(patterns[i].get_canonical_form(), patterns[j].get_canonical_form());
+
+    // same degrees, not isomorphic
+    Pattern two_triangles(6);
+    for (int i = 0; i < 3; ++i) {
+        two_triangles.add_edge(i, (i + 1) % 3);
+        two_triangles.add_edge(3 + i, 3 + (i + 1) % 3);
+    }
+    ASSERT_NE(two_triangles.get_canonical_form(), cycle(6).get_canonical_form());
+}
+
+static std::vector<Pattern> test_patterns() {
+    std::vector<Pattern> patterns = {Pattern(House), Pattern(QG3), Pattern(Hourglass), Pattern(Cycle_6_Tri), cycle(7)};
+    // house with a tail
+    Pattern p(7);
+    p.add_edge(0, 1);
+    p.add_edge(1, 2);
+    p.add_edge(2, 3);
+    p.add_edge(3, 0);
+    p.add_edge(0, 4);
+    p.add_edge(1, 4);
+    p.add_edge(2, 5);
+    p.add_edge(5, 6);
+    patterns.push_back(p);
+    return patterns;
+}
+
+TEST(plan_cache_test, hit) {
+    Graph *g = random_graph(24, 0.3, 2022);
+
+    const char *dir = "plan_cache_test.dir";
+    std::mt19937 rng(2022);
+    for (const Pattern& pattern : test_patterns()) {
+        bool is_pattern_valid;
+        Schedule_IEP schedule(pattern, is_pattern_valid, 1, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt);
+        long long ans = g->pattern_matching(schedule);
+
+        PlanCache cache(dir);
+        remove(cache.get_file_name(cache.get_key(pattern, 1, 1, true, g, false, false)).c_str());
+        Schedule_IEP *first = cache.get_schedule(pattern, is_pattern_valid, 1, 1, true, g);
+        ASSERT_FALSE(cache.get_last_hit());
+        ASSERT_EQ(is_pattern_valid, true);
+        expect_same_schedule(schedule, *first);
+
+        // an isomorphic pattern is answered from the file
+        std::vector<int> perm(pattern.get_size());
+        for (int i = 0; i < (int)perm.size(); ++i) perm[i] = i;
+        std::shuffle(perm.begin(), perm.end(), rng);
+        PlanCache other(dir);
+        is_pattern_valid = false;
+        Schedule_IEP *second = other.get_schedule(relabel(pattern, perm), is_pattern_valid, 1, 1, true, g);
+        ASSERT_TRUE(other.get_last_hit());
+        ASSERT_EQ(is_pattern_valid, true);
+        expect_same_schedule(*first, *second);
+        ASSERT_EQ(g->pattern_matching(*second), ans);
+
+        // other parameters are a different plan
+        remove(other.get_file_name(other.get_key(pattern, 1, 2, true, g, false, false)).c_str());
+        Schedule_IEP *third = other.get_schedule(pattern, is_pattern_valid, 1, 2, true, g);
+        ASSERT_FALSE(other.get_last_hit());
+        ASSERT_EQ(g->pattern_matching(*third), ans);
+        ASSERT_EQ(other.get_hit_cnt(), 1);
+        ASSERT_EQ(other.get_miss_cnt(), 1);
+
+        delete first;
+        delete second;
+        delete third;
+        remove(other.get_file_name(other.get_key(pattern, 1, 1, true, g, false, false)).c_str());
+        remove(other.get_file_name(other.get_key(pattern, 1, 2, true, g, false, false)).c_str());
+    }
+    rmdir(dir);
+    delete g;
+}
+
+TEST(plan_cache_test, truncated_file) {
+    Graph *g = random_graph(24, 0.3, 2022);
+
+    const char *dir = "plan_cache_test.dir";
+    Pattern pattern(House);
+    PlanCache cache(dir);
+    std::string file_name = cache.get_file_name(cache.get_key(pattern, 1, 1, true, g, false, false));
+    bool is_pattern_valid;
+    delete cache.get_schedule(pattern, is_pattern_valid, 1, 1, true, g);
+
+    FILE *fp = fopen(file_name.c_str(), "rb");
+    ASSERT_NE(fp, nullptr);
+    std::vector<char> buf(1 << 20);
+    size_t len = fread(buf.data(), 1, buf.size(), fp);
+    fclose(fp);
+    fp = fopen(file_name.c_str(), "wb");
+    fwrite(buf.data(), 1, len / 2, fp);
+    fclose(fp);
+
+    // a torn file is planned again and rewritten
+    Schedule_IEP *schedule = cache.get_schedule(pattern, is_pattern_valid, 1, 1, true, g);
+    ASSERT_FALSE(cache.get_last_hit());
+    ASSERT_EQ(is_pattern_valid, true);
+    Schedule_IEP *loaded = cache.get_schedule(pattern, is_pattern_valid, 1, 1, true, g);
+    ASSERT_TRUE(cache.get_last_hit());
+    expect_same_schedule(*schedule, *loaded);
+
+    delete schedule;
+    delete loaded;
+    remove(file_name.c_str());
+    rmdir(dir);
+    delete g;
+}
+
+TEST(plan_cache_test, truncated_plan) {
+    Graph *g = random_graph(24, 0.3, 2022);
+    const char *dir = "plan_cache_test.dir";
+    Pattern pattern = cycle(12);
+    PlanCache cache(dir);
+    std::string file_name = cache.get_file_name(cache.get_key(pattern, 1, 2, true, g, false, false));
+    remove(file_name.c_str());
+
+    // a plan whose search ran out of time is not kept
+    bool is_pattern_valid;
+    Schedule_IEP *truncated = cache.get_schedule(pattern, is_pattern_valid, 1, 2, true, g, false, false, 0);
+    ASSERT_EQ(is_pattern_valid, true);
+    ASSERT_TRUE(truncated->is_planning_truncated());
+    ASSERT_NE(access(file_name.c_str(), F_OK), 0);
+    delete cache.get_schedule(pattern, is_pattern_valid, 1, 2, true, g, false, false, 0);
+    ASSERT_FALSE(cache.get_last_hit());
+
+    delete truncated;
+    rmdir(dir);
+    delete g;
+}
+
+TEST(plan_cache_test, key) {
+    Graph *g = random_graph(24, 0.3, 2022);
+    PlanCache cache("plan_cache_test.dir");
+    Pattern pattern(House);
+
+    // the plans of another planner are other files
+    std::string key = cache.get_key(pattern, 1, 1, true, g, false, false);
+    ASSERT_NE(key.find(" planner" + std::to_string(Schedule_IEP::planner_version) + " "), std::string::npos);
+    // and so are the degree-aware ones, of every change of the statistics
+    std::string degree_key = cache.get_key(pattern, 1, 1, true, g, false, true);
+    ASSERT_NE(degree_key, key);
+    g->degree_stats->random_common_rate *= 2;
+    ASSERT_NE(cache.get_key(pattern, 1, 1, true, g, false, true), degree_key);
+    ASSERT_EQ(cache.get_key(pattern, 1, 1, true, g, false, false), key);
+
+    rmdir("plan_cache_test.dir");
+    delete g;
+}
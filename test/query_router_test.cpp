@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+#include <../include/graph.h>
+#include "../include/pattern.h"
+#include "../include/common.h"
+#include "../include/schedule_IEP.h"
+#include "../include/motif_generator.h"
+#include "../include/query_router.h"
+#include "../include/analytic_counting.h"
+#include "test_graph.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+static long long generic_count(Graph *g, const Pattern& pattern, bool vertex_induced) {
+    bool is_pattern_valid;
+    Schedule_IEP schedule(pattern, is_pattern_valid, 1, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt, vertex_induced);
+    EXPECT_TRUE(is_pattern_valid);
+    return g->pattern_matching(schedule);
+}
+
+TEST(query_router_test, classify) {
+    Pattern star(5), path(5), wedge(3), tailed_star(5);
+    for (int i = 1; i < 5; ++i) {
+        star.add_edge(0, i);
+        path.add_edge(i - 1, i);
+    }
+    wedge.add_edge(0, 1);
+    wedge.add_edge(1, 2);
+    tailed_star.add_edge(0, 1);
+    tailed_star.add_edge(0, 2);
+    tailed_star.add_edge(0, 3);
+    tailed_star.add_edge(3, 4);
+    ASSERT_EQ(QueryRouter::classify(Pattern(3, true)), PatternClass::Triangle);
+    ASSERT_EQ(QueryRouter::classify(Pattern(2, true)), PatternClass::Clique);
+    ASSERT_EQ(QueryRouter::classify(Pattern(6, true)), PatternClass::Clique);
+    ASSERT_EQ(QueryRouter::classify(wedge), PatternClass::Wedge);
+    ASSERT_EQ(QueryRouter::classify(star), PatternClass::Star);
+    ASSERT_EQ(QueryRouter::classify(path), PatternClass::Path);
+    ASSERT_EQ(QueryRouter::classify(tailed_star), PatternClass::DoubleStar);
+    tailed_star.add_edge(4, 2);
+    ASSERT_EQ(QueryRouter::classify(tailed_star), PatternClass::Other);
+    ASSERT_EQ(QueryRouter::classify(Pattern(House)), PatternClass::Other);
+    ASSERT_EQ(QueryRouter::classify(Pattern(Rectangle)), PatternClass::Other);
+    ASSERT_EQ(QueryRouter::classify(Pattern(4)), PatternClass::Other); // not connected
+}
+
+TEST(query_router_test, counts) {
+    Graph *g = random_graph(60, 0.35, 2022);
+    QueryRouter router(g);
+    std::vector<Pattern> patterns;
+    for (int size = 3; size <= 5; ++size)
+        for (const Pattern& p : MotifGenerator(size).generate())
+            patterns.push_back(p);
+    patterns.push_back(Pattern(6, true));
+    patterns.push_back(Pattern(7, true));
+    for (const Pattern& p : patterns)
+        for (int vertex_induced = 0; vertex_induced < 2; ++vertex_induced) {
+            bool is_pattern_valid;
+            long long ans = router.count(p, is_pattern_valid, vertex_induced);
+            ASSERT_TRUE(is_pattern_valid);
+            ASSERT_EQ(ans, generic_count(g, p, vertex_induced));
+            PatternClass pattern_class = QueryRouter::classify(p);
+            if (pattern_class == PatternClass::Triangle || pattern_class == PatternClass::Clique) {
+                ASSERT_STRNE(router.get_last_engine(), "pattern_matching");
+            }
+        }
+    delete g;
+}
+
+TEST(query_router_test, analytic) {
+    // dense, so the leaves of the two centers of a double star share many neighbors
+    Graph *g = random_graph(50, 0.5, 7);
+    AnalyticCounter counter(g);
+    for (int size = 3; size <= 7; ++size) {
+        Pattern star(size);
+        for (int i = 1; i < size; ++i)
+            star.add_edge(0, i);
+        ASSERT_TRUE(AnalyticCounter::is_supported(star));
+        ASSERT_EQ(counter.count(star), generic_count(g, star, false));
+        // centers 0 and 1 with a and size - 2 - a leaves
+        for (int a = 1; a <= size - 3; ++a) {
+            Pattern double_star(size);
+            double_star.add_edge(0, 1);
+            for (int i = 2; i < size; ++i)
+                double_star.add_edge(i < 2 + a ? 0 : 1, i);
+            ASSERT_TRUE(AnalyticCounter::is_supported(double_star));
+            ASSERT_EQ(counter.count(double_star), generic_count(g, double_star, false));
+        }
+    }
+    Pattern wedge(3), path(5);
+    wedge.add_edge(0, 1);
+    wedge.add_edge(1, 2);
+    for (int i = 1; i < 5; ++i)
+        path.add_edge(i - 1, i);
+    ASSERT_EQ(counter.count(wedge, true), generic_count(g, wedge, true));
+    ASSERT_EQ(counter.count_triangles(), g->triangle_counting_mt());
+    ASSERT_FALSE(AnalyticCounter::is_supported(path));
+    ASSERT_FALSE(AnalyticCounter::is_supported(Pattern(4), true));
+    ASSERT_FALSE(AnalyticCounter::is_supported(Pattern(Rectangle)));
+    delete g;
+}
@@ -0,0 +1,252 @@
+#include <gtest/gtest.h>
+#include <../include/graph.h>
+#include "../include/dataloader.h"
+#include "../include/pattern.h"
+#include "../include/common.h"
+#include "../include/schedule_IEP.h"
+#include "../include/plan_cache.h"
+#include "../include/query_server.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+
+static const char* graph_path = "../../dataset/wiki-vote.g";
+static const char* rectangle = "0101101001011010";
+static const char* house = "0101110101010101010011000";
+
+// a client of serve(), which runs in its own thread between two pipes
+class PipeClient {
+public:
+    PipeClient(QueryServer& server) {
+        int request_pipe[2], reply_pipe[2];
+        EXPECT_EQ(pipe(request_pipe), 0);
+        EXPECT_EQ(pipe(reply_pipe), 0);
+        requests = fdopen(request_pipe[1], "w");
+        replies = fdopen(reply_pipe[0], "r");
+        FILE* in = fdopen(request_pipe[0], "r");
+        FILE* out = fdopen(reply_pipe[1], "w");
+        thread = std::thread([&server, in, out, this] {
+            running = server.serve(in, out);
+            fclose(out);
+            fclose(in);
+        });
+    }
+
+    ~PipeClient() {
+        if (thread.joinable())
+            finish();
+    }
+
+    void send(const std::string& line) {
+        fprintf(requests, "%s\n", line.c_str());
+        fflush(requests);
+    }
+
+    // the reply of line, without its newline
+    std::string request(const std::string& line) {
+        send(line);
+        char reply[1024];
+        if (fgets(reply, sizeof(reply), replies) == nullptr)
+            return "";
+        std::string s(reply);
+        if (!s.empty() && s.back() == '\n')
+            s.pop_back();
+        return s;
+    }
+
+    // ends the requests, returns what serve() returned
+    bool finish() {
+        fclose(requests);
+        thread.join();
+        fclose(replies);
+        return running;
+    }
+
+private:
+    FILE* requests;
+    FILE* replies;
+    std::thread thread;
+    bool running;
+};
+
+static std::vector<std::string> split(const std::string& reply) {
+    std::istringstream in(reply);
+    std::vector<std::string> words;
+    std::string word;
+    while (in >> word)
+        words.push_back(word);
+    return words;
+}
+
+static long long generic_count(Graph *g, const char* adj, int size, bool vertex_induced) {
+    bool is_pattern_valid;
+    Schedule_IEP schedule(Pattern(size, adj), is_pattern_valid, 1, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt, vertex_induced);
+    EXPECT_TRUE(is_pattern_valid);
+    return g->pattern_matching(schedule);
+}
+
+TEST(query_server_test, pipe) {
+    Graph *g;
+    DataLoader D;
+    ASSERT_TRUE(D.fast_load(g, graph_path));
+
+    QueryServer server(nullptr, 0);
+    PipeClient client(server);
+    ASSERT_EQ(client.request("graphs"), "ok 0");
+    std::vector<std::string> reply = split(client.request(std::string("load wiki ") + graph_path));
+    ASSERT_EQ(reply.size(), 5u);
+    ASSERT_EQ(reply[0], "ok");
+    ASSERT_EQ(reply[1], "wiki");
+    ASSERT_EQ(std::stoll(reply[2]), (long long)g->v_cnt);
+    ASSERT_EQ(std::stoll(reply[3]), (long long)g->e_cnt);
+    ASSERT_EQ(client.request("load other no_such_graph.g"), "error cannot load no_such_graph.g");
+    ASSERT_EQ(client.request("graphs"), "ok 1 wiki");
+
+    // triangles are counted by their own engine, without a plan
+    reply = split(client.request("count wiki 3 011101110"));
+    ASSERT_EQ(reply.size(), 5u);
+    ASSERT_EQ(reply[0], "ok");
+    ASSERT_EQ(reply[1], "608389");
+    ASSERT_EQ(reply[4], "direct");
+
+    // the plan of a generic pattern is made by the first query of any of its labelings
+    long long rectangle_cnt = generic_count(g, rectangle, 4, false);
+    reply = split(client.request(std::string("count wiki 4 ") + rectangle));
+    ASSERT_EQ(reply.size(), 5u);
+    ASSERT_EQ(reply[0], "ok");
+    ASSERT_EQ(std::stoll(reply[1]), rectangle_cnt);
+    ASSERT_EQ(reply[4], "miss");
+    reply = split(client.request("count wiki 4 0011001111001100"));
+    ASSERT_EQ(reply[0], "ok");
+    ASSERT_EQ(std::stoll(reply[1]), rectangle_cnt);
+    ASSERT_EQ(reply[4], "hit");
+    reply = split(client.request(std::string("count wiki 4 ") + rectangle + " induced"));
+    ASSERT_EQ(reply[0], "ok");
+    ASSERT_EQ(std::stoll(reply[1]), generic_count(g, rectangle, 4, true));
+    ASSERT_EQ(reply[4], "miss");
+
+    // the house takes seconds, its count is stopped by the timeout
+    reply = split(client.request(std::string("count wiki 5 ") + house + " timeout 0.05"));
+    ASSERT_EQ(reply.size(), 7u);
+    ASSERT_EQ(reply[0], "partial");
+    ASSERT_GE(std::stoll(reply[1]), 0);
+    ASSERT_GE(std::stod(reply[3]), 0.0);
+    ASSERT_LT(std::stod(reply[3]), 1.0);
+    ASSERT_EQ(reply[6], "miss");
+    reply = split(client.request(std::string("count wiki 5 ") + house + " timeout 0"));
+    ASSERT_EQ(reply[0], "partial");
+    ASSERT_EQ(reply[6], "hit");
+
+    ASSERT_EQ(client.request("count wiki 3 011"), "error the pattern needs 2 to 16 vertices and SIZE * SIZE adjacency characters");
+    ASSERT_EQ(client.request("count wiki 3 010100000"), "error the pattern is not connected");
+    ASSERT_EQ(client.request("count wiki 3 011101110 bogus"), "error bad option bogus");
+    ASSERT_EQ(client.request("count wiki 3"), "error usage: count NAME SIZE ADJ [induced] [timeout SECONDS]");
+    ASSERT_EQ(client.request("count none 3 011101110"), "error unknown graph none");
+    ASSERT_EQ(client.request("frobnicate"), "error unknown command frobnicate");
+
+    ASSERT_EQ(client.request("drop wiki"), "ok");
+    ASSERT_EQ(client.request("drop wiki"), "error unknown graph");
+    ASSERT_EQ(client.request("count wiki 3 011101110"), "error unknown graph wiki");
+    ASSERT_EQ(client.request("graphs"), "ok 0");
+
+    ASSERT_EQ(client.request("shutdown"), "ok");
+    ASSERT_FALSE(client.finish());
+    delete g;
+}
+
+TEST(query_server_test, quit) {
+    QueryServer server(nullptr, 0);
+    PipeClient quitting(server);
+    ASSERT_EQ(quitting.request("graphs"), "ok 0");
+    quitting.send("quit");
+    ASSERT_TRUE(quitting.finish());
+
+    // the end of the requests is a quit
+    PipeClient closing(server);
+    ASSERT_EQ(closing.request("graphs"), "ok 0");
+    ASSERT_TRUE(closing.finish());
+}
+
+TEST(query_server_test, plan_cache) {
+    Graph *g;
+    DataLoader D;
+    ASSERT_TRUE(D.fast_load(g, graph_path));
+    const char *dir = "query_server_test.dir";
+    PlanCache cache(dir);
+    std::string file_name = cache.get_file_name(cache.get_key(Pattern(4, rectangle), 1, 1, true, g, false, false));
+    remove(file_name.c_str());
+
+    long long rectangle_cnt = generic_count(g, rectangle, 4, false);
+    for (int run = 0; run < 2; ++run) {
+        // the plans of a server are its own, the second one loads the schedule from the cache
+        QueryServer server(&cache, 0);
+        PipeClient client(server);
+        ASSERT_EQ(split(client.request(std::string("load wiki ") + graph_path))[0], "ok");
+        std::vector<std::string> reply = split(client.request(std::string("count wiki 4 ") + rectangle));
+        ASSERT_EQ(reply[0], "ok");
+        ASSERT_EQ(std::stoll(reply[1]), rectangle_cnt);
+        ASSERT_EQ(reply[4], "miss");
+        ASSERT_EQ(access(file_name.c_str(), F_OK), 0);
+        ASSERT_TRUE(client.finish());
+    }
+
+    remove(file_name.c_str());
+    rmdir(dir);
+    delete g;
+}
+
+static int connect_to(const char* socket_path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+TEST(query_server_test, socket_shutdown) {
+    const char* socket_path = "query_server_test.sock";
+    // shared with the server thread, which outlives the test if it hangs
+    std::shared_ptr<QueryServer> server(new QueryServer(nullptr, 0));
+    std::shared_ptr<std::promise<bool> > served(new std::promise<bool>());
+    std::future<bool> result = served->get_future();
+    std::thread([server, served, socket_path] { served->set_value(server->serve_socket(socket_path)); }).detach();
+
+    int idle = -1, client = -1;
+    for (int i = 0; i < 100 && (idle < 0 || client < 0); ++i) {
+        if (idle < 0)
+            idle = connect_to(socket_path);
+        else
+            client = connect_to(socket_path);
+        if (idle < 0 || client < 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_GE(idle, 0);
+    ASSERT_GE(client, 0);
+
+    // an idle client does not keep the server from stopping
+    const char request[] = "shutdown\n";
+    ASSERT_EQ(write(client, request, sizeof(request) - 1), (ssize_t)(sizeof(request) - 1));
+    char reply[16];
+    ASSERT_EQ(read(client, reply, sizeof(reply)), 3);
+    ASSERT_EQ(std::string(reply, 3), "ok\n");
+    ASSERT_EQ(result.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    ASSERT_TRUE(result.get());
+    ASSERT_EQ(read(idle, reply, sizeof(reply)), 0);
+    ASSERT_NE(access(socket_path, F_OK), 0);
+    close(idle);
+    close(client);
+}
@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+#include <../include/graph.h>
+#include "../include/pattern.h"
+#include "../include/common.h"
+#include "../include/schedule_IEP.h"
+#include "../include/schedule_plan.h"
+#include "../include/motif_generator.h"
+#include "test_graph.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+#include <omp.h>
+
+static void expect_same_plan(const SchedulePlan& a, const SchedulePlan& b) {
+    ASSERT_EQ(a.byte_size, b.byte_size);
+    ASSERT_EQ(memcmp(&a, &b, a.byte_size), 0);
+}
+
+TEST(schedule_plan_test, counts) {
+    Graph *g = random_graph(40, 0.3, 2022);
+    std::vector<Pattern> patterns = MotifGenerator(5).generate();
+    patterns.push_back(Pattern(House));
+    patterns.push_back(Pattern(Hourglass));
+    for (const Pattern& pattern : patterns)
+        for (int vertex_induced = 0; vertex_induced < 2; ++vertex_induced)
+            for (int use_iep = 0; use_iep < 2; ++use_iep) {
+                bool is_pattern_valid;
+                Schedule_IEP schedule(pattern, is_pattern_valid, 1, 1, use_iep && !vertex_induced,
+                    g->v_cnt, g->e_cnt, g->tri_cnt, vertex_induced);
+                SchedulePlan *plan = SchedulePlan::create(schedule);
+                ASSERT_EQ((uintptr_t)plan % 64, 0u);
+                ASSERT_EQ(plan->byte_size % 64, 0u);
+                ASSERT_TRUE(SchedulePlan::check(plan, plan->byte_size));
+                ASSERT_EQ(plan->get_size(), schedule.get_size());
+                ASSERT_EQ(plan->get_in_exclusion_optimize_num(), schedule.get_in_exclusion_optimize_num());
+                ASSERT_EQ(plan->get_restrict_pair_num(), (int)schedule.restrict_pair.size());
+
+                // a plain byte copy is a plan of its own
+                void *copy = aligned_alloc(64, plan->byte_size);
+                memcpy(copy, plan, plan->byte_size);
+                long long ans = g->pattern_matching(*plan);
+                SchedulePlan::destroy(plan);
+                ASSERT_EQ(g->pattern_matching(*static_cast<SchedulePlan*>(copy)), ans);
+                free(copy);
+
+                // the count of the plain schedule, without IEP and restrictions
+                Schedule_IEP plain(pattern, is_pattern_valid, 0, 0, false, g->v_cnt, g->e_cnt, g->tri_cnt, vertex_induced);
+                ASSERT_EQ(g->pattern_matching(plain) / plain.get_multiplicity(), ans);
+            }
+    delete g;
+}
+
+TEST(schedule_plan_test, save_load) {
+    Graph *g = random_graph(40, 0.3, 7);
+    bool is_pattern_valid;
+    Schedule_IEP schedule(Pattern(House), is_pattern_valid, 1, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt);
+    SchedulePlan *plan = SchedulePlan::create(schedule);
+    SchedulePlan *clone = plan->clone();
+    expect_same_plan(*plan, *clone);
+
+    const char *file_name = "schedule_plan_test.plan";
+    FILE *fp = fopen(file_name, "wb");
+    ASSERT_TRUE(plan->save(fp));
+    fclose(fp);
+    fp = fopen(file_name, "rb");
+    SchedulePlan *loaded = SchedulePlan::load(fp);
+    fclose(fp);
+    ASSERT_NE(loaded, nullptr);
+    expect_same_plan(*plan, *loaded);
+    ASSERT_EQ(g->pattern_matching(*loaded), g->pattern_matching(schedule));
+
+    // a torn file is not a plan
+    fp = fopen(file_name, "wb");
+    fwrite(plan, 1, plan->byte_size / 2, fp);
+    fclose(fp);
+    fp = fopen(file_name, "rb");
+    ASSERT_EQ(SchedulePlan::load(fp), nullptr);
+    fclose(fp);
+    remove(file_name);
+
+    // neither are bytes with an index out of range
+    int *data = reinterpret_cast<int *>(clone);
+    data[clone->offset[SchedulePlan::Next]] = clone->get_total_prefix_num();
+    ASSERT_FALSE(SchedulePlan::check(clone, clone->byte_size));
+    ASSERT_FALSE(SchedulePlan::check(plan, plan->byte_size - 64));
+
+    SchedulePlan::destroy(plan);
+    SchedulePlan::destroy(clone);
+    SchedulePlan::destroy(loaded);
+    delete g;
+}
+
+TEST(schedule_plan_test, concurrent_graphs) {
+    // graphs of different degrees, each run sizes its buffers by its own graph
+    Graph *graphs[] = {random_graph(30, 0.2, 3), random_graph(300, 0.5, 4)};
+    bool is_pattern_valid;
+    std::vector<SchedulePlan *> plans;
+    std::vector<long long> expected;
+    for (Graph *g : graphs) {
+        std::vector<int> degree;
+        for (int v = 0; v < g->v_cnt; ++v)
+            degree.push_back(g->vertex[v + 1] - g->vertex[v]);
+        std::sort(degree.begin(), degree.end());
+        ASSERT_EQ(g->get_max_intersection_size(), degree[g->v_cnt - 2]);
+        for (const Pattern &pattern : {Pattern(Rectangle), Pattern(4, true)}) {
+            Schedule_IEP schedule(pattern, is_pattern_valid, 1, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt);
+            plans.push_back(SchedulePlan::create(schedule));
+            expected.push_back(g->pattern_matching(*plans.back()));
+        }
+    }
+
+    int saved = VertexSet::max_intersection_size;
+    VertexSet::max_intersection_size = 0;
+    std::vector<long long> ans(plans.size());
+    std::vector<std::thread> threads;
+    for (int i = 0; i < (int)plans.size(); ++i)
+        threads.push_back(std::thread([&, i] {
+            omp_set_num_threads(2);
+            ans[i] = graphs[i / 2]->pattern_matching(*plans[i]);
+        }));
+    for (std::thread &t : threads)
+        t.join();
+    VertexSet::max_intersection_size = saved;
+    ASSERT_EQ(ans, expected);
+
+    for (SchedulePlan *plan : plans)
+        SchedulePlan::destroy(plan);
+    for (Graph *g : graphs)
+        delete g;
+}
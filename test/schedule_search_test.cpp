@@ -0,0 +1,218 @@
+#include <gtest/gtest.h>
+#include <../include/graph.h>
+#include "../include/pattern.h"
+#include "../include/common.h"
+#include "../include/schedule_IEP.h"
+#include "test_graph.h"
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static bool has_edge(Graph *g, int u, int v) {
+    return std::binary_search(g->edge + g->vertex[u], g->edge + g->vertex[u + 1], v);
+}
+
+static void brute_force_dfs(Graph *g, const Pattern &pattern, std::vector<int> &embedding, int depth, long long &cnt) {
+    int size = pattern.get_size();
+    const int *adj_mat = pattern.get_adj_mat_ptr();
+    if (depth == size) {
+        ++cnt;
+        return;
+    }
+    for (int v = 0; v < g->v_cnt; ++v) {
+        bool ok = true;
+        for (int i = 0; i < depth && ok; ++i)
+            if (embedding[i] == v || (adj_mat[INDEX(depth, i, size)] && !has_edge(g, v, embedding[i])))
+                ok = false;
+        if (ok) {
+            embedding[depth] = v;
+            brute_force_dfs(g, pattern, embedding, depth + 1, cnt);
+        }
+    }
+}
+
+// edge-induced subgraph count, patterns are given with every vertex adjacent to an earlier one
+static long long brute_force_count(Graph *g, const Pattern &pattern) {
+    int size = pattern.get_size();
+    const int *adj_mat = pattern.get_adj_mat_ptr();
+    std::vector<int> embedding(size);
+    long long cnt = 0;
+    brute_force_dfs(g, pattern, embedding, 0, cnt);
+
+    std::vector<int> perm(size);
+    for (int i = 0; i < size; ++i)
+        perm[i] = i;
+    long long automorphism_cnt = 0;
+    do {
+        bool ok = true;
+        for (int i = 0; i < size && ok; ++i)
+            for (int j = 0; j < size && ok; ++j)
+                if (adj_mat[INDEX(i, j, size)] != adj_mat[INDEX(perm[i], perm[j], size)])
+                    ok = false;
+        if (ok)
+            ++automorphism_cnt;
+    } while (std::next_permutation(perm.begin(), perm.end()));
+    return cnt / automorphism_cnt;
+}
+
+static Pattern cycle(int size) {
+    Pattern p(size);
+    for (int i = 0; i < size; ++i)
+        p.add_edge(i, (i + 1) % size);
+    return p;
+}
+
+static std::vector<Pattern> large_patterns() {
+    std::vector<Pattern> patterns;
+    patterns.push_back(cycle(7));
+    patterns.push_back(cycle(8));
+
+    // house with a tail
+    Pattern p(7);
+    p.add_edge(0, 1);
+    p.add_edge(1, 2);
+    p.add_edge(2, 3);
+    p.add_edge(3, 0);
+    p.add_edge(0, 4);
+    p.add_edge(1, 4);
+    p.add_edge(2, 5);
+    p.add_edge(5, 6);
+    patterns.push_back(p);
+
+    // two 4-cliques sharing a vertex
+    Pattern q(7);
+    for (int i = 0; i < 4; ++i)
+        for (int j = i + 1; j < 4; ++j)
+            q.add_edge(i, j);
+    for (int i = 3; i < 7; ++i)
+        for (int j = i + 1; j < 7; ++j)
+            q.add_edge(i, j);
+    patterns.push_back(q);
+
+    // star with one subdivided edge
+    Pattern s(8);
+    for (int i = 1; i < 7; ++i)
+        s.add_edge(0, i);
+    s.add_edge(6, 7);
+    patterns.push_back(s);
+    return patterns;
+}
+
+TEST(schedule_search_test, large_pattern_counts) {
+    Graph *g = random_graph(24, 0.3, 2022);
+    for (const Pattern &pattern : large_patterns()) {
+        long long expected = brute_force_count(g, pattern);
+        for (int restricts_type = 1; restricts_type <= 2; ++restricts_type)
+            for (int use_in_exclusion_optimize = 0; use_in_exclusion_optimize <= 1; ++use_in_exclusion_optimize)
+                for (const DegreeStatistics* degree_stats : {(const DegreeStatistics*)nullptr, (const DegreeStatistics*)g->degree_stats}) {
+                    bool is_pattern_valid;
+                    Schedule_IEP schedule(pattern, is_pattern_valid, 1, restricts_type, use_in_exclusion_optimize, g->v_cnt, g->e_cnt, g->tri_cnt, false, degree_stats);
+                    ASSERT_EQ(is_pattern_valid, true);
+                    ASSERT_EQ(g->pattern_matching(schedule), expected);
+                }
+    }
+    delete g;
+}
+
+// beyond 8 vertices the orders are compared with GraphZero's restrictions,
+// restricts_type 1 then generates the full restriction sets of the best one
+TEST(schedule_search_test, larger_pattern_counts) {
+    std::vector<Pattern> patterns;
+    patterns.push_back(cycle(9));
+    patterns.push_back(cycle(10));
+    // house with a path of 4 vertices on its roof
+    Pattern p(9);
+    p.add_edge(0, 1);
+    p.add_edge(1, 2);
+    p.add_edge(2, 3);
+    p.add_edge(3, 0);
+    p.add_edge(0, 4);
+    p.add_edge(1, 4);
+    for (int i = 4; i < 8; ++i)
+        p.add_edge(i, i + 1);
+    patterns.push_back(p);
+
+    Graph *g = random_graph(16, 0.35, 2022);
+    for (const Pattern &pattern : patterns) {
+        long long expected = brute_force_count(g, pattern);
+        ASSERT_GT(expected, 0);
+        for (int restricts_type = 1; restricts_type <= 2; ++restricts_type)
+            for (int use_in_exclusion_optimize = 0; use_in_exclusion_optimize <= 1; ++use_in_exclusion_optimize) {
+                bool is_pattern_valid;
+                Schedule_IEP schedule(pattern, is_pattern_valid, 1, restricts_type, use_in_exclusion_optimize, g->v_cnt, g->e_cnt, g->tri_cnt);
+                ASSERT_EQ(is_pattern_valid, true);
+                ASSERT_EQ(g->pattern_matching(schedule), expected);
+            }
+    }
+    delete g;
+}
+
+// the plans of the exhaustive search, see schedule_plans_6.txt
+TEST(schedule_search_test, same_plans_up_to_6_vertices) {
+    const long long stats[2][3] = {{7115, 201524, 608389}, {1000000, 20000000, 100000000}};
+    std::ifstream in("../../test/schedule_plans_6.txt");
+    ASSERT_TRUE(in.good());
+    int plan_cnt = 0;
+    for (std::string line; std::getline(in, line);) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream fields(line);
+        int stats_id, restricts_type, use_in_exclusion_optimize;
+        std::string adj, expected;
+        fields >> stats_id >> adj >> restricts_type >> use_in_exclusion_optimize;
+        std::getline(fields, expected);
+        int size = 3;
+        while (size * size < (int)adj.size())
+            ++size;
+        Pattern pattern(size);
+        for (int i = 0; i < size; ++i)
+            for (int j = 0; j < i; ++j)
+                if (adj[i * size + j] == '1')
+                    pattern.add_edge(i, j);
+
+        bool is_pattern_valid;
+        Schedule_IEP schedule(pattern, is_pattern_valid, 1, restricts_type, use_in_exclusion_optimize, stats[stats_id][0], stats[stats_id][1], stats[stats_id][2]);
+        ASSERT_TRUE(is_pattern_valid);
+        std::ostringstream plan;
+        plan << ' ';
+        for (int i = 0; i < size * size; ++i)
+            plan << (schedule.get_adj_mat_ptr()[i] ? '1' : '0');
+        plan << ' ' << schedule.get_in_exclusion_optimize_num();
+        for (const auto &restrict : schedule.restrict_pair)
+            plan << ' ' << restrict.first << ',' << restrict.second;
+        ASSERT_EQ(plan.str(), expected) << line;
+        ++plan_cnt;
+    }
+    // 141 patterns, 2 statistics, 2 restriction types, with and without IEP
+    ASSERT_EQ(plan_cnt, 1128);
+}
+
+TEST(schedule_search_test, planning_time) {
+    // the old search enumerated all size! orders, which took hours for 10 vertices
+    for (int size = 9; size <= 12; ++size) {
+        double t1 = get_wall_time();
+        bool is_pattern_valid;
+        Schedule_IEP schedule(cycle(size), is_pattern_valid, 1, 2, true, 1000000, 20000000, 100000000);
+        double t2 = get_wall_time();
+        ASSERT_EQ(is_pattern_valid, true);
+        ASSERT_EQ(schedule.get_multiplicity(), 2 * size);
+        ASSERT_LT(t2 - t1, Schedule_IEP::default_planning_time_limit + 1.0);
+    }
+}
+
+TEST(schedule_search_test, truncated_planning) {
+    bool is_pattern_valid;
+    Schedule_IEP complete(cycle(6), is_pattern_valid, 1, 2, true, 1000000, 20000000, 100000000);
+    ASSERT_EQ(is_pattern_valid, true);
+    ASSERT_FALSE(complete.is_planning_truncated());
+
+    // without time the search stops after the greedy order, which is still a valid plan
+    Schedule_IEP truncated(cycle(12), is_pattern_valid, 1, 2, true, 1000000, 20000000, 100000000, false, nullptr, 0);
+    ASSERT_EQ(is_pattern_valid, true);
+    ASSERT_TRUE(truncated.is_planning_truncated());
+    ASSERT_EQ(truncated.get_multiplicity(), 24);
+}
@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+#include <../include/graph.h>
+#include "../include/pattern.h"
+#include "../include/schedule_IEP.h"
+#include "../include/schedule_tuner.h"
+#include "test_graph.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+#include <vector>
+
+static std::vector<Pattern> patterns() {
+    return {Pattern(PatternType::Rectangle), Pattern(PatternType::House), Pattern(PatternType::Pentagon), Pattern(PatternType::Cycle_6_Tri)};
+}
+
+TEST(schedule_tuner_test, candidates) {
+    Graph* g = power_law_graph(3000, 6, 2.2, 2022);
+    for (const Pattern& pattern : patterns()) {
+        bool is_pattern_valid;
+        Schedule_IEP schedule(pattern, is_pattern_valid, 1, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt, false, g->degree_stats);
+        ASSERT_EQ(is_pattern_valid, true);
+        long long expected = g->pattern_matching(schedule);
+
+        std::vector<ScheduleCandidate> candidates = Schedule_IEP::get_candidates(pattern, 8, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt, g->degree_stats);
+        ASSERT_GT(candidates.size(), 0u);
+        ASSERT_LE(candidates.size(), 8u);
+        for (int i = 0; i < (int)candidates.size(); ++i) {
+            if (i > 0) {
+                ASSERT_LE(candidates[i - 1].cost, candidates[i].cost);
+                ASSERT_TRUE(candidates[i - 1].order != candidates[i].order || candidates[i - 1].restricts != candidates[i].restricts);
+            }
+            Schedule_IEP candidate(pattern, candidates[i]);
+            ASSERT_EQ(g->pattern_matching(candidate), expected);
+        }
+        // the best candidate is what the constructor plans
+        Schedule_IEP best(pattern, candidates[0]);
+        ASSERT_EQ(best.get_in_exclusion_optimize_redundancy(), schedule.get_in_exclusion_optimize_redundancy());
+        ASSERT_DOUBLE_EQ(best.estimate_cost(g->v_cnt, g->e_cnt, g->tri_cnt, g->degree_stats),
+                         schedule.estimate_cost(g->v_cnt, g->e_cnt, g->tri_cnt, g->degree_stats));
+    }
+    delete g;
+}
+
+TEST(schedule_tuner_test, tuned_counts) {
+    Graph* g = power_law_graph(3000, 6, 2.2, 2022);
+    ScheduleTuner tuner(g);
+    for (const Pattern& pattern : patterns()) {
+        bool is_pattern_valid;
+        Schedule_IEP schedule(pattern, is_pattern_valid, 1, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt, false, g->degree_stats);
+        long long expected = g->pattern_matching(schedule);
+
+        Schedule_IEP* tuned = tuner.tune(pattern, is_pattern_valid);
+        ASSERT_EQ(is_pattern_valid, true);
+        ASSERT_LT(tuner.get_picked_rank(), tuner.get_candidate_cnt());
+        ASSERT_LE(tuner.get_sample_cnt(), g->v_cnt);
+        ASSERT_EQ(g->pattern_matching(*tuned), expected);
+        delete tuned;
+    }
+    delete g;
+}
+
+TEST(schedule_tuner_test, whole_graph_sample) {
+    // with no budget limit and no candidate dropped, the last round samples every vertex
+    Graph* g = power_law_graph(3000, 6, 2.2, 2022);
+    ScheduleTuner tuner(g, 8, 1e9);
+    for (const Pattern& pattern : patterns()) {
+        bool is_pattern_valid;
+        Schedule_IEP schedule(pattern, is_pattern_valid, 1, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt, false, g->degree_stats);
+        long long expected = g->pattern_matching(schedule);
+
+        Schedule_IEP* tuned = tuner.tune(pattern, is_pattern_valid);
+        ASSERT_EQ(g->pattern_matching(*tuned), expected);
+        if (tuner.get_sample_cnt() == g->v_cnt) {
+            ASSERT_NEAR(tuner.get_estimated_count(), expected, 1e-6 * expected);
+        }
+        delete tuned;
+    }
+    delete g;
+}
+
+TEST(schedule_tuner_test, first_round_budget) {
+    // no budget: the first round is not run, the best ranked candidate is picked
+    Graph* g = power_law_graph(3000, 6, 2.2, 2022);
+    ScheduleTuner tuner(g, 8, 0);
+    for (const Pattern& pattern : patterns()) {
+        bool is_pattern_valid;
+        Schedule_IEP* tuned = tuner.tune(pattern, is_pattern_valid);
+        ASSERT_EQ(is_pattern_valid, true);
+        ASSERT_EQ(tuner.get_picked_rank(), 0);
+        ASSERT_EQ(tuner.get_round_cnt(), 0);
+        if (tuner.get_candidate_cnt() > 1) {
+            ASSERT_LE(tuner.get_sample_cnt(), ScheduleTuner::first_round_samples + DegreeStatistics::bucket_num);
+        }
+        delete tuned;
+    }
+    delete g;
+}
+
+TEST(schedule_tuner_test, invalid_pattern) {
+    Graph* g = power_law_graph(300, 6, 2.2, 2022);
+    Pattern disconnected(4);
+    disconnected.add_edge(0, 1);
+    disconnected.add_edge(2, 3);
+    ScheduleTuner tuner(g);
+    bool is_pattern_valid = true;
+    ASSERT_EQ(tuner.tune(disconnected, is_pattern_valid), nullptr);
+    ASSERT_FALSE(is_pattern_valid);
+    delete g;
+}
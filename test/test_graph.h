@@ -0,0 +1,77 @@
+#pragma once
+#include "../include/graph.h"
+#include "../include/vertex_set.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+#include <vector>
+
+// Random graphs of the tests, built in memory instead of loaded from a file.
+
+// The graph of the adjacency lists, which are sorted, with its statistics.
+inline Graph *graph_from_adj(std::vector<std::vector<int>> &adj) {
+    int n = adj.size();
+    Graph *g = new Graph();
+    g->v_cnt = n;
+    g->e_cnt = 0;
+    for (int i = 0; i < n; ++i)
+        g->e_cnt += adj[i].size();
+    g->vertex = new e_index_t[n + 1];
+    g->edge = new v_index_t[g->e_cnt];
+    std::vector<int> degree;
+    e_index_t pos = 0;
+    for (int i = 0; i < n; ++i) {
+        std::sort(adj[i].begin(), adj[i].end());
+        g->vertex[i] = pos;
+        for (int v : adj[i])
+            g->edge[pos++] = v;
+        degree.push_back(adj[i].size());
+    }
+    g->vertex[n] = pos;
+    // VertexSets built outside the engine still use the default
+    std::sort(degree.begin(), degree.end());
+    if (n >= 2)
+        VertexSet::max_intersection_size = std::max(VertexSet::max_intersection_size, degree[n - 2]);
+    g->compute_statistics();
+    return g;
+}
+
+// G(n, p); with core_p, the first n / 4 vertices are connected with
+// probability core_p instead, a dense core with large truss numbers
+inline Graph *random_graph(int n, double p, int seed, double core_p = -1) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::vector<std::vector<int>> adj(n);
+    for (int i = 0; i < n; ++i)
+        for (int j = i + 1; j < n; ++j)
+            if (uniform(rng) < (core_p >= 0 && j < n / 4 ? core_p : p)) {
+                adj[i].push_back(j);
+                adj[j].push_back(i);
+            }
+    return graph_from_adj(adj);
+}
+
+// Chung-Lu graph: vertex i has weight proportional to (i + 1)^(-1 / (exponent - 1)),
+// so the degrees follow a power law with the given exponent
+inline Graph *power_law_graph(int n, double avg_degree, double exponent, int seed) {
+    std::vector<double> weight(n);
+    for (int i = 0; i < n; ++i)
+        weight[i] = std::pow(i + 1.0, -1 / (exponent - 1));
+    std::mt19937_64 rng(seed);
+    std::discrete_distribution<int> pick(weight.begin(), weight.end());
+    std::set<std::pair<int, int>> edges;
+    long long m = (long long)(avg_degree * n / 2);
+    for (long long i = 0; i < m; ++i) {
+        int u = pick(rng), v = pick(rng);
+        if (u != v)
+            edges.insert(std::make_pair(std::min(u, v), std::max(u, v)));
+    }
+    std::vector<std::vector<int>> adj(n);
+    for (const auto &e : edges) {
+        adj[e.first].push_back(e.second);
+        adj[e.second].push_back(e.first);
+    }
+    return graph_from_adj(adj);
+}
@@ -0,0 +1,48 @@
+#include <gtest/gtest.h>
+#include <../include/graph.h>
+#include <../include/dataloader.h>
+#include "../include/common.h"
+#include "test_graph.h"
+
+#include <cstdint>
+#include <vector>
+
+TEST(triangle_counting_test, dense) {
+    // out lists of more than 256 vertices take the bitmap path
+    Graph *g = random_graph(1500, 0.4, 3, 0.7);
+    int n = g->v_cnt, words = (n + 63) / 64;
+    std::vector<std::vector<uint64_t>> adj(n, std::vector<uint64_t>(words, 0));
+    for (int u = 0; u < n; ++u)
+        for (e_index_t i = g->vertex[u]; i < g->vertex[u + 1]; ++i)
+            adj[u][g->edge[i] / 64] |= 1ULL << (g->edge[i] % 64);
+    long long tri_cnt = 0;
+    for (int u = 0; u < n; ++u)
+        for (e_index_t i = g->vertex[u]; i < g->vertex[u + 1]; ++i)
+            for (int k = 0; k < words; ++k)
+                tri_cnt += __builtin_popcountll(adj[u][k] & adj[g->edge[i]][k]);
+    tri_cnt /= 6;
+    ASSERT_EQ(g->tri_cnt, tri_cnt);
+
+    int *support = g->edge_support();
+    long long support_sum = 0;
+    for (e_index_t i = 0; i < g->e_cnt; ++i)
+        support_sum += support[i];
+    ASSERT_EQ(support_sum, tri_cnt * 6);
+    delete[] support;
+    delete g;
+}
+
+TEST(triangle_counting_test, mpi_single_rank) {
+    Graph *g;
+    DataLoader D;
+    ASSERT_EQ(D.fast_load(g, "../../dataset/wiki-vote.g"), true);
+    // the master thread of Graphmpi only hands out vertex ranges
+    for (int thread_count = 2; thread_count <= 4; ++thread_count)
+        ASSERT_EQ(g->triangle_counting_mpi(thread_count), 608389);
+    delete g;
+
+    // with hubs, whose out edges take the bitmap path
+    g = random_graph(1500, 0.4, 3, 0.7);
+    ASSERT_EQ(g->triangle_counting_mpi(2), g->triangle_counting_mt());
+    delete g;
+}
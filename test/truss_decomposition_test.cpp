@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include <../include/graph.h>
+#include <../include/dataloader.h>
+#include "../include/pattern.h"
+#include "../include/common.h"
+#include "test_graph.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+TEST(truss_decomposition_test, random) {
+    Graph *g = random_graph(120, 0.08, 7, 0.7);
+    int n = g->v_cnt;
+    std::vector<std::vector<bool>> adj(n, std::vector<bool>(n, false));
+    for (int u = 0; u < n; ++u)
+        for (e_index_t i = g->vertex[u]; i < g->vertex[u + 1]; ++i)
+            adj[u][g->edge[i]] = true;
+
+    int *support = g->edge_support();
+    for (int u = 0; u < n; ++u)
+        for (e_index_t i = g->vertex[u]; i < g->vertex[u + 1]; ++i) {
+            int v = g->edge[i], common = 0;
+            for (int w = 0; w < n; ++w)
+                common += adj[u][w] && adj[v][w];
+            ASSERT_EQ(support[i], common);
+        }
+
+    // the k-truss by removing edges of support below k - 2 until none is left
+    std::vector<std::vector<int>> expected(n, std::vector<int>(n, 0));
+    std::vector<std::vector<bool>> alive = adj;
+    for (int k = 3; ; ++k) {
+        bool removed = true;
+        while (removed) {
+            removed = false;
+            for (int u = 0; u < n; ++u)
+                for (int v = u + 1; v < n; ++v)
+                    if (alive[u][v]) {
+                        int common = 0;
+                        for (int w = 0; w < n; ++w)
+                            common += alive[u][w] && alive[v][w];
+                        if (common < k - 2) {
+                            alive[u][v] = alive[v][u] = false;
+                            expected[u][v] = expected[v][u] = k - 1;
+                            removed = true;
+                        }
+                    }
+        }
+        bool empty = true;
+        for (int u = 0; u < n; ++u)
+            for (int v = 0; v < n; ++v)
+                empty = empty && !alive[u][v];
+        if (empty)
+            break;
+    }
+
+    int *truss = g->truss_decomposition(support);
+    int max_truss = 0;
+    for (int u = 0; u < n; ++u)
+        for (e_index_t i = g->vertex[u]; i < g->vertex[u + 1]; ++i) {
+            ASSERT_EQ(truss[i], expected[u][g->edge[i]]);
+            max_truss = std::max(max_truss, truss[i]);
+        }
+    ASSERT_GE(max_truss, 5);
+
+    int *truss_again = g->truss_decomposition();
+    for (e_index_t i = 0; i < g->e_cnt; ++i)
+        ASSERT_EQ(truss_again[i], truss[i]);
+
+    delete[] support;
+    delete[] truss;
+    delete[] truss_again;
+    delete g;
+}
+
+TEST(truss_decomposition_test, clique_filter) {
+    Graph *g;
+    DataLoader D;
+    ASSERT_EQ(D.fast_load(g, "../../dataset/wiki-vote.g"), true);
+
+    ASSERT_EQ(Pattern(House).get_truss_number(), 2);
+    int *truss = g->truss_decomposition();
+    for (int size = 4; size <= 5; ++size) {
+        Pattern pattern(size, true);
+        ASSERT_EQ(pattern.get_truss_number(), size);
+        Graph *h = g->truss_subgraph(pattern.get_truss_number(), truss);
+        ASSERT_LT(h->e_cnt, g->e_cnt);
+
+        bool is_pattern_valid;
+        Schedule_IEP schedule(pattern, is_pattern_valid, 1, 1, true, g->v_cnt, g->e_cnt, g->tri_cnt);
+        ASSERT_EQ(is_pattern_valid, true);
+        Schedule_IEP filtered_schedule(pattern, is_pattern_valid, 1, 1, true, h->v_cnt, h->e_cnt, h->tri_cnt);
+        ASSERT_EQ(is_pattern_valid, true);
+        ASSERT_EQ(h->pattern_matching(filtered_schedule), g->pattern_matching(schedule));
+        delete h;
+    }
+    delete[] truss;
+    delete g;
+}